@@ -0,0 +1,96 @@
+#include "stdafx.h"
+
+#include "BarrierBatch.h"
+
+// the last pending barrier that touches the resource, or -1
+static size_t LastPendingOf (const SBarrierBatch& batch, const void* resource)
+{
+    for (size_t i = batch.m_pending.size(); i-- > 0;)
+    {
+        const SBarrier& barrier = batch.m_pending[i];
+        if (barrier.m_resource == resource || (barrier.m_type == EBarrierType::aliasing && barrier.m_resourceBefore == resource))
+            return i;
+    }
+    return size_t(-1);
+}
+
+void BarrierBatchTransition (SBarrierBatch& batch, const void* resource, UINT32 before, UINT32 after, UINT32 subresource, UINT32 flags)
+{
+    batch.m_stats.m_requested++;
+
+    if (flags == 0)
+    {
+        if (before == after)
+        {
+            batch.m_stats.m_dropped++;
+            return;
+        }
+
+        // A to B then B to C is A to C, and A to B then B to A is nothing
+        size_t last = LastPendingOf(batch, resource);
+        if (last != size_t(-1))
+        {
+            SBarrier& pending = batch.m_pending[last];
+            if (pending.m_type == EBarrierType::transition && pending.m_flags == 0 && pending.m_subresource == subresource && pending.m_after == before)
+            {
+                batch.m_stats.m_merged++;
+                pending.m_after = after;
+                if (pending.m_before == pending.m_after)
+                {
+                    batch.m_pending.erase(batch.m_pending.begin() + last);
+                    batch.m_stats.m_dropped++;
+                }
+                return;
+            }
+        }
+    }
+
+    SBarrier barrier;
+    barrier.m_type = EBarrierType::transition;
+    barrier.m_resource = resource;
+    barrier.m_subresource = subresource;
+    barrier.m_before = before;
+    barrier.m_after = after;
+    barrier.m_flags = flags;
+    batch.m_pending.push_back(barrier);
+}
+
+void BarrierBatchUnorderedAccess (SBarrierBatch& batch, const void* resource)
+{
+    batch.m_stats.m_requested++;
+
+    size_t last = LastPendingOf(batch, resource);
+    if (last != size_t(-1) && batch.m_pending[last].m_type == EBarrierType::unorderedAccess)
+    {
+        batch.m_stats.m_dropped++;
+        return;
+    }
+
+    SBarrier barrier;
+    barrier.m_type = EBarrierType::unorderedAccess;
+    barrier.m_resource = resource;
+    batch.m_pending.push_back(barrier);
+}
+
+void BarrierBatchAliasing (SBarrierBatch& batch, const void* resourceBefore, const void* resourceAfter)
+{
+    batch.m_stats.m_requested++;
+
+    SBarrier barrier;
+    barrier.m_type = EBarrierType::aliasing;
+    barrier.m_resource = resourceAfter;
+    barrier.m_resourceBefore = resourceBefore;
+    batch.m_pending.push_back(barrier);
+}
+
+void BarrierBatchFlush (SBarrierBatch& batch, std::vector<SBarrier>& barriers)
+{
+    barriers.clear();
+    if (batch.m_pending.empty())
+        return;
+
+    batch.m_stats.m_issued += batch.m_pending.size();
+    batch.m_stats.m_flushes++;
+    barriers.swap(batch.m_pending);
+    batch.m_pending.clear();
+}
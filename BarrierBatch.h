@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+// Collects resource barriers so that they go to the command list in one ResourceBarrier call, at the points where the
+// commands after them need them, instead of one call per barrier. A transition that undoes or continues the last pending
+// transition of the same resource is merged into it, and a uav barrier right after another of the same resource is
+// dropped. Resources are compared by address, and states and flags are D3D12_RESOURCE_STATES and
+// D3D12_RESOURCE_BARRIER_FLAGS values. cdGraphicsAPIDX12 owns one per queue and flushes them into their command lists.
+//
+// Nothing may use a resource with pending barriers until they are flushed, which is what lets transitions be merged.
+
+static const UINT32 c_barrierAllSubresources = 0xffffffff;
+
+enum class EBarrierType
+{
+    transition,
+    unorderedAccess,
+    aliasing,
+};
+
+struct SBarrier
+{
+    EBarrierType    m_type = EBarrierType::transition;
+    const void*     m_resource = nullptr;           // for aliasing, the resource taking over the memory
+    const void*     m_resourceBefore = nullptr;     // for aliasing, the resource that had it, if known
+    UINT32          m_subresource = c_barrierAllSubresources;
+    UINT32          m_before = 0;
+    UINT32          m_after = 0;
+    UINT32          m_flags = 0;                    // split barriers are never merged
+};
+
+struct SBarrierBatchStats
+{
+    size_t m_requested = 0;
+    size_t m_issued = 0;
+    size_t m_merged = 0;        // transitions folded into a pending one
+    size_t m_dropped = 0;       // transitions that went nowhere and repeated uav barriers
+    size_t m_flushes = 0;       // flushes that issued anything, which are the ResourceBarrier calls
+};
+
+struct SBarrierBatch
+{
+    std::vector<SBarrier>   m_pending;
+    SBarrierBatchStats      m_stats;
+};
+
+void BarrierBatchTransition (SBarrierBatch& batch, const void* resource, UINT32 before, UINT32 after, UINT32 subresource = c_barrierAllSubresources, UINT32 flags = 0);
+
+// a null resource is a uav barrier for all uav accesses
+void BarrierBatchUnorderedAccess (SBarrierBatch& batch, const void* resource);
+
+void BarrierBatchAliasing (SBarrierBatch& batch, const void* resourceBefore, const void* resourceAfter);
+
+// Moves the pending barriers to barriers, in the order they were asked for, and counts them as issued.
+void BarrierBatchFlush (SBarrierBatch& batch, std::vector<SBarrier>& barriers);
@@ -0,0 +1,1869 @@
+#include "stdafx.h"
+
+#include "Benchmarks.h"
+#include "ObjLoader.h"
+#include "MeshProcessing.h"
+#include "MeshCache.h"
+#include "Math.h"
+#include "Culling.h"
+#include "DrawList.h"
+#include "CommandStateFilter.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorRing.h"
+#include "UploadRing.h"
+#include "ObjectTable.h"
+#include "StreamingCopy.h"
+#include "DeferredRelease.h"
+#include "Threading.h"
+#include "JobSystem.h"
+
+#include <stdarg.h>
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <tuple>
+
+BenchmarkReport::BenchmarkReport (const char* fileName)
+{
+    fopen_s(&m_file, fileName, "w");
+}
+
+BenchmarkReport::~BenchmarkReport ()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+void BenchmarkReport::Log (const char* format, ...)
+{
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    vsprintf_s(buffer, format, args);
+    va_end(args);
+
+    OutputDebugStringA(buffer);
+    OutputDebugStringA("\n");
+    if (m_file)
+        fprintf(m_file, "%s\n", buffer);
+}
+
+void BenchmarkReport::Check (bool condition, const char* format, ...)
+{
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    vsprintf_s(buffer, format, args);
+    va_end(args);
+
+    if (!condition)
+        ++m_failureCount;
+
+    Log("%s: %s", condition ? "PASS" : "FAIL", buffer);
+}
+
+// the thread counts to try in scaling benchmarks: 1, 2, 4 ... up to the hardware thread count
+static std::vector<size_t> GetThreadCounts ()
+{
+    size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    std::vector<size_t> ret;
+    for (size_t count = 1; count < maxThreads; count *= 2)
+        ret.push_back(count);
+    ret.push_back(maxThreads);
+    return ret;
+}
+
+static void BenchmarkObjLoad (BenchmarkReport& report)
+{
+    struct SObjFile
+    {
+        const char* fileName;
+        const char* baseDir;
+    };
+
+    // the sponza models are large and optional, so they are skipped if not present
+    static const SObjFile c_files[] =
+    {
+        { "assets/Models/cube/cube.obj", "assets/Models/cube/" },
+        { "assets/Models/sponza/sponza.obj", "assets/Models/sponza/" },
+        { "assets/Models/cryteksponza/sponza.obj", "assets/Models/cryteksponza/" },
+    };
+
+    static const int c_repeatCount = 3;
+
+    report.Log("===== OBJ Loading =====");
+
+    for (const SObjFile& file : c_files)
+    {
+        std::ifstream stream(file.fileName, std::ios::binary | std::ios::ate);
+        if (!stream)
+        {
+            report.Log("%s: not found, skipping", file.fileName);
+            continue;
+        }
+        double fileSizeMB = double(stream.tellg()) / (1024.0 * 1024.0);
+        stream.close();
+
+        // load with tinyobj as the reference
+        tinyobj::attrib_t attribReference;
+        std::vector<tinyobj::shape_t> shapesReference;
+        std::vector<tinyobj::material_t> materialsReference;
+        std::string err;
+        BenchmarkTimer timer;
+        tinyobj::LoadObj(&attribReference, &shapesReference, &materialsReference, &err, file.fileName, file.baseDir, true);
+        double referenceSeconds = timer.ElapsedSeconds();
+        report.Log("%s: %0.2f MB, tinyobj %0.2f MB/s", file.fileName, fileSizeMB, fileSizeMB / referenceSeconds);
+
+        for (size_t threadCount : GetThreadCounts())
+        {
+            double bestSeconds = 0.0;
+            for (int repeat = 0; repeat < c_repeatCount; ++repeat)
+            {
+                tinyobj::attrib_t attrib;
+                std::vector<tinyobj::shape_t> shapes;
+                std::vector<tinyobj::material_t> materials;
+                timer.Reset();
+                ObjLoadParallel(&attrib, &shapes, &materials, &err, file.fileName, file.baseDir, true, threadCount);
+                double seconds = timer.ElapsedSeconds();
+                if (repeat == 0 || seconds < bestSeconds)
+                    bestSeconds = seconds;
+
+                // the output has to match tinyobj exactly
+                if (repeat == 0)
+                {
+                    std::string difference;
+                    bool same = ObjLoadCompare(attribReference, shapesReference, materialsReference, attrib, shapes, materials, difference);
+                    report.Check(same, "%s with %zu threads matches tinyobj %s", file.fileName, threadCount, difference.c_str());
+                }
+            }
+
+            report.Log("  %2zu threads: %0.2f MB/s (%0.2fx tinyobj)", threadCount, fileSizeMB / bestSeconds, referenceSeconds / bestSeconds);
+        }
+    }
+}
+
+// Makes a triangle soup of a bumpy heightfield with gridSize x gridSize quads, where u follows x and v follows y.
+// The analytic normal and tangent of each grid point are also returned, indexed by y * (gridSize + 1) + x.
+static void MakeHeightfield (size_t gridSize, std::vector<Vertex>& triangleVertices, std::vector<XMFLOAT3>& normals, std::vector<XMFLOAT3>& tangents)
+{
+    auto height = [] (float x, float y) { return 0.25f * std::sinf(x) * std::cosf(y); };
+
+    size_t pointsPerRow = gridSize + 1;
+    std::vector<Vertex> points(pointsPerRow * pointsPerRow);
+    normals.resize(points.size());
+    tangents.resize(points.size());
+    float scale = 8.0f / float(gridSize);
+    for (size_t y = 0; y < pointsPerRow; ++y)
+    {
+        for (size_t x = 0; x < pointsPerRow; ++x)
+        {
+            float px = float(x) * scale;
+            float py = float(y) * scale;
+            float dzdx = 0.25f * std::cosf(px) * std::cosf(py);
+            float dzdy = -0.25f * std::sinf(px) * std::sinf(py);
+
+            Vertex& point = points[y * pointsPerRow + x];
+            point.position = XMFLOAT3(px, py, height(px, py));
+            point.normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            point.tangent = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+            point.uv = XMFLOAT2(float(x) / float(gridSize), float(y) / float(gridSize));
+
+            XMFLOAT3& normal = normals[y * pointsPerRow + x];
+            normal = XMFLOAT3(-dzdx, -dzdy, 1.0f);
+            Normalize(normal);
+
+            XMFLOAT3& tangent = tangents[y * pointsPerRow + x];
+            tangent = XMFLOAT3(1.0f, 0.0f, dzdx);
+            tangent = tangent - normal * Dot(normal, tangent);
+            Normalize(tangent);
+        }
+    }
+
+    triangleVertices.clear();
+    for (size_t y = 0; y < gridSize; ++y)
+    {
+        for (size_t x = 0; x < gridSize; ++x)
+        {
+            const Vertex& point00 = points[y * pointsPerRow + x];
+            const Vertex& point10 = points[y * pointsPerRow + x + 1];
+            const Vertex& point01 = points[(y + 1) * pointsPerRow + x];
+            const Vertex& point11 = points[(y + 1) * pointsPerRow + x + 1];
+
+            triangleVertices.push_back(point00);
+            triangleVertices.push_back(point01);
+            triangleVertices.push_back(point10);
+
+            triangleVertices.push_back(point01);
+            triangleVertices.push_back(point11);
+            triangleVertices.push_back(point10);
+        }
+    }
+}
+
+static void BenchmarkTangentSpace (BenchmarkReport& report)
+{
+    static const size_t c_gridSize = 512;
+    static const int c_repeatCount = 3;
+
+    report.Log("===== Tangent Space =====");
+
+    std::vector<Vertex> triangleVertices;
+    std::vector<XMFLOAT3> expectedNormals;
+    std::vector<XMFLOAT3> expectedTangents;
+    MakeHeightfield(c_gridSize, triangleVertices, expectedNormals, expectedTangents);
+
+    // welding should give back the grid points
+    std::vector<Vertex> weldedVertices;
+    std::vector<UINT32> indices;
+    BenchmarkTimer timer;
+    MeshWeldVertices(triangleVertices, weldedVertices, indices);
+    double weldSeconds = timer.ElapsedSeconds();
+    report.Check(weldedVertices.size() == expectedNormals.size(), "welding %zu triangle vertices gives %zu vertices (expected %zu)", triangleVertices.size(), weldedVertices.size(), expectedNormals.size());
+    report.Log("welding: %0.2f ms", weldSeconds * 1000.0);
+    if (weldedVertices.size() != expectedNormals.size())
+        return;
+
+    std::vector<Vertex> reference;
+    for (size_t threadCount : GetThreadCounts())
+    {
+        double bestSeconds = 0.0;
+        std::vector<Vertex> vertices;
+        for (int repeat = 0; repeat < c_repeatCount; ++repeat)
+        {
+            vertices = weldedVertices;
+            timer.Reset();
+            MeshCalculateTangentSpace(vertices, indices, true, threadCount);
+            double seconds = timer.ElapsedSeconds();
+            if (repeat == 0 || seconds < bestSeconds)
+                bestSeconds = seconds;
+        }
+        report.Log("  %2zu threads: %0.2f ms, %0.2f M triangles/s", threadCount, bestSeconds * 1000.0, double(indices.size() / 3) / (bestSeconds * 1000000.0));
+
+        // the results have to be the same no matter how many threads did the work
+        if (reference.empty())
+            reference = vertices;
+        else
+            report.Check(memcmp(&reference[0], &vertices[0], vertices.size() * sizeof(Vertex)) == 0, "results with %zu threads match 1 thread", threadCount);
+    }
+
+    // compare against the analytic tangent frames. The grid point of a vertex comes from its uv.
+    float minNormalDot = 1.0f;
+    float minTangentDot = 1.0f;
+    size_t wrongHandedness = 0;
+    for (size_t i = 0; i < reference.size(); ++i)
+    {
+        size_t x = size_t(reference[i].uv.x * float(c_gridSize) + 0.5f);
+        size_t y = size_t(reference[i].uv.y * float(c_gridSize) + 0.5f);
+        size_t gridIndex = y * (c_gridSize + 1) + x;
+
+        XMFLOAT3 tangent(reference[i].tangent.x, reference[i].tangent.y, reference[i].tangent.z);
+        minNormalDot = std::min<float>(minNormalDot, Dot(reference[i].normal, expectedNormals[gridIndex]));
+        minTangentDot = std::min<float>(minTangentDot, Dot(tangent, expectedTangents[gridIndex]));
+        if (reference[i].tangent.w != 1.0f)
+            ++wrongHandedness;
+    }
+    report.Check(minNormalDot > 0.99f, "normals match the analytic normals (min dot %f)", minNormalDot);
+    report.Check(minTangentDot > 0.99f, "tangents match the analytic tangents (min dot %f)", minTangentDot);
+    report.Check(wrongHandedness == 0, "%zu vertices have the wrong handedness", wrongHandedness);
+
+    // mirroring u should flip the handedness but not the normal
+    std::vector<Vertex> mirrored = weldedVertices;
+    for (Vertex& vertex : mirrored)
+        vertex.uv.x = 1.0f - vertex.uv.x;
+    MeshCalculateTangentSpace(mirrored, indices, true);
+    size_t notMirrored = 0;
+    for (size_t i = 0; i < mirrored.size(); ++i)
+    {
+        if (mirrored[i].tangent.w != -1.0f || Dot(mirrored[i].normal, reference[i].normal) < 0.999f)
+            ++notMirrored;
+    }
+    report.Check(notMirrored == 0, "mirrored uvs flip the handedness (%zu vertices did not)", notMirrored);
+}
+
+// Appends a triangle soup of a sphere with radius 1 made of 64x32 slices
+static void MakeSphere (const XMFLOAT3& center, std::vector<Vertex>& triangleVertices)
+{
+    static const size_t c_slicesX = 64;
+    static const size_t c_slicesY = 32;
+
+    for (size_t indexY = 0; indexY < c_slicesY; ++indexY)
+    {
+        for (size_t indexX = 0; indexX < c_slicesX; ++indexX)
+        {
+            auto makePoint = [&] (size_t x, size_t y)
+            {
+                float percentX = float(x) / float(c_slicesX);
+                float percentY = float(y) / float(c_slicesY);
+                float sinX = std::sinf(percentX * 2 * c_pi);
+                float cosX = std::cosf(percentX * 2 * c_pi);
+                float sinY = std::sinf(percentY * c_pi);
+                float cosY = std::cosf(percentY * c_pi);
+
+                Vertex ret;
+                ret.position = center + XMFLOAT3(cosX * sinY, cosY, sinX * sinY);
+                ret.normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+                ret.tangent = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+                ret.uv = XMFLOAT2(percentX, percentY);
+                return ret;
+            };
+
+            Vertex point00 = makePoint(indexX, indexY);
+            Vertex point10 = makePoint(indexX + 1, indexY);
+            Vertex point01 = makePoint(indexX, indexY + 1);
+            Vertex point11 = makePoint(indexX + 1, indexY + 1);
+
+            triangleVertices.push_back(point00);
+            triangleVertices.push_back(point01);
+            triangleVertices.push_back(point10);
+
+            triangleVertices.push_back(point01);
+            triangleVertices.push_back(point11);
+            triangleVertices.push_back(point10);
+        }
+    }
+}
+
+// Makes a triangle soup of a 4x4 grid of spheres with radius 1, 4 units apart, on the xz plane
+static void MakeSphereField (std::vector<Vertex>& triangleVertices)
+{
+    triangleVertices.clear();
+    for (size_t sphereIndex = 0; sphereIndex < 16; ++sphereIndex)
+        MakeSphere(XMFLOAT3(float(sphereIndex % 4) * 4.0f, 0.0f, float(sphereIndex / 4) * 4.0f), triangleVertices);
+}
+
+// the vertical field of view and the screen height in pixels that the camera path is made for
+static const float c_cameraPathFov = XM_PIDIV4;
+static const float c_cameraPathViewHeight = 1080.0f;
+
+// Makes the view projection matrices of a scripted camera path through a scene's bounding box, laid out like
+// SConstantBuffer::viewProjectionMatrix. The camera walks down the long horizontal axis of the box at a quarter of its
+// height, looking ahead and sweeping left and right, then walks back.
+static void MakeCameraPath (const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, size_t numFrames, std::vector<XMMATRIX>& viewProjections, std::vector<XMFLOAT3>& positions)
+{
+    XMFLOAT3 size = boxMax - boxMin;
+    bool alongX = size.x >= size.z;
+    float diagonal = std::sqrtf(Dot(size, size));
+    XMMATRIX projection = XMMatrixPerspectiveFovRH(c_cameraPathFov, 16.0f / 9.0f, diagonal * 0.0005f, diagonal * 2.0f);
+
+    viewProjections.resize(numFrames);
+    positions.resize(numFrames);
+    for (size_t frame = 0; frame < numFrames; ++frame)
+    {
+        float t = float(frame) / float(numFrames);
+        float walk = 0.1f + 0.8f * (t < 0.5f ? t * 2.0f : 2.0f - t * 2.0f);
+        float forward = t < 0.5f ? 1.0f : -1.0f;
+        float sweep = std::sinf(t * 4.0f * c_pi) * c_pi / 3.0f;
+
+        XMFLOAT3& position = positions[frame];
+        position.x = boxMin.x + size.x * (alongX ? walk : 0.5f);
+        position.y = boxMin.y + size.y * 0.25f;
+        position.z = boxMin.z + size.z * (alongX ? 0.5f : walk);
+
+        XMFLOAT3 direction = alongX ? XMFLOAT3(forward * std::cosf(sweep), 0.0f, std::sinf(sweep)) : XMFLOAT3(std::sinf(sweep), 0.0f, forward * std::cosf(sweep));
+        XMFLOAT3 target = position + direction;
+        XMMATRIX view = XMMatrixLookAtRH(XMLoadFloat3(&position), XMLoadFloat3(&target), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        viewProjections[frame] = XMMatrixTranspose(XMMatrixMultiply(view, projection));
+    }
+}
+
+static void BenchmarkMeshlets (BenchmarkReport& report)
+{
+    struct SScene
+    {
+        const char* fileName;
+        const char* baseDir;
+    };
+
+    // the sponza models are large and optional, so they are skipped if not present. The sphere field is procedural.
+    static const SScene c_scenes[] =
+    {
+        { "assets/Models/sponza/sponza.obj", "assets/Models/sponza/" },
+        { "assets/Models/cryteksponza/sponza.obj", "assets/Models/cryteksponza/" },
+        { nullptr, nullptr },
+    };
+
+    static const size_t c_numFrames = 240;
+
+    report.Log("===== Meshlets =====");
+
+    for (const SScene& scene : c_scenes)
+    {
+        const char* sceneName = scene.fileName ? scene.fileName : "sphere field";
+
+        // load or make the scene
+        std::vector<SMeshCacheSubObject> subObjects;
+        BenchmarkTimer timer;
+        if (scene.fileName)
+        {
+            std::ifstream stream(scene.fileName);
+            if (!stream)
+            {
+                report.Log("%s: not found, skipping", scene.fileName);
+                continue;
+            }
+            stream.close();
+
+            if (!ModelLoadMeshData(scene.fileName, scene.baseDir, false, subObjects))
+            {
+                report.Check(false, "%s: could not load", scene.fileName);
+                continue;
+            }
+            report.Log("%s: loaded in %0.2f ms", sceneName, timer.ElapsedSeconds() * 1000.0);
+        }
+        else
+        {
+            std::vector<Vertex> triangleVertices;
+            MakeSphereField(triangleVertices);
+            subObjects.resize(1);
+            MeshWeldVertices(triangleVertices, subObjects[0].m_vertices, subObjects[0].m_indices);
+            MeshCalculateTangentSpace(subObjects[0].m_vertices, subObjects[0].m_indices, true);
+            timer.Reset();
+            MeshletsBuild(subObjects[0].m_vertices, subObjects[0].m_indices, subObjects[0].m_meshlets);
+            report.Log("%s: meshlets built in %0.2f ms", sceneName, timer.ElapsedSeconds() * 1000.0);
+        }
+
+        // validate the meshlets
+        size_t numMeshlets = 0;
+        size_t numMeshletVertices = 0;
+        size_t numTriangles = 0;
+        size_t limitFailures = 0;
+        size_t coverageFailures = 0;
+        size_t boundsFailures = 0;
+        XMFLOAT3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+        XMFLOAT3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (const SMeshCacheSubObject& subObject : subObjects)
+        {
+            const SMeshlets& meshlets = subObject.m_meshlets;
+            std::vector<std::array<UINT32, 3>> expectedTriangles;
+            std::vector<std::array<UINT32, 3>> meshletTriangles;
+
+            // triangles are compared rotated so the smallest index is first, which keeps the winding
+            auto addTriangle = [] (std::vector<std::array<UINT32, 3>>& triangles, UINT32 a, UINT32 b, UINT32 c)
+            {
+                if (b < a && b < c)
+                    triangles.push_back({ b, c, a });
+                else if (c < a && c < b)
+                    triangles.push_back({ c, a, b });
+                else
+                    triangles.push_back({ a, b, c });
+            };
+
+            // the meshlets are of LOD 0 only
+            size_t numIndices = subObject.m_lods.empty() ? subObject.m_indices.size() : subObject.m_lods[0].m_indexCount;
+            for (size_t i = 0; i + 2 < numIndices; i += 3)
+                addTriangle(expectedTriangles, subObject.m_indices[i], subObject.m_indices[i + 1], subObject.m_indices[i + 2]);
+
+            for (const SMeshlet& meshlet : meshlets.m_meshlets)
+            {
+                if (meshlet.m_vertexCount > c_meshletMaxVertices || meshlet.m_triangleCount > c_meshletMaxTriangles)
+                    ++limitFailures;
+
+                const UINT32* vertices = &meshlets.m_vertices[meshlet.m_vertexOffset];
+                const UINT8* triangles = &meshlets.m_triangles[meshlet.m_triangleOffset * 3];
+                for (UINT32 i = 0; i < meshlet.m_triangleCount; ++i)
+                    addTriangle(meshletTriangles, vertices[triangles[i * 3]], vertices[triangles[i * 3 + 1]], vertices[triangles[i * 3 + 2]]);
+
+                for (UINT32 i = 0; i < meshlet.m_vertexCount; ++i)
+                {
+                    XMFLOAT3 offset = subObject.m_vertices[vertices[i]].position - meshlet.m_center;
+                    if (std::sqrtf(Dot(offset, offset)) > meshlet.m_radius * 1.0001f + 1e-6f)
+                        ++boundsFailures;
+                }
+            }
+
+            std::sort(expectedTriangles.begin(), expectedTriangles.end());
+            std::sort(meshletTriangles.begin(), meshletTriangles.end());
+            if (expectedTriangles != meshletTriangles)
+                ++coverageFailures;
+
+            for (const Vertex& vertex : subObject.m_vertices)
+            {
+                boxMin = XMFLOAT3(std::min<float>(boxMin.x, vertex.position.x), std::min<float>(boxMin.y, vertex.position.y), std::min<float>(boxMin.z, vertex.position.z));
+                boxMax = XMFLOAT3(std::max<float>(boxMax.x, vertex.position.x), std::max<float>(boxMax.y, vertex.position.y), std::max<float>(boxMax.z, vertex.position.z));
+            }
+
+            numMeshlets += meshlets.m_meshlets.size();
+            numMeshletVertices += meshlets.m_vertices.size();
+            numTriangles += numIndices / 3;
+        }
+
+        report.Log("  %zu subobjects, %zu triangles, %zu meshlets, %0.1f vertices and %0.1f triangles per meshlet",
+            subObjects.size(), numTriangles, numMeshlets, double(numMeshletVertices) / double(numMeshlets), double(numTriangles) / double(numMeshlets));
+        report.Check(limitFailures == 0, "%s: %zu meshlets over the vertex or triangle limit", sceneName, limitFailures);
+        report.Check(coverageFailures == 0, "%s: %zu subobjects where the meshlets don't have exactly the mesh's triangles", sceneName, coverageFailures);
+        report.Check(boundsFailures == 0, "%s: %zu vertices outside of their meshlet's bounding sphere", sceneName, boundsFailures);
+
+        // cull along the camera path
+        std::vector<XMMATRIX> viewProjections;
+        std::vector<XMFLOAT3> cameraPositions;
+        MakeCameraPath(boxMin, boxMax, c_numFrames, viewProjections, cameraPositions);
+
+        SMeshletCullStats stats;
+        size_t coneFailures = 0;
+        double cullSeconds = 0.0;
+        std::vector<UINT32> visibleMeshlets;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            SFrustum frustum = FrustumFromViewProjection(viewProjections[frame]);
+            for (const SMeshCacheSubObject& subObject : subObjects)
+            {
+                visibleMeshlets.clear();
+                timer.Reset();
+                MeshletsCull(subObject.m_meshlets, XMMatrixIdentity(), frustum, cameraPositions[frame], visibleMeshlets, stats);
+                cullSeconds += timer.ElapsedSeconds();
+
+                // every triangle of a cone culled meshlet that is inside the frustum has to be back facing
+                size_t visibleIndex = 0;
+                for (size_t meshletIndex = 0; meshletIndex < subObject.m_meshlets.m_meshlets.size(); ++meshletIndex)
+                {
+                    if (visibleIndex < visibleMeshlets.size() && visibleMeshlets[visibleIndex] == meshletIndex)
+                    {
+                        ++visibleIndex;
+                        continue;
+                    }
+
+                    const SMeshlet& meshlet = subObject.m_meshlets.m_meshlets[meshletIndex];
+                    if (!FrustumTestSphere(frustum, meshlet.m_center, meshlet.m_radius))
+                        continue;
+
+                    const UINT32* vertices = &subObject.m_meshlets.m_vertices[meshlet.m_vertexOffset];
+                    const UINT8* triangles = &subObject.m_meshlets.m_triangles[meshlet.m_triangleOffset * 3];
+                    for (UINT32 i = 0; i < meshlet.m_triangleCount; ++i)
+                    {
+                        const XMFLOAT3& p0 = subObject.m_vertices[vertices[triangles[i * 3 + 0]]].position;
+                        const XMFLOAT3& p1 = subObject.m_vertices[vertices[triangles[i * 3 + 1]]].position;
+                        const XMFLOAT3& p2 = subObject.m_vertices[vertices[triangles[i * 3 + 2]]].position;
+                        XMFLOAT3 normal = Cross(p2 - p0, p1 - p0);
+                        XMFLOAT3 toCamera = cameraPositions[frame] - p0;
+                        if (Dot(normal, toCamera) > 1e-4f * std::sqrtf(Dot(normal, normal) * Dot(toCamera, toCamera)))
+                        {
+                            ++coneFailures;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        report.Check(coneFailures == 0, "%s: %zu cone culled meshlets had front facing triangles", sceneName, coneFailures);
+        report.Log("  %zu frames: %0.1f%% of meshlets frustum culled, %0.1f%% cone culled, %0.1f%% of triangles rejected, %0.3f ms per frame",
+            c_numFrames,
+            100.0 * double(stats.m_meshletsFrustumCulled) / double(stats.m_meshletsTested),
+            100.0 * double(stats.m_meshletsConeCulled) / double(stats.m_meshletsTested),
+            100.0 * double(stats.m_trianglesTested - stats.m_trianglesVisible) / double(stats.m_trianglesTested),
+            cullSeconds * 1000.0 / double(c_numFrames));
+    }
+}
+
+static void BenchmarkLods (BenchmarkReport& report)
+{
+    // An object of a scene: a subobject, and where it is
+    struct SObject
+    {
+        size_t      m_subObject;
+        XMFLOAT3    m_offset;
+        XMFLOAT3    m_center;
+        float       m_radius;
+    };
+
+    // the sponza models are large and optional, so they are skipped if not present. The sphere grid is procedural.
+    static const char* c_scenes[][2] =
+    {
+        { "assets/Models/sponza/sponza.obj", "assets/Models/sponza/" },
+        { "assets/Models/cryteksponza/sponza.obj", "assets/Models/cryteksponza/" },
+        { nullptr, nullptr },
+    };
+
+    static const size_t c_numFrames = 240;
+    static const size_t c_sphereGridSize = 32;
+    static const float c_sphereGridSpacing = 6.0f;
+
+    report.Log("===== LODs =====");
+
+    for (const auto& scene : c_scenes)
+    {
+        const char* fileName = scene[0];
+        const char* sceneName = fileName ? fileName : "sphere grid";
+
+        // load or make the scene
+        std::vector<SMeshCacheSubObject> subObjects;
+        std::vector<SObject> objects;
+        if (fileName)
+        {
+            std::ifstream stream(fileName);
+            if (!stream)
+            {
+                report.Log("%s: not found, skipping", fileName);
+                continue;
+            }
+            stream.close();
+
+            if (!ModelLoadMeshData(fileName, scene[1], false, subObjects))
+            {
+                report.Check(false, "%s: could not load", fileName);
+                continue;
+            }
+
+            for (size_t i = 0; i < subObjects.size(); ++i)
+                objects.push_back({ i, XMFLOAT3(0.0f, 0.0f, 0.0f) });
+        }
+        else
+        {
+            std::vector<Vertex> triangleVertices;
+            MakeSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), triangleVertices);
+            subObjects.resize(1);
+            MeshWeldVertices(triangleVertices, subObjects[0].m_vertices, subObjects[0].m_indices);
+            MeshCalculateTangentSpace(subObjects[0].m_vertices, subObjects[0].m_indices, true);
+
+            BenchmarkTimer timer;
+            MeshLodBuild(subObjects[0].m_vertices, subObjects[0].m_indices, subObjects[0].m_lods);
+            report.Log("%s: LODs built in %0.2f ms", sceneName, timer.ElapsedSeconds() * 1000.0);
+
+            for (size_t i = 0; i < c_sphereGridSize * c_sphereGridSize; ++i)
+                objects.push_back({ 0, XMFLOAT3(float(i % c_sphereGridSize) * c_sphereGridSpacing, 0.0f, float(i / c_sphereGridSize) * c_sphereGridSpacing) });
+        }
+
+        // validate the LODs
+        size_t lodCounts[c_meshLodMaxLods + 1] = {};
+        size_t lodTriangles[c_meshLodMaxLods] = {};
+        size_t rangeFailures = 0;
+        size_t orderFailures = 0;
+        size_t degenerateFailures = 0;
+        size_t seamFailures = 0;
+        for (const SMeshCacheSubObject& subObject : subObjects)
+        {
+            const std::vector<SMeshLod>& lods = subObject.m_lods;
+            lodCounts[std::min<size_t>(lods.size(), c_meshLodMaxLods)]++;
+            if (lods.empty() || lods.size() > c_meshLodMaxLods || lods[0].m_indexOffset != 0)
+            {
+                ++rangeFailures;
+                continue;
+            }
+
+            // vertices that share a position with another vertex are on a seam, and have to be in every LOD
+            std::vector<UINT8> usedByLod0(subObject.m_vertices.size(), 0);
+            for (size_t i = 0; i < lods[0].m_indexCount; ++i)
+                usedByLod0[subObject.m_indices[i]] = 1;
+            std::vector<UINT32> order;
+            for (UINT32 i = 0; i < UINT32(subObject.m_vertices.size()); ++i)
+            {
+                if (usedByLod0[i])
+                    order.push_back(i);
+            }
+            auto positionLess = [&] (UINT32 a, UINT32 b)
+            {
+                const XMFLOAT3& positionA = subObject.m_vertices[a].position;
+                const XMFLOAT3& positionB = subObject.m_vertices[b].position;
+                return std::make_tuple(positionA.x, positionA.y, positionA.z) < std::make_tuple(positionB.x, positionB.y, positionB.z);
+            };
+            std::sort(order.begin(), order.end(), positionLess);
+            std::vector<UINT32> seamVertices;
+            for (size_t i = 0; i + 1 < order.size(); ++i)
+            {
+                if (!positionLess(order[i], order[i + 1]))
+                {
+                    seamVertices.push_back(order[i]);
+                    seamVertices.push_back(order[i + 1]);
+                }
+            }
+
+            for (size_t lodIndex = 0; lodIndex < lods.size(); ++lodIndex)
+            {
+                const SMeshLod& lod = lods[lodIndex];
+                lodTriangles[lodIndex] += lod.m_indexCount / 3;
+                if (size_t(lod.m_indexOffset) + lod.m_indexCount > subObject.m_indices.size() || lod.m_indexCount % 3 != 0)
+                {
+                    ++rangeFailures;
+                    continue;
+                }
+                if (lodIndex > 0 && (lod.m_indexCount >= lods[lodIndex - 1].m_indexCount || lod.m_error < lods[lodIndex - 1].m_error))
+                    ++orderFailures;
+
+                std::vector<UINT8> used(subObject.m_vertices.size(), 0);
+                const UINT32* indices = &subObject.m_indices[lod.m_indexOffset];
+                for (size_t i = 0; i < lod.m_indexCount; i += 3)
+                {
+                    if (lodIndex > 0 && (indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i] == indices[i + 2]))
+                        ++degenerateFailures;
+                    for (size_t corner = 0; corner < 3; ++corner)
+                    {
+                        if (indices[i + corner] >= subObject.m_vertices.size())
+                            ++rangeFailures;
+                        else
+                            used[indices[i + corner]] = 1;
+                    }
+                }
+
+                for (UINT32 vertex : seamVertices)
+                {
+                    if (!used[vertex])
+                    {
+                        ++seamFailures;
+                        break;
+                    }
+                }
+            }
+        }
+
+        report.Log("  %zu subobjects with 1/2/3/4/5 LODs: %zu/%zu/%zu/%zu/%zu", subObjects.size(), lodCounts[1], lodCounts[2], lodCounts[3], lodCounts[4], lodCounts[5]);
+        report.Log("  triangles per LOD: %zu/%zu/%zu/%zu/%zu", lodTriangles[0], lodTriangles[1], lodTriangles[2], lodTriangles[3], lodTriangles[4]);
+        report.Check(rangeFailures == 0, "%s: %zu bad LOD index ranges", sceneName, rangeFailures);
+        report.Check(orderFailures == 0, "%s: %zu LODs that don't have fewer triangles and more error than the one before", sceneName, orderFailures);
+        report.Check(degenerateFailures == 0, "%s: %zu degenerate triangles made by simplifying", sceneName, degenerateFailures);
+        report.Check(seamFailures == 0, "%s: %zu LODs missing seam vertices", sceneName, seamFailures);
+
+        // the bounding sphere of each object, around the center of its bounding box
+        XMFLOAT3 sceneMin(FLT_MAX, FLT_MAX, FLT_MAX);
+        XMFLOAT3 sceneMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (SObject& object : objects)
+        {
+            const SMeshCacheSubObject& subObject = subObjects[object.m_subObject];
+            XMFLOAT3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+            XMFLOAT3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (const Vertex& vertex : subObject.m_vertices)
+            {
+                XMFLOAT3 position = vertex.position + object.m_offset;
+                boxMin = XMFLOAT3(std::min<float>(boxMin.x, position.x), std::min<float>(boxMin.y, position.y), std::min<float>(boxMin.z, position.z));
+                boxMax = XMFLOAT3(std::max<float>(boxMax.x, position.x), std::max<float>(boxMax.y, position.y), std::max<float>(boxMax.z, position.z));
+            }
+            object.m_center = (boxMin + boxMax) * 0.5f;
+            object.m_radius = 0.0f;
+            for (const Vertex& vertex : subObject.m_vertices)
+            {
+                XMFLOAT3 offset = vertex.position + object.m_offset - object.m_center;
+                object.m_radius = std::max<float>(object.m_radius, std::sqrtf(Dot(offset, offset)));
+            }
+
+            sceneMin = XMFLOAT3(std::min<float>(sceneMin.x, boxMin.x), std::min<float>(sceneMin.y, boxMin.y), std::min<float>(sceneMin.z, boxMin.z));
+            sceneMax = XMFLOAT3(std::max<float>(sceneMax.x, boxMax.x), std::max<float>(sceneMax.y, boxMax.y), std::max<float>(sceneMax.z, boxMax.z));
+        }
+
+        // the sphere grid is flat, so give the camera some height to walk at
+        if (!fileName)
+            sceneMax.y += 8.0f;
+
+        // draw along the camera path, selecting LODs the same way the renderer does
+        std::vector<XMMATRIX> viewProjections;
+        std::vector<XMFLOAT3> cameraPositions;
+        MakeCameraPath(sceneMin, sceneMax, c_numFrames, viewProjections, cameraPositions);
+        float projectionScaleY = 1.0f / std::tanf(c_cameraPathFov * 0.5f);
+
+        size_t trianglesFull = 0;
+        size_t trianglesLod = 0;
+        size_t selectedLods[c_meshLodMaxLods] = {};
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            SFrustum frustum = FrustumFromViewProjection(viewProjections[frame]);
+            for (const SObject& object : objects)
+            {
+                if (!FrustumTestSphere(frustum, object.m_center, object.m_radius))
+                    continue;
+
+                const std::vector<SMeshLod>& lods = subObjects[object.m_subObject].m_lods;
+                XMFLOAT3 offset = object.m_center - cameraPositions[frame];
+                float distance = std::sqrtf(Dot(offset, offset)) - object.m_radius;
+                size_t lodIndex = MeshLodSelect(lods, MeshLodPixelsPerUnit(projectionScaleY, c_cameraPathViewHeight, 1.0f, distance));
+
+                selectedLods[lodIndex]++;
+                trianglesFull += lods[0].m_indexCount / 3;
+                trianglesLod += lods[lodIndex].m_indexCount / 3;
+            }
+        }
+
+        report.Log("  %zu frames: %0.0f triangles per frame at LOD 0, %0.0f with LODs (%0.1f%% fewer)", c_numFrames,
+            double(trianglesFull) / double(c_numFrames), double(trianglesLod) / double(c_numFrames),
+            trianglesFull > 0 ? 100.0 * double(trianglesFull - trianglesLod) / double(trianglesFull) : 0.0);
+        report.Log("  draws per LOD: %zu/%zu/%zu/%zu/%zu", selectedLods[0], selectedLods[1], selectedLods[2], selectedLods[3], selectedLods[4]);
+    }
+}
+
+static void BenchmarkFrustumCulling (BenchmarkReport& report)
+{
+    static const size_t c_numObjects = 100000;
+    static const size_t c_numFrames = 240;
+    static const float c_sceneSize = 200.0f;
+
+    report.Log("===== Frustum Culling =====");
+
+    // random boxes of different sizes and rotations scattered through the scene
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> positionDist(0.0f, c_sceneSize);
+    std::uniform_real_distribution<float> sizeDist(0.1f, 2.0f);
+    std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * c_pi);
+
+    SCullingBounds bounds;
+    for (size_t i = 0; i < c_numObjects; ++i)
+    {
+        XMFLOAT3 boxMax(sizeDist(rng), sizeDist(rng), sizeDist(rng));
+        XMFLOAT3 boxMin = boxMax * -1.0f;
+        float radius = std::sqrtf(Dot(boxMax, boxMax));
+        float scale = sizeDist(rng);
+        XMMATRIX objectToWorld = XMMatrixMultiply(XMMatrixMultiply(XMMatrixScaling(scale, scale, scale), XMMatrixRotationY(angleDist(rng))),
+            XMMatrixTranslation(positionDist(rng), positionDist(rng) * 0.1f, positionDist(rng)));
+        CullingBoundsAdd(bounds, boxMin, boxMax, radius, objectToWorld);
+    }
+
+    std::vector<XMMATRIX> viewProjections;
+    std::vector<XMFLOAT3> cameraPositions;
+    MakeCameraPath(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(c_sceneSize, c_sceneSize * 0.1f, c_sceneSize), c_numFrames, viewProjections, cameraPositions);
+
+    SCullingStats stats;
+    SCullingStats statsScalar;
+    size_t mismatchedFrames = 0;
+    size_t centerFailures = 0;
+    double seconds = 0.0;
+    double secondsScalar = 0.0;
+    std::vector<UINT32> visible;
+    std::vector<UINT32> visibleScalar;
+    visible.reserve(c_numObjects);
+    visibleScalar.reserve(c_numObjects);
+    for (size_t frame = 0; frame < c_numFrames; ++frame)
+    {
+        SFrustum frustum = FrustumFromViewProjection(viewProjections[frame]);
+
+        visible.clear();
+        BenchmarkTimer timer;
+        CullingFrustum(frustum, bounds, visible, stats);
+        seconds += timer.ElapsedSeconds();
+
+        visibleScalar.clear();
+        timer.Reset();
+        CullingFrustumScalar(frustum, bounds, visibleScalar, statsScalar);
+        secondsScalar += timer.ElapsedSeconds();
+
+        if (visible != visibleScalar)
+            ++mismatchedFrames;
+
+        // an object whose center is in the frustum must never be culled
+        size_t visibleIndex = 0;
+        for (size_t i = 0; i < bounds.m_count; ++i)
+        {
+            if (visibleIndex < visible.size() && visible[visibleIndex] == i)
+            {
+                ++visibleIndex;
+                continue;
+            }
+            if (FrustumTestSphere(frustum, XMFLOAT3(bounds.m_centerX[i], bounds.m_centerY[i], bounds.m_centerZ[i]), 0.0f))
+                ++centerFailures;
+        }
+    }
+
+    report.Check(mismatchedFrames == 0, "%zu frames where the SIMD culling results differ from the scalar ones", mismatchedFrames);
+    report.Check(centerFailures == 0, "%zu objects culled while their center was in the frustum", centerFailures);
+    report.Log("  %zu objects, %zu frames: %0.1f%% visible", c_numObjects, c_numFrames, 100.0 * double(stats.m_visible) / double(stats.m_tested));
+    report.Log("  SIMD: %0.3f ms per frame, %0.2f ns per object", seconds * 1000.0 / double(c_numFrames), seconds * 1e9 / double(stats.m_tested));
+    report.Log("  scalar: %0.3f ms per frame, %0.2f ns per object (%0.2fx slower)", secondsScalar * 1000.0 / double(c_numFrames), secondsScalar * 1e9 / double(statsScalar.m_tested), secondsScalar / seconds);
+}
+
+static void BenchmarkDrawList (BenchmarkReport& report)
+{
+    static const size_t c_numDraws = 50000;
+    static const size_t c_numIterations = 100;
+
+    report.Log("===== Draw List =====");
+
+    // random draws, in the order a scene walk would find them
+    struct SDrawState
+    {
+        UINT32  m_pipeline;
+        UINT32  m_material;
+        UINT32  m_texture;
+        UINT32  m_mesh;
+        float   m_depth;
+    };
+    std::mt19937 rng(1234);
+    std::vector<SDrawState> draws(c_numDraws);
+    for (SDrawState& draw : draws)
+    {
+        draw.m_pipeline = rng() % 2;
+        draw.m_material = rng() % 11;
+        draw.m_texture = rng() % 200;
+        draw.m_mesh = rng() % 4096;
+        draw.m_depth = std::uniform_real_distribution<float>(0.1f, 100.0f)(rng);
+    }
+
+    SDrawList drawList;
+    double buildSeconds = 0.0;
+    double sortSeconds = 0.0;
+    double stdSortSeconds = 0.0;
+    size_t orderFailures = 0;
+    std::vector<SDrawPacket> expected;
+    for (size_t iteration = 0; iteration < c_numIterations; ++iteration)
+    {
+        BenchmarkTimer timer;
+        DrawListClear(drawList);
+        for (size_t i = 0; i < draws.size(); ++i)
+        {
+            const SDrawState& draw = draws[i];
+            DrawListAdd(drawList, DrawKeyMake(draw.m_pipeline, draw.m_material, draw.m_texture, draw.m_mesh, draw.m_depth), UINT32(i));
+        }
+        buildSeconds += timer.ElapsedSeconds();
+
+        expected = drawList.m_packets;
+
+        timer.Reset();
+        DrawListSort(drawList);
+        sortSeconds += timer.ElapsedSeconds();
+
+        timer.Reset();
+        std::stable_sort(expected.begin(), expected.end(), [] (const SDrawPacket& a, const SDrawPacket& b) { return a.m_sortKey < b.m_sortKey; });
+        stdSortSeconds += timer.ElapsedSeconds();
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            if (expected[i].m_sortKey != drawList.m_packets[i].m_sortKey || expected[i].m_drawIndex != drawList.m_packets[i].m_drawIndex)
+            {
+                ++orderFailures;
+                break;
+            }
+        }
+    }
+    report.Check(orderFailures == 0, "%zu radix sorts that differ from a stable sort", orderFailures);
+
+    // the fields have to survive the round trip through the key
+    size_t fieldFailures = 0;
+    for (const SDrawPacket& packet : drawList.m_packets)
+    {
+        const SDrawState& draw = draws[packet.m_drawIndex];
+        if (DrawKeyGetField(packet.m_sortKey, EDrawKeyField::pipeline) != draw.m_pipeline ||
+            DrawKeyGetField(packet.m_sortKey, EDrawKeyField::material) != draw.m_material ||
+            DrawKeyGetField(packet.m_sortKey, EDrawKeyField::texture) != draw.m_texture ||
+            DrawKeyGetField(packet.m_sortKey, EDrawKeyField::mesh) != draw.m_mesh)
+            ++fieldFailures;
+    }
+    report.Check(fieldFailures == 0, "%zu sort keys that don't give back their fields", fieldFailures);
+
+    // count the state changes of submitting in scene order and in sorted order
+    auto countStateChanges = [] (const std::vector<SDrawPacket>& packets)
+    {
+        SDrawListStats stats;
+        UINT64 lastSortKey = packets.empty() ? 0 : ~packets[0].m_sortKey;
+        for (const SDrawPacket& packet : packets)
+        {
+            for (size_t field = 0; field < (size_t)EDrawKeyField::depth; ++field)
+                DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, (EDrawKeyField)field, stats);
+            lastSortKey = packet.m_sortKey;
+        }
+        return stats;
+    };
+    std::vector<SDrawPacket> unsorted(drawList.m_packets.size());
+    for (const SDrawPacket& packet : drawList.m_packets)
+        unsorted[packet.m_drawIndex] = packet;
+    SDrawListStats unsortedStats = countStateChanges(unsorted);
+    SDrawListStats sortedStats = countStateChanges(drawList.m_packets);
+
+    report.Log("  %zu draws: %zu state changes in scene order, %zu sorted (%zu avoided)", c_numDraws, unsortedStats.m_stateChanges, sortedStats.m_stateChanges, sortedStats.m_stateChangesAvoided);
+    report.Log("  build %0.3f ms, radix sort %0.3f ms, std::stable_sort %0.3f ms",
+        buildSeconds * 1000.0 / double(c_numIterations), sortSeconds * 1000.0 / double(c_numIterations), stdSortSeconds * 1000.0 / double(c_numIterations));
+
+    // a field of spheres, like the instancing stress scene. Every sphere uses the same mesh, so the batches are made
+    // by the material and LOD combinations.
+    {
+        static const size_t c_numSpheres = 10000;
+
+        DrawListClear(drawList);
+        for (size_t i = 0; i < c_numSpheres; ++i)
+        {
+            UINT32 material = UINT32(i % 11);
+            UINT32 lod = rng() % 5;
+            DrawListAdd(drawList, DrawKeyMake(material == 6 ? 1 : 0, material, 0, lod, std::uniform_real_distribution<float>(0.1f, 100.0f)(rng)), UINT32(i));
+        }
+        DrawListSort(drawList);
+
+        std::vector<SDrawBatch> batches;
+        DrawListBatch(drawList, batches);
+
+        // batches have to cover the packets in order, share everything but depth inside, and differ from their neighbors
+        size_t batchFailures = 0;
+        size_t nextPacket = 0;
+        for (size_t batchIndex = 0; batchIndex < batches.size(); ++batchIndex)
+        {
+            const SDrawBatch& batch = batches[batchIndex];
+            if (batch.m_firstPacket != nextPacket || batch.m_packetCount == 0)
+                ++batchFailures;
+            nextPacket = batch.m_firstPacket + batch.m_packetCount;
+
+            UINT64 first = drawList.m_packets[batch.m_firstPacket].m_sortKey;
+            for (size_t i = batch.m_firstPacket; i < nextPacket; ++i)
+            {
+                UINT64 key = drawList.m_packets[i].m_sortKey;
+                for (size_t field = 0; field < (size_t)EDrawKeyField::depth; ++field)
+                {
+                    if (DrawKeyGetField(key, (EDrawKeyField)field) != DrawKeyGetField(first, (EDrawKeyField)field))
+                        ++batchFailures;
+                }
+            }
+
+            if (batchIndex > 0)
+            {
+                UINT64 previous = drawList.m_packets[batch.m_firstPacket - 1].m_sortKey;
+                bool differs = false;
+                for (size_t field = 0; field < (size_t)EDrawKeyField::depth; ++field)
+                    differs = differs || DrawKeyGetField(previous, (EDrawKeyField)field) != DrawKeyGetField(first, (EDrawKeyField)field);
+                if (!differs)
+                    ++batchFailures;
+            }
+        }
+        report.Check(batchFailures == 0 && nextPacket == c_numSpheres, "instancing batches split the sorted draws correctly (%zu errors)", batchFailures);
+        report.Log("  %zu sphere draws become %zu instanced draws", c_numSpheres, batches.size());
+    }
+}
+
+static void BenchmarkDescriptorAllocator (BenchmarkReport& report)
+{
+    static const UINT32 c_capacity = 4096;
+    static const size_t c_numFrames = 10000;
+    static const size_t c_allocationsPerFrame = 20;
+    static const UINT32 c_sizes[] = { 1, 3, 5 };   // a constant buffer, and the sizes of the skybox and material tables
+
+    report.Log("===== Descriptor Allocator =====");
+
+    // the rules, one at a time
+    {
+        SDescriptorAllocator allocator;
+        DescriptorAllocatorInit(allocator, 16);
+
+        UINT32 offsets[4];
+        bool ok = DescriptorAllocatorAllocate(allocator, 8, offsets[0]) &&
+            DescriptorAllocatorAllocate(allocator, 5, offsets[1]) &&
+            DescriptorAllocatorAllocate(allocator, 3, offsets[2]) &&
+            !DescriptorAllocatorAllocate(allocator, 1, offsets[3]) &&
+            offsets[0] == 0 && offsets[1] == 8 && offsets[2] == 13 && allocator.m_allocated == 16;
+        report.Check(ok, "allocations are contiguous and fail when the allocator is full");
+
+        DescriptorAllocatorFree(allocator, offsets[1], 5, 1);
+        ok = !DescriptorAllocatorAllocate(allocator, 1, offsets[3]);
+        DescriptorAllocatorRetire(allocator, 0);
+        ok = ok && !DescriptorAllocatorAllocate(allocator, 1, offsets[3]);
+        DescriptorAllocatorRetire(allocator, 1);
+        ok = ok && DescriptorAllocatorAllocate(allocator, 5, offsets[3]) && offsets[3] == 8;
+        report.Check(ok, "freed ranges are only reused once their fence value completes");
+
+        DescriptorAllocatorFree(allocator, offsets[0], 8, 2);
+        DescriptorAllocatorFree(allocator, offsets[2], 3, 2);
+        DescriptorAllocatorFree(allocator, offsets[3], 5, 2);
+        DescriptorAllocatorRetire(allocator, 2);
+        ok = allocator.m_allocated == 0 && allocator.m_freeRanges.size() == 1 && DescriptorAllocatorLargestFreeRange(allocator) == 16;
+        report.Check(ok, "freed neighbors merge back into one range");
+
+        ok = DescriptorAllocatorAllocate(allocator, 12, offsets[0]);
+        DescriptorAllocatorGrow(allocator, 32);
+        std::vector<SDescriptorRange> allocatedRanges;
+        DescriptorAllocatorGetAllocatedRanges(allocator, allocatedRanges);
+        ok = ok && allocator.m_freeRanges.size() == 1 && DescriptorAllocatorLargestFreeRange(allocator) == 20 &&
+            allocatedRanges.size() == 1 && allocatedRanges[0].m_offset == 0 && allocatedRanges[0].m_count == 12;
+        report.Check(ok, "growing keeps allocations in place and merges with the free space at the end");
+
+        bool threw = false;
+        DescriptorAllocatorFree(allocator, 20, 4, 3);
+        try
+        {
+            DescriptorAllocatorRetire(allocator, 3);
+        }
+        catch (const std::exception&)
+        {
+            threw = true;
+        }
+        report.Check(threw, "freeing a range that is already free throws");
+    }
+
+    // Random churn like streaming would cause: each frame frees some of the live allocations and makes new ones, with
+    // the frees pending for a frame. Every allocation is checked against a map of which descriptors are in use.
+    {
+        std::mt19937 rng(9012);
+        SDescriptorAllocator allocator;
+        DescriptorAllocatorInit(allocator, c_capacity);
+
+        std::vector<SDescriptorRange> live;
+        std::vector<SDescriptorRange> freedLastFrame, freedThisFrame;
+        std::vector<bool> used(c_capacity, false);
+        size_t allocations = 0;
+        size_t failures = 0;
+        size_t overlaps = 0;
+        double fragmentationSum = 0.0;
+        BenchmarkTimer timer;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            for (size_t i = 0; i < c_allocationsPerFrame; ++i)
+            {
+                // free as often as allocating, once the heap is about 3/4 full
+                if (!live.empty() && (allocator.m_allocated > c_capacity * 3 / 4 || rng() % 2 == 0))
+                {
+                    size_t index = rng() % live.size();
+                    SDescriptorRange range = live[index];
+                    live[index] = live.back();
+                    live.pop_back();
+                    freedThisFrame.push_back(range);
+                    DescriptorAllocatorFree(allocator, range.m_offset, range.m_count, frame);
+                }
+
+                UINT32 count = c_sizes[rng() % _countof(c_sizes)];
+                UINT32 offset;
+                if (!DescriptorAllocatorAllocate(allocator, count, offset))
+                {
+                    ++failures;
+                    continue;
+                }
+                ++allocations;
+                for (UINT32 j = 0; j < count; ++j)
+                {
+                    if (used[offset + j])
+                        ++overlaps;
+                    used[offset + j] = true;
+                }
+                live.push_back({ offset, count });
+            }
+
+            // the frame before this one is done on the GPU, so what it freed stops being in use
+            if (frame > 0)
+                DescriptorAllocatorRetire(allocator, frame - 1);
+            for (const SDescriptorRange& range : freedLastFrame)
+            {
+                for (UINT32 j = 0; j < range.m_count; ++j)
+                    used[range.m_offset + j] = false;
+            }
+            freedLastFrame.swap(freedThisFrame);
+            freedThisFrame.clear();
+
+            UINT32 totalFree = c_capacity - allocator.m_allocated;
+            if (totalFree > 0)
+                fragmentationSum += 1.0 - double(DescriptorAllocatorLargestFreeRange(allocator)) / double(totalFree);
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        report.Check(overlaps == 0 && failures == 0, "%zu random allocations never overlapped a live or pending range (%zu overlaps, %zu failed)", allocations, overlaps, failures);
+        report.Log("  average fragmentation %0.3f (1 - largest free range / free descriptors), %zu free ranges at the end", fragmentationSum / double(c_numFrames), allocator.m_freeRanges.size());
+        report.Log("  %0.2f ns per allocation or free", seconds * 1e9 / double(c_numFrames * c_allocationsPerFrame * 2));
+    }
+}
+
+static void BenchmarkDescriptorRing (BenchmarkReport& report)
+{
+    static const UINT32 c_capacity = 1024;
+    static const size_t c_numFrames = 10000;
+    static const size_t c_framesInFlight = 2;
+    static const size_t c_tablesPerFrame = 100;
+    static const UINT32 c_numMaterials = 8;
+    static const UINT32 c_materialTextures = 5;
+
+    report.Log("===== Descriptor Ring =====");
+
+    // the rules, one at a time
+    {
+        SDescriptorRing ring;
+        DescriptorRingInit(ring, 8);
+
+        UINT32 a[] = { 10, 11, 12 };
+        UINT32 b[] = { 10, 11, 13 };
+        UINT32 offsets[4];
+        bool copies[4];
+        bool ok = DescriptorRingAllocateTable(ring, a, 3, offsets[0], copies[0]) &&
+            DescriptorRingAllocateTable(ring, b, 3, offsets[1], copies[1]) &&
+            DescriptorRingAllocateTable(ring, a, 3, offsets[2], copies[2]) &&
+            copies[0] && copies[1] && !copies[2] && offsets[0] == 0 && offsets[1] == 3 && offsets[2] == 0;
+        report.Check(ok, "identical tables in a frame are shared");
+
+        DescriptorRingEndFrame(ring, 1);
+        ok = DescriptorRingAllocateTable(ring, a, 2, offsets[0], copies[0]) && copies[0] && offsets[0] == 6 &&
+            !DescriptorRingAllocateTable(ring, a, 3, offsets[1], copies[1]);
+        DescriptorRingRetire(ring, 0);
+        ok = ok && !DescriptorRingAllocateTable(ring, a, 3, offsets[1], copies[1]);
+        report.Check(ok, "a full ring fails until the frames using it are retired");
+
+        DescriptorRingRetire(ring, 1);
+        ok = DescriptorRingAllocateTable(ring, a, 3, offsets[1], copies[1]) && copies[1] && offsets[1] == 0;
+        report.Check(ok, "tables aren't shared across frames, and wrap to the start of the ring instead of splitting");
+
+        DescriptorRingReset(ring);
+        ok = ring.m_stats.m_tables == 5 && DescriptorRingAllocateTable(ring, a, 3, offsets[0], copies[0]) && offsets[0] == 0 && copies[0];
+        report.Check(ok, "reset empties the ring and keeps the stats");
+    }
+
+    // Frames that each ask for material tables, like the draw loop does, with a few frames on the GPU at once. Every
+    // table is checked to not overlap a table of a frame that hasn't been retired yet.
+    {
+        std::mt19937 rng(3456);
+        SDescriptorRing ring;
+        DescriptorRingInit(ring, c_capacity);
+
+        std::vector<UINT64> usedByFrame(c_capacity, UINT64(-1));
+        size_t overlaps = 0;
+        size_t failures = 0;
+        BenchmarkTimer timer;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            for (size_t i = 0; i < c_tablesPerFrame; ++i)
+            {
+                UINT32 material = rng() % c_numMaterials;
+                UINT32 sources[c_materialTextures];
+                for (UINT32 j = 0; j < c_materialTextures; ++j)
+                    sources[j] = material * c_materialTextures + j;
+
+                UINT32 offset;
+                bool needsCopy;
+                if (!DescriptorRingAllocateTable(ring, sources, c_materialTextures, offset, needsCopy))
+                {
+                    ++failures;
+                    continue;
+                }
+                if (!needsCopy)
+                    continue;
+
+                for (UINT32 j = 0; j < c_materialTextures; ++j)
+                {
+                    UINT64 user = usedByFrame[offset + j];
+                    if (user != UINT64(-1) && user + c_framesInFlight > frame)
+                        ++overlaps;
+                    usedByFrame[offset + j] = frame;
+                }
+            }
+            DescriptorRingEndFrame(ring, frame);
+
+            // the GPU finishes the oldest frame once there are too many in flight
+            if (frame + 1 >= c_framesInFlight)
+                DescriptorRingRetire(ring, frame + 1 - c_framesInFlight);
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        const SDescriptorRingStats& stats = ring.m_stats;
+        report.Check(overlaps == 0 && failures == 0, "%zu tables over %zu frames never overwrote one in flight (%zu overlaps, %zu failed)", stats.m_tables, c_numFrames, overlaps, failures);
+        report.Log("  %zu of %zu tables shared, %zu descriptors copied instead of %zu", stats.m_tablesReused, stats.m_tables, stats.m_descriptorsCopied, stats.m_tables * c_materialTextures);
+        report.Log("  %0.2f ns per table", seconds * 1e9 / double(stats.m_tables));
+    }
+}
+
+static void BenchmarkUploadRing (BenchmarkReport& report)
+{
+    static const UINT64 c_capacity = 1024 * 1024;
+    static const size_t c_numFrames = 10000;
+    static const size_t c_framesInFlight = 2;
+    static const size_t c_constantsPerFrame = 200;
+    static const UINT64 c_constantsAlignment = 256;
+    static const UINT64 c_instanceSize = 64;
+
+    report.Log("===== Upload Ring =====");
+
+    // the rules, one at a time
+    {
+        SUploadRing ring;
+        UploadRingInit(ring, 1024);
+
+        UINT64 offsets[4];
+        bool ok = UploadRingAllocate(ring, 64, 256, offsets[0]) &&
+            UploadRingAllocate(ring, 100, 256, offsets[1]) &&
+            UploadRingAllocate(ring, 8, 4, offsets[2]) &&
+            offsets[0] == 0 && offsets[1] == 256 && offsets[2] == 356;
+        report.Check(ok, "allocations are aligned and packed");
+
+        ok = !UploadRingAllocate(ring, 64, 3, offsets[3]) && !UploadRingAllocate(ring, 64, 2048, offsets[3]) && !UploadRingAllocate(ring, 0, 4, offsets[3]);
+        report.Check(ok, "bad sizes and alignments fail");
+
+        UploadRingEndFrame(ring, 1);
+        ok = UploadRingAllocate(ring, 512, 256, offsets[0]) && offsets[0] == 512 &&
+            !UploadRingAllocate(ring, 256, 256, offsets[1]);
+        UploadRingRetire(ring, 0);
+        ok = ok && !UploadRingAllocate(ring, 256, 256, offsets[1]);
+        report.Check(ok, "a full ring fails until the frames using it are retired");
+
+        UploadRingRetire(ring, 1);
+        ok = UploadRingAllocate(ring, 256, 256, offsets[1]) && offsets[1] == 0;
+        report.Check(ok, "retiring a frame frees its space, and allocations wrap to the start of the ring");
+    }
+
+    // Frames of per draw constants and one block of instance data, with a few frames on the GPU at once. Every
+    // allocation is checked to be aligned, and to not overlap one of a frame that hasn't been retired yet.
+    {
+        std::mt19937 rng(4567);
+        SUploadRing ring;
+        UploadRingInit(ring, c_capacity);
+
+        // which frame last used each 64 byte block
+        std::vector<UINT64> usedByFrame(size_t(c_capacity / 64), UINT64(-1));
+        size_t overlaps = 0;
+        size_t misaligned = 0;
+        size_t failures = 0;
+        auto allocate = [&] (size_t frame, UINT64 size, UINT64 alignment)
+        {
+            UINT64 offset;
+            if (!UploadRingAllocate(ring, size, alignment, offset))
+            {
+                ++failures;
+                return;
+            }
+            if (offset % alignment != 0)
+                ++misaligned;
+
+            for (UINT64 block = offset / 64; block < (offset + size + 63) / 64; ++block)
+            {
+                UINT64 user = usedByFrame[size_t(block)];
+                if (user != UINT64(-1) && user != frame && user + c_framesInFlight > frame)
+                    ++overlaps;
+                usedByFrame[size_t(block)] = frame;
+            }
+        };
+
+        BenchmarkTimer timer;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            for (size_t i = 0; i < c_constantsPerFrame; ++i)
+                allocate(frame, 64 + rng() % 192, c_constantsAlignment);
+            allocate(frame, c_instanceSize * (1 + rng() % 2000), c_instanceSize);
+
+            UploadRingEndFrame(ring, frame);
+
+            // the GPU finishes the oldest frame once there are too many in flight
+            if (frame + 1 >= c_framesInFlight)
+                UploadRingRetire(ring, frame + 1 - c_framesInFlight);
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        const SUploadRingStats& stats = ring.m_stats;
+        report.Check(overlaps == 0 && misaligned == 0 && failures == 0, "%zu allocations over %zu frames were aligned and never overwrote one in flight (%zu overlaps, %zu misaligned, %zu failed)", stats.m_allocations, c_numFrames, overlaps, misaligned, failures);
+        report.Log("  %0.1f KB per frame, peak %0.1f KB of %0.1f KB in use", double(stats.m_bytesAllocated) / double(c_numFrames) / 1024.0, double(stats.m_peakBytesInUse) / 1024.0, double(c_capacity) / 1024.0);
+        report.Log("  %0.2f ns per allocation", seconds * 1e9 / double(stats.m_allocations));
+    }
+}
+
+static void BenchmarkObjectTable (BenchmarkReport& report)
+{
+    static const UINT32 c_numObjects = 10000;
+    static const size_t c_numFrames = 1000;
+    static const UINT32 c_movesPerFrame = 100;
+    static const UINT32 c_maxGap = 4;
+
+    report.Log("===== Object Table =====");
+
+    // the rules, one at a time
+    {
+        SObjectTable table;
+        ObjectTableInit(table, 4);
+        std::vector<SObjectRange> ranges;
+
+        UINT32 slots[5];
+        bool ok = ObjectTableAllocate(table, slots[0]) && ObjectTableAllocate(table, slots[1]) &&
+            ObjectTableAllocate(table, slots[2]) && ObjectTableAllocate(table, slots[3]) &&
+            !ObjectTableAllocate(table, slots[4]) && slots[0] == 0 && slots[3] == 3;
+        report.Check(ok, "slots are handed out in order until the table is full");
+
+        ObjectTableTakeDirtyRanges(table, 0, ranges);
+        ok = ranges.size() == 1 && ranges[0].m_first == 0 && ranges[0].m_count == 4;
+        ObjectTableTakeDirtyRanges(table, 0, ranges);
+        ok = ok && ranges.empty();
+        report.Check(ok, "new slots are dirty, and taking the dirty ranges clears them");
+
+        ObjectTableFree(table, 2);
+        ok = ObjectTableAllocate(table, slots[4]) && slots[4] == 2;
+        ObjectTableMarkDirty(table, 0);
+        ObjectTableMarkDirty(table, 0);
+        ObjectTableTakeDirtyRanges(table, 0, ranges);
+        ok = ok && ranges.size() == 2 && ranges[0].m_first == 0 && ranges[0].m_count == 1 && ranges[1].m_first == 2 && ranges[1].m_count == 1;
+        report.Check(ok, "freed slots are reused, and a slot marked twice is uploaded once");
+
+        ObjectTableMarkDirty(table, 3);
+        ObjectTableMarkDirty(table, 0);
+        ObjectTableTakeDirtyRanges(table, 2, ranges);
+        ok = ranges.size() == 1 && ranges[0].m_first == 0 && ranges[0].m_count == 4;
+        report.Check(ok, "ranges closer than the gap are joined");
+
+        ObjectTableGrow(table, 8);
+        ObjectTableTakeDirtyRanges(table, 0, ranges);
+        ok = table.m_capacity == 8 && ranges.size() == 1 && ranges[0].m_first == 0 && ranges[0].m_count == 4 && ObjectTableAllocate(table, slots[0]) && slots[0] == 4;
+        report.Check(ok, "growing keeps the slots and makes them all dirty");
+    }
+
+    // A scene where a few objects move each frame. Only what moved should be uploaded, and the uploaded ranges have to
+    // cover every object that moved.
+    {
+        std::mt19937 rng(5678);
+        SObjectTable table;
+        ObjectTableInit(table, 256);
+        std::vector<SObjectRange> ranges;
+
+        for (UINT32 i = 0; i < c_numObjects; ++i)
+        {
+            UINT32 slot;
+            while (!ObjectTableAllocate(table, slot))
+                ObjectTableGrow(table, table.m_capacity * 2);
+        }
+        ObjectTableTakeDirtyRanges(table, c_maxGap, ranges);
+        table.m_stats = SObjectTableStats();
+
+        std::vector<bool> moved(c_numObjects);
+        size_t missed = 0;
+        BenchmarkTimer timer;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            std::fill(moved.begin(), moved.end(), false);
+            for (UINT32 i = 0; i < c_movesPerFrame; ++i)
+            {
+                UINT32 slot = rng() % c_numObjects;
+                moved[slot] = true;
+                ObjectTableMarkDirty(table, slot);
+            }
+
+            ObjectTableTakeDirtyRanges(table, c_maxGap, ranges);
+            for (const SObjectRange& range : ranges)
+                std::fill(moved.begin() + range.m_first, moved.begin() + range.m_first + range.m_count, false);
+            missed += std::count(moved.begin(), moved.end(), true);
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        const SObjectTableStats& stats = table.m_stats;
+        report.Check(missed == 0, "the uploads covered every object that moved (%zu missed)", missed);
+        report.Log("  %u of %u objects moving per frame: %0.1f slots in %0.1f copies uploaded per frame, instead of all %u", c_movesPerFrame, c_numObjects, double(stats.m_slotsUploaded) / double(c_numFrames), double(stats.m_ranges) / double(c_numFrames), c_numObjects);
+        report.Log("  %0.2f us per frame to find the ranges", seconds * 1e6 / double(c_numFrames));
+    }
+}
+
+// laid out like SConstantBuffer, which is 18 lines
+struct SBenchmarkSceneConstants
+{
+    XMMATRIX viewMatrix;
+    XMMATRIX viewMatrixIT;
+    XMMATRIX projectionMatrix;
+    XMMATRIX viewProjectionMatrix;
+    XMFLOAT4 viewDimensions;
+    XMFLOAT4 cameraPosition;
+};
+
+// fills the scene constants the way OnUpdate does for a camera that isn't rotated
+static void WriteBenchmarkSceneConstants (SBenchmarkSceneConstants& constants, const XMFLOAT3& position)
+{
+    constants.viewMatrix = XMMatrixTranspose(XMMatrixTranslation(-position.x, -position.y, -position.z));
+    constants.viewMatrixIT = XMMatrixTranslation(position.x, position.y, position.z);
+    constants.viewProjectionMatrix = XMMatrixMultiply(constants.projectionMatrix, constants.viewMatrix);
+    constants.cameraPosition = XMFLOAT4(position.x, position.y, position.z, 0.0f);
+}
+
+static void BenchmarkStreamingCopy (BenchmarkReport& report)
+{
+    static const size_t c_numBuffers = 256 * 1024;   // 72 MB, so the copies aren't all in the cache
+    static const size_t c_numPasses = 4;
+    static const size_t c_numFrames = 1000;
+
+    report.Log("===== Streaming Copy =====");
+
+    // 16 byte aligned memory standing in for an upload heap
+    std::vector<UINT64> storage((c_numBuffers * sizeof(SBenchmarkSceneConstants) + 16) / sizeof(UINT64));
+    unsigned char* dest = (unsigned char*)(((size_t)storage.data() + 15) & ~size_t(15));
+
+    // random changes to random lines, and sizes with a partial line at the end
+    {
+        std::mt19937 rng(6789);
+        std::vector<unsigned char> source(1000), mirror(1000, 0);
+        memset(dest, 0, source.size());
+        SStreamingCopyStats stats;
+        bool ok = true;
+        for (size_t i = 0; i < 1000; ++i)
+        {
+            size_t size = 1 + rng() % source.size();
+            size_t lines = (size + c_streamingCopyLineSize - 1) / c_streamingCopyLineSize;
+            std::vector<bool> changed(lines, false);
+            for (size_t j = 0, changes = rng() % 8; j < changes; ++j)
+            {
+                size_t byte = rng() % size;
+                unsigned char value = (unsigned char)rng();
+                if (value != mirror[byte])
+                    changed[byte / c_streamingCopyLineSize] = true;
+                source[byte] = value;
+            }
+
+            size_t written = StreamingCopyChangedLines(dest, mirror.data(), source.data(), size, stats);
+            ok = ok && written == size_t(std::count(changed.begin(), changed.end(), true)) &&
+                memcmp(dest, source.data(), size) == 0 && memcmp(mirror.data(), source.data(), size) == 0;
+        }
+        report.Check(ok, "only the changed lines are written, and the destination and mirror match the source");
+    }
+
+    // how much of the scene constants a camera changes
+    {
+        SBenchmarkSceneConstants constants = {};
+        constants.projectionMatrix = XMMatrixTranspose(XMMatrixPerspectiveFovRH(c_cameraPathFov, 16.0f / 9.0f, 0.1f, 1000.0f));
+        constants.viewDimensions = XMFLOAT4(1920.0f, 1080.0f, 0.0f, 0.0f);
+        SBenchmarkSceneConstants mirror = {};
+
+        SStreamingCopyStats still, walking;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            WriteBenchmarkSceneConstants(constants, XMFLOAT3(0.0f, 1.0f, 0.0f));
+            StreamingCopyChangedLines(dest, &mirror, &constants, sizeof(constants), still);
+        }
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            WriteBenchmarkSceneConstants(constants, XMFLOAT3(0.0f, 1.0f, float(frame) * 0.01f));
+            StreamingCopyChangedLines(dest, &mirror, &constants, sizeof(constants), walking);
+        }
+
+        // the first write of the still camera writes everything, and then nothing changes
+        report.Check(still.m_linesWritten < still.m_lines / 100, "rewriting unchanged constants writes almost nothing (%zu of %zu lines)", still.m_linesWritten, still.m_lines);
+        report.Check(walking.m_linesWritten < walking.m_lines, "a walking camera writes %zu of %zu lines, %0.0f%%", walking.m_linesWritten, walking.m_lines, 100.0 * double(walking.m_linesWritten) / double(walking.m_lines));
+    }
+
+    // Upload bandwidth of many scene constant buffers. This memory is cached, unlike an upload heap, so it shows the
+    // CPU cost and not the write combining savings.
+    {
+        std::vector<SBenchmarkSceneConstants> sources(c_numBuffers), mirrors(c_numBuffers);
+        for (size_t i = 0; i < c_numBuffers; ++i)
+        {
+            sources[i].projectionMatrix = XMMatrixTranspose(XMMatrixPerspectiveFovRH(c_cameraPathFov, 16.0f / 9.0f, 0.1f, 1000.0f));
+            sources[i].viewDimensions = XMFLOAT4(1920.0f, 1080.0f, 0.0f, 0.0f);
+            WriteBenchmarkSceneConstants(sources[i], XMFLOAT3(float(i), 1.0f, 0.0f));
+        }
+        memcpy(mirrors.data(), sources.data(), c_numBuffers * sizeof(SBenchmarkSceneConstants));
+
+        double bytes = double(c_numBuffers * c_numPasses * sizeof(SBenchmarkSceneConstants));
+        auto logBandwidth = [&] (const char* name, double seconds)
+        {
+            report.Log("  %-28s %0.2f GB/s", name, bytes / seconds / 1e9);
+        };
+
+        BenchmarkTimer timer;
+        for (size_t pass = 0; pass < c_numPasses; ++pass)
+        {
+            for (size_t i = 0; i < c_numBuffers; ++i)
+                memcpy(dest + i * sizeof(SBenchmarkSceneConstants), &sources[i], sizeof(SBenchmarkSceneConstants));
+        }
+        logBandwidth("memcpy", timer.ElapsedSeconds());
+
+        timer.Reset();
+        for (size_t pass = 0; pass < c_numPasses; ++pass)
+        {
+            for (size_t i = 0; i < c_numBuffers; ++i)
+                StreamingCopy(dest + i * sizeof(SBenchmarkSceneConstants), &sources[i], sizeof(SBenchmarkSceneConstants));
+        }
+        logBandwidth("streaming", timer.ElapsedSeconds());
+
+        // each pass walks every camera forward a bit, so the changed lines have to be found and written
+        SStreamingCopyStats stats;
+        timer.Reset();
+        for (size_t pass = 0; pass < c_numPasses; ++pass)
+        {
+            for (size_t i = 0; i < c_numBuffers; ++i)
+            {
+                WriteBenchmarkSceneConstants(sources[i], XMFLOAT3(float(i), 1.0f, float(pass) * 0.01f));
+                StreamingCopyChangedLines(dest + i * sizeof(SBenchmarkSceneConstants), &mirrors[i], &sources[i], sizeof(SBenchmarkSceneConstants), stats);
+            }
+        }
+        logBandwidth("changed lines, walking", timer.ElapsedSeconds());
+        report.Log("    (including making the constants, %0.0f%% of lines written)", 100.0 * double(stats.m_linesWritten) / double(stats.m_lines));
+    }
+}
+
+static void BenchmarkDeferredRelease (BenchmarkReport& report)
+{
+    static const size_t c_numFrames = 10000;
+    static const UINT64 c_framesInFlight = 3;
+    static const size_t c_maxReleasesPerFrame = 20;
+
+    report.Log("===== Deferred Release =====");
+
+    // Frames release random numbers of things with the fence value of the frame, and the GPU finishes a frame once
+    // there are too many in flight. Nothing may come out before its frame is done, and everything comes out in the end.
+    {
+        std::mt19937 rng(7890);
+        SDeferredReleaseQueue queue;
+        std::vector<SDeferredRelease> retired;
+        size_t early = 0;
+        size_t pushed = 0;
+        UINT64 completed = 0;
+
+        BenchmarkTimer timer;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            UINT64 fenceValue = frame + 1;
+            size_t releases = rng() % (c_maxReleasesPerFrame + 1);
+            for (size_t i = 0; i < releases; ++i)
+            {
+                SDeferredRelease release;
+                release.m_kind = (rng() % 2) ? EDeferredReleaseKind::object : EDeferredReleaseKind::descriptorRange;
+                release.m_bytes = 64 * (1 + rng() % 1024);
+                release.m_fenceValue = fenceValue;
+                DeferredReleasePush(queue, release);
+                ++pushed;
+            }
+
+            if (fenceValue >= c_framesInFlight)
+                completed = fenceValue + 1 - c_framesInFlight;
+
+            retired.clear();
+            DeferredReleaseRetire(queue, completed, retired);
+            for (const SDeferredRelease& release : retired)
+            {
+                if (release.m_fenceValue > completed)
+                    ++early;
+            }
+        }
+        retired.clear();
+        DeferredReleaseRetire(queue, c_numFrames, retired);
+        double seconds = timer.ElapsedSeconds();
+
+        const SDeferredReleaseStats& stats = queue.m_stats;
+        report.Check(early == 0 && stats.m_released == pushed && stats.m_pending == 0 && stats.m_pendingBytes == 0, "%zu releases over %zu frames came out after their frame was done (%zu early, %zu left)", pushed, c_numFrames, early, stats.m_pending);
+        report.Log("  peak %0.1f MB pending release, %0.2f ns per release", double(stats.m_peakPendingBytes) / (1024.0 * 1024.0), seconds * 1e9 / double(pushed));
+    }
+}
+
+static void BenchmarkParallelRecording (BenchmarkReport& report)
+{
+    static const size_t c_numDraws = 30000;
+    static const size_t c_numIterations = 50;
+    static const size_t c_minDrawsPerChunk = 128;
+
+    report.Log("===== Parallel Recording =====");
+
+    // the rules, one at a time
+    {
+        std::vector<SDrawBatch> batches;
+        std::vector<SDrawChunk> chunks;
+        DrawListChunk(batches, c_minDrawsPerChunk, 4, chunks);
+        report.Check(chunks.empty(), "no batches make no chunks");
+
+        batches.resize(c_minDrawsPerChunk * 2 - 1);
+        DrawListChunk(batches, c_minDrawsPerChunk, 4, chunks);
+        bool ok = chunks.size() == 1 && chunks[0].m_firstBatch == 0 && chunks[0].m_batchCount == batches.size();
+        report.Check(ok, "a list too small to split is one chunk");
+
+        batches.resize(1001);
+        DrawListChunk(batches, c_minDrawsPerChunk, 3, chunks);
+        ok = chunks.size() == 3 && chunks[0].m_batchCount == 334 && chunks[1].m_batchCount == 334 && chunks[2].m_batchCount == 333 &&
+            chunks[1].m_firstBatch == 334 && chunks[2].m_firstBatch == 668;
+        report.Check(ok, "chunks split the batches evenly and in order");
+
+        DrawListChunk(batches, c_minDrawsPerChunk, 0, chunks);
+        report.Check(chunks.size() == 1, "0 max chunks is treated as 1");
+    }
+
+    // A sponza sized draw list recorded as one chunk, and split over more threads. The command lists are stand ins that
+    // take what the state filter lets through, and the draws, so this is the CPU side of recording without a driver.
+    std::mt19937 rng(8901);
+    SDrawList drawList;
+    for (size_t i = 0; i < c_numDraws; ++i)
+        DrawListAdd(drawList, DrawKeyMake(rng() % 2, rng() % 25, rng() % 400, rng() % 4096, std::uniform_real_distribution<float>(0.1f, 100.0f)(rng)), UINT32(i));
+    DrawListSort(drawList);
+    std::vector<SDrawBatch> batches;
+    DrawListBatch(drawList, batches);
+
+    auto recordChunk = [&] (const SDrawChunk& chunk, SCommandStateFilter& filter, std::vector<UINT64>& commands)
+    {
+        CommandStateFilterReset(filter, nullptr);
+        commands.clear();
+        SDrawListStats stats;
+        UINT64 lastSortKey = ~drawList.m_packets[batches[chunk.m_firstBatch].m_firstPacket].m_sortKey;
+        for (UINT32 batchIndex = chunk.m_firstBatch; batchIndex < chunk.m_firstBatch + chunk.m_batchCount; ++batchIndex)
+        {
+            UINT64 sortKey = drawList.m_packets[batches[batchIndex].m_firstPacket].m_sortKey;
+            if (DrawKeyFieldChanged(sortKey, lastSortKey, EDrawKeyField::pipeline, stats) &&
+                CommandStateFilterPipelineState(filter, (const void*)size_t(DrawKeyGetField(sortKey, EDrawKeyField::pipeline) + 1)))
+                commands.push_back(sortKey);
+            if (DrawKeyFieldChanged(sortKey, lastSortKey, EDrawKeyField::material, stats) &&
+                CommandStateFilterRootTable(filter, 6, DrawKeyGetField(sortKey, EDrawKeyField::material)))
+                commands.push_back(sortKey);
+            if (DrawKeyFieldChanged(sortKey, lastSortKey, EDrawKeyField::texture, stats) &&
+                CommandStateFilterRootTable(filter, 4, DrawKeyGetField(sortKey, EDrawKeyField::texture)))
+                commands.push_back(sortKey);
+            if (DrawKeyFieldChanged(sortKey, lastSortKey, EDrawKeyField::mesh, stats))
+            {
+                UINT32 mesh = DrawKeyGetField(sortKey, EDrawKeyField::mesh);
+                if (CommandStateFilterVertexBuffer(filter, 0, { UINT64(mesh) << 16, 1024, 32 }))
+                    commands.push_back(sortKey);
+                if (CommandStateFilterIndexBuffer(filter, { UINT64(mesh) << 16, 512, 42 }))
+                    commands.push_back(sortKey);
+            }
+
+            // draws are tagged with the top bit, so they can be told apart from state changes
+            commands.push_back((UINT64(1) << 63) | batchIndex);
+            lastSortKey = sortKey;
+        }
+    };
+
+    std::vector<UINT64> serialDraws;
+    double serialMilliseconds = 0.0;
+    for (size_t numThreads = 1; numThreads <= 8; numThreads *= 2)
+    {
+        std::vector<SDrawChunk> chunks;
+        DrawListChunk(batches, c_minDrawsPerChunk, numThreads, chunks);
+        std::vector<SCommandStateFilter> filters(chunks.size());
+        std::vector<std::vector<UINT64>> commands(chunks.size());
+
+        BenchmarkTimer timer;
+        for (size_t iteration = 0; iteration < c_numIterations; ++iteration)
+        {
+            ParallelFor(chunks.size(), 1,
+                [&] (size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                        recordChunk(chunks[i], filters[i], commands[i]);
+                },
+                chunks.size()
+            );
+        }
+        double milliseconds = timer.ElapsedSeconds() * 1000.0 / double(c_numIterations);
+
+        // the draws of the chunks, submitted in order, have to be the draws of the whole list in order
+        std::vector<UINT64> draws;
+        size_t stateCalls = 0;
+        for (const std::vector<UINT64>& chunkCommands : commands)
+        {
+            for (UINT64 command : chunkCommands)
+            {
+                if (command >> 63)
+                    draws.push_back(command);
+                else
+                    ++stateCalls;
+            }
+        }
+        if (numThreads == 1)
+        {
+            serialDraws = draws;
+            serialMilliseconds = milliseconds;
+        }
+
+        report.Check(draws == serialDraws && draws.size() == batches.size(), "%zu threads: %zu chunks submit the same %zu draws in the same order", numThreads, chunks.size(), draws.size());
+        report.Log("  %zu threads: %0.3f ms to record (%0.2fx), %zu state calls", numThreads, milliseconds, serialMilliseconds / milliseconds, stateCalls);
+    }
+}
+
+// The binding work SubmitDrawList does for materials, with descriptor tables and with bindless materials. This is the
+// application side of submission only. The calls that get through the state filter would also cost driver time.
+static void BenchmarkMaterialBinding (BenchmarkReport& report)
+{
+    static const size_t c_numDraws = 10000;
+    static const size_t c_numFrames = 100;
+    static const UINT32 c_numMaterials = 11;
+    static const UINT32 c_numTextures = 4;
+    static const UINT32 c_materialTextures = 5;
+
+    // the root parameters, like RootTableParameter
+    static const UINT32 c_diffuseTexture = 4;
+    static const UINT32 c_materialTextureSet = 6;
+    static const UINT32 c_drawConstants = 10;
+
+    report.Log("===== Material Binding =====");
+
+    std::mt19937 rng(7890);
+    SDrawList drawList;
+    for (size_t i = 0; i < c_numDraws; ++i)
+    {
+        UINT32 material = rng() % c_numMaterials;
+        UINT32 texture = rng() % c_numTextures;
+        UINT32 mesh = rng() % 64;
+        float depth = std::uniform_real_distribution<float>(0.1f, 100.0f)(rng);
+        DrawListAdd(drawList, DrawKeyMake(0, material, texture, mesh, depth), UINT32(i));
+    }
+    std::vector<SDrawPacket> sceneOrder = drawList.m_packets;
+    DrawListSort(drawList);
+
+    struct SResult
+    {
+        size_t  m_calls = 0;        // that got through the state filter
+        size_t  m_rootDWORDs = 0;   // of root arguments set by those calls. A table is 1 DWORD, and each root constant is 1.
+        size_t  m_copies = 0;       // descriptors copied into transient tables
+        double  m_seconds = 0.0;
+    };
+
+    auto submit = [] (const std::vector<SDrawPacket>& packets, bool bindless)
+    {
+        SResult result;
+        SDescriptorRing ring;
+        DescriptorRingInit(ring, 1024);
+        SCommandStateFilter filter;
+        CommandStateFilterReset(filter, nullptr);
+
+        BenchmarkTimer timer;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            SDrawListStats stats;
+            UINT64 lastSortKey = ~packets[0].m_sortKey;
+            for (const SDrawPacket& packet : packets)
+            {
+                bool materialChanged = DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, EDrawKeyField::material, stats);
+                bool textureChanged = DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, EDrawKeyField::texture, stats);
+                UINT32 material = DrawKeyGetField(packet.m_sortKey, EDrawKeyField::material);
+                UINT32 texture = DrawKeyGetField(packet.m_sortKey, EDrawKeyField::texture);
+                if (bindless)
+                {
+                    // the texture heap indices are made up, the material textures come first
+                    UINT32 textureHeapID = c_numMaterials * c_materialTextures + texture;
+                    if ((materialChanged || textureChanged) && CommandStateFilterRootTable(filter, c_drawConstants, UINT64(material) | (UINT64(textureHeapID) << 32)))
+                    {
+                        result.m_calls++;
+                        result.m_rootDWORDs += 2;
+                    }
+                }
+                else
+                {
+                    if (materialChanged)
+                    {
+                        UINT32 sources[c_materialTextures];
+                        for (UINT32 i = 0; i < c_materialTextures; ++i)
+                            sources[i] = material * c_materialTextures + i;
+                        UINT32 offset;
+                        bool needsCopy;
+                        if (!DescriptorRingAllocateTable(ring, sources, c_materialTextures, offset, needsCopy))
+                            throw std::exception();
+                        if (CommandStateFilterRootTable(filter, c_materialTextureSet, offset))
+                        {
+                            result.m_calls++;
+                            result.m_rootDWORDs += 1;
+                        }
+                    }
+                    if (textureChanged && CommandStateFilterRootTable(filter, c_diffuseTexture, texture))
+                    {
+                        result.m_calls++;
+                        result.m_rootDWORDs += 1;
+                    }
+                }
+                lastSortKey = packet.m_sortKey;
+            }
+            DescriptorRingEndFrame(ring, frame);
+            DescriptorRingRetire(ring, frame);
+        }
+        result.m_seconds = timer.ElapsedSeconds();
+        result.m_copies = ring.m_stats.m_descriptorsCopied;
+        return result;
+    };
+
+    const char* orderNames[] = { "scene order", "sorted order" };
+    const std::vector<SDrawPacket>* orders[] = { &sceneOrder, &drawList.m_packets };
+    for (size_t order = 0; order < _countof(orders); ++order)
+    {
+        SResult tables = submit(*orders[order], false);
+        SResult bindless = submit(*orders[order], true);
+        report.Log("  %zu draws in %s, per frame:", c_numDraws, orderNames[order]);
+        report.Log("    tables:   %zu binding calls, %zu root DWORDs, %zu descriptors copied, %0.3f ms", tables.m_calls / c_numFrames, tables.m_rootDWORDs / c_numFrames, tables.m_copies / c_numFrames, tables.m_seconds * 1000.0 / double(c_numFrames));
+        report.Log("    bindless: %zu binding calls, %zu root DWORDs, %zu descriptors copied, %0.3f ms", bindless.m_calls / c_numFrames, bindless.m_rootDWORDs / c_numFrames, bindless.m_copies / c_numFrames, bindless.m_seconds * 1000.0 / double(c_numFrames));
+        report.Check(bindless.m_calls <= tables.m_calls && bindless.m_copies == 0, "bindless materials make no more binding calls than tables in %s, and copy no descriptors", orderNames[order]);
+    }
+}
+
+int RunBenchmarks (const char* reportFileName)
+{
+    BenchmarkReport report(reportFileName);
+
+    // make the job system here, so this thread is the one that gets to hand out jobs without a lock
+    JobSystemDefault();
+
+    BenchmarkObjLoad(report);
+    BenchmarkTangentSpace(report);
+    BenchmarkMeshlets(report);
+    BenchmarkLods(report);
+    BenchmarkFrustumCulling(report);
+    BenchmarkDrawList(report);
+    BenchmarkDescriptorAllocator(report);
+    BenchmarkDescriptorRing(report);
+    BenchmarkMaterialBinding(report);
+    BenchmarkUploadRing(report);
+    BenchmarkObjectTable(report);
+    BenchmarkStreamingCopy(report);
+    BenchmarkDeferredRelease(report);
+    BenchmarkParallelRecording(report);
+
+    report.Log("===== %zu failures =====", report.GetFailureCount());
+    return int(report.GetFailureCount());
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <stdio.h>
+
+// Collects the results of a benchmark run. Everything logged goes to the debug output window and to the report file.
+class BenchmarkReport
+{
+public:
+    BenchmarkReport (const char* fileName);
+    ~BenchmarkReport ();
+
+    void Log (const char* format, ...);
+
+    // logs the message as PASS or FAIL, and counts the failures
+    void Check (bool condition, const char* format, ...);
+
+    size_t GetFailureCount () const { return m_failureCount; }
+
+private:
+    FILE*   m_file = nullptr;
+    size_t  m_failureCount = 0;
+};
+
+class BenchmarkTimer
+{
+public:
+    BenchmarkTimer ()
+    {
+        Reset();
+    }
+
+    void Reset ()
+    {
+        m_start = std::chrono::high_resolution_clock::now();
+    }
+
+    double ElapsedSeconds () const
+    {
+        std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - m_start;
+        return seconds.count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point m_start;
+};
+
+// Runs the headless benchmarks and validation tests. This is what the -benchmark command line argument does.
+// Returns the number of failed checks, so it can be used as the process exit code.
+int RunBenchmarks (const char* reportFileName);
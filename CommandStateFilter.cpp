@@ -0,0 +1,91 @@
+#include "stdafx.h"
+
+#include "CommandStateFilter.h"
+
+// counts the call, and whether it was dropped
+static bool CountCall (SCommandStateFilter& filter, bool needed)
+{
+    filter.m_stats.m_calls++;
+    if (!needed)
+        filter.m_stats.m_filtered++;
+    return needed;
+}
+
+void CommandStateFilterReset (SCommandStateFilter& filter, const void* pipelineState)
+{
+    SCommandStateFilterStats stats = filter.m_stats;
+    filter = SCommandStateFilter();
+    filter.m_pipelineState = pipelineState;
+    filter.m_stats = stats;
+}
+
+void CommandStateFilterDescriptorHeaps (SCommandStateFilter& filter)
+{
+    filter.m_rootTablesKnown = 0;
+}
+
+bool CommandStateFilterPipelineState (SCommandStateFilter& filter, const void* pipelineState)
+{
+    // null means unknown, and null is never set through the filter, so it doesn't need a known flag
+    bool needed = pipelineState != filter.m_pipelineState || !pipelineState;
+    filter.m_pipelineState = pipelineState;
+    return CountCall(filter, needed);
+}
+
+bool CommandStateFilterRootSignature (SCommandStateFilter& filter, const void* rootSignature)
+{
+    bool needed = rootSignature != filter.m_rootSignature || !rootSignature;
+    if (needed)
+        filter.m_rootTablesKnown = 0;
+    filter.m_rootSignature = rootSignature;
+    return CountCall(filter, needed);
+}
+
+bool CommandStateFilterRootTable (SCommandStateFilter& filter, UINT32 rootParameter, UINT64 descriptorHandle)
+{
+    // parameters past what is tracked are always set
+    if (rootParameter >= c_commandStateMaxRootParameters)
+        return CountCall(filter, true);
+
+    UINT32 bit = 1u << rootParameter;
+    bool needed = !(filter.m_rootTablesKnown & bit) || filter.m_rootTables[rootParameter] != descriptorHandle;
+    filter.m_rootTables[rootParameter] = descriptorHandle;
+    filter.m_rootTablesKnown |= bit;
+    return CountCall(filter, needed);
+}
+
+bool CommandStateFilterVertexBuffer (SCommandStateFilter& filter, UINT32 slot, const SCommandStateVertexBuffer& vertexBuffer)
+{
+    if (slot >= c_commandStateMaxVertexBuffers)
+        return CountCall(filter, true);
+
+    UINT32 bit = 1u << slot;
+    const SCommandStateVertexBuffer& current = filter.m_vertexBuffers[slot];
+    bool needed = !(filter.m_vertexBuffersKnown & bit) ||
+        current.m_location != vertexBuffer.m_location ||
+        current.m_size != vertexBuffer.m_size ||
+        current.m_stride != vertexBuffer.m_stride;
+    filter.m_vertexBuffers[slot] = vertexBuffer;
+    filter.m_vertexBuffersKnown |= bit;
+    return CountCall(filter, needed);
+}
+
+bool CommandStateFilterIndexBuffer (SCommandStateFilter& filter, const SCommandStateIndexBuffer& indexBuffer)
+{
+    const SCommandStateIndexBuffer& current = filter.m_indexBuffer;
+    bool needed = !filter.m_indexBufferKnown ||
+        current.m_location != indexBuffer.m_location ||
+        current.m_size != indexBuffer.m_size ||
+        current.m_format != indexBuffer.m_format;
+    filter.m_indexBuffer = indexBuffer;
+    filter.m_indexBufferKnown = true;
+    return CountCall(filter, needed);
+}
+
+bool CommandStateFilterTopology (SCommandStateFilter& filter, UINT32 topology)
+{
+    bool needed = !filter.m_topologyKnown || filter.m_topology != topology;
+    filter.m_topology = topology;
+    filter.m_topologyKnown = true;
+    return CountCall(filter, needed);
+}
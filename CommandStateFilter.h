@@ -0,0 +1,62 @@
+#pragma once
+
+// Remembers the state bound on a command list so that calls which would set it to what it already is can be dropped.
+// Objects and descriptors are compared by address, so it has to be reset along with its command list, before anything
+// it remembers can be released. Each cdCommandRecorderDX12 owns one for its command list, and asks it before making
+// each state setting call.
+
+static const size_t c_commandStateMaxRootParameters = 32;
+static const size_t c_commandStateMaxVertexBuffers = 16;
+
+struct SCommandStateVertexBuffer
+{
+    UINT64  m_location;
+    UINT32  m_size;
+    UINT32  m_stride;
+};
+
+struct SCommandStateIndexBuffer
+{
+    UINT64  m_location;
+    UINT32  m_size;
+    UINT32  m_format;
+};
+
+struct SCommandStateFilterStats
+{
+    size_t m_calls = 0;
+    size_t m_filtered = 0;
+};
+
+struct SCommandStateFilter
+{
+    // null objects and clear known bits mean that state could be anything
+    const void*                 m_pipelineState;
+    const void*                 m_rootSignature;
+    UINT64                      m_rootTables[c_commandStateMaxRootParameters];
+    UINT32                      m_rootTablesKnown;
+    SCommandStateVertexBuffer   m_vertexBuffers[c_commandStateMaxVertexBuffers];
+    UINT32                      m_vertexBuffersKnown;
+    SCommandStateIndexBuffer    m_indexBuffer;
+    bool                        m_indexBufferKnown;
+    UINT32                      m_topology;
+    bool                        m_topologyKnown;
+
+    SCommandStateFilterStats    m_stats;
+};
+
+// Forgets all bound state, like when the command list is reset. pipelineState is the one the command list was reset
+// with, which may be null. The stats are kept.
+void CommandStateFilterReset (SCommandStateFilter& filter, const void* pipelineState);
+
+// Forgets the root tables, because changing the descriptor heaps unbinds them
+void CommandStateFilterDescriptorHeaps (SCommandStateFilter& filter);
+
+// These each return whether the call needs to be made, and remember the new state if so. Setting the root signature
+// unbinds the root tables, like it does in D3D12.
+bool CommandStateFilterPipelineState (SCommandStateFilter& filter, const void* pipelineState);
+bool CommandStateFilterRootSignature (SCommandStateFilter& filter, const void* rootSignature);
+bool CommandStateFilterRootTable (SCommandStateFilter& filter, UINT32 rootParameter, UINT64 descriptorHandle);
+bool CommandStateFilterVertexBuffer (SCommandStateFilter& filter, UINT32 slot, const SCommandStateVertexBuffer& vertexBuffer);
+bool CommandStateFilterIndexBuffer (SCommandStateFilter& filter, const SCommandStateIndexBuffer& indexBuffer);
+bool CommandStateFilterTopology (SCommandStateFilter& filter, UINT32 topology);
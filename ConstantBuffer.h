@@ -2,6 +2,7 @@
 
 #include "DXSample.h"
 #include "dx12.h"
+#include "StreamingCopy.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -21,58 +22,87 @@ public:
 
     void Init (cdGraphicsAPIDX12& graphicsAPI)
     {
-        // Create the constant buffer.
+        m_graphicsAPI = &graphicsAPI;
+
+        // Create the constant buffer, with a version for each frame in flight
         ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
             D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
+            &CD3DX12_RESOURCE_DESC::Buffer(c_versionSize * c_framesInFlight),
             D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
             IID_PPV_ARGS(&m_constantBuffer)));
 
-        // reserve a heap id for this constant buffer
-        m_index = graphicsAPI.ReserveGeneralHeapID();
-
-        // Describe and create a constant buffer view.
-        D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-        cbvDesc.BufferLocation = m_constantBuffer->GetGPUVirtualAddress();
-        cbvDesc.SizeInBytes = (sizeof(T) + 255) & ~255;	// CB size is required to be 256-byte aligned.
-        CD3DX12_CPU_DESCRIPTOR_HANDLE handle(
-            graphicsAPI.m_generalHeap->GetCPUDescriptorHandleForHeapStart(),
-            m_index,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
-        graphicsAPI.m_device->CreateConstantBufferView(&cbvDesc, handle);
-
         // Map and initialize the constant buffer. We don't unmap this until the
         // app closes. Keeping things mapped for the lifetime of the resource is okay.
         CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
         ThrowIfFailed(m_constantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_constantBufferBegin)));
+        m_gpuVirtualAddress = m_constantBuffer->GetGPUVirtualAddress();
+
+        // the mirrors have to start out matching the versions
+        memset(m_slotData, 0, sizeof(m_slotData));
+        for (unsigned int slot = 0; slot < c_framesInFlight; ++slot)
+            StreamingCopy(m_constantBufferBegin + slot * c_versionSize, &m_slotData[slot], sizeof(T));
 
         // write the default constructed data
         Write([] (T&) {});
     }
 
+    // Only the version for the frame being recorded is written, since the GPU may still be reading the others. They
+    // are brought up to date when their frame gets the GPU address. Only the 16 byte lines that differ from what the
+    // version has are written, because the upload heap is write combined and slow to write to.
     template <typename LAMBDA>
     void Write (LAMBDA& lambda)
     {
         lambda(m_constantBufferData);
-        memcpy(m_constantBufferBegin, &m_constantBufferData, sizeof(T));
+        m_dataVersion++;
+        UpdateVersion(m_graphicsAPI->GetFrameSlot());
+    }
+
+    // the CPU copy of the last written data
+    const T& Read () const
+    {
+        return m_constantBufferData;
+    }
+
+    // how many of the lines that could have been written to the upload heap were
+    const SStreamingCopyStats& GetWriteStats () const
+    {
+        return m_writeStats;
     }
 
-    CD3DX12_GPU_DESCRIPTOR_HANDLE GetGPUHandle(cdGraphicsAPIDX12& graphicsAPI)
+    // Constant buffers are bound as root CBVs, so they don't need a descriptor. This is the version for the frame being
+    // recorded.
+    D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress()
     {
-        CD3DX12_GPU_DESCRIPTOR_HANDLE handle(
-            graphicsAPI.m_generalHeap->GetGPUDescriptorHandleForHeapStart(),
-            m_index,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
-        return handle;
+        unsigned int slot = m_graphicsAPI->GetFrameSlot();
+        UpdateVersion(slot);
+        return m_gpuVirtualAddress + slot * c_versionSize;
     }
 
 private:
+    // CB size is required to be 256-byte aligned
+    static const size_t c_versionSize = (sizeof(T) + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) & ~size_t(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
+
+    void UpdateVersion (unsigned int slot)
+    {
+        if (m_slotDataVersions[slot] == m_dataVersion)
+            return;
+        StreamingCopyChangedLines(m_constantBufferBegin + slot * c_versionSize, &m_slotData[slot], &m_constantBufferData, sizeof(T), m_writeStats);
+        m_slotDataVersions[slot] = m_dataVersion;
+    }
+
+    cdGraphicsAPIDX12*              m_graphicsAPI = nullptr;
     ComPtr<ID3D12Resource>          m_constantBuffer;      // the actual d3d resource
+    D3D12_GPU_VIRTUAL_ADDRESS       m_gpuVirtualAddress = 0;
     T                               m_constantBufferData;  // the CPU copy that can be read/write.
-    T*                              m_constantBufferBegin; // write to here to make it go to the video card. Write only.
-    unsigned int                    m_index;
+    unsigned char*                  m_constantBufferBegin = nullptr; // write to here to make it go to the video card. Write only.
+
+    // which write each version has, so versions that missed writes can catch up
+    size_t                          m_dataVersion = 0;
+    size_t                          m_slotDataVersions[c_framesInFlight] = {};
+
+    // what is in each version, so that writes can skip what didn't change without reading the upload heap
+    T                               m_slotData[c_framesInFlight];
+    SStreamingCopyStats             m_writeStats;
 };
\ No newline at end of file
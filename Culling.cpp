@@ -0,0 +1,200 @@
+#include "stdafx.h"
+
+#include "Culling.h"
+
+#include <immintrin.h>
+
+SFrustum FrustumFromViewProjection (const XMMATRIX& viewProjection)
+{
+    // Gribb / Hartmann plane extraction
+    XMVECTOR planes[6] =
+    {
+        XMVectorAdd(viewProjection.r[3], viewProjection.r[0]),      // left
+        XMVectorSubtract(viewProjection.r[3], viewProjection.r[0]), // right
+        XMVectorAdd(viewProjection.r[3], viewProjection.r[1]),      // bottom
+        XMVectorSubtract(viewProjection.r[3], viewProjection.r[1]), // top
+        viewProjection.r[2],                                        // near
+        XMVectorSubtract(viewProjection.r[3], viewProjection.r[2]), // far
+    };
+
+    SFrustum frustum;
+    for (size_t i = 0; i < 6; ++i)
+        XMStoreFloat4(&frustum.m_planes[i], XMPlaneNormalize(planes[i]));
+    return frustum;
+}
+
+bool FrustumTestSphere (const SFrustum& frustum, const XMFLOAT3& center, float radius)
+{
+    for (const XMFLOAT4& plane : frustum.m_planes)
+    {
+        if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+// the arrays are padded to this many objects
+static const size_t c_cullingBatchSize = 8;
+
+void CullingBoundsClear (SCullingBounds& bounds)
+{
+    bounds = SCullingBounds();
+}
+
+size_t CullingBoundsAdd (SCullingBounds& bounds, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, float radius, const XMMATRIX& objectToWorld)
+{
+    size_t index = bounds.m_count++;
+    if (index % c_cullingBatchSize == 0)
+    {
+        // grow by a batch of empty objects. They are never reported as visible.
+        size_t size = index + c_cullingBatchSize;
+        for (std::vector<float>* array : { &bounds.m_centerX, &bounds.m_centerY, &bounds.m_centerZ, &bounds.m_radius, &bounds.m_extentX, &bounds.m_extentY, &bounds.m_extentZ })
+            array->resize(size, 0.0f);
+    }
+
+    XMFLOAT3 center;
+    XMVECTOR objectCenter = XMVectorScale(XMVectorAdd(XMLoadFloat3(&boxMin), XMLoadFloat3(&boxMax)), 0.5f);
+    XMStoreFloat3(&center, XMVector3TransformCoord(objectCenter, objectToWorld));
+
+    // the world space box around the transformed box has an extent of sum(abs(axis) * extent) over the matrix axes
+    XMFLOAT3 extent;
+    XMVECTOR worldExtent = XMVectorAdd(XMVectorAdd(
+        XMVectorScale(XMVectorAbs(objectToWorld.r[0]), (boxMax.x - boxMin.x) * 0.5f),
+        XMVectorScale(XMVectorAbs(objectToWorld.r[1]), (boxMax.y - boxMin.y) * 0.5f)),
+        XMVectorScale(XMVectorAbs(objectToWorld.r[2]), (boxMax.z - boxMin.z) * 0.5f));
+    XMStoreFloat3(&extent, worldExtent);
+
+    // the radius scales by the largest axis scale
+    float scale = std::max<float>(std::max<float>(XMVectorGetX(XMVector3Length(objectToWorld.r[0])), XMVectorGetX(XMVector3Length(objectToWorld.r[1]))), XMVectorGetX(XMVector3Length(objectToWorld.r[2])));
+
+    bounds.m_centerX[index] = center.x;
+    bounds.m_centerY[index] = center.y;
+    bounds.m_centerZ[index] = center.z;
+    bounds.m_radius[index] = radius * scale;
+    bounds.m_extentX[index] = extent.x;
+    bounds.m_extentY[index] = extent.y;
+    bounds.m_extentZ[index] = extent.z;
+    return index;
+}
+
+// appends the indices of the set bits of the mask, for the batch of objects starting at firstIndex
+static inline void AppendVisible (int mask, size_t firstIndex, size_t count, std::vector<UINT32>& visible)
+{
+    while (mask)
+    {
+        unsigned long bit;
+        _BitScanForward(&bit, mask);
+        mask &= mask - 1;
+        if (firstIndex + bit < count)
+            visible.push_back(UINT32(firstIndex + bit));
+    }
+}
+
+void CullingFrustum (const SFrustum& frustum, const SCullingBounds& bounds, std::vector<UINT32>& visible, SCullingStats& stats)
+{
+    size_t visibleBefore = visible.size();
+
+#if defined(__AVX__)
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6], planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+    for (size_t i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4& plane = frustum.m_planes[i];
+        planeX[i] = _mm256_set1_ps(plane.x);
+        planeY[i] = _mm256_set1_ps(plane.y);
+        planeZ[i] = _mm256_set1_ps(plane.z);
+        planeW[i] = _mm256_set1_ps(plane.w);
+        planeAbsX[i] = _mm256_set1_ps(std::fabs(plane.x));
+        planeAbsY[i] = _mm256_set1_ps(std::fabs(plane.y));
+        planeAbsZ[i] = _mm256_set1_ps(std::fabs(plane.z));
+    }
+
+    for (size_t first = 0; first < bounds.m_count; first += 8)
+    {
+        __m256 centerX = _mm256_loadu_ps(&bounds.m_centerX[first]);
+        __m256 centerY = _mm256_loadu_ps(&bounds.m_centerY[first]);
+        __m256 centerZ = _mm256_loadu_ps(&bounds.m_centerZ[first]);
+        __m256 radius = _mm256_loadu_ps(&bounds.m_radius[first]);
+        __m256 extentX = _mm256_loadu_ps(&bounds.m_extentX[first]);
+        __m256 extentY = _mm256_loadu_ps(&bounds.m_extentY[first]);
+        __m256 extentZ = _mm256_loadu_ps(&bounds.m_extentZ[first]);
+
+        // inside means within the sphere's radius and within the box's projected extent of every plane
+        __m256 outside = _mm256_setzero_ps();
+        for (size_t i = 0; i < 6; ++i)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[i], centerX), _mm256_mul_ps(planeY[i], centerY)), _mm256_add_ps(_mm256_mul_ps(planeZ[i], centerZ), planeW[i]));
+            __m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeAbsX[i], extentX), _mm256_mul_ps(planeAbsY[i], extentY)), _mm256_mul_ps(planeAbsZ[i], extentZ));
+            __m256 negativeDistance = _mm256_sub_ps(_mm256_setzero_ps(), distance);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(negativeDistance, radius, _CMP_GT_OQ));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(negativeDistance, boxRadius, _CMP_GT_OQ));
+        }
+
+        AppendVisible(~_mm256_movemask_ps(outside) & 0xFF, first, bounds.m_count, visible);
+    }
+#else
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6], planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+    for (size_t i = 0; i < 6; ++i)
+    {
+        const XMFLOAT4& plane = frustum.m_planes[i];
+        planeX[i] = _mm_set1_ps(plane.x);
+        planeY[i] = _mm_set1_ps(plane.y);
+        planeZ[i] = _mm_set1_ps(plane.z);
+        planeW[i] = _mm_set1_ps(plane.w);
+        planeAbsX[i] = _mm_set1_ps(std::fabs(plane.x));
+        planeAbsY[i] = _mm_set1_ps(std::fabs(plane.y));
+        planeAbsZ[i] = _mm_set1_ps(std::fabs(plane.z));
+    }
+
+    for (size_t first = 0; first < bounds.m_count; first += 4)
+    {
+        __m128 centerX = _mm_loadu_ps(&bounds.m_centerX[first]);
+        __m128 centerY = _mm_loadu_ps(&bounds.m_centerY[first]);
+        __m128 centerZ = _mm_loadu_ps(&bounds.m_centerZ[first]);
+        __m128 radius = _mm_loadu_ps(&bounds.m_radius[first]);
+        __m128 extentX = _mm_loadu_ps(&bounds.m_extentX[first]);
+        __m128 extentY = _mm_loadu_ps(&bounds.m_extentY[first]);
+        __m128 extentZ = _mm_loadu_ps(&bounds.m_extentZ[first]);
+
+        // inside means within the sphere's radius and within the box's projected extent of every plane
+        __m128 outside = _mm_setzero_ps();
+        for (size_t i = 0; i < 6; ++i)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[i], centerX), _mm_mul_ps(planeY[i], centerY)), _mm_add_ps(_mm_mul_ps(planeZ[i], centerZ), planeW[i]));
+            __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeAbsX[i], extentX), _mm_mul_ps(planeAbsY[i], extentY)), _mm_mul_ps(planeAbsZ[i], extentZ));
+            __m128 negativeDistance = _mm_sub_ps(_mm_setzero_ps(), distance);
+            outside = _mm_or_ps(outside, _mm_cmpgt_ps(negativeDistance, radius));
+            outside = _mm_or_ps(outside, _mm_cmpgt_ps(negativeDistance, boxRadius));
+        }
+
+        AppendVisible(~_mm_movemask_ps(outside) & 0xF, first, bounds.m_count, visible);
+    }
+#endif
+
+    stats.m_tested += bounds.m_count;
+    stats.m_visible += visible.size() - visibleBefore;
+}
+
+void CullingFrustumScalar (const SFrustum& frustum, const SCullingBounds& bounds, std::vector<UINT32>& visible, SCullingStats& stats)
+{
+    for (size_t index = 0; index < bounds.m_count; ++index)
+    {
+        bool inside = true;
+        for (const XMFLOAT4& plane : frustum.m_planes)
+        {
+            float distance = plane.x * bounds.m_centerX[index] + plane.y * bounds.m_centerY[index] + plane.z * bounds.m_centerZ[index] + plane.w;
+            float boxRadius = std::fabs(plane.x) * bounds.m_extentX[index] + std::fabs(plane.y) * bounds.m_extentY[index] + std::fabs(plane.z) * bounds.m_extentZ[index];
+            if (-distance > bounds.m_radius[index] || -distance > boxRadius)
+            {
+                inside = false;
+                break;
+            }
+        }
+
+        stats.m_tested++;
+        if (inside)
+        {
+            stats.m_visible++;
+            visible.push_back(UINT32(index));
+        }
+    }
+}
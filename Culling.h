@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+using namespace DirectX;
+
+// The 6 planes of a view frustum, facing inwards. A point p is inside of a plane when dot(plane.xyz, p) + plane.w >= 0.
+// The planes are normalized, so that value is also the distance to the plane.
+struct SFrustum
+{
+    XMFLOAT4 m_planes[6];
+};
+
+// Makes a world space frustum from a view projection matrix that is laid out like SConstantBuffer::viewProjectionMatrix,
+// meaning clip = matrix * position, with D3D's 0 to 1 clip space depth.
+SFrustum FrustumFromViewProjection (const XMMATRIX& viewProjection);
+
+// returns true if the sphere is at least partially inside the frustum
+bool FrustumTestSphere (const SFrustum& frustum, const XMFLOAT3& center, float radius);
+
+// World space bounds of many objects, as structure of arrays for SIMD culling. Each object has a bounding box and a
+// bounding sphere that share a center. The arrays are padded to a multiple of 8 objects.
+struct SCullingBounds
+{
+    std::vector<float>  m_centerX;
+    std::vector<float>  m_centerY;
+    std::vector<float>  m_centerZ;
+    std::vector<float>  m_radius;
+    std::vector<float>  m_extentX;      // half size of the bounding box
+    std::vector<float>  m_extentY;
+    std::vector<float>  m_extentZ;
+    size_t              m_count = 0;
+};
+
+struct SCullingStats
+{
+    size_t m_tested = 0;
+    size_t m_visible = 0;
+};
+
+void CullingBoundsClear (SCullingBounds& bounds);
+
+// Adds an object, given its object space bounds and a DirectXMath row vector object to world matrix. Returns its index.
+size_t CullingBoundsAdd (SCullingBounds& bounds, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, float radius, const XMMATRIX& objectToWorld);
+
+// Tests the objects against the frustum 4 at a time with SSE, or 8 at a time with AVX if the build targets it.
+// An object is visible if both its sphere and its box are at least partially inside of every plane.
+// The indices of the visible objects are appended to visible in increasing order.
+void CullingFrustum (const SFrustum& frustum, const SCullingBounds& bounds, std::vector<UINT32>& visible, SCullingStats& stats);
+
+// The same test one object at a time, to compare against
+void CullingFrustumScalar (const SFrustum& frustum, const SCullingBounds& bounds, std::vector<UINT32>& visible, SCullingStats& stats);
@@ -14,6 +14,7 @@
 
 #include "Model.h"
 #include "Math.h"
+#include "Benchmarks.h"
 #include <vector>
 #include <chrono>
 #include "pix3.h"
@@ -23,12 +24,17 @@ enum RootTableParameter
 {
     SceneConstantBuffer = 0,
     ModelConstantBuffer,
-    TextureSampler,
     UAV,
     SplitsumTexture,
     DiffuseTexture,
     SkyboxTextureSet,
     MaterialTextureSet,
+    ObjectData,
+
+    // only in the root signature if bindless materials are supported
+    BindlessTextures,
+    MaterialRecords,
+    DrawConstants,
 
     Count
 };
@@ -103,7 +109,14 @@ void D3D12HelloTriangle::MakePSOs()
     {
         SShaderPermutations::EMaterialMode materialMode;
         SShaderPermutations::EStereoMode stereoMode;
-        SShaderPermutations::GetSettings(i, materialMode, stereoMode);
+        SShaderPermutations::EMaterialBinding materialBinding;
+        SShaderPermutations::GetSettings(i, materialMode, stereoMode, materialBinding);
+
+        if (stereoMode == SShaderPermutations::EStereoMode::singlePass && !m_graphicsAPI.m_renderTargetArrayIndexFromVS)
+            continue;
+
+        if (materialBinding == SShaderPermutations::EMaterialBinding::bindless && !m_graphicsAPI.m_bindlessSupported)
+            continue;
 
         char materialModeString[2] = { 0, 0 };
         materialModeString[0] = '0' + (char)materialMode;
@@ -111,19 +124,35 @@ void D3D12HelloTriangle::MakePSOs()
         char stereoModeString[2] = { 0, 0 };
         stereoModeString[0] = '0' + (char)stereoMode;
 
+        char materialBindingString[2] = { 0, 0 };
+        materialBindingString[0] = '0' + (char)materialBinding;
+
         ID3DBlob* vertexShader;
         ID3DBlob* pixelShader;
         m_graphicsAPI.CompileVSPS(L"./assets/Shaders/shaders.hlsl", vertexShader, pixelShader, m_shaderDebug,
             {
                 { "MATERIAL_MODE", materialModeString },
                 { "STEREO_MODE", stereoModeString },
+                { "MATERIAL_BINDING", materialBindingString },
                 { nullptr, nullptr }
             }
         );
 
+        // single pass stereo draws every instance once per eye, so it steps through the instance matrices at a lower rate
+        D3D12_INPUT_ELEMENT_DESC inputElements[_countof(inputElementDescsInstanced)];
+        std::copy(std::begin(inputElementDescsInstanced), std::end(inputElementDescsInstanced), inputElements);
+        if (stereoMode == SShaderPermutations::EStereoMode::singlePass)
+        {
+            for (D3D12_INPUT_ELEMENT_DESC& element : inputElements)
+            {
+                if (element.InputSlotClass == D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA)
+                    element.InstanceDataStepRate = c_stereoEyeCount;
+            }
+        }
+
         // Describe and create the graphics pipeline state object (PSO).
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-        psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+        psoDesc.InputLayout = { inputElements, _countof(inputElements) };
         psoDesc.pRootSignature = m_rootSignature;
         psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader);
         psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader);
@@ -155,6 +184,12 @@ void D3D12HelloTriangle::MakePSOs()
                 psoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_GREEN | D3D12_COLOR_WRITE_ENABLE_BLUE;
                 break;
             }
+            case SShaderPermutations::EStereoMode::singlePass:
+            {
+                // each eye has its own render target, and the color channels are picked when the eyes are combined
+                psoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+                break;
+            }
         }
 
         ThrowIfFailed(m_graphicsAPI.m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineStateModels[i])));
@@ -163,12 +198,19 @@ void D3D12HelloTriangle::MakePSOs()
         pixelShader->Release();
     }
 
-	// create the skybox shader
+	// create the skybox shader. It only has a few textures, so it always uses descriptor tables.
     for (size_t i = 0; i < SShaderPermutations::Count; ++i)
     {
         SShaderPermutations::EMaterialMode materialMode;
         SShaderPermutations::EStereoMode stereoMode;
-        SShaderPermutations::GetSettings(i, materialMode, stereoMode);
+        SShaderPermutations::EMaterialBinding materialBinding;
+        SShaderPermutations::GetSettings(i, materialMode, stereoMode, materialBinding);
+
+        if (stereoMode == SShaderPermutations::EStereoMode::singlePass && !m_graphicsAPI.m_renderTargetArrayIndexFromVS)
+            continue;
+
+        if (materialBinding != SShaderPermutations::EMaterialBinding::tables)
+            continue;
 
         char materialModeString[2] = { 0, 0 };
         materialModeString[0] = '0' + (char)materialMode;
@@ -214,6 +256,37 @@ void D3D12HelloTriangle::MakePSOs()
         vertexShader->Release();
         pixelShader->Release();
 	}
+
+    // create the shader that combines the eyes of single pass stereo
+    if (m_graphicsAPI.m_renderTargetArrayIndexFromVS)
+    {
+        ID3DBlob* vertexShader;
+        ID3DBlob* pixelShader;
+        m_graphicsAPI.CompileVSPS(L"./assets/Shaders/stereo.hlsl", vertexShader, pixelShader, m_shaderDebug, { { nullptr, nullptr } });
+
+        // a full screen triangle made from the vertex ids
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.InputLayout = { nullptr, 0 };
+        psoDesc.pRootSignature = m_rootSignature;
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader);
+        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader);
+        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState.DepthEnable = false;
+        psoDesc.SampleMask = UINT_MAX;
+        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        psoDesc.NumRenderTargets = 1;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        psoDesc.SampleDesc.Count = 1;
+        psoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+
+        ThrowIfFailed(m_graphicsAPI.m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineStateStereoComposite)));
+
+        vertexShader->Release();
+        pixelShader->Release();
+    }
 }
 
 D3D12HelloTriangle::D3D12HelloTriangle(UINT width, UINT height, std::wstring name) :
@@ -227,20 +300,30 @@ D3D12HelloTriangle::D3D12HelloTriangle(UINT width, UINT height, std::wstring nam
 
 void D3D12HelloTriangle::OnInit()
 {
-    m_graphicsAPI.Create(m_GPUDebug, false, 2, m_width, m_height, Win32Application::GetHwnd());
+    // make the job system here, so the main thread is the one that gets to hand out jobs without a lock
+    JobSystemDefault();
+
+    m_graphicsAPI.Create(m_GPUDebug, false, 2, m_width, m_height, Win32Application::GetHwnd(), 0, m_frameLatencyWaitable);
     
-    m_rootSignature = m_graphicsAPI.CreateRootSignature(
-        {
-            { D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1 },
-            { D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1 },
-            { D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER , 1},
-            { D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1 },
-            { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 },
-            { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 },
-            { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3 },
-            { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 5 }
-        }
-    );    
+    std::vector<cdRootSignatureParameter> rootSignatureParameters =
+    {
+        { D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, ERootParameterKind::constantBufferView },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, ERootParameterKind::constantBufferView },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1 },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3 },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 5 },
+        { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, ERootParameterKind::shaderResourceView }
+    };
+    if (m_graphicsAPI.m_bindlessSupported)
+    {
+        rootSignatureParameters.push_back({ D3D12_DESCRIPTOR_RANGE_TYPE_SRV, c_unboundedDescriptorRange, ERootParameterKind::descriptorTable, 1 });
+        rootSignatureParameters.push_back({ D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, ERootParameterKind::shaderResourceView });
+        rootSignatureParameters.push_back({ D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2, ERootParameterKind::constants });
+    }
+    rootSignatureParameters.push_back({ D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, ERootParameterKind::staticSampler });
+    m_rootSignature = m_graphicsAPI.CreateRootSignature(rootSignatureParameters);
 
     MakePSOs();
 
@@ -255,42 +338,68 @@ void D3D12HelloTriangle::LoadTextures()
 {
     m_splitSum = TextureMgr::LoadTexture(m_graphicsAPI, "assets/splitsum.png", true, false);
 
-    // load the material textures
-    size_t fileNameIndex = 0;
-    for (size_t materialIndex = 0; materialIndex < (size_t)EMaterial::Count; ++materialIndex)
+    // load the material textures all at once, so the files are decoded in parallel
+    static const size_t c_numTextures = (size_t)EMaterial::Count * (size_t)EMaterialTexture::Count;
+    std::vector<std::string> fileNames(c_numTextures);
+    std::vector<STextureLoad> loads(c_numTextures);
+    for (size_t fileNameIndex = 0; fileNameIndex < c_numTextures; ++fileNameIndex)
     {
-        for (size_t textureIndex = 0; textureIndex < (size_t)EMaterialTexture::Count; ++textureIndex)
+        STextureLoad& load = loads[fileNameIndex];
+        if (s_materialFileNames[fileNameIndex])
         {
-            TextureID texture;
+            char fileName[1024];
+            sprintf_s(fileName, "assets/PBRMaterialTextures/%s", s_materialFileNames[fileNameIndex]);
+            fileNames[fileNameIndex] = fileName;
+            load.m_isLinear = s_materialTextureLinear[fileNameIndex % (size_t)EMaterialTexture::Count];
+            load.m_makeMips = true;
+        }
+        else
+        {
+            fileNames[fileNameIndex] = "Assets/white.png";
+            load.m_isLinear = true;
+        }
+        load.m_fileName = fileNames[fileNameIndex].c_str();
+    }
 
-            if (s_materialFileNames[fileNameIndex])
-            {
-                char fileName[1024];
-                sprintf_s(fileName, "assets/PBRMaterialTextures/%s", s_materialFileNames[fileNameIndex]);
-                texture = TextureMgr::LoadTexture(m_graphicsAPI, fileName, s_materialTextureLinear[textureIndex], true);
-            }
-            else
-            {
-                texture = TextureMgr::LoadTexture(m_graphicsAPI, "Assets/white.png", true, false);
-            }
+    TextureID textures[c_numTextures];
+    TextureMgr::LoadTextures(m_graphicsAPI, c_numTextures, loads.data(), textures);
+    for (size_t materialIndex = 0; materialIndex < (size_t)EMaterial::Count; ++materialIndex)
+    {
+        for (size_t textureIndex = 0; textureIndex < (size_t)EMaterialTexture::Count; ++textureIndex)
+            m_materials[materialIndex][textureIndex] = textures[materialIndex * (size_t)EMaterialTexture::Count + textureIndex];
+    }
 
-            m_materials[materialIndex][textureIndex] = texture;
+    MakeMaterialRecords();
+}
 
-            fileNameIndex++;
-        }
+void D3D12HelloTriangle::MakeMaterialRecords()
+{
+    if (!m_graphicsAPI.m_bindlessSupported)
+        return;
 
-        static_assert((size_t)EMaterialTexture::Count == 5, "Please update this code");
-        TextureID textures[] =
-        {
-            m_materials[materialIndex][0],
-            m_materials[materialIndex][1],
-            m_materials[materialIndex][2],
-            m_materials[materialIndex][3],
-            m_materials[materialIndex][4],
-        };
-
-        m_materialDescriptorTableHeapID[materialIndex] = TextureMgr::CreateTextureDescriptorTable(m_graphicsAPI, _countof(textures), textures);
+    SMaterialRecord records[(size_t)EMaterial::Count];
+    for (size_t materialIndex = 0; materialIndex < (size_t)EMaterial::Count; ++materialIndex)
+    {
+        for (size_t textureIndex = 0; textureIndex < (size_t)EMaterialTexture::Count; ++textureIndex)
+            records[materialIndex].m_textures[textureIndex] = TextureMgr::GetHeapID(m_materials[materialIndex][textureIndex]);
     }
+
+    // the records never change, so they stay in the upload heap
+    ThrowIfFailed(m_graphicsAPI.m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(sizeof(records)),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_materialRecords)));
+
+    void* materialRecordsBegin;
+    CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(m_materialRecords->Map(0, &readRange, &materialRecordsBegin));
+    memcpy(materialRecordsBegin, records, sizeof(records));
+    m_materialRecords->Unmap(0, nullptr);
+
+    NAME_D3D12_OBJECT(m_materialRecords);
 }
 
 void D3D12HelloTriangle::MakeProceduralMeshes()
@@ -322,10 +431,10 @@ void D3D12HelloTriangle::MakeProceduralMeshes()
                 float cosY2 = std::cosf(percentY2 * c_pi);
 
                 // Position, normal, tangent, uv
-                Vertex point00 = { { cosX1 * sinY1, cosY1, sinX1 * sinY1 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX1, percentY1 } };
-                Vertex point10 = { { cosX2 * sinY1, cosY1, sinX2 * sinY1 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX2, percentY1 } };
-                Vertex point01 = { { cosX1 * sinY2, cosY2, sinX1 * sinY2 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX1, percentY2 } };
-                Vertex point11 = { { cosX2 * sinY2, cosY2, sinX2 * sinY2 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX2, percentY2 } };
+                Vertex point00 = { { cosX1 * sinY1, cosY1, sinX1 * sinY1 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX1, percentY1 } };
+                Vertex point10 = { { cosX2 * sinY1, cosY1, sinX2 * sinY1 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX2, percentY1 } };
+                Vertex point01 = { { cosX1 * sinY2, cosY2, sinX1 * sinY2 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX1, percentY2 } };
+                Vertex point11 = { { cosX2 * sinY2, cosY2, sinX2 * sinY2 },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX2, percentY2 } };
 
                 // triangle 1 = 00, 01, 10
                 sphereVertices.push_back(point00);
@@ -357,9 +466,9 @@ void D3D12HelloTriangle::MakeProceduralMeshes()
                 float cosY = std::cosf(percentY * c_pi);
                 float sinY = std::sinf(percentY * c_pi);
 
-                Vertex point0 = { { 0.0f, 1.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } };
-                Vertex point1 = { { cosX1 * sinY, cosY, sinX1 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX1, percentY } };
-                Vertex point2 = { { cosX2 * sinY, cosY, sinX2 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX2, percentY } };
+                Vertex point0 = { { 0.0f, 1.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } };
+                Vertex point1 = { { cosX1 * sinY, cosY, sinX1 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX1, percentY } };
+                Vertex point2 = { { cosX2 * sinY, cosY, sinX2 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX2, percentY } };
 
                 sphereVertices.push_back(point0);
                 sphereVertices.push_back(point1);
@@ -374,9 +483,9 @@ void D3D12HelloTriangle::MakeProceduralMeshes()
                 float cosY = std::cosf(percentY * c_pi);
                 float sinY = std::sinf(percentY * c_pi);
 
-                Vertex point0 = { { 0.0f, -1.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 1.0f } };
-                Vertex point1 = { { cosX1 * sinY, cosY, sinX1 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX1, percentY } };
-                Vertex point2 = { { cosX2 * sinY, cosY, sinX2 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ percentX2, percentY } };
+                Vertex point0 = { { 0.0f, -1.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 0.0f, 1.0f } };
+                Vertex point1 = { { cosX1 * sinY, cosY, sinX1 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX1, percentY } };
+                Vertex point2 = { { cosX2 * sinY, cosY, sinX2 * sinY },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ percentX2, percentY } };
 
                 sphereVertices.push_back(point2);
                 sphereVertices.push_back(point1);
@@ -413,35 +522,126 @@ void D3D12HelloTriangle::MakeProceduralMeshes()
     }
 }
 
+// the stress scene is a square of spheres, going away from the camera
+static const size_t c_stressSceneSize = 100;
+static const float c_stressSceneSpacing = 1.0f;
+static const float c_stressSceneSphereScale = 0.4f;
+
+// the object table starts big enough for the normal scene, and doubles when it needs to
+static const UINT32 c_initialObjectSlots = 256;
+
+// Draw lists are only split so that each command list has at least this many draws. The stress scene batches its
+// spheres into a draw per material and LOD, which is up to 55 draws, so this splits it over up to 6 command lists and
+// the recording thread count toggle matters there. The default scene is a few draws, and records on one thread.
+static const size_t c_minDrawsPerChunk = 8;
+
+// how many visible subobjects each draw list building job works on
+static const size_t c_drawListBuildGrainSize = 256;
+
+// dirty object ranges closer than this are uploaded with one copy
+static const UINT32 c_objectRangeMaxGap = 4;
+
+void D3D12HelloTriangle::MakeInstances()
+{
+    for (const SModelInstance& instance : m_instances)
+        ObjectTableFree(m_objectTable, instance.m_objectSlot);
+    m_instances.clear();
+
+    MakeSceneInstances();
+
+    // give every instance a slot in the object table, and write its data there
+    for (SModelInstance& instance : m_instances)
+    {
+        while (!ObjectTableAllocate(m_objectTable, instance.m_objectSlot))
+            ObjectTableGrow(m_objectTable, m_objectTable.m_capacity * 2);
+        m_objectData.resize(m_objectTable.m_capacity);
+        m_objectData[instance.m_objectSlot].m_objectToWorld = instance.m_objectToWorld;
+    }
+}
+
+void D3D12HelloTriangle::MakeSceneInstances()
+{
+    if (!m_stressScene)
+    {
+        // one of each model, where it was loaded. The model constants have the transposed model matrix.
+        for (size_t i = 0; i < (size_t)EModel::Count; ++i)
+        {
+            SModelInstance instance;
+            instance.m_model = i;
+            XMStoreFloat4x4(&instance.m_objectToWorld, XMMatrixTranspose(m_models[i].m_constants.modelMatrix));
+            instance.m_material = s_modelsToLoad[i].modelMaterial;
+            m_instances.push_back(instance);
+        }
+        return;
+    }
+
+    // center the sphere on its origin before scaling it down, and give the spheres all of the materials
+    const SSubObject& sphere = m_models[(size_t)EModel::Sphere].m_subObjects[0];
+    XMFLOAT3 center = (sphere.m_boundsMin + sphere.m_boundsMax) * 0.5f;
+    XMMATRIX centerAndScale = XMMatrixMultiply(XMMatrixTranslation(-center.x, -center.y, -center.z), XMMatrixScaling(c_stressSceneSphereScale, c_stressSceneSphereScale, c_stressSceneSphereScale));
+    m_instances.resize(c_stressSceneSize * c_stressSceneSize);
+    for (size_t z = 0; z < c_stressSceneSize; ++z)
+    {
+        for (size_t x = 0; x < c_stressSceneSize; ++x)
+        {
+            SModelInstance& instance = m_instances[z * c_stressSceneSize + x];
+            instance.m_model = (size_t)EModel::Sphere;
+            XMMATRIX translation = XMMatrixTranslation((float(x) - float(c_stressSceneSize - 1) * 0.5f) * c_stressSceneSpacing, 0.5f, float(z) * c_stressSceneSpacing);
+            XMStoreFloat4x4(&instance.m_objectToWorld, XMMatrixMultiply(centerAndScale, translation));
+            instance.m_material = (EMaterial)((x + z) % (size_t)EMaterial::Count);
+        }
+    }
+}
+
+void D3D12HelloTriangle::MakeCullingBounds()
+{
+    CullingBoundsClear(m_cullingBounds);
+    m_cullingEntries.clear();
+
+    // every subobject of every model is its own mesh
+    UINT32 firstMesh[(size_t)EModel::Count];
+    UINT32 meshCount = 0;
+    for (size_t i = 0; i < (size_t)EModel::Count; ++i)
+    {
+        firstMesh[i] = meshCount;
+        meshCount += UINT32(m_models[i].m_subObjects.size());
+    }
+
+    for (size_t i = 0; i < m_instances.size(); ++i)
+    {
+        const SModelInstance& instance = m_instances[i];
+        XMMATRIX objectToWorld = XMLoadFloat4x4(&instance.m_objectToWorld);
+        float objectScale = std::max<float>(std::max<float>(XMVectorGetX(XMVector3Length(objectToWorld.r[0])), XMVectorGetX(XMVector3Length(objectToWorld.r[1]))), XMVectorGetX(XMVector3Length(objectToWorld.r[2])));
+        const std::vector<SSubObject>& subObjects = m_models[instance.m_model].m_subObjects;
+        for (size_t j = 0; j < subObjects.size(); ++j)
+        {
+            CullingBoundsAdd(m_cullingBounds, subObjects[j].m_boundsMin, subObjects[j].m_boundsMax, subObjects[j].m_boundsRadius, objectToWorld);
+            m_cullingEntries.push_back({ i, &subObjects[j], firstMesh[instance.m_model] + UINT32(j), objectScale });
+        }
+    }
+}
+
 void D3D12HelloTriangle::LoadSkyboxes()
 {
     // load the skyboxes
     for (size_t i = 0; i < (size_t)ESkyBox::Count; ++i)
     {
-        m_skyboxes[i].m_tex = TextureMgr::LoadCubeMap(m_graphicsAPI, s_skyboxBaseFileName[i], false);
+        m_skyboxes[i].m_tex = TextureMgr::LoadCubeMap(m_graphicsAPI, s_skyboxBaseFileName[i], false, true);
         m_skyboxes[i].m_texDiffuse = TextureMgr::LoadCubeMap(m_graphicsAPI, s_skyboxBaseFileNameDiffuse[i], false);
         m_skyboxes[i].m_texSpecular = TextureMgr::LoadCubeMapMips(m_graphicsAPI, s_skyboxBaseFileNameSpecular[i], 5, false);
-
-        TextureID textures[] =
-        {
-            m_skyboxes[i].m_tex,
-            m_skyboxes[i].m_texDiffuse,
-            m_skyboxes[i].m_texSpecular
-        };
-
-        m_skyboxes[i].m_descriptorTableHeapID = TextureMgr::CreateTextureDescriptorTable(m_graphicsAPI, sizeof(textures) / sizeof(textures[0]), textures);
     }
+    m_graphicsAPI.FlushBarriers();
 
     // Position, normal, tangent, uv
-    Vertex v000{ { -1.0f, -1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } };
-    Vertex v100{ {  1.0f, -1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } };
-    Vertex v010{ { -1.0f,  1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 1.0f } };
-    Vertex v110{ {  1.0f,  1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 1.0f, 1.0f } };
+    Vertex v000{ { -1.0f, -1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } };
+    Vertex v100{ {  1.0f, -1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } };
+    Vertex v010{ { -1.0f,  1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 0.0f, 1.0f } };
+    Vertex v110{ {  1.0f,  1.0f, -1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 1.0f, 1.0f } };
 
-    Vertex v001{ { -1.0f, -1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } };
-    Vertex v101{ {  1.0f, -1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } };
-    Vertex v011{ { -1.0f,  1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 1.0f } };
-    Vertex v111{ {  1.0f,  1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f },{ 1.0f, 1.0f } };
+    Vertex v001{ { -1.0f, -1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f } };
+    Vertex v101{ {  1.0f, -1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 1.0f, 0.0f } };
+    Vertex v011{ { -1.0f,  1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 0.0f, 1.0f } };
+    Vertex v111{ {  1.0f,  1.0f,  1.0f },{ 0.0f, 0.0f, 0.0f },{ 0.0f, 0.0f, 0.0f, 0.0f },{ 1.0f, 1.0f } };
 
     std::vector<Vertex> skyboxVertices
     {
@@ -507,24 +707,7 @@ void D3D12HelloTriangle::LoadSkyboxes()
 // Load the sample assets.
 void D3D12HelloTriangle::LoadAssets()
 {
-    TextureMgr::Create(m_graphicsAPI);
-
-    m_uav = TextureMgr::CreateUAVTexture(m_graphicsAPI, m_width, m_height);
-
-	// Create a texture samplers
-	{
-        D3D12_SAMPLER_DESC sampler = {};
-        sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
-        sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-        sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-        sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-        sampler.MinLOD = 0.0f;
-        sampler.MaxLOD = D3D12_FLOAT32_MAX;
-        sampler.MipLODBias = 0;
-        sampler.MaxAnisotropy = 0;
-        sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
-        m_graphicsAPI.m_device->CreateSampler(&sampler, m_graphicsAPI.m_samplerHeap->GetCPUDescriptorHandleForHeapStart());
-	}
+    TextureMgr::Create(m_graphicsAPI, m_shaderDebug);
 
     // load the basic textures
     LoadTextures();
@@ -534,6 +717,9 @@ void D3D12HelloTriangle::LoadAssets()
 
     // make the procedural meshes
     MakeProceduralMeshes();
+    ObjectTableInit(m_objectTable, c_initialObjectSlots);
+    MakeInstances();
+    MakeCullingBounds();
 
     // Close the command list and execute it to begin the initial GPU setup.
     m_graphicsAPI.CloseAndExecuteCommandList();
@@ -562,25 +748,12 @@ void D3D12HelloTriangle::LoadAssets()
         }
     );
 
-	// Create synchronization objects and wait until assets have been uploaded to the GPU.
-	{
-		ThrowIfFailed(m_graphicsAPI.m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-		m_fenceValue = 1;
-
-		// Create an event handle to use for frame synchronization.
-		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-		if (m_fenceEvent == nullptr)
-		{
-			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-		}
-
-		// Wait for the command list to execute; we are reusing the same command 
-		// list in our main loop but for now, we just want to wait for setup to 
-		// complete before continuing.
-		WaitForPreviousFrame();
-	}
+    // wait until assets have been uploaded to the GPU, so the upload heaps can go
+    m_graphicsAPI.WaitForGPU();
+    m_graphicsAPI.AcquireFrame();
 
-    m_graphicsAPI.OnFrameComplete();
+    // the mips are made on the compute queue while the first frame is recorded, which waits for them on the GPU
+    TextureMgr::GenerateMips(m_graphicsAPI);
 }
 
 // Update frame-based values.
@@ -675,8 +848,20 @@ void D3D12HelloTriangle::OnRender()
             if (seconds.count() > 1.0f)
             {
                 float fps = float(frameCount) / float(seconds.count());
-                WCHAR buffer[256];
-                swprintf_s(buffer, L"fps = %0.2f (%0.2f ms)", fps, 1000.0f / fps);
+                WCHAR buffer[512];
+                const SCommandStateFilterStats& filterStats = m_graphicsAPI.m_stateFilter.m_stats;
+                const SDescriptorRingStats& ringStats = m_graphicsAPI.m_transientDescriptorRing.m_stats;
+                const SUploadRingStats& uploadStats = m_graphicsAPI.m_uploadRing.m_stats;
+                const SObjectTableStats& objectStats = m_objectTable.m_stats;
+                const SStreamingCopyStats& constantStats = m_constantBuffer.GetWriteStats();
+                const SDeferredReleaseStats& releaseStats = m_graphicsAPI.m_deferredReleases.m_stats;
+                const SBarrierBatchStats& barrierStats = m_graphicsAPI.m_barrierBatch.m_stats;
+                float constantsDirty = constantStats.m_lines > 0 ? 100.0f * float(constantStats.m_linesWritten) / float(constantStats.m_lines) : 0.0f;
+                WCHAR latencyText[64] = L"";
+                if (m_graphicsAPI.m_frameLatencyWaitableObject)
+                    swprintf_s(latencyText, L" latency = %u frames", m_graphicsAPI.m_frameLatency.m_latency);
+                swprintf_s(buffer, L"fps = %0.2f (%0.2f ms) record = %0.3f ms (%zu threads)%s visible = %zu / %zu tris = %zu draws = %zu (%zu instances) state changes = %zu (%zu avoided) filtered calls = %zu / %zu descriptor tables = %zu (%zu reused) uploaded = %zu KB (%zu objects) constant lines written = %0.0f%% gpu = %0.2f ms%s pending release = %zu (%zu KB) barriers = %zu / %zu (%zu calls) transients = %zu KB (%zu KB unaliased)",
+                    fps, 1000.0f / fps, m_recordMilliseconds, m_recordingThreads, (m_bindlessMaterials && m_graphicsAPI.m_bindlessSupported) ? L" bindless" : L"", m_cullingStats.m_visible, m_cullingStats.m_tested, m_trianglesDrawn, m_drawListStats.m_draws, m_drawListStats.m_instances, m_drawListStats.m_stateChanges, m_drawListStats.m_stateChangesAvoided, filterStats.m_filtered, filterStats.m_calls, ringStats.m_tables, ringStats.m_tablesReused, uploadStats.m_bytesAllocated / 1024, objectStats.m_slotsUploaded, constantsDirty, m_graphicsAPI.m_gpuFrameMilliseconds, latencyText, releaseStats.m_pending, size_t(releaseStats.m_pendingBytes / 1024), barrierStats.m_issued, barrierStats.m_requested, barrierStats.m_flushes, size_t(m_renderGraphCompiled.m_stats.m_heapBytes / 1024), size_t(m_renderGraphCompiled.m_stats.m_transientBytes / 1024));
                 SetCustomWindowText(buffer);
                 frameCount = 0;
                 start = now;
@@ -686,9 +871,20 @@ void D3D12HelloTriangle::OnRender()
         ++frameCount;
     }
 
-	// make and execute command list
+	// make and execute command list. The state filter, ring and barrier stats are per frame.
+    m_graphicsAPI.m_stateFilter.m_stats = SCommandStateFilterStats();
+    m_graphicsAPI.m_transientDescriptorRing.m_stats = SDescriptorRingStats();
+    m_graphicsAPI.m_uploadRing.m_stats = SUploadRingStats();
+    m_objectTable.m_stats = SObjectTableStats();
+    m_graphicsAPI.m_barrierBatch.m_stats = SBarrierBatchStats();
     m_graphicsAPI.OpenCommandList(m_rootSignature, m_pipelineStateSkybox[0].Get());
-	PopulateCommandList();
+    TextureMgr::FinishMips(m_graphicsAPI);
+    {
+        std::chrono::high_resolution_clock::time_point recordStart = std::chrono::high_resolution_clock::now();
+        PopulateCommandList();
+        std::chrono::duration<float, std::milli> recordTime = std::chrono::high_resolution_clock::now() - recordStart;
+        m_recordMilliseconds = recordTime.count();
+    }
     m_graphicsAPI.CloseAndExecuteCommandList();
 
 	// Present the frame.
@@ -697,16 +893,18 @@ void D3D12HelloTriangle::OnRender()
     else
         ThrowIfFailed(m_graphicsAPI.m_swapChain->Present(0, 0));
 
-	WaitForPreviousFrame();
+    m_frameIndex = m_graphicsAPI.m_swapChain->GetCurrentBackBufferIndex();
 
-    m_graphicsAPI.OnFrameComplete();
+    // OnUpdate writes the constants of the next frame, so its frame context has to be free before then. This only
+    // waits for the frame that used it last, which lets the CPU get c_framesInFlight frames ahead of the GPU.
+    m_graphicsAPI.AcquireFrame();
 }
 
 void D3D12HelloTriangle::OnDestroy()
 {
 	// Ensure that the GPU is no longer referencing resources that are about to be
 	// cleaned up by the destructor.
-	WaitForPreviousFrame();
+    m_graphicsAPI.WaitForGPU();
 
     m_rootSignature->Release();
     m_rootSignature = nullptr;
@@ -714,218 +912,446 @@ void D3D12HelloTriangle::OnDestroy()
     m_graphicsAPI.Destroy();
 
     TextureMgr::Destroy();
+}
 
-	CloseHandle(m_fenceEvent);
+void D3D12HelloTriangle::MakeFrameTables()
+{
+    // the split sum texture, the sky box textures, and the rest of what every command list of the frame binds. The
+    // render targets and the uav are the render graph's, and are bound by its passes.
+    const SSkyBoxTextures& skybox = m_skyboxes[(size_t)m_skyBox];
+    TextureID skyboxTextures[] = { skybox.m_tex, skybox.m_texDiffuse, skybox.m_texSpecular };
+    m_frameBindings.m_sceneConstants = m_constantBuffer.GetGPUVirtualAddress();
+    m_frameBindings.m_splitSum = TextureMgr::MakeGPUHandle(m_graphicsAPI, m_splitSum);
+    m_frameBindings.m_skyboxTextures = TextureMgr::MakeDescriptorTable(m_graphicsAPI, _countof(skyboxTextures), skyboxTextures);
+
+    if (!m_bindlessMaterials || !m_graphicsAPI.m_bindlessSupported)
+        MakeMaterialTables();
+
+    m_frameTablesGrowths = m_graphicsAPI.m_generalHeapAllocator.m_growths;
 }
 
-void D3D12HelloTriangle::SetMaterialTexturesForObject(EMaterial material)
+void D3D12HelloTriangle::MakeMaterialTables()
 {
-    if (material == EMaterial::Count)
-        material = m_material;
+    for (size_t material = 0; material < (size_t)EMaterial::Count; ++material)
+        m_materialTables[material] = TextureMgr::MakeDescriptorTable(m_graphicsAPI, _countof(m_materials[material]), m_materials[material]);
+}
+
+// the offset that the stereo modes move objects by in clip space x, in shaders.hlsl
+static const float c_stereoClipOffset = 0.125f;
+
+void D3D12HelloTriangle::CullModels()
+{
+    const SConstantBuffer& constantBuffer = m_constantBuffer.Read();
+    XMMATRIX viewProjection = constantBuffer.viewProjectionMatrix;
 
-    CD3DX12_GPU_DESCRIPTOR_HANDLE handle(
-        m_graphicsAPI.m_generalHeap->GetGPUDescriptorHandleForHeapStart(),
-        (UINT)m_materialDescriptorTableHeapID[(size_t)material],
-        m_graphicsAPI.m_generalHeapDescriptorSize
+    // the stereo modes add +/- c_stereoClipOffset to clip space x. Adding it to clip space w instead moves the side
+    // planes out far enough to cover both eyes, and only loosens the others.
+    if (m_redBlue3DMode)
+        viewProjection.r[3] = XMVectorAdd(viewProjection.r[3], XMVectorSet(0.0f, 0.0f, 0.0f, c_stereoClipOffset));
+
+    m_visibleSubObjects.clear();
+    m_cullingStats = SCullingStats();
+    CullingFrustum(FrustumFromViewProjection(viewProjection), m_cullingBounds, m_visibleSubObjects, m_cullingStats);
+}
+
+void D3D12HelloTriangle::BuildDrawList()
+{
+    const SConstantBuffer& constantBuffer = m_constantBuffer.Read();
+    float projectionScaleY = XMVectorGetY(constantBuffer.projectionMatrix.r[1]);
+
+    // the LOD and sort key of each draw only depend on its subobject, so they are worked out on the job system
+    m_draws.resize(m_visibleSubObjects.size());
+    m_drawSortKeys.resize(m_visibleSubObjects.size());
+    ParallelFor(m_visibleSubObjects.size(), c_drawListBuildGrainSize,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                m_drawSortKeys[i] = MakeDraw(i, projectionScaleY);
+        }
     );
 
-    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::MaterialTextureSet, handle);
+    DrawListClear(m_drawList);
+    m_drawListStats = SDrawListStats();
+    m_trianglesDrawn = 0;
+    for (size_t i = 0; i < m_visibleSubObjects.size(); ++i)
+    {
+        m_trianglesDrawn += m_draws[i].m_lod->m_indexCount / 3;
+        DrawListAdd(m_drawList, m_drawSortKeys[i], UINT32(i));
+    }
+
+    DrawListSort(m_drawList);
+    DrawListBatch(m_drawList, m_drawBatches);
+    WriteInstanceBuffer();
 }
 
-void D3D12HelloTriangle::PopulateCommandList()
+UINT64 D3D12HelloTriangle::MakeDraw(size_t i, float projectionScaleY)
 {
-    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::SceneConstantBuffer, m_constantBuffer.GetGPUHandle(m_graphicsAPI));
-    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::TextureSampler, m_graphicsAPI.m_samplerHeap->GetGPUDescriptorHandleForHeapStart());
-    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::UAV, TextureMgr::MakeGPUHandle(m_graphicsAPI, m_uav));
+    UINT32 index = m_visibleSubObjects[i];
+    const SCullingEntry& entry = m_cullingEntries[index];
+    const SSubObject& subObject = *entry.m_subObject;
+
+    // pick the LOD by how big its geometric error is on screen, at the closest point of the bounding sphere
+    XMFLOAT3 offset = XMFLOAT3(m_cullingBounds.m_centerX[index], m_cullingBounds.m_centerY[index], m_cullingBounds.m_centerZ[index]) - m_cameraPos;
+    float centerDistance = std::sqrtf(Dot(offset, offset));
+    float pixelsPerUnit = MeshLodPixelsPerUnit(projectionScaleY, float(m_height), entry.m_objectScale, centerDistance - m_cullingBounds.m_radius[index]);
+    size_t lodIndex = MeshLodSelect(subObject.m_lods, pixelsPerUnit);
+    const SMeshLod& lod = subObject.m_lods[lodIndex];
+    m_draws[i] = { index, &lod };
+
+    EMaterial material = m_instances[entry.m_instance].m_material;
+    if (material == EMaterial::Count)
+        material = m_material;
+    SShaderPermutations::EMaterialMode materialMode = (material == EMaterial::DiffuseWhite) ? SShaderPermutations::EMaterialMode::untextured : SShaderPermutations::EMaterialMode::textured;
 
-    m_graphicsAPI.m_commandList->RSSetViewports(1, &m_viewport);
-    m_graphicsAPI.m_commandList->RSSetScissorRects(1, &m_scissorRect);
+    // each LOD of a mesh is a different mesh as far as batching goes, because it has a different index range
+    UINT32 mesh = entry.m_mesh * UINT32(c_meshLodMaxLods) + UINT32(lodIndex);
+    return DrawKeyMake(UINT32(materialMode), UINT32(material), UINT32(subObject.m_textureDiffuse), mesh, centerDistance);
+}
 
-	// Indicate that the back buffer will be used as a render target.
-    m_graphicsAPI.m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_graphicsAPI.m_renderTargetsColor[m_frameIndex], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+void D3D12HelloTriangle::WriteInstanceBuffer()
+{
+    const std::vector<SDrawPacket>& packets = m_drawList.m_packets;
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_graphicsAPI.m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_graphicsAPI.m_rtvHeapDescriptorSize);
-    CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_graphicsAPI.m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
-    m_graphicsAPI.m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+    if (packets.empty())
+        return;
 
-	// Record commands.
-    // Don't need to clear color, because we draw a skybox that erases everything anyways
-	//const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	//m_graphicsAPI.m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    m_graphicsAPI.m_commandList->ClearDepthStencilView(m_graphicsAPI.m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-    m_graphicsAPI.m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    // the instances only live for this frame, so they come from the upload ring
+    SUploadAllocation allocation = m_graphicsAPI.AllocateUpload(packets.size() * sizeof(UINT32), sizeof(UINT32));
+    UINT32* instances = (UINT32*)allocation.m_cpuAddress;
 
-    // clear the uav
+    m_instanceBufferView.BufferLocation = allocation.m_gpuAddress;
+    m_instanceBufferView.StrideInBytes = sizeof(UINT32);
+    m_instanceBufferView.SizeInBytes = UINT(packets.size() * sizeof(UINT32));
+
+    // the instances are in sorted packet order, so each batch's instances are next to each other
+    for (size_t i = 0; i < packets.size(); ++i)
     {
-        CD3DX12_GPU_DESCRIPTOR_HANDLE gpuHandle = TextureMgr::MakeGPUHandleShaderInvisible(m_graphicsAPI, m_uav);
-        CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle = TextureMgr::MakeCPUHandleShaderInvisible(m_graphicsAPI, m_uav);
-        ID3D12Resource* resource = TextureMgr::GetResourceShaderInvisible(m_graphicsAPI, m_uav);
+        const SDraw& draw = m_draws[packets[i].m_drawIndex];
+        instances[i] = m_instances[m_cullingEntries[draw.m_cullingEntry].m_instance].m_objectSlot;
+    }
+}
 
-        const float uavClear[] = { 0.0f, 0.0f, 1.0f, 0.0f };
-        m_graphicsAPI.m_commandList->ClearUnorderedAccessViewFloat(gpuHandle, cpuHandle, resource, uavClear, 0, nullptr);
+void D3D12HelloTriangle::UploadObjectData()
+{
+    // a bigger table needs a new buffer. Growing the table marked every slot dirty, so it all gets uploaded below.
+    if (m_objectTable.m_capacity > m_objectBufferCapacity)
+    {
+        if (m_objectBuffer)
+            m_graphicsAPI.DeferRelease(m_objectBuffer.Detach());
+
+        m_objectBufferCapacity = m_objectTable.m_capacity;
+        m_objectBufferState = D3D12_RESOURCE_STATE_COPY_DEST;
+        ThrowIfFailed(m_graphicsAPI.m_device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(m_objectBufferCapacity * sizeof(SObjectData)),
+            m_objectBufferState,
+            nullptr,
+            IID_PPV_ARGS(&m_objectBuffer)));
+        NAME_D3D12_OBJECT(m_objectBuffer);
     }
 
-    // set the split sum texture
-    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::SplitsumTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, m_splitSum));
+    ObjectTableTakeDirtyRanges(m_objectTable, c_objectRangeMaxGap, m_dirtyObjectRanges);
+    if (m_dirtyObjectRanges.empty())
+        return;
 
-    // set the sky box textures
-    CD3DX12_GPU_DESCRIPTOR_HANDLE handle(
-        m_graphicsAPI.m_generalHeap->GetGPUDescriptorHandleForHeapStart(),
-        m_skyboxes[(size_t)m_skyBox].m_descriptorTableHeapID,
-        m_graphicsAPI.m_generalHeapDescriptorSize
-    );
-    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::SkyboxTextureSet, handle);
+    PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Upload Object Data");
 
-    // draw regularly
-    if (!m_redBlue3DMode)
+    // all of the changed data goes in one upload allocation, and each range is copied with one call
+    UINT32 slotCount = 0;
+    for (const SObjectRange& range : m_dirtyObjectRanges)
+        slotCount += range.m_count;
+    SUploadAllocation allocation = m_graphicsAPI.AllocateUpload(slotCount * sizeof(SObjectData), sizeof(SObjectData));
+
+    // the copies need the buffer in the copy dest state now, but the draws don't need it back until the first pass
+    if (m_objectBufferState != D3D12_RESOURCE_STATE_COPY_DEST)
+        m_graphicsAPI.Transition(m_objectBuffer.Get(), m_objectBufferState, D3D12_RESOURCE_STATE_COPY_DEST);
+    m_graphicsAPI.FlushBarriers();
+
+    UINT64 uploadOffset = 0;
+    for (const SObjectRange& range : m_dirtyObjectRanges)
     {
-        PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Render Meshes");
+        UINT64 size = range.m_count * sizeof(SObjectData);
+        memcpy((unsigned char*)allocation.m_cpuAddress + uploadOffset, &m_objectData[range.m_first], size);
+        m_graphicsAPI.m_commandList->CopyBufferRegion(m_objectBuffer.Get(), range.m_first * sizeof(SObjectData), allocation.m_resource, allocation.m_offset + uploadOffset, size);
+        uploadOffset += size;
+    }
 
-        // figure out the shader permutation parameters
-        SShaderPermutations::EMaterialMode materialMode = (m_material == EMaterial::DiffuseWhite) ? SShaderPermutations::EMaterialMode::untextured : SShaderPermutations::EMaterialMode::textured;
-        SShaderPermutations::EStereoMode stereoMode = SShaderPermutations::EStereoMode::none;
-        size_t psoIndex = SShaderPermutations::GetIndex(materialMode, stereoMode);
+    m_objectBufferState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    m_graphicsAPI.Transition(m_objectBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, m_objectBufferState);
+}
 
-        // draw the skybox model first
-        {
-            PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Model: %s", m_skyboxModel.m_name.c_str());
+void D3D12HelloTriangle::SubmitDrawList(SShaderPermutations::EStereoMode stereoMode)
+{
+    if (m_drawBatches.empty())
+        return;
 
-            m_graphicsAPI.m_commandList->SetPipelineState(m_pipelineStateSkybox[psoIndex].Get());
-            m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::ModelConstantBuffer, m_skyboxModel.m_constantBuffer.GetGPUHandle(m_graphicsAPI));
-            for (const SSubObject& subObject : m_skyboxModel.m_subObjects)
-            {
-                m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
-                m_graphicsAPI.m_commandList->IASetVertexBuffers(0, 1, &subObject.m_vertexBufferView);
-                m_graphicsAPI.m_commandList->DrawInstanced(subObject.m_numVertices, 1, 0, 0);
-            }
-        }
+    DrawListChunk(m_drawBatches, c_minDrawsPerChunk, m_recordingThreads, m_drawChunks);
+    if (m_drawChunks.size() == 1)
+    {
+        RecordDrawChunk(m_graphicsAPI, stereoMode, m_drawChunks[0], m_drawListStats);
+        return;
+    }
 
-        // draw the models
-        m_graphicsAPI.m_commandList->SetPipelineState(m_pipelineStateModels[psoIndex].Get());
-        for (size_t i = 0; i < (size_t)EModel::Count; ++i)
+    // every chunk's command list starts out with nothing bound, and so does the main one after them
+    m_drawChunkStats.assign(m_drawChunks.size(), SDrawListStats());
+    m_graphicsAPI.RecordInParallel(m_drawChunks.size(), m_rootSignature,
+        [&] (cdCommandRecorderDX12& recorder, size_t index)
         {
-            if (m_models[i].m_subObjects.size() == 0)
-                continue;
+            BindFrameState(recorder);
+            RecordDrawChunk(recorder, stereoMode, m_drawChunks[index], m_drawChunkStats[index]);
+        }
+    );
+    BindFrameState(m_graphicsAPI);
+
+    for (const SDrawListStats& stats : m_drawChunkStats)
+    {
+        m_drawListStats.m_draws += stats.m_draws;
+        m_drawListStats.m_instances += stats.m_instances;
+        m_drawListStats.m_stateChanges += stats.m_stateChanges;
+        m_drawListStats.m_stateChangesAvoided += stats.m_stateChangesAvoided;
+    }
+}
 
-            PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Model: %s", m_models[i].m_name.c_str());
+// This runs on the recording threads, so it only reads what the main thread set up for the frame.
+void D3D12HelloTriangle::RecordDrawChunk(cdCommandRecorderDX12& recorder, SShaderPermutations::EStereoMode stereoMode, const SDrawChunk& chunk, SDrawListStats& stats)
+{
+    PIXScopedEvent(recorder.m_commandList, PIX_COLOR_INDEX(0), "Draw List");
 
-            SetMaterialTexturesForObject(s_modelsToLoad[i].modelMaterial);
+    recorder.IASetVertexBuffer(1, m_instanceBufferView);
+    recorder.SetGraphicsRootShaderResourceView(RootTableParameter::ObjectData, m_objectBuffer->GetGPUVirtualAddress());
 
-            m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::ModelConstantBuffer, m_models[i].m_constantBuffer.GetGPUHandle(m_graphicsAPI));
-            for (const SSubObject& subObject : m_models[i].m_subObjects)
-            {
-                m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
-                m_graphicsAPI.m_commandList->IASetVertexBuffers(0, 1, &subObject.m_vertexBufferView);
-                m_graphicsAPI.m_commandList->DrawInstanced(subObject.m_numVertices, 1, 0, 0);
-            }
-        }
+    // single pass stereo draws every instance once per eye
+    UINT eyeCount = (stereoMode == SShaderPermutations::EStereoMode::singlePass) ? c_stereoEyeCount : 1;
+
+    // bindless materials bind every texture once, and then each draw only changes two root constants
+    SShaderPermutations::EMaterialBinding materialBinding = SShaderPermutations::EMaterialBinding::tables;
+    if (m_bindlessMaterials && m_graphicsAPI.m_bindlessSupported)
+    {
+        materialBinding = SShaderPermutations::EMaterialBinding::bindless;
+        recorder.SetGraphicsRootDescriptorTable(RootTableParameter::BindlessTextures, m_graphicsAPI.GetGeneralHeapGPUHandle(0));
+        recorder.SetGraphicsRootShaderResourceView(RootTableParameter::MaterialRecords, m_materialRecords->GetGPUVirtualAddress());
     }
-    // draw red/blue 3d
-    else
+
+    // only set the state that changed since the last batch. Every field of the first key differs from its complement,
+    // so the first batch sets everything.
+    UINT64 lastSortKey = ~m_drawList.m_packets[m_drawBatches[chunk.m_firstBatch].m_firstPacket].m_sortKey;
+    for (UINT32 batchIndex = chunk.m_firstBatch; batchIndex < chunk.m_firstBatch + chunk.m_batchCount; ++batchIndex)
     {
-        // red
+        const SDrawBatch& batch = m_drawBatches[batchIndex];
+        const SDrawPacket& packet = m_drawList.m_packets[batch.m_firstPacket];
+        const SDraw& draw = m_draws[packet.m_drawIndex];
+        const SSubObject& subObject = *m_cullingEntries[draw.m_cullingEntry].m_subObject;
+        stats.m_draws++;
+        stats.m_instances += batch.m_packetCount;
+
+        if (DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, EDrawKeyField::pipeline, stats))
         {
-            PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Render Meshes (Red)");
-
-            // figure out the shader permutation parameters
-            SShaderPermutations::EMaterialMode materialMode = (m_material == EMaterial::DiffuseWhite) ? SShaderPermutations::EMaterialMode::untextured : SShaderPermutations::EMaterialMode::textured;
-            SShaderPermutations::EStereoMode stereoMode = SShaderPermutations::EStereoMode::red;
-            size_t psoIndex = SShaderPermutations::GetIndex(materialMode, stereoMode);
+            SShaderPermutations::EMaterialMode materialMode = (SShaderPermutations::EMaterialMode)DrawKeyGetField(packet.m_sortKey, EDrawKeyField::pipeline);
+            recorder.SetPipelineState(m_pipelineStateModels[SShaderPermutations::GetIndex(materialMode, stereoMode, materialBinding)].Get());
+        }
 
-            // draw the skybox model first
+        bool materialChanged = DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, EDrawKeyField::material, stats);
+        bool textureChanged = DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, EDrawKeyField::texture, stats);
+        if (materialBinding == SShaderPermutations::EMaterialBinding::bindless)
+        {
+            if (materialChanged || textureChanged)
+                recorder.SetGraphicsRoot32BitConstants(RootTableParameter::DrawConstants, DrawKeyGetField(packet.m_sortKey, EDrawKeyField::material), TextureMgr::GetHeapID(subObject.m_textureDiffuse));
+        }
+        else
+        {
+            if (materialChanged)
             {
-                PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Model: %s", m_skyboxModel.m_name.c_str());
-                m_graphicsAPI.m_commandList->SetPipelineState(m_pipelineStateSkybox[psoIndex].Get());
-                m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::ModelConstantBuffer, m_skyboxModel.m_constantBuffer.GetGPUHandle(m_graphicsAPI));
-                for (const SSubObject& subObject : m_skyboxModel.m_subObjects)
-                {
-                    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
-                    m_graphicsAPI.m_commandList->IASetVertexBuffers(0, 1, &subObject.m_vertexBufferView);
-                    m_graphicsAPI.m_commandList->DrawInstanced(subObject.m_numVertices, 1, 0, 0);
-                }
+                // EMaterial::Count means the material picked with the keyboard
+                EMaterial material = (EMaterial)DrawKeyGetField(packet.m_sortKey, EDrawKeyField::material);
+                if (material == EMaterial::Count)
+                    material = m_material;
+                recorder.SetGraphicsRootDescriptorTable(RootTableParameter::MaterialTextureSet, m_materialTables[(size_t)material]);
             }
 
-            // draw the models
-            m_graphicsAPI.m_commandList->SetPipelineState(m_pipelineStateModels[psoIndex].Get());
-            for (size_t i = 0; i < (size_t)EModel::Count; ++i)
-            {
-                if (m_models[i].m_subObjects.size() == 0)
-                    continue;
+            if (textureChanged)
+                recorder.SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
+        }
 
-                PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Model: %s", m_models[i].m_name.c_str());
+        // the LODs of a subobject share its buffers, so the state filter drops these when only the LOD changed
+        if (DrawKeyFieldChanged(packet.m_sortKey, lastSortKey, EDrawKeyField::mesh, stats))
+        {
+            recorder.IASetVertexBuffer(0, subObject.m_vertexBufferView);
+            recorder.IASetIndexBuffer(subObject.m_indexBufferView);
+        }
 
-                SetMaterialTexturesForObject(s_modelsToLoad[i].modelMaterial);
+        // the batch's packets are its instances, and their matrices are at the same place in the instance buffer
+        recorder.m_commandList->DrawIndexedInstanced(draw.m_lod->m_indexCount, batch.m_packetCount * eyeCount, draw.m_lod->m_indexOffset, 0, batch.m_firstPacket);
 
-                m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::ModelConstantBuffer, m_models[i].m_constantBuffer.GetGPUHandle(m_graphicsAPI));
-                for (const SSubObject& subObject : m_models[i].m_subObjects)
-                {
-                    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
-                    m_graphicsAPI.m_commandList->IASetVertexBuffers(0, 1, &subObject.m_vertexBufferView);
-                    m_graphicsAPI.m_commandList->DrawInstanced(subObject.m_numVertices, 1, 0, 0);
-                }
-            }
-        }
+        lastSortKey = packet.m_sortKey;
+    }
+}
 
-        // clear depth
-        m_graphicsAPI.m_commandList->ClearDepthStencilView(m_graphicsAPI.m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+void D3D12HelloTriangle::BindFrameState(cdCommandRecorderDX12& recorder)
+{
+    recorder.SetGraphicsRootConstantBufferView(RootTableParameter::SceneConstantBuffer, m_frameBindings.m_sceneConstants);
+    recorder.SetGraphicsRootDescriptorTable(RootTableParameter::UAV, m_frameBindings.m_uav);
+    recorder.SetGraphicsRootDescriptorTable(RootTableParameter::SplitsumTexture, m_frameBindings.m_splitSum);
+    recorder.SetGraphicsRootDescriptorTable(RootTableParameter::SkyboxTextureSet, m_frameBindings.m_skyboxTextures);
+
+    recorder.m_commandList->RSSetViewports(1, &m_viewport);
+    recorder.m_commandList->RSSetScissorRects(1, &m_scissorRect);
+    recorder.m_commandList->OMSetRenderTargets(1, &m_frameBindings.m_renderTarget, FALSE, &m_frameBindings.m_depthStencil);
+    recorder.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
 
-        // blue
-        {
-            PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Render Meshes (Blue)");
+void D3D12HelloTriangle::DrawSkybox(SShaderPermutations::EStereoMode stereoMode)
+{
+    PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Model: %s", m_skyboxModel.m_name.c_str());
 
-            // figure out the shader permutation parameters
-            SShaderPermutations::EMaterialMode materialMode = (m_material == EMaterial::DiffuseWhite) ? SShaderPermutations::EMaterialMode::untextured : SShaderPermutations::EMaterialMode::textured;
-            SShaderPermutations::EStereoMode stereoMode = SShaderPermutations::EStereoMode::blue;
-            size_t psoIndex = SShaderPermutations::GetIndex(materialMode, stereoMode);
+    // figure out the shader permutation parameters
+    SShaderPermutations::EMaterialMode materialMode = (m_material == EMaterial::DiffuseWhite) ? SShaderPermutations::EMaterialMode::untextured : SShaderPermutations::EMaterialMode::textured;
+    size_t psoIndex = SShaderPermutations::GetIndex(materialMode, stereoMode);
 
-            // no need to render the skybox the second time. It would find the same things, so we handle it all in the red pass
+    // single pass stereo draws it once per eye
+    UINT eyeCount = (stereoMode == SShaderPermutations::EStereoMode::singlePass) ? c_stereoEyeCount : 1;
 
-            // draw the models
-            m_graphicsAPI.m_commandList->SetPipelineState(m_pipelineStateModels[psoIndex].Get());
-            for (size_t i = 0; i < (size_t)EModel::Count; ++i)
-            {
-                if (m_models[i].m_subObjects.size() == 0)
-                    continue;
+    m_graphicsAPI.SetPipelineState(m_pipelineStateSkybox[psoIndex].Get());
+    m_graphicsAPI.SetGraphicsRootConstantBufferView(RootTableParameter::ModelConstantBuffer, m_graphicsAPI.UploadConstants(m_skyboxModel.m_constants));
+    for (const SSubObject& subObject : m_skyboxModel.m_subObjects)
+    {
+        m_graphicsAPI.SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
+        m_graphicsAPI.IASetVertexBuffer(0, subObject.m_vertexBufferView);
+        m_graphicsAPI.IASetIndexBuffer(subObject.m_indexBufferView);
+        m_graphicsAPI.m_commandList->DrawIndexedInstanced(subObject.m_lods[0].m_indexCount, eyeCount, subObject.m_lods[0].m_indexOffset, 0, 0);
+    }
+}
 
-                PIXScopedEvent(m_graphicsAPI.m_commandList, PIX_COLOR_INDEX(0), "Model: %s", m_models[i].m_name.c_str());
+void D3D12HelloTriangle::PopulateCommandList()
+{
+    CullModels();
+    BuildDrawList();
+    UploadObjectData();
+
+    // The graph's views can grow the general heap, which would leave handles made before them in the old heap, so the
+    // graph is realized before anything else of the frame is bound.
+    BuildRenderGraph();
+    RenderGraphCompile(m_renderGraph, m_renderGraphCompiled);
+    m_graphicsAPI.RealizeRenderGraph(m_renderGraph, m_renderGraphCompiled);
+    MakeFrameTables();
+
+    m_graphicsAPI.ExecuteRenderGraph(m_renderGraph, m_renderGraphCompiled);
+}
 
-                SetMaterialTexturesForObject(s_modelsToLoad[i].modelMaterial);
+// The passes of the frame, which are made again each frame because they depend on the back buffer and the stereo mode.
+// The graph works out the barriers between them, and puts the depth buffers, the uav and the stereo targets in memory
+// they can share.
+void D3D12HelloTriangle::BuildRenderGraph()
+{
+    RenderGraphClear(m_renderGraph);
+
+    // the back buffer is only moved out of the present state and back
+    ID3D12Resource* backBuffer = m_graphicsAPI.m_renderTargetsColor[m_frameIndex];
+    D3D12_RESOURCE_DESC backBufferDesc = backBuffer->GetDesc();
+    SRenderGraphTextureDesc backBufferGraphDesc;
+    backBufferGraphDesc.m_width = UINT32(backBufferDesc.Width);
+    backBufferGraphDesc.m_height = backBufferDesc.Height;
+    backBufferGraphDesc.m_format = UINT32(backBufferDesc.Format);
+    RenderGraphState present = RenderGraphAccessState(ERenderGraphAccess::present);
+    UINT32 backBufferResource = RenderGraphImport(m_renderGraph, "Back Buffer", backBufferGraphDesc, backBuffer, present, present);
+    CD3DX12_CPU_DESCRIPTOR_HANDLE backBufferRTV(m_graphicsAPI.m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_graphicsAPI.m_rtvHeapDescriptorSize);
+
+    UINT32 uav = RenderGraphCreate(m_renderGraph, "UAV", m_graphicsAPI.MakeRenderGraphTextureDesc(DXGI_FORMAT_R8G8B8A8_UNORM, m_width, m_height, 1, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+    UINT32 pass = RenderGraphAddPass(m_renderGraph, "Clear UAV", [this, uav] ()
+    {
+        const float uavClear[] = { 0.0f, 0.0f, 1.0f, 0.0f };
+        m_graphicsAPI.m_commandList->ClearUnorderedAccessViewFloat(m_graphicsAPI.GetRenderGraphUAV(uav), m_graphicsAPI.GetRenderGraphUAVStaging(uav),
+            m_graphicsAPI.GetRenderGraphResource(m_renderGraph, uav), uavClear, 0, nullptr);
+    });
+    RenderGraphUse(m_renderGraph, pass, uav, ERenderGraphAccess::unorderedAccess);
+
+    // draws with the pass's render target and depth buffer, after clearing the depth buffer. Don't need to clear color,
+    // because we draw a skybox that erases everything anyways.
+    auto drawMeshes = [this, uav] (CD3DX12_CPU_DESCRIPTOR_HANDLE renderTarget, UINT32 depth, SShaderPermutations::EStereoMode stereoMode, bool drawSkybox)
+    {
+        // a pass before this one may have grown the general heap, which left the frame's tables in the old one
+        if (m_graphicsAPI.m_generalHeapAllocator.m_growths != m_frameTablesGrowths)
+            MakeFrameTables();
+
+        m_frameBindings.m_uav = m_graphicsAPI.GetRenderGraphUAV(uav);
+        m_frameBindings.m_renderTarget = renderTarget;
+        m_frameBindings.m_depthStencil = m_graphicsAPI.GetRenderGraphDSV(depth);
+        BindFrameState(m_graphicsAPI);
+        m_graphicsAPI.m_commandList->ClearDepthStencilView(m_frameBindings.m_depthStencil, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+
+        // draw the skybox model first, then the models
+        if (drawSkybox)
+            DrawSkybox(stereoMode);
+        SubmitDrawList(stereoMode);
+    };
 
-                m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::ModelConstantBuffer, m_models[i].m_constantBuffer.GetGPUHandle(m_graphicsAPI));
-                for (const SSubObject& subObject : m_models[i].m_subObjects)
-                {
-                    m_graphicsAPI.m_commandList->SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, TextureMgr::MakeGPUHandle(m_graphicsAPI, subObject.m_textureDiffuse));
-                    m_graphicsAPI.m_commandList->IASetVertexBuffers(0, 1, &subObject.m_vertexBufferView);
-                    m_graphicsAPI.m_commandList->DrawInstanced(subObject.m_numVertices, 1, 0, 0);
-                }
-            }
-        }
+    SRenderGraphTextureDesc depthDesc = m_graphicsAPI.MakeRenderGraphTextureDesc(DXGI_FORMAT_D32_FLOAT, m_width, m_height, 1, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+    // draw regularly
+    if (!m_redBlue3DMode)
+    {
+        UINT32 depth = RenderGraphCreate(m_renderGraph, "Depth", depthDesc);
+        pass = RenderGraphAddPass(m_renderGraph, "Render Meshes", [=] ()
+        {
+            drawMeshes(backBufferRTV, depth, SShaderPermutations::EStereoMode::none, true);
+        });
+        RenderGraphUse(m_renderGraph, pass, backBufferResource, ERenderGraphAccess::renderTarget);
+        RenderGraphUse(m_renderGraph, pass, depth, ERenderGraphAccess::depthWrite);
+        RenderGraphUse(m_renderGraph, pass, uav, ERenderGraphAccess::unorderedAccess);
     }
+    // draw red/blue 3d with both eyes at once, and then combine them. The red eye is slice 0 and the blue eye is slice 1.
+    else if (m_graphicsAPI.m_renderTargetArrayIndexFromVS)
+    {
+        UINT32 stereoColor = RenderGraphCreate(m_renderGraph, "Stereo Color", m_graphicsAPI.MakeRenderGraphTextureDesc(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, m_width, m_height, c_stereoEyeCount, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET));
+        UINT32 stereoDepth = RenderGraphCreate(m_renderGraph, "Stereo Depth", m_graphicsAPI.MakeRenderGraphTextureDesc(DXGI_FORMAT_D32_FLOAT, m_width, m_height, c_stereoEyeCount, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
 
-	// Indicate that the back buffer will now be used to present.
-    m_graphicsAPI.m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_graphicsAPI.m_renderTargetsColor[m_frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+        // the skybox covers the whole screen, so the eyes don't need to be cleared
+        pass = RenderGraphAddPass(m_renderGraph, "Render Meshes (Single Pass Stereo)", [=] ()
+        {
+            drawMeshes(m_graphicsAPI.GetRenderGraphRTV(stereoColor), stereoDepth, SShaderPermutations::EStereoMode::singlePass, true);
+        });
+        RenderGraphUse(m_renderGraph, pass, stereoColor, ERenderGraphAccess::renderTarget);
+        RenderGraphUse(m_renderGraph, pass, stereoDepth, ERenderGraphAccess::depthWrite);
+        RenderGraphUse(m_renderGraph, pass, uav, ERenderGraphAccess::unorderedAccess);
+
+        // take red from the red eye and green and blue from the blue eye
+        pass = RenderGraphAddPass(m_renderGraph, "Combine Eyes", [=] ()
+        {
+            m_graphicsAPI.m_commandList->OMSetRenderTargets(1, &backBufferRTV, FALSE, nullptr);
+            m_graphicsAPI.SetPipelineState(m_pipelineStateStereoComposite.Get());
+            m_graphicsAPI.SetGraphicsRootDescriptorTable(RootTableParameter::DiffuseTexture, m_graphicsAPI.GetRenderGraphSRV(stereoColor));
+            m_graphicsAPI.m_commandList->DrawInstanced(3, 1, 0, 0);
+        });
+        RenderGraphUse(m_renderGraph, pass, stereoColor, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(m_renderGraph, pass, backBufferResource, ERenderGraphAccess::renderTarget);
+    }
+    // draw red/blue 3d one eye at a time, when the vertex shader can't pick the render target
+    else
+    {
+        UINT32 depth = RenderGraphCreate(m_renderGraph, "Depth", depthDesc);
+        pass = RenderGraphAddPass(m_renderGraph, "Render Meshes (Red)", [=] ()
+        {
+            drawMeshes(backBufferRTV, depth, SShaderPermutations::EStereoMode::red, true);
+        });
+        RenderGraphUse(m_renderGraph, pass, backBufferResource, ERenderGraphAccess::renderTarget);
+        RenderGraphUse(m_renderGraph, pass, depth, ERenderGraphAccess::depthWrite);
+        RenderGraphUse(m_renderGraph, pass, uav, ERenderGraphAccess::unorderedAccess);
+
+        // no need to render the skybox the second time. It would find the same things, so we handle it all in the red pass
+        pass = RenderGraphAddPass(m_renderGraph, "Render Meshes (Blue)", [=] ()
+        {
+            drawMeshes(backBufferRTV, depth, SShaderPermutations::EStereoMode::blue, false);
+        });
+        RenderGraphUse(m_renderGraph, pass, backBufferResource, ERenderGraphAccess::renderTarget);
+        RenderGraphUse(m_renderGraph, pass, depth, ERenderGraphAccess::depthWrite);
+        RenderGraphUse(m_renderGraph, pass, uav, ERenderGraphAccess::unorderedAccess);
+    }
 }
 
-void D3D12HelloTriangle::WaitForPreviousFrame()
+int D3D12HelloTriangle::OnBenchmark()
 {
-	// WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-	// This is code implemented as such for simplicity. The D3D12HelloFrameBuffering
-	// sample illustrates how to use fences for efficient resource usage and to
-	// maximize GPU utilization.
-
-	// Signal and increment the fence value.
-	const UINT64 fence = m_fenceValue;
-	ThrowIfFailed(m_graphicsAPI.m_commandQueue->Signal(m_fence.Get(), fence));
-	m_fenceValue++;
-
-	// Wait until the previous frame is finished.
-	if (m_fence->GetCompletedValue() < fence)
-	{
-		ThrowIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
-		WaitForSingleObject(m_fenceEvent, INFINITE);
-	}
-
-	m_frameIndex = m_graphicsAPI.m_swapChain->GetCurrentBackBufferIndex();
+    return RunBenchmarks("benchmark.txt");
 }
 
 void D3D12HelloTriangle::OnKeyDown(UINT8 key)
@@ -959,6 +1385,24 @@ void D3D12HelloTriangle::OnKeyUp(UINT8 key)
         m_vsync = !m_vsync;
     }
 
+    if (key == 'B')
+    {
+        m_bindlessMaterials = !m_bindlessMaterials;
+    }
+
+    // cycles through recording the draw list on 1, 2, 4 and 8 threads
+    if (key == 'T')
+    {
+        m_recordingThreads = (m_recordingThreads >= 8) ? 1 : m_recordingThreads * 2;
+    }
+
+    if (key == 'I')
+    {
+        m_stressScene = !m_stressScene;
+        MakeInstances();
+        MakeCullingBounds();
+    }
+
     if (key == 189) // '-' next to numbers
     {
         int current = int(m_material);
@@ -21,6 +21,9 @@
 #include "TextureMgr.h"
 #include "Math.h"
 #include "dx12.h"
+#include "Culling.h"
+#include "DrawList.h"
+#include "ObjectTable.h"
 
 using namespace DirectX;
 
@@ -39,28 +42,43 @@ struct SShaderPermutations
         none,
         red,
         blue,
+        singlePass,     // both eyes in one draw, each to its own slice of a render target array
 
         Count
     };
 
-    static size_t GetIndex (EMaterialMode materialMode, EStereoMode stereoMode)
+    enum class EMaterialBinding
     {
-        size_t ret = (size_t)stereoMode;
+        tables,     // descriptor tables of the material's textures
+        bindless,   // root constants index material records and the whole general heap
+
+        Count
+    };
+
+    static size_t GetIndex (EMaterialMode materialMode, EStereoMode stereoMode, EMaterialBinding materialBinding = EMaterialBinding::tables)
+    {
+        size_t ret = (size_t)materialBinding;
+        ret *= (size_t)EStereoMode::Count;
+        ret += (size_t)stereoMode;
         ret *= (size_t)EMaterialMode::Count;
         ret += (size_t)materialMode;
         return ret;
     }
 
-    static void GetSettings (size_t index, EMaterialMode &materialMode, EStereoMode &stereoMode)
+    static void GetSettings (size_t index, EMaterialMode &materialMode, EStereoMode &stereoMode, EMaterialBinding &materialBinding)
     {
         materialMode = (EMaterialMode)(index % (size_t)EMaterialMode::Count);
         index /= (size_t)EMaterialMode::Count;
-        stereoMode = (EStereoMode)index;
+        stereoMode = (EStereoMode)(index % (size_t)EStereoMode::Count);
+        index /= (size_t)EStereoMode::Count;
+        materialBinding = (EMaterialBinding)index;
     }
 
-    static const size_t Count = (size_t)EMaterialMode::Count * (size_t)EStereoMode::Count;
+    static const size_t Count = (size_t)EMaterialMode::Count * (size_t)EStereoMode::Count * (size_t)EMaterialBinding::Count;
 };
 
+static const UINT c_stereoEyeCount = 2;
+
 // Note that while ComPtr is used to manage the lifetime of resources on the CPU,
 // it has no understanding of the lifetime of resources on the GPU. Apps must account
 // for the GPU lifetime of resources to avoid destroying objects that may still be
@@ -116,6 +134,18 @@ enum class EMaterialTexture
     Count
 };
 
+// the general heap indices of a material's textures, for bindless materials. Matches SMaterialRecord in Shaders.h.
+struct SMaterialRecord
+{
+    UINT32 m_textures[(size_t)EMaterialTexture::Count];
+};
+
+// what the shaders know about each model instance, in the object table. Matches SObjectData in Shaders.h.
+struct SObjectData
+{
+    XMFLOAT4X4 m_objectToWorld;
+};
+
 enum class EModel
 {
     Sphere,
@@ -124,9 +154,33 @@ enum class EModel
     Count
 };
 
+// a copy of a model in the scene. Instances of the same model are drawn together with instanced draws.
+struct SModelInstance
+{
+    size_t              m_model;
+    XMFLOAT4X4          m_objectToWorld;
+    EMaterial           m_material;     // EMaterial::Count means the material picked with the keyboard
+    UINT32              m_objectSlot;
+};
+
+// a subobject of one of the model instances, as it is known to culling
+struct SCullingEntry
+{
+    size_t              m_instance;
+    const SSubObject*   m_subObject;
+    UINT32              m_mesh;         // which subobject of which model, the same for every instance
+    float               m_objectScale;  // the largest axis scale of the model matrix, for LOD selection
+};
+
+// what a draw packet draws
+struct SDraw
+{
+    UINT32              m_cullingEntry;
+    const SMeshLod*     m_lod;
+};
+
 struct SSkyBoxTextures
 {
-    unsigned int m_descriptorTableHeapID;
     TextureID m_tex;
     TextureID m_texDiffuse;
     TextureID m_texSpecular;
@@ -146,6 +200,7 @@ public:
     virtual void OnKeyUp(UINT8 key);
     virtual void OnLeftMouseClick();
     virtual void OnMouseMove(int relX, int relY);
+    virtual int OnBenchmark();
 
 private:
 
@@ -154,6 +209,7 @@ private:
 	CD3DX12_RECT m_scissorRect;
 	ComPtr<ID3D12PipelineState> m_pipelineStateModels[SShaderPermutations::Count];
     ComPtr<ID3D12PipelineState> m_pipelineStateSkybox[SShaderPermutations::Count];
+    ComPtr<ID3D12PipelineState> m_pipelineStateStereoComposite;
 
     cdGraphicsAPIDX12       m_graphicsAPI;
     ID3D12RootSignature*    m_rootSignature;
@@ -163,30 +219,44 @@ private:
     SModel m_models[(size_t)EModel::Count];
     ConstantBuffer<SConstantBuffer> m_constantBuffer;
 
-	// Synchronization objects.
+	// which back buffer is rendered to. The fences are in m_graphicsAPI.
 	UINT m_frameIndex;
-	HANDLE m_fenceEvent;
-	ComPtr<ID3D12Fence> m_fence;
-	UINT64 m_fenceValue;
 
     void MakePSOs();
 
     void LoadTextures();
+    void MakeMaterialRecords();
     void LoadSkyboxes();
 
     void MakeProceduralMeshes();
 
+    void MakeInstances();
+    void MakeSceneInstances();
+    void MakeCullingBounds();
+
 	void LoadAssets();
     
-    void SetMaterialTexturesForObject(EMaterial material);
+    // The descriptor tables and GPU handles every draw of the frame binds. The transient descriptor ring isn't thread
+    // safe, so they are made before recording draws, and they are made again if the general heap grew since.
+    void MakeFrameTables();
+    void MakeMaterialTables();
+
+    void CullModels();
+    void BuildDrawList();
+    // picks the LOD of the i'th visible subobject, fills in its draw and returns its sort key. Runs on any thread.
+    UINT64 MakeDraw(size_t i, float projectionScaleY);
+    void WriteInstanceBuffer();
+    void UploadObjectData();
+    void SubmitDrawList(SShaderPermutations::EStereoMode stereoMode);
+    void RecordDrawChunk(cdCommandRecorderDX12& recorder, SShaderPermutations::EStereoMode stereoMode, const SDrawChunk& chunk, SDrawListStats& stats);
+    void BindFrameState(cdCommandRecorderDX12& recorder);
+    void DrawSkybox(SShaderPermutations::EStereoMode stereoMode);
 
 	void PopulateCommandList();
-	void WaitForPreviousFrame();
+    void BuildRenderGraph();
 
     std::array<bool, 256> m_keyState;
 
-    TextureID m_uav = TextureID::invalid;
-
     std::array<SSkyBoxTextures, (size_t)ESkyBox::Count> m_skyboxes;
 
     ESkyBox m_skyBox = ESkyBox::Vasa;
@@ -197,7 +267,13 @@ private:
     bool m_mouseLookMode = false;
 
     TextureID m_materials[(size_t)EMaterial::Count][(size_t)EMaterialTexture::Count];
-    unsigned int m_materialDescriptorTableHeapID[(size_t)EMaterial::Count];   
+
+    // bindless materials, indexed by EMaterial
+    bool                        m_bindlessMaterials = false;
+    ComPtr<ID3D12Resource>      m_materialRecords;
+
+    // CPU time of the last PopulateCommandList
+    float                       m_recordMilliseconds = 0.0f;
 
     XMFLOAT3 m_cameraPos = { 0.0f, 1.0f, -5.0f };
     float m_cameraPitch = 0.0f;
@@ -206,4 +282,59 @@ private:
     bool m_redBlue3DMode = false;
 
     bool m_vsync = true;
+
+    // the models in the scene. The stress scene is a big field of spheres.
+    std::vector<SModelInstance> m_instances;
+    bool                        m_stressScene = false;
+
+    // the world space bounds of the model instance subobjects, in instance order. The skybox isn't culled.
+    SCullingBounds              m_cullingBounds;
+    std::vector<SCullingEntry>  m_cullingEntries;
+    std::vector<UINT32>         m_visibleSubObjects;
+    SCullingStats               m_cullingStats;
+
+    // the draws of the visible subobjects, sorted by state and batched into instanced draws
+    std::vector<SDraw>          m_draws;
+    std::vector<UINT64>         m_drawSortKeys;
+    SDrawList                   m_drawList;
+    std::vector<SDrawBatch>     m_drawBatches;
+    SDrawListStats              m_drawListStats;
+    size_t                      m_trianglesDrawn = 0;
+
+    // Draw lists with enough draws are split into chunks, which are recorded at once into their own command lists on
+    // up to this many threads
+    size_t                      m_recordingThreads = 4;
+    std::vector<SDrawChunk>     m_drawChunks;
+    std::vector<SDrawListStats> m_drawChunkStats;
+
+    // the passes of the frame, and what compiling them worked out
+    SRenderGraph                m_renderGraph;
+    SRenderGraphCompiled        m_renderGraphCompiled;
+
+    // what every command list of the frame binds, worked out on the main thread. The render targets are the pass's.
+    struct SFrameBindings
+    {
+        D3D12_GPU_VIRTUAL_ADDRESS       m_sceneConstants;
+        D3D12_GPU_DESCRIPTOR_HANDLE     m_uav;
+        D3D12_GPU_DESCRIPTOR_HANDLE     m_splitSum;
+        D3D12_GPU_DESCRIPTOR_HANDLE     m_skyboxTextures;
+        D3D12_CPU_DESCRIPTOR_HANDLE     m_renderTarget;
+        D3D12_CPU_DESCRIPTOR_HANDLE     m_depthStencil;
+    };
+    SFrameBindings                  m_frameBindings = {};
+    D3D12_GPU_DESCRIPTOR_HANDLE     m_materialTables[(size_t)EMaterial::Count] = {};
+    UINT32                          m_frameTablesGrowths = 0;   // the general heap's growths when the tables were made
+
+    // the object slot of every packet in the sorted draw list, in the upload ring each frame. This is vertex buffer slot
+    // 1 of the model draws.
+    D3D12_VERTEX_BUFFER_VIEW    m_instanceBufferView = {};
+
+    // The per object data of the model instances, in a default heap buffer that is only copied to where it changed.
+    // m_objectData is the CPU copy, indexed by slot.
+    SObjectTable                m_objectTable;
+    std::vector<SObjectData>    m_objectData;
+    std::vector<SObjectRange>   m_dirtyObjectRanges;
+    ComPtr<ID3D12Resource>      m_objectBuffer;
+    UINT32                      m_objectBufferCapacity = 0;
+    D3D12_RESOURCE_STATES       m_objectBufferState = D3D12_RESOURCE_STATE_COPY_DEST;
 };
@@ -20,7 +20,9 @@ DXSample::DXSample(UINT width, UINT height, std::wstring name) :
 	m_title(name),
 	m_useWarpDevice(false),
     m_shaderDebug(false),
-    m_GPUDebug(false)
+    m_GPUDebug(false),
+    m_benchmarkMode(false),
+    m_frameLatencyWaitable(false)
 {
 	WCHAR assetsPath[512];
 	GetAssetsPath(assetsPath, _countof(assetsPath));
@@ -101,5 +103,16 @@ void DXSample::ParseCommandLineArgs(WCHAR* argv[], int argc)
             m_GPUDebug = true;
             m_title = m_title + L" (gpudebug)";
         }
+        else if (_wcsnicmp(argv[i], L"-benchmark", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/benchmark", wcslen(argv[i])) == 0)
+        {
+            m_benchmarkMode = true;
+        }
+        else if (_wcsnicmp(argv[i], L"-waitable", wcslen(argv[i])) == 0 ||
+            _wcsnicmp(argv[i], L"/waitable", wcslen(argv[i])) == 0)
+        {
+            m_frameLatencyWaitable = true;
+            m_title = m_title + L" (waitable)";
+        }
 	}
 }
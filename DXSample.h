@@ -31,10 +31,14 @@ public:
     virtual void OnLeftMouseClick()         {}
     virtual void OnMouseMove(int /*relX*/, int /*relY*/) {}
 
+    // Run instead of the main loop when -benchmark is passed. Returns the process exit code.
+    virtual int OnBenchmark()               { return 0; }
+
 	// Accessors.
 	UINT GetWidth() const           { return m_width; }
 	UINT GetHeight() const          { return m_height; }
 	const WCHAR* GetTitle() const   { return m_title.c_str(); }
+    bool IsBenchmarkMode() const    { return m_benchmarkMode; }
 
 	void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
 
@@ -52,6 +56,8 @@ protected:
 	bool m_useWarpDevice;
     bool m_shaderDebug;
     bool m_GPUDebug;
+    bool m_benchmarkMode;
+    bool m_frameLatencyWaitable;
 
 private:
 	// Root assets path.
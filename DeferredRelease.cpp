@@ -0,0 +1,33 @@
+#include "stdafx.h"
+
+#include "DeferredRelease.h"
+
+#include <algorithm>
+
+void DeferredReleasePush (SDeferredReleaseQueue& queue, const SDeferredRelease& release)
+{
+    if (!queue.m_entries.empty() && release.m_fenceValue < queue.m_entries.back().m_fenceValue)
+        throw std::exception();
+
+    queue.m_entries.push_back(release);
+
+    SDeferredReleaseStats& stats = queue.m_stats;
+    stats.m_pending++;
+    stats.m_pendingBytes += release.m_bytes;
+    stats.m_peakPendingBytes = std::max<UINT64>(stats.m_peakPendingBytes, stats.m_pendingBytes);
+}
+
+void DeferredReleaseRetire (SDeferredReleaseQueue& queue, UINT64 completedFenceValue, std::vector<SDeferredRelease>& retired)
+{
+    SDeferredReleaseStats& stats = queue.m_stats;
+    while (!queue.m_entries.empty() && queue.m_entries.front().m_fenceValue <= completedFenceValue)
+    {
+        const SDeferredRelease& release = queue.m_entries.front();
+        stats.m_pending--;
+        stats.m_pendingBytes -= release.m_bytes;
+        stats.m_released++;
+        stats.m_releasedBytes += release.m_bytes;
+        retired.push_back(release);
+        queue.m_entries.pop_front();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+// Holds on to things the GPU may still be using until the fence value of the last frame that could use them has
+// completed. The entries are just what the owner needs to let go of them later, and cdGraphicsAPIDX12 does the
+// releasing when they come back out.
+//
+// Entries are pushed with the fence value of the frame being recorded, which only goes up, so the queue is in fence
+// order and retiring only has to look at the front.
+
+enum class EDeferredReleaseKind
+{
+    object,             // a COM object to Release, like a resource or a heap
+    descriptorRange,    // a range of general heap descriptors to free
+};
+
+struct SDeferredRelease
+{
+    EDeferredReleaseKind    m_kind = EDeferredReleaseKind::object;
+    void*                   m_object = nullptr;
+    UINT32                  m_first = 0;
+    UINT32                  m_count = 0;
+    UINT64                  m_bytes = 0;        // what it takes up in memory, for the stats
+    UINT64                  m_fenceValue = 0;
+};
+
+struct SDeferredReleaseStats
+{
+    size_t m_pending = 0;
+    UINT64 m_pendingBytes = 0;
+    UINT64 m_peakPendingBytes = 0;
+    size_t m_released = 0;
+    UINT64 m_releasedBytes = 0;
+};
+
+struct SDeferredReleaseQueue
+{
+    std::deque<SDeferredRelease>    m_entries;      // oldest first
+    SDeferredReleaseStats           m_stats;
+};
+
+// Throws if the fence value is lower than the one of the last entry pushed.
+void DeferredReleasePush (SDeferredReleaseQueue& queue, const SDeferredRelease& release);
+
+// Takes out the entries the GPU is done with, oldest first, and adds them to retired for the owner to release.
+void DeferredReleaseRetire (SDeferredReleaseQueue& queue, UINT64 completedFenceValue, std::vector<SDeferredRelease>& retired);
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+// puts a range back into the sorted free list, merging it with the free ranges on either side
+static void InsertFreeRange (SDescriptorAllocator& allocator, SDescriptorRange range)
+{
+    std::vector<SDescriptorRange>& freeRanges = allocator.m_freeRanges;
+    auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), range.m_offset,
+        [] (const SDescriptorRange& freeRange, UINT32 offset) { return freeRange.m_offset < offset; });
+
+    // overlapping a free range means this was freed twice
+    if (next != freeRanges.end() && range.m_offset + range.m_count > next->m_offset)
+        throw std::exception();
+    if (next != freeRanges.begin() && (next - 1)->m_offset + (next - 1)->m_count > range.m_offset)
+        throw std::exception();
+
+    bool mergePrevious = next != freeRanges.begin() && (next - 1)->m_offset + (next - 1)->m_count == range.m_offset;
+    bool mergeNext = next != freeRanges.end() && range.m_offset + range.m_count == next->m_offset;
+
+    if (mergePrevious && mergeNext)
+    {
+        (next - 1)->m_count += range.m_count + next->m_count;
+        freeRanges.erase(next);
+    }
+    else if (mergePrevious)
+    {
+        (next - 1)->m_count += range.m_count;
+    }
+    else if (mergeNext)
+    {
+        next->m_offset = range.m_offset;
+        next->m_count += range.m_count;
+    }
+    else
+    {
+        freeRanges.insert(next, range);
+    }
+}
+
+void DescriptorAllocatorInit (SDescriptorAllocator& allocator, UINT32 capacity)
+{
+    allocator = SDescriptorAllocator();
+    DescriptorAllocatorGrow(allocator, capacity);
+    allocator.m_growths = 0;
+}
+
+void DescriptorAllocatorGrow (SDescriptorAllocator& allocator, UINT32 capacity)
+{
+    if (capacity <= allocator.m_capacity)
+        return;
+
+    InsertFreeRange(allocator, { allocator.m_capacity, capacity - allocator.m_capacity });
+    allocator.m_capacity = capacity;
+    allocator.m_growths++;
+}
+
+bool DescriptorAllocatorAllocate (SDescriptorAllocator& allocator, UINT32 count, UINT32& offset)
+{
+    if (count == 0)
+        return false;
+
+    // find the smallest free range that fits
+    std::vector<SDescriptorRange>& freeRanges = allocator.m_freeRanges;
+    size_t best = freeRanges.size();
+    for (size_t i = 0; i < freeRanges.size(); ++i)
+    {
+        if (freeRanges[i].m_count >= count && (best == freeRanges.size() || freeRanges[i].m_count < freeRanges[best].m_count))
+        {
+            best = i;
+            if (freeRanges[i].m_count == count)
+                break;
+        }
+    }
+    if (best == freeRanges.size())
+        return false;
+
+    // take it from the front of the free range
+    offset = freeRanges[best].m_offset;
+    freeRanges[best].m_offset += count;
+    freeRanges[best].m_count -= count;
+    if (freeRanges[best].m_count == 0)
+        freeRanges.erase(freeRanges.begin() + best);
+
+    allocator.m_allocated += count;
+    return true;
+}
+
+void DescriptorAllocatorFree (SDescriptorAllocator& allocator, UINT32 offset, UINT32 count, UINT64 fenceValue)
+{
+    if (count == 0 || UINT64(offset) + count > allocator.m_capacity)
+        throw std::exception();
+
+    allocator.m_pendingFrees.push_back({ { offset, count }, fenceValue });
+}
+
+void DescriptorAllocatorRetire (SDescriptorAllocator& allocator, UINT64 completedFenceValue)
+{
+    std::vector<SDescriptorAllocator::SPendingFree>& pendingFrees = allocator.m_pendingFrees;
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingFrees.size(); ++i)
+    {
+        if (pendingFrees[i].m_fenceValue <= completedFenceValue)
+        {
+            InsertFreeRange(allocator, pendingFrees[i].m_range);
+            allocator.m_allocated -= pendingFrees[i].m_range.m_count;
+        }
+        else
+        {
+            pendingFrees[kept++] = pendingFrees[i];
+        }
+    }
+    pendingFrees.resize(kept);
+}
+
+void DescriptorAllocatorGetAllocatedRanges (const SDescriptorAllocator& allocator, std::vector<SDescriptorRange>& ranges)
+{
+    // the allocated ranges are the gaps between the free ones
+    ranges.clear();
+    UINT32 offset = 0;
+    for (const SDescriptorRange& freeRange : allocator.m_freeRanges)
+    {
+        if (freeRange.m_offset > offset)
+            ranges.push_back({ offset, freeRange.m_offset - offset });
+        offset = freeRange.m_offset + freeRange.m_count;
+    }
+    if (allocator.m_capacity > offset)
+        ranges.push_back({ offset, allocator.m_capacity - offset });
+}
+
+UINT32 DescriptorAllocatorLargestFreeRange (const SDescriptorAllocator& allocator)
+{
+    UINT32 largest = 0;
+    for (const SDescriptorRange& freeRange : allocator.m_freeRanges)
+        largest = std::max<UINT32>(largest, freeRange.m_count);
+    return largest;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+// Hands out contiguous ranges of descriptor heap indices, which keep their place when it grows. cdGraphicsAPIDX12 uses
+// one for the general heap, and copies the descriptors into a bigger heap when it grows.
+//
+// Freed ranges wait until the GPU is done with them, then merge with any free neighbors so that big ranges come back
+// together, like buddies do. Sizes aren't rounded to powers of two though, because descriptor tables are small odd
+// sizes like 3 and 5. Allocation takes the smallest free range that fits, to keep the big ones big.
+
+struct SDescriptorRange
+{
+    UINT32  m_offset;
+    UINT32  m_count;
+};
+
+struct SDescriptorAllocator
+{
+    UINT32                          m_capacity = 0;
+    UINT32                          m_allocated = 0;    // including the frees that are still pending
+    UINT32                          m_growths = 0;      // a heap remade bigger on growth invalidates the handles into the old one
+
+    std::vector<SDescriptorRange>   m_freeRanges;       // sorted by offset. Neighbors are always merged.
+
+    // frees that can't be reused until the GPU passes their fence value
+    struct SPendingFree
+    {
+        SDescriptorRange    m_range;
+        UINT64              m_fenceValue;
+    };
+    std::vector<SPendingFree>       m_pendingFrees;
+};
+
+void DescriptorAllocatorInit (SDescriptorAllocator& allocator, UINT32 capacity);
+
+// Adds the indices from the old capacity up to the new one. Allocations stay where they are.
+void DescriptorAllocatorGrow (SDescriptorAllocator& allocator, UINT32 capacity);
+
+// Returns false if there is no free range big enough, in which case the caller can grow the allocator and try again
+bool DescriptorAllocatorAllocate (SDescriptorAllocator& allocator, UINT32 count, UINT32& offset);
+
+// The range can be reused once DescriptorAllocatorRetire is called with a completed fence value of at least fenceValue.
+// Throws if the range isn't inside the allocator.
+void DescriptorAllocatorFree (SDescriptorAllocator& allocator, UINT32 offset, UINT32 count, UINT64 fenceValue);
+
+// Makes the pending frees that the GPU is done with free. Throws if one of them was already free.
+void DescriptorAllocatorRetire (SDescriptorAllocator& allocator, UINT64 completedFenceValue);
+
+// The ranges that aren't free, including pending frees, sorted by offset
+void DescriptorAllocatorGetAllocatedRanges (const SDescriptorAllocator& allocator, std::vector<SDescriptorRange>& ranges);
+
+UINT32 DescriptorAllocatorLargestFreeRange (const SDescriptorAllocator& allocator);
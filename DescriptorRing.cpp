@@ -0,0 +1,101 @@
+#include "stdafx.h"
+
+#include "DescriptorRing.h"
+
+#include <algorithm>
+
+// FNV-1a over the source indices
+static UINT64 HashSources (const UINT32* sources, UINT32 count)
+{
+    UINT64 hash = 14695981039346656037ull;
+    for (UINT32 i = 0; i < count; ++i)
+    {
+        hash ^= sources[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void DescriptorRingInit (SDescriptorRing& ring, UINT32 capacity)
+{
+    ring = SDescriptorRing();
+    ring.m_capacity = capacity;
+}
+
+void DescriptorRingReset (SDescriptorRing& ring)
+{
+    SDescriptorRingStats stats = ring.m_stats;
+    DescriptorRingInit(ring, ring.m_capacity);
+    ring.m_stats = stats;
+}
+
+bool DescriptorRingAllocateTable (SDescriptorRing& ring, const UINT32* sources, UINT32 count, UINT32& offset, bool& needsCopy)
+{
+    if (count == 0 || count > ring.m_capacity)
+        return false;
+
+    // share a table made earlier this frame if there is one
+    UINT64 hash = HashSources(sources, count);
+    auto range = ring.m_tableLookup.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const SDescriptorRing::STable& table = ring.m_tables[it->second];
+        if (table.m_count == count && std::equal(sources, sources + count, &ring.m_tableSources[table.m_firstSource]))
+        {
+            offset = table.m_offset;
+            needsCopy = false;
+            ring.m_stats.m_tables++;
+            ring.m_stats.m_tablesReused++;
+            return true;
+        }
+    }
+
+    // skip to the start of the ring if the table would go past the end
+    UINT64 head = ring.m_head;
+    UINT32 index = UINT32(head % ring.m_capacity);
+    if (index + count > ring.m_capacity)
+    {
+        head += ring.m_capacity - index;
+        index = 0;
+    }
+    if (head + count - ring.m_tail > ring.m_capacity)
+        return false;
+    ring.m_head = head + count;
+
+    SDescriptorRing::STable table;
+    table.m_offset = index;
+    table.m_count = count;
+    table.m_firstSource = UINT32(ring.m_tableSources.size());
+    ring.m_tableSources.insert(ring.m_tableSources.end(), sources, sources + count);
+    ring.m_tableLookup.insert({ hash, UINT32(ring.m_tables.size()) });
+    ring.m_tables.push_back(table);
+
+    offset = index;
+    needsCopy = true;
+    ring.m_stats.m_tables++;
+    ring.m_stats.m_descriptorsCopied += count;
+    return true;
+}
+
+void DescriptorRingEndFrame (SDescriptorRing& ring, UINT64 fenceValue)
+{
+    // a frame that made no tables has nothing to free later
+    UINT64 lastHead = ring.m_frameEnds.empty() ? ring.m_tail : ring.m_frameEnds.back().m_head;
+    if (ring.m_head != lastHead)
+        ring.m_frameEnds.push_back({ ring.m_head, fenceValue });
+
+    ring.m_tables.clear();
+    ring.m_tableSources.clear();
+    ring.m_tableLookup.clear();
+}
+
+void DescriptorRingRetire (SDescriptorRing& ring, UINT64 completedFenceValue)
+{
+    size_t retired = 0;
+    while (retired < ring.m_frameEnds.size() && ring.m_frameEnds[retired].m_fenceValue <= completedFenceValue)
+    {
+        ring.m_tail = ring.m_frameEnds[retired].m_head;
+        ++retired;
+    }
+    ring.m_frameEnds.erase(ring.m_frameEnds.begin(), ring.m_frameEnds.begin() + retired);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+// Hands out descriptor tables that only live for a frame, from a ring of descriptor heap indices. A table can be bound
+// until the frame it was made in retires, or the ring is reset. cdGraphicsAPIDX12 puts one at the end of the shader
+// visible general heap, and fills the tables by copying descriptors from the staging heap.
+//
+// Tables are made from a list of source descriptor indices. A table with the same sources as one made earlier in the
+// same frame is shared instead of being copied again.
+
+struct SDescriptorRingStats
+{
+    size_t m_tables = 0;
+    size_t m_tablesReused = 0;
+    size_t m_descriptorsCopied = 0;
+};
+
+struct SDescriptorRing
+{
+    UINT32                          m_capacity = 0;
+
+    // These count every descriptor ever allocated, so they only go up. The ring index is the count modulo capacity.
+    UINT64                          m_head = 0;
+    UINT64                          m_tail = 0;         // everything before this is free
+
+    // where each submitted frame's tables end, oldest first
+    struct SFrameEnd
+    {
+        UINT64  m_head;
+        UINT64  m_fenceValue;
+    };
+    std::vector<SFrameEnd>          m_frameEnds;
+
+    // the tables made since the last DescriptorRingEndFrame, found by a hash of their sources
+    struct STable
+    {
+        UINT32  m_offset;
+        UINT32  m_count;
+        UINT32  m_firstSource;      // index into m_tableSources
+    };
+    std::vector<STable>                         m_tables;
+    std::vector<UINT32>                         m_tableSources;
+    std::unordered_multimap<UINT64, UINT32>     m_tableLookup;  // hash to index into m_tables
+
+    SDescriptorRingStats            m_stats;
+};
+
+void DescriptorRingInit (SDescriptorRing& ring, UINT32 capacity);
+
+// Empties the ring and forgets the tables, like when the heap it lives in is replaced. The stats are kept.
+void DescriptorRingReset (SDescriptorRing& ring);
+
+// Finds or makes a table of the given sources. Returns false if the ring is too full, which means more was made in
+// the frames that the GPU hasn't finished than fits. needsCopy is true when the caller has to fill the table.
+// Tables never wrap around the end of the ring.
+bool DescriptorRingAllocateTable (SDescriptorRing& ring, const UINT32* sources, UINT32 count, UINT32& offset, bool& needsCopy);
+
+// Marks the tables made so far as used by GPU work that is done when fenceValue completes, and stops sharing them
+void DescriptorRingEndFrame (SDescriptorRing& ring, UINT64 fenceValue);
+
+// Frees the tables of the frames that are done
+void DescriptorRingRetire (SDescriptorRing& ring, UINT64 completedFenceValue);
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+
+#include "DrawList.h"
+
+#include <algorithm>
+#include <cstring>
+
+// how many bits each field of the sort key has, most significant first. They add up to 64.
+static const UINT32 c_drawKeyFieldBits[(size_t)EDrawKeyField::Count] =
+{
+    4,  // pipeline
+    8,  // material
+    16, // texture
+    16, // mesh
+    20, // depth
+};
+
+static UINT32 DrawKeyFieldShift (EDrawKeyField field)
+{
+    UINT32 shift = 64;
+    for (size_t i = 0; i <= (size_t)field; ++i)
+        shift -= c_drawKeyFieldBits[i];
+    return shift;
+}
+
+static UINT64 DrawKeyFieldMask (EDrawKeyField field)
+{
+    return (UINT64(1) << c_drawKeyFieldBits[(size_t)field]) - 1;
+}
+
+UINT64 DrawKeyMake (UINT32 pipeline, UINT32 material, UINT32 texture, UINT32 mesh, float depth)
+{
+    // the bits of a non negative float sort the same way as its value, so the top bits are a quantized depth
+    UINT32 depthBits;
+    depth = std::max<float>(depth, 0.0f);
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    depthBits >>= 32 - c_drawKeyFieldBits[(size_t)EDrawKeyField::depth];
+
+    UINT32 values[(size_t)EDrawKeyField::Count] = { pipeline, material, texture, mesh, depthBits };
+    UINT64 sortKey = 0;
+    for (size_t i = 0; i < (size_t)EDrawKeyField::Count; ++i)
+    {
+        // a truncated value would make different state look the same
+        if (UINT64(values[i]) > DrawKeyFieldMask((EDrawKeyField)i))
+            throw std::exception();
+        sortKey |= UINT64(values[i]) << DrawKeyFieldShift((EDrawKeyField)i);
+    }
+    return sortKey;
+}
+
+UINT32 DrawKeyGetField (UINT64 sortKey, EDrawKeyField field)
+{
+    return UINT32((sortKey >> DrawKeyFieldShift(field)) & DrawKeyFieldMask(field));
+}
+
+bool DrawKeyFieldChanged (UINT64 sortKey, UINT64 lastSortKey, EDrawKeyField field, SDrawListStats& stats)
+{
+    UINT64 mask = DrawKeyFieldMask(field) << DrawKeyFieldShift(field);
+    if ((sortKey ^ lastSortKey) & mask)
+    {
+        stats.m_stateChanges++;
+        return true;
+    }
+    stats.m_stateChangesAvoided++;
+    return false;
+}
+
+void DrawListClear (SDrawList& drawList)
+{
+    drawList.m_packets.clear();
+}
+
+void DrawListAdd (SDrawList& drawList, UINT64 sortKey, UINT32 drawIndex)
+{
+    drawList.m_packets.push_back({ sortKey, drawIndex });
+}
+
+void DrawListSort (SDrawList& drawList)
+{
+    std::vector<SDrawPacket>& packets = drawList.m_packets;
+    std::vector<SDrawPacket>& scratch = drawList.m_sortScratch;
+    scratch.resize(packets.size());
+    if (packets.size() < 2)
+        return;
+
+    // count every byte of every key in one read of the packets
+    size_t histograms[8][256] = {};
+    for (const SDrawPacket& packet : packets)
+    {
+        for (size_t pass = 0; pass < 8; ++pass)
+            histograms[pass][(packet.m_sortKey >> (pass * 8)) & 0xFF]++;
+    }
+
+    for (size_t pass = 0; pass < 8; ++pass)
+    {
+        size_t* histogram = histograms[pass];
+
+        // if every key has the same byte here, this pass wouldn't change the order
+        if (histogram[(packets[0].m_sortKey >> (pass * 8)) & 0xFF] == packets.size())
+            continue;
+
+        size_t offset = 0;
+        for (size_t i = 0; i < 256; ++i)
+        {
+            size_t count = histogram[i];
+            histogram[i] = offset;
+            offset += count;
+        }
+
+        for (const SDrawPacket& packet : packets)
+            scratch[histogram[(packet.m_sortKey >> (pass * 8)) & 0xFF]++] = packet;
+        packets.swap(scratch);
+    }
+}
+
+void DrawListBatch (const SDrawList& drawList, std::vector<SDrawBatch>& batches)
+{
+    batches.clear();
+
+    // everything above the depth field has to match
+    UINT64 stateMask = ~(DrawKeyFieldMask(EDrawKeyField::depth) << DrawKeyFieldShift(EDrawKeyField::depth));
+    const std::vector<SDrawPacket>& packets = drawList.m_packets;
+    for (size_t i = 0; i < packets.size(); ++i)
+    {
+        if (batches.empty() || ((packets[i].m_sortKey ^ packets[i - 1].m_sortKey) & stateMask) != 0)
+            batches.push_back({ UINT32(i), 0 });
+        batches.back().m_packetCount++;
+    }
+}
+
+void DrawListChunk (const std::vector<SDrawBatch>& batches, size_t minDrawsPerChunk, size_t maxChunks, std::vector<SDrawChunk>& chunks)
+{
+    chunks.clear();
+    if (batches.empty())
+        return;
+
+    size_t numChunks = std::max<size_t>(batches.size() / std::max<size_t>(minDrawsPerChunk, 1), 1);
+    numChunks = std::min<size_t>(numChunks, std::max<size_t>(maxChunks, 1));
+
+    // the first batches.size() % numChunks chunks get one more draw
+    size_t first = 0;
+    for (size_t i = 0; i < numChunks; ++i)
+    {
+        size_t count = batches.size() / numChunks + (i < batches.size() % numChunks ? 1 : 0);
+        chunks.push_back({ UINT32(first), UINT32(count) });
+        first += count;
+    }
+}
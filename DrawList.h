@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+// The fields of a draw's 64 bit sort key, from most to least significant. Sorting by the key groups draws that share
+// pipeline state, then material, then texture, then mesh, and draws front to back within each group. Draws whose keys
+// only differ by depth can be drawn together as instances.
+enum class EDrawKeyField
+{
+    pipeline,
+    material,
+    texture,
+    mesh,
+    depth,
+
+    Count
+};
+
+// One draw of a draw list. What it draws is up to the caller, who finds it by m_drawIndex.
+struct SDrawPacket
+{
+    UINT64  m_sortKey;
+    UINT32  m_drawIndex;
+};
+
+// A flat list of draw packets that is refilled and sorted every frame
+struct SDrawList
+{
+    std::vector<SDrawPacket>    m_packets;
+    std::vector<SDrawPacket>    m_sortScratch;
+};
+
+// A run of sorted packets whose keys only differ by depth
+struct SDrawBatch
+{
+    UINT32  m_firstPacket;
+    UINT32  m_packetCount;
+};
+
+// A run of batches that one command list records
+struct SDrawChunk
+{
+    UINT32  m_firstBatch;
+    UINT32  m_batchCount;
+};
+
+struct SDrawListStats
+{
+    size_t m_draws = 0;
+    size_t m_instances = 0;
+    size_t m_stateChanges = 0;
+    size_t m_stateChangesAvoided = 0;
+};
+
+// Makes a sort key. Throws if a value doesn't fit in its field. depth is a distance from the camera and is quantized.
+UINT64 DrawKeyMake (UINT32 pipeline, UINT32 material, UINT32 texture, UINT32 mesh, float depth);
+
+UINT32 DrawKeyGetField (UINT64 sortKey, EDrawKeyField field);
+
+// Returns whether the field differs between two keys, and counts it as a state change or an avoided one
+bool DrawKeyFieldChanged (UINT64 sortKey, UINT64 lastSortKey, EDrawKeyField field, SDrawListStats& stats);
+
+void DrawListClear (SDrawList& drawList);
+
+void DrawListAdd (SDrawList& drawList, UINT64 sortKey, UINT32 drawIndex);
+
+// Sorts the packets by key with a stable LSD radix sort, 8 bits per pass. Passes where every key has the same byte
+// are skipped.
+void DrawListSort (SDrawList& drawList);
+
+// Splits the sorted packets into batches that can each be one instanced draw
+void DrawListBatch (const SDrawList& drawList, std::vector<SDrawBatch>& batches);
+
+// Splits the batches into at most maxChunks chunks of about the same number of draws, for recording on that many
+// threads. A chunk has at least minDrawsPerChunk draws, because each command list costs something to set up, so small
+// lists are one chunk.
+void DrawListChunk (const std::vector<SDrawBatch>& batches, size_t minDrawsPerChunk, size_t maxChunks, std::vector<SDrawChunk>& chunks);
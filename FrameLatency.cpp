@@ -0,0 +1,86 @@
+#include "stdafx.h"
+
+#include "FrameLatency.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double c_smoothing = 0.1;
+
+// CPU time this many deviations over the average is treated as a spike that queued frames have to cover
+static const double c_spikeDeviations = 2.0;
+
+void FrameLatencyInit (SFrameLatencyController& controller, unsigned int minLatency, unsigned int maxLatency, double tolerance)
+{
+    if (minLatency == 0 || maxLatency < minLatency || tolerance < 0.0)
+        throw std::exception();
+
+    controller = SFrameLatencyController();
+    controller.m_minLatency = minLatency;
+    controller.m_maxLatency = maxLatency;
+    controller.m_latency = maxLatency;
+    controller.m_wantedLatency = maxLatency;
+    controller.m_tolerance = tolerance;
+}
+
+double FrameLatencyPredictMilliseconds (const SFrameLatencyController& controller, unsigned int latency)
+{
+    double cpu = controller.m_cpuMilliseconds;
+    double gpu = controller.m_gpuMilliseconds;
+    if (latency <= 1)
+        return cpu + gpu;
+
+    // each frame queued past the first spreads a spike out over one more frame
+    double spike = c_spikeDeviations * controller.m_cpuDeviation / double(latency - 1);
+    return std::max<double>(cpu + spike, gpu);
+}
+
+bool FrameLatencyUpdate (SFrameLatencyController& controller, double cpuMilliseconds, double gpuMilliseconds, double waitMilliseconds)
+{
+    SFrameLatencyStats& stats = controller.m_stats;
+    if (stats.m_frames == 0)
+    {
+        controller.m_cpuMilliseconds = cpuMilliseconds;
+        controller.m_gpuMilliseconds = gpuMilliseconds;
+    }
+    else
+    {
+        double cpuError = cpuMilliseconds - controller.m_cpuMilliseconds;
+        controller.m_cpuMilliseconds += cpuError * c_smoothing;
+        controller.m_cpuDeviation += (std::fabs(cpuError) - controller.m_cpuDeviation) * c_smoothing;
+        controller.m_gpuMilliseconds += (gpuMilliseconds - controller.m_gpuMilliseconds) * c_smoothing;
+    }
+    stats.m_frames++;
+    stats.m_waitMilliseconds += waitMilliseconds;
+
+    double best = FrameLatencyPredictMilliseconds(controller, controller.m_maxLatency);
+    for (unsigned int latency = controller.m_minLatency; latency < controller.m_maxLatency; ++latency)
+        best = std::min<double>(best, FrameLatencyPredictMilliseconds(controller, latency));
+
+    unsigned int wanted = controller.m_maxLatency;
+    for (unsigned int latency = controller.m_minLatency; latency < controller.m_maxLatency; ++latency)
+    {
+        if (FrameLatencyPredictMilliseconds(controller, latency) <= best * (1.0 + controller.m_tolerance))
+        {
+            wanted = latency;
+            break;
+        }
+    }
+
+    if (wanted != controller.m_wantedLatency)
+    {
+        controller.m_wantedLatency = wanted;
+        controller.m_framesWanted = 0;
+    }
+    controller.m_framesWanted++;
+
+    if (wanted == controller.m_latency || controller.m_framesWanted < c_frameLatencyFramesBeforeChange)
+        return false;
+
+    if (wanted > controller.m_latency)
+        stats.m_increases++;
+    else
+        stats.m_decreases++;
+    controller.m_latency = wanted;
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Picks how many frames the swap chain lets the CPU queue up, from measured CPU and GPU frame times. Fewer queued
+// frames means input shows up on screen sooner, more means the GPU doesn't go idle while the CPU records.
+// cdGraphicsAPIDX12 gives it the times of each frame, and passes the latency on to SetMaximumFrameLatency.
+//
+// With a latency of 1 the CPU and GPU take turns, so a frame takes CPU + GPU time. With more, they overlap and a frame
+// takes the longer of the two, and the extra frames also soak up spikes in CPU time. The controller picks the lowest
+// latency whose predicted frame time is within a tolerance of the best one, and only changes after the choice has been
+// the same for a while, so that it doesn't flip back and forth.
+
+static const unsigned int c_frameLatencyFramesBeforeChange = 30;
+
+struct SFrameLatencyStats
+{
+    size_t m_frames = 0;
+    size_t m_increases = 0;
+    size_t m_decreases = 0;
+    double m_waitMilliseconds = 0.0;    // total time the CPU spent waiting to start frames
+};
+
+struct SFrameLatencyController
+{
+    unsigned int    m_minLatency = 1;
+    unsigned int    m_maxLatency = 1;
+    unsigned int    m_latency = 1;
+    double          m_tolerance = 0.0;      // how much longer frames can be, as a fraction, to get a lower latency
+
+    // smoothed over recent frames
+    double          m_cpuMilliseconds = 0.0;
+    double          m_cpuDeviation = 0.0;
+    double          m_gpuMilliseconds = 0.0;
+
+    // the latency the last frames wanted, and for how many frames in a row
+    unsigned int    m_wantedLatency = 1;
+    unsigned int    m_framesWanted = 0;
+
+    SFrameLatencyStats m_stats;
+};
+
+// Starts at the highest latency, which is what the swap chain is made with.
+void FrameLatencyInit (SFrameLatencyController& controller, unsigned int minLatency, unsigned int maxLatency, double tolerance);
+
+// the frame time the controller expects at a latency, from the smoothed times
+double FrameLatencyPredictMilliseconds (const SFrameLatencyController& controller, unsigned int latency);
+
+// Takes the times of a frame and returns true if the latency changed.
+bool FrameLatencyUpdate (SFrameLatencyController& controller, double cpuMilliseconds, double gpuMilliseconds, double waitMilliseconds);
@@ -0,0 +1,40 @@
+#include "stdafx.h"
+
+#include "FramePacer.h"
+
+void FramePacerInit (SFramePacer& pacer, unsigned int framesInFlight)
+{
+    if (framesInFlight == 0)
+        throw std::exception();
+
+    pacer = SFramePacer();
+    pacer.m_framesInFlight = framesInFlight;
+    pacer.m_contextFenceValues.resize(framesInFlight, 0);
+}
+
+unsigned int FramePacerContext (const SFramePacer& pacer)
+{
+    return (unsigned int)(pacer.m_frameNumber % pacer.m_framesInFlight);
+}
+
+UINT64 FramePacerFenceValue (const SFramePacer& pacer)
+{
+    return pacer.m_frameNumber + 1;
+}
+
+UINT64 FramePacerAcquire (SFramePacer& pacer, UINT64 completedFenceValue)
+{
+    UINT64 fenceValue = pacer.m_contextFenceValues[FramePacerContext(pacer)];
+    pacer.m_stats.m_frames++;
+    if (completedFenceValue < fenceValue)
+        pacer.m_stats.m_waits++;
+    return fenceValue;
+}
+
+UINT64 FramePacerSubmit (SFramePacer& pacer)
+{
+    UINT64 fenceValue = FramePacerFenceValue(pacer);
+    pacer.m_contextFenceValues[FramePacerContext(pacer)] = fenceValue;
+    pacer.m_frameNumber++;
+    return fenceValue;
+}
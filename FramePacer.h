@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+// Keeps track of which frames the GPU may still be working on, so that the CPU can record up to a number of frames
+// ahead of it. It says which fence values to wait for and signal. cdGraphicsAPIDX12 owns one, does the waiting and
+// signaling, and has a command allocator and a release list per frame context.
+//
+// Frames are numbered from 0, and frame n signals fence value n + 1 when the GPU is done with it. Frame n records
+// with context n % framesInFlight, so before it can start, the frame that last used that context has to be done.
+
+struct SFramePacerStats
+{
+    size_t m_frames = 0;
+    size_t m_waits = 0;     // frames that had to wait for the GPU before they could start
+};
+
+struct SFramePacer
+{
+    unsigned int            m_framesInFlight = 0;
+    UINT64                  m_frameNumber = 0;          // the frame being recorded
+    std::vector<UINT64>     m_contextFenceValues;       // of the last frame that used each context, 0 if none has
+
+    SFramePacerStats        m_stats;
+};
+
+void FramePacerInit (SFramePacer& pacer, unsigned int framesInFlight);
+
+// which frame context the frame being recorded uses
+unsigned int FramePacerContext (const SFramePacer& pacer);
+
+// the fence value that the frame being recorded signals
+UINT64 FramePacerFenceValue (const SFramePacer& pacer);
+
+// Returns the fence value that has to be complete before the frame being recorded can reuse its context, which is 0
+// if nothing has used it yet. Counts a wait if completedFenceValue is behind it.
+UINT64 FramePacerAcquire (SFramePacer& pacer, UINT64 completedFenceValue);
+
+// Remembers the fence value of the frame being recorded for its context, and moves on to the next frame. Returns the
+// fence value to signal.
+UINT64 FramePacerSubmit (SFramePacer& pacer);
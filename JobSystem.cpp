@@ -0,0 +1,336 @@
+#include "stdafx.h"
+
+#include "JobSystem.h"
+
+#include <functional>
+
+// how many times an idle worker looks for jobs before it goes to sleep
+static const size_t c_idleSpins = 64;
+
+static const size_t c_noWorker = size_t(-1);
+
+// the job system and worker this thread owns a deque of, if any
+struct SJobThread
+{
+    SJobSystem* m_system = nullptr;
+    size_t      m_worker = c_noWorker;
+};
+
+static thread_local SJobThread s_jobThread;
+
+static size_t CurrentWorker (const SJobSystem& system)
+{
+    return (s_jobThread.m_system == &system) ? s_jobThread.m_worker : c_noWorker;
+}
+
+static void WriteSlot (SJobSlot& slot, const SJob& job)
+{
+    slot.m_function.store(job.m_function, std::memory_order_relaxed);
+    slot.m_data.store(job.m_data, std::memory_order_relaxed);
+    slot.m_begin.store(job.m_begin, std::memory_order_relaxed);
+    slot.m_end.store(job.m_end, std::memory_order_relaxed);
+    slot.m_counter.store(job.m_counter, std::memory_order_relaxed);
+}
+
+static void ReadSlot (const SJobSlot& slot, SJob& job)
+{
+    job.m_function = slot.m_function.load(std::memory_order_relaxed);
+    job.m_data = slot.m_data.load(std::memory_order_relaxed);
+    job.m_begin = slot.m_begin.load(std::memory_order_relaxed);
+    job.m_end = slot.m_end.load(std::memory_order_relaxed);
+    job.m_counter = slot.m_counter.load(std::memory_order_relaxed);
+}
+
+// The deque operations are the ones from "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.), with
+// a fixed size buffer instead of a growing one.
+static bool DequePush (SJobDeque& deque, const SJob& job)
+{
+    INT64 bottom = deque.m_bottom.load(std::memory_order_relaxed);
+    INT64 top = deque.m_top.load(std::memory_order_acquire);
+    if (bottom - top >= INT64(c_jobDequeCapacity))
+        return false;
+
+    WriteSlot(deque.m_slots[bottom & (c_jobDequeCapacity - 1)], job);
+    std::atomic_thread_fence(std::memory_order_release);
+    deque.m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static bool DequePop (SJobDeque& deque, SJob& job)
+{
+    INT64 bottom = deque.m_bottom.load(std::memory_order_relaxed) - 1;
+    deque.m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    INT64 top = deque.m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        deque.m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ReadSlot(deque.m_slots[bottom & (c_jobDequeCapacity - 1)], job);
+    if (top < bottom)
+        return true;
+
+    // this is the last job, and a thief may be taking it too
+    bool taken = deque.m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    deque.m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return taken;
+}
+
+static bool DequeSteal (SJobDeque& deque, SJob& job)
+{
+    INT64 top = deque.m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    INT64 bottom = deque.m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+        return false;
+
+    ReadSlot(deque.m_slots[top & (c_jobDequeCapacity - 1)], job);
+    return deque.m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+static void AddStat (std::atomic<size_t>& stat)
+{
+    stat.store(stat.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static void RunJob (SJobSystem& system, size_t worker, const SJob& job)
+{
+    job.m_function(job);
+    if (worker != c_noWorker)
+        AddStat(system.m_workers[worker]->m_stats.m_jobsRun);
+    job.m_counter->m_pending.fetch_sub(1, std::memory_order_release);
+}
+
+// from the worker's own deque first, then the jobs from other threads, then the other workers' deques
+static bool TakeJob (SJobSystem& system, size_t worker, SJob& job)
+{
+    if (worker != c_noWorker && DequePop(system.m_workers[worker]->m_deque, job))
+    {
+        system.m_queued--;
+        return true;
+    }
+
+    if (system.m_externalCount.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(system.m_externalLock);
+        if (!system.m_externalJobs.empty())
+        {
+            job = system.m_externalJobs.back();
+            system.m_externalJobs.pop_back();
+            system.m_externalCount--;
+            system.m_queued--;
+            return true;
+        }
+    }
+
+    // start at a random worker, so thieves spread out over the victims
+    size_t numWorkers = system.m_workers.size();
+    size_t start = 0;
+    if (worker != c_noWorker)
+    {
+        UINT32& random = system.m_workers[worker]->m_random;
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        start = random % numWorkers;
+    }
+
+    for (size_t i = 0; i < numWorkers; ++i)
+    {
+        size_t victim = (start + i) % numWorkers;
+        if (victim == worker)
+            continue;
+
+        if (worker != c_noWorker)
+            AddStat(system.m_workers[worker]->m_stats.m_stealAttempts);
+
+        if (DequeSteal(system.m_workers[victim]->m_deque, job))
+        {
+            if (worker != c_noWorker)
+                AddStat(system.m_workers[worker]->m_stats.m_steals);
+            system.m_queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void WorkerThread (SJobSystem& system, size_t worker)
+{
+    s_jobThread.m_system = &system;
+    s_jobThread.m_worker = worker;
+
+    size_t idle = 0;
+    while (!system.m_quit.load(std::memory_order_relaxed))
+    {
+        SJob job;
+        if (TakeJob(system, worker, job))
+        {
+            RunJob(system, worker, job);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < c_idleSpins)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // JobSystemRun adds to m_queued before it looks at m_sleeping, and this adds to m_sleeping before it looks at
+        // m_queued, so one of them sees the other and a job can't get queued without waking anyone.
+        std::unique_lock<std::mutex> lock(system.m_sleepLock);
+        system.m_sleeping++;
+        AddStat(system.m_workers[worker]->m_stats.m_sleeps);
+        system.m_wake.wait(lock, [&] () { return system.m_queued.load() > 0 || system.m_quit.load(); });
+        system.m_sleeping--;
+        idle = 0;
+    }
+
+    s_jobThread = SJobThread();
+}
+
+void JobSystemInit (SJobSystem& system, size_t numThreads)
+{
+    if (!system.m_workers.empty())
+        throw std::exception();
+
+    if (numThreads == 0)
+        numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    system.m_quit = false;
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        system.m_workers.emplace_back(new SJobWorker());
+        system.m_workers[i]->m_random = UINT32(i) * 0x9E3779B9u + 1;
+    }
+
+    system.m_previousSystem = s_jobThread.m_system;
+    system.m_previousWorker = s_jobThread.m_worker;
+    s_jobThread.m_system = &system;
+    s_jobThread.m_worker = 0;
+
+    for (size_t i = 1; i < numThreads; ++i)
+        system.m_workers[i]->m_thread = std::thread(WorkerThread, std::ref(system), i);
+}
+
+void JobSystemShutdown (SJobSystem& system)
+{
+    if (system.m_workers.empty())
+        return;
+
+    // run whatever is still queued, so nothing waiting on it gets stuck
+    SJob job;
+    while (TakeJob(system, CurrentWorker(system), job))
+        RunJob(system, CurrentWorker(system), job);
+
+    {
+        std::lock_guard<std::mutex> lock(system.m_sleepLock);
+        system.m_quit = true;
+    }
+    system.m_wake.notify_all();
+
+    for (size_t i = 1; i < system.m_workers.size(); ++i)
+        system.m_workers[i]->m_thread.join();
+    system.m_workers.clear();
+
+    s_jobThread.m_system = system.m_previousSystem;
+    s_jobThread.m_worker = system.m_previousWorker;
+}
+
+SJobSystem& JobSystemDefault ()
+{
+    struct SDefaultJobSystem
+    {
+        SJobSystem m_system;
+        SDefaultJobSystem () { JobSystemInit(m_system, 0); }
+        ~SDefaultJobSystem () { JobSystemShutdown(m_system); }
+    };
+
+    static SDefaultJobSystem s_default;
+    return s_default.m_system;
+}
+
+size_t JobSystemThreadCount (const SJobSystem& system)
+{
+    return system.m_workers.size();
+}
+
+void JobSystemRun (SJobSystem& system, const SJob* jobs, size_t count, SJobCounter& counter)
+{
+    if (count == 0)
+        return;
+
+    // count them all first, so the counter can't get to zero while the jobs are still being handed out
+    counter.m_pending.fetch_add(count, std::memory_order_relaxed);
+
+    size_t worker = CurrentWorker(system);
+    size_t queued = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        SJob job = jobs[i];
+        job.m_counter = &counter;
+
+        if (worker == c_noWorker)
+        {
+            std::lock_guard<std::mutex> lock(system.m_externalLock);
+            system.m_externalJobs.push_back(job);
+            system.m_externalCount++;
+            system.m_externalTotal++;
+            ++queued;
+        }
+        else if (DequePush(system.m_workers[worker]->m_deque, job))
+        {
+            ++queued;
+        }
+        else
+        {
+            system.m_inlineJobs++;
+            RunJob(system, worker, job);
+        }
+    }
+
+    if (queued == 0)
+        return;
+
+    system.m_queued += INT64(queued);
+    if (system.m_sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(system.m_sleepLock);
+        if (queued == 1)
+            system.m_wake.notify_one();
+        else
+            system.m_wake.notify_all();
+    }
+}
+
+void JobSystemWait (SJobSystem& system, SJobCounter& counter)
+{
+    size_t worker = CurrentWorker(system);
+    while (counter.m_pending.load(std::memory_order_acquire) != 0)
+    {
+        SJob job;
+        if (TakeJob(system, worker, job))
+            RunJob(system, worker, job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+SJobSystemStats JobSystemGetStats (const SJobSystem& system)
+{
+    SJobSystemStats stats;
+    for (const std::unique_ptr<SJobWorker>& worker : system.m_workers)
+    {
+        stats.m_jobsRun += worker->m_stats.m_jobsRun.load(std::memory_order_relaxed);
+        stats.m_steals += worker->m_stats.m_steals.load(std::memory_order_relaxed);
+        stats.m_stealAttempts += worker->m_stats.m_stealAttempts.load(std::memory_order_relaxed);
+        stats.m_sleeps += worker->m_stats.m_sleeps.load(std::memory_order_relaxed);
+    }
+    stats.m_externalJobs = system.m_externalTotal.load(std::memory_order_relaxed);
+    stats.m_inlineJobs = system.m_inlineJobs.load(std::memory_order_relaxed);
+    return stats;
+}
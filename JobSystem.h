@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads that run small jobs, for the engine's CPU side work: model processing, texture decoding,
+// draw list building and command list recording. Jobs must not throw, and may wait on jobs they hand out.
+//
+// Each worker has its own Chase-Lev deque. A worker pushes and pops jobs at the bottom of its own deque, without locks,
+// and workers that run out of jobs steal from the top of the others'. The thread that makes the job system gets a deque
+// too, so it can hand out jobs and help run them. Other threads hand out jobs through a locked queue.
+//
+// Jobs signal a counter when they finish. Waiting on a counter runs other jobs until it gets to zero, so a job can wait
+// for the jobs it depends on without tying up its thread, and jobs can hand out more jobs.
+
+static const size_t c_jobDequeCapacity = 1024;   // a power of 2. Jobs pushed to a full deque run right away.
+
+struct SJob;
+typedef void (*JobFunction) (const SJob& job);
+
+struct SJobCounter
+{
+    std::atomic<size_t> m_pending{ 0 };     // jobs handed out that haven't finished yet
+};
+
+struct SJob
+{
+    JobFunction     m_function = nullptr;
+    const void*     m_data = nullptr;
+    size_t          m_begin = 0;
+    size_t          m_end = 0;
+    SJobCounter*    m_counter = nullptr;    // set when the job is handed out
+};
+
+// the fields of a job, each atomic because a thief can read a slot while its owner is writing it. The thief throws
+// away what it read when that happens.
+struct SJobSlot
+{
+    std::atomic<JobFunction>    m_function{ nullptr };
+    std::atomic<const void*>    m_data{ nullptr };
+    std::atomic<size_t>         m_begin{ 0 };
+    std::atomic<size_t>         m_end{ 0 };
+    std::atomic<SJobCounter*>   m_counter{ nullptr };
+};
+
+struct SJobDeque
+{
+    std::atomic<INT64>  m_top{ 0 };         // where thieves take from
+    char                m_padding0[64];
+    std::atomic<INT64>  m_bottom{ 0 };      // where the owner pushes and pops
+    char                m_padding1[64];
+    SJobSlot            m_slots[c_jobDequeCapacity];
+};
+
+// only the owner of the worker adds to these, but anyone can read them
+struct SJobWorkerStats
+{
+    std::atomic<size_t> m_jobsRun{ 0 };
+    std::atomic<size_t> m_steals{ 0 };
+    std::atomic<size_t> m_stealAttempts{ 0 };
+    std::atomic<size_t> m_sleeps{ 0 };
+};
+
+struct SJobWorker
+{
+    SJobDeque       m_deque;
+    SJobWorkerStats m_stats;
+    UINT32          m_random = 0;           // for picking who to steal from
+    std::thread     m_thread;               // not used by worker 0, which belongs to the thread that made the system
+};
+
+struct SJobSystemStats
+{
+    size_t m_jobsRun = 0;
+    size_t m_steals = 0;
+    size_t m_stealAttempts = 0;
+    size_t m_sleeps = 0;
+    size_t m_externalJobs = 0;              // jobs handed out by threads without a deque
+    size_t m_inlineJobs = 0;                // jobs that ran right away because a deque was full
+};
+
+struct SJobSystem
+{
+    std::vector<std::unique_ptr<SJobWorker>> m_workers;
+
+    // for threads that aren't workers
+    std::mutex                  m_externalLock;
+    std::vector<SJob>           m_externalJobs;
+    std::atomic<size_t>         m_externalCount{ 0 };
+    std::atomic<size_t>         m_externalTotal{ 0 };
+    std::atomic<size_t>         m_inlineJobs{ 0 };
+
+    // idle workers sleep until there are jobs queued
+    std::mutex                  m_sleepLock;
+    std::condition_variable     m_wake;
+    std::atomic<INT64>          m_queued{ 0 };
+    std::atomic<size_t>         m_sleeping{ 0 };
+    std::atomic<bool>           m_quit{ false };
+
+    // what the thread that made the system was a worker of before, to put back on shutdown
+    SJobSystem*                 m_previousSystem = nullptr;
+    size_t                      m_previousWorker = 0;
+};
+
+// Starts numThreads - 1 worker threads, and makes the calling thread worker 0. numThreads of 0 means use all hardware
+// threads. Has to be shut down from the same thread.
+void JobSystemInit (SJobSystem& system, size_t numThreads);
+
+// Waits for the workers to finish what's queued, and stops them.
+void JobSystemShutdown (SJobSystem& system);
+
+// Made with all hardware threads on first use, by the thread that uses it first. That should be the main thread.
+SJobSystem& JobSystemDefault ();
+
+size_t JobSystemThreadCount (const SJobSystem& system);
+
+// Hands out count jobs, which decrement the counter as they finish.
+void JobSystemRun (SJobSystem& system, const SJob* jobs, size_t count, SJobCounter& counter);
+
+// Runs queued jobs until the counter gets to zero.
+void JobSystemWait (SJobSystem& system, SJobCounter& counter);
+
+SJobSystemStats JobSystemGetStats (const SJobSystem& system);
+
+template <typename LAMBDA>
+struct SJobParallelFor
+{
+    const LAMBDA*       m_work = nullptr;
+    size_t              m_count = 0;
+    size_t              m_grainSize = 0;
+    size_t              m_numGrains = 0;
+    std::atomic<size_t> m_nextGrain{ 0 };
+};
+
+// each parallel for job takes grains until there are none left, so the jobs that start first do more of the work
+template <typename LAMBDA>
+void JobParallelForGrains (const SJob& job)
+{
+    SJobParallelFor<LAMBDA>& parallelFor = *(SJobParallelFor<LAMBDA>*)job.m_data;
+    size_t grain;
+    while ((grain = parallelFor.m_nextGrain++) < parallelFor.m_numGrains)
+    {
+        size_t begin = grain * parallelFor.m_grainSize;
+        (*parallelFor.m_work)(begin, std::min<size_t>(begin + parallelFor.m_grainSize, parallelFor.m_count));
+    }
+}
+
+// Splits [0, count) into grains of grainSize items and runs work(begin, end) on each grain. At most maxThreads threads
+// (including the calling thread) work on it at once, and 0 means as many as the job system has. The calling thread
+// helps until all of the grains are done.
+template <typename LAMBDA>
+void JobSystemParallelFor (SJobSystem& system, size_t count, size_t grainSize, const LAMBDA& work, size_t maxThreads = 0)
+{
+    if (count == 0)
+        return;
+
+    SJobParallelFor<LAMBDA> parallelFor;
+    parallelFor.m_work = &work;
+    parallelFor.m_count = count;
+    parallelFor.m_grainSize = std::max<size_t>(grainSize, 1);
+    parallelFor.m_numGrains = (count + parallelFor.m_grainSize - 1) / parallelFor.m_grainSize;
+
+    if (maxThreads == 0)
+        maxThreads = JobSystemThreadCount(system);
+    size_t numJobs = std::min<size_t>(maxThreads, parallelFor.m_numGrains);
+
+    SJob job;
+    job.m_function = &JobParallelForGrains<LAMBDA>;
+    job.m_data = &parallelFor;
+
+    SJobCounter counter;
+    if (numJobs > 1)
+    {
+        std::vector<SJob> jobs(numJobs - 1, job);
+        JobSystemRun(system, jobs.data(), jobs.size(), counter);
+    }
+
+    JobParallelForGrains<LAMBDA>(job);
+    JobSystemWait(system, counter);
+}
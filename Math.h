@@ -46,6 +46,11 @@ inline XMFLOAT3 Cross (const XMFLOAT3& a, const XMFLOAT3& b)
     return ret;
 }
 
+inline float Dot (const XMFLOAT3& a, const XMFLOAT3& b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
 inline void Normalize (XMFLOAT3& v)
 {
     float len = std::sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
@@ -0,0 +1,135 @@
+#include "stdafx.h"
+
+#include "MeshCache.h"
+
+static const UINT32 c_meshCacheMagic = 'MSHC';
+
+// bump this whenever the cached data or the way it is made changes
+static const UINT32 c_meshCacheVersion = 2;
+
+struct SMeshCacheHeader
+{
+    UINT32  m_magic;
+    UINT32  m_version;
+    UINT64  m_sourceSize;
+    UINT64  m_sourceWriteTime;
+    UINT32  m_flipV;
+    UINT32  m_numSubObjects;
+};
+
+static std::string MakeCacheFileName (const char* fileName)
+{
+    std::string ret = fileName;
+    ret += ".meshcache";
+    return ret;
+}
+
+// fills out the parts of the header that identify the source file and load options
+static bool MakeHeader (const char* fileName, bool flipV, SMeshCacheHeader& header)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(fileName, GetFileExInfoStandard, &attributes))
+        return false;
+
+    header.m_magic = c_meshCacheMagic;
+    header.m_version = c_meshCacheVersion;
+    header.m_sourceSize = (UINT64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    header.m_sourceWriteTime = (UINT64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    header.m_flipV = flipV ? 1 : 0;
+    header.m_numSubObjects = 0;
+    return true;
+}
+
+template <typename T>
+static void WriteArray (FILE* file, const std::vector<T>& data)
+{
+    UINT32 count = UINT32(data.size());
+    fwrite(&count, sizeof(count), 1, file);
+    if (count > 0)
+        fwrite(&data[0], sizeof(T), count, file);
+}
+
+template <typename T>
+static bool ReadArray (FILE* file, std::vector<T>& data)
+{
+    UINT32 count;
+    if (fread(&count, sizeof(count), 1, file) != 1)
+        return false;
+    data.resize(count);
+    return count == 0 || fread(&data[0], sizeof(T), count, file) == count;
+}
+
+bool MeshCacheLoad (const char* fileName, bool flipV, std::vector<SMeshCacheSubObject>& subObjects)
+{
+    SMeshCacheHeader expectedHeader;
+    if (!MakeHeader(fileName, flipV, expectedHeader))
+        return false;
+
+    FILE* file = nullptr;
+    if (fopen_s(&file, MakeCacheFileName(fileName).c_str(), "rb") != 0 || !file)
+        return false;
+
+    SMeshCacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.m_magic == expectedHeader.m_magic &&
+        header.m_version == expectedHeader.m_version &&
+        header.m_sourceSize == expectedHeader.m_sourceSize &&
+        header.m_sourceWriteTime == expectedHeader.m_sourceWriteTime &&
+        header.m_flipV == expectedHeader.m_flipV;
+
+    if (ok)
+    {
+        subObjects.resize(header.m_numSubObjects);
+        for (SMeshCacheSubObject& subObject : subObjects)
+        {
+            std::vector<char> textureDiffuse;
+            ok = ok &&
+                ReadArray(file, textureDiffuse) &&
+                ReadArray(file, subObject.m_vertices) &&
+                ReadArray(file, subObject.m_indices) &&
+                ReadArray(file, subObject.m_lods) &&
+                ReadArray(file, subObject.m_meshlets.m_meshlets) &&
+                ReadArray(file, subObject.m_meshlets.m_vertices) &&
+                ReadArray(file, subObject.m_meshlets.m_triangles);
+            subObject.m_textureDiffuse.assign(textureDiffuse.begin(), textureDiffuse.end());
+        }
+    }
+
+    fclose(file);
+
+    if (!ok)
+        subObjects.clear();
+    return ok;
+}
+
+void MeshCacheSave (const char* fileName, bool flipV, const std::vector<SMeshCacheSubObject>& subObjects)
+{
+    SMeshCacheHeader header;
+    if (!MakeHeader(fileName, flipV, header))
+        return;
+    header.m_numSubObjects = UINT32(subObjects.size());
+
+    // a cache that can't be written just means the model gets processed again next time
+    FILE* file = nullptr;
+    if (fopen_s(&file, MakeCacheFileName(fileName).c_str(), "wb") != 0 || !file)
+    {
+        OutputDebugStringA("Could not write mesh cache for ");
+        OutputDebugStringA(fileName);
+        OutputDebugStringA("\n");
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    for (const SMeshCacheSubObject& subObject : subObjects)
+    {
+        WriteArray(file, std::vector<char>(subObject.m_textureDiffuse.begin(), subObject.m_textureDiffuse.end()));
+        WriteArray(file, subObject.m_vertices);
+        WriteArray(file, subObject.m_indices);
+        WriteArray(file, subObject.m_lods);
+        WriteArray(file, subObject.m_meshlets.m_meshlets);
+        WriteArray(file, subObject.m_meshlets.m_vertices);
+        WriteArray(file, subObject.m_meshlets.m_triangles);
+    }
+
+    fclose(file);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Model.h"
+
+// The processed data of one subobject of a model file
+struct SMeshCacheSubObject
+{
+    std::string             m_textureDiffuse;   // empty means untextured
+    std::vector<Vertex>     m_vertices;
+    std::vector<UINT32>     m_indices;          // of all of the LODs
+    std::vector<SMeshLod>   m_lods;
+    SMeshlets               m_meshlets;         // of LOD 0
+};
+
+// The binary cache of processed model files, so that loading a model doesn't have to parse the obj and rebuild the
+// tangent frames, meshlets and LODs every time. The cache of "file.obj" is "file.obj.meshcache". It is ignored if the model
+// file's size or write time changed, the load options changed, or the cache format version changed.
+bool MeshCacheLoad (const char* fileName, bool flipV, std::vector<SMeshCacheSubObject>& subObjects);
+
+void MeshCacheSave (const char* fileName, bool flipV, const std::vector<SMeshCacheSubObject>& subObjects);
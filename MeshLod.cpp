@@ -0,0 +1,429 @@
+#include "stdafx.h"
+
+#include "MeshLod.h"
+#include "Model.h"
+#include "Math.h"
+
+#include <cfloat>
+#include <numeric>
+
+// a LOD has to have at most this fraction of the triangles of the previous LOD, else the chain stops there
+static const float c_minReduction = 0.75f;
+
+// collapses that cost more than this fraction of the mesh's bounding radius are never done
+static const float c_maxRelativeError = 0.25f;
+
+// how strongly open borders resist being moved off of their line, compared to surfaces resisting being moved off of
+// their plane
+static const double c_borderWeight = 10.0;
+
+// collapses can't turn a triangle's normal by more than the angle with this cosine, which keeps them from folding over
+static const float c_maxFlipCosine = 0.5f;
+
+enum class EVertexKind : UINT8
+{
+    manifold,   // can collapse into any neighbor
+    border,     // on an open border, can only collapse along the border
+    locked,     // on a seam or non manifold, never collapses
+};
+
+// The sum of squared distances to a set of weighted planes, as p^T A p + 2 b.p + c with A = n n^T, b = d n, c = d d
+struct SQuadric
+{
+    double m_a00 = 0.0, m_a01 = 0.0, m_a02 = 0.0, m_a11 = 0.0, m_a12 = 0.0, m_a22 = 0.0;
+    double m_b0 = 0.0, m_b1 = 0.0, m_b2 = 0.0;
+    double m_c = 0.0;
+    double m_weight = 0.0;
+};
+
+struct SCollapse
+{
+    UINT32  m_from;
+    UINT32  m_to;
+    float   m_cost;
+};
+
+// the memory the simplification passes reuse
+struct SSimplifyScratch
+{
+    std::vector<UINT64>     m_edges;
+    std::vector<UINT32>     m_adjacencyOffsets;
+    std::vector<UINT32>     m_adjacency;
+    std::vector<SCollapse>  m_collapses;
+    std::vector<UINT32>     m_remap;
+    std::vector<UINT8>      m_touched;
+};
+
+static void QuadricAddPlane (SQuadric& quadric, const XMFLOAT3& normal, float distance, double weight)
+{
+    double x = normal.x, y = normal.y, z = normal.z, d = distance;
+    quadric.m_a00 += weight * x * x;
+    quadric.m_a01 += weight * x * y;
+    quadric.m_a02 += weight * x * z;
+    quadric.m_a11 += weight * y * y;
+    quadric.m_a12 += weight * y * z;
+    quadric.m_a22 += weight * z * z;
+    quadric.m_b0 += weight * x * d;
+    quadric.m_b1 += weight * y * d;
+    quadric.m_b2 += weight * z * d;
+    quadric.m_c += weight * d * d;
+    quadric.m_weight += weight;
+}
+
+static void QuadricAdd (SQuadric& quadric, const SQuadric& other)
+{
+    quadric.m_a00 += other.m_a00;
+    quadric.m_a01 += other.m_a01;
+    quadric.m_a02 += other.m_a02;
+    quadric.m_a11 += other.m_a11;
+    quadric.m_a12 += other.m_a12;
+    quadric.m_a22 += other.m_a22;
+    quadric.m_b0 += other.m_b0;
+    quadric.m_b1 += other.m_b1;
+    quadric.m_b2 += other.m_b2;
+    quadric.m_c += other.m_c;
+    quadric.m_weight += other.m_weight;
+}
+
+// the weighted sum of squared distances, not divided by the weight
+static double QuadricEvaluate (const SQuadric& quadric, const XMFLOAT3& position)
+{
+    double x = position.x, y = position.y, z = position.z;
+    return
+        quadric.m_a00 * x * x + quadric.m_a11 * y * y + quadric.m_a22 * z * z +
+        2.0 * (quadric.m_a01 * x * y + quadric.m_a02 * x * z + quadric.m_a12 * y * z) +
+        2.0 * (quadric.m_b0 * x + quadric.m_b1 * y + quadric.m_b2 * z) +
+        quadric.m_c;
+}
+
+// the weighted mean squared distance of the target position to the planes of both vertices
+static float CollapseCost (const SQuadric& from, const SQuadric& to, const XMFLOAT3& position)
+{
+    double weight = from.m_weight + to.m_weight;
+    if (weight <= 0.0)
+        return 0.0f;
+    double error = QuadricEvaluate(from, position) + QuadricEvaluate(to, position);
+    return float(std::max<double>(error, 0.0) / weight);
+}
+
+// makes a sorted list of the directed edges of the triangles
+static void MakeDirectedEdges (const std::vector<UINT32>& indices, std::vector<UINT64>& edges)
+{
+    edges.resize(indices.size());
+    for (size_t triangle = 0; triangle < indices.size() / 3; ++triangle)
+    {
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            UINT32 a = indices[triangle * 3 + corner];
+            UINT32 b = indices[triangle * 3 + (corner + 1) % 3];
+            edges[triangle * 3 + corner] = (UINT64(a) << 32) | b;
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+}
+
+static bool HasEdge (const std::vector<UINT64>& edges, UINT32 a, UINT32 b)
+{
+    return std::binary_search(edges.begin(), edges.end(), (UINT64(a) << 32) | b);
+}
+
+// an edge is open if only one of its two directions is used by a triangle
+static bool IsOpenEdge (const std::vector<UINT64>& edges, UINT32 a, UINT32 b)
+{
+    return HasEdge(edges, a, b) != HasEdge(edges, b, a);
+}
+
+static void ClassifyVertices (const std::vector<Vertex>& vertices, const std::vector<UINT32>& indices, std::vector<EVertexKind>& kinds)
+{
+    kinds.assign(vertices.size(), EVertexKind::manifold);
+
+    // vertices that share their position with other vertices are on a seam
+    std::vector<UINT32> order(vertices.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto positionLess = [&] (UINT32 a, UINT32 b)
+    {
+        const XMFLOAT3& positionA = vertices[a].position;
+        const XMFLOAT3& positionB = vertices[b].position;
+        if (positionA.x != positionB.x)
+            return positionA.x < positionB.x;
+        if (positionA.y != positionB.y)
+            return positionA.y < positionB.y;
+        return positionA.z < positionB.z;
+    };
+    std::sort(order.begin(), order.end(), positionLess);
+    for (size_t i = 0; i + 1 < order.size(); ++i)
+    {
+        if (!positionLess(order[i], order[i + 1]))
+        {
+            kinds[order[i]] = EVertexKind::locked;
+            kinds[order[i + 1]] = EVertexKind::locked;
+        }
+    }
+
+    // a directed edge used more than once is non manifold. A vertex on a simple open border has 2 open edges.
+    std::vector<UINT64> edges;
+    MakeDirectedEdges(indices, edges);
+    std::vector<UINT32> openEdgeCounts(vertices.size(), 0);
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        UINT32 a = UINT32(edges[i] >> 32);
+        UINT32 b = UINT32(edges[i]);
+        if (i + 1 < edges.size() && edges[i] == edges[i + 1])
+        {
+            kinds[a] = EVertexKind::locked;
+            kinds[b] = EVertexKind::locked;
+        }
+        if (!HasEdge(edges, b, a))
+        {
+            openEdgeCounts[a]++;
+            openEdgeCounts[b]++;
+        }
+    }
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        if (kinds[i] == EVertexKind::manifold && openEdgeCounts[i] > 0)
+            kinds[i] = openEdgeCounts[i] == 2 ? EVertexKind::border : EVertexKind::locked;
+    }
+}
+
+// the quadrics of the planes of the triangles around each vertex, plus planes that keep open borders in place
+static void MakeQuadrics (const std::vector<Vertex>& vertices, const std::vector<UINT32>& indices, std::vector<SQuadric>& quadrics)
+{
+    quadrics.assign(vertices.size(), SQuadric());
+
+    std::vector<UINT64> edges;
+    MakeDirectedEdges(indices, edges);
+
+    for (size_t triangle = 0; triangle < indices.size() / 3; ++triangle)
+    {
+        const UINT32* triangleIndices = &indices[triangle * 3];
+        const XMFLOAT3& p0 = vertices[triangleIndices[0]].position;
+        XMFLOAT3 normal = Cross(vertices[triangleIndices[1]].position - p0, vertices[triangleIndices[2]].position - p0);
+        float length = std::sqrtf(Dot(normal, normal));
+        if (length <= 0.0f)
+            continue;
+        normal = normal * (1.0f / length);
+
+        // weighted by area
+        for (size_t corner = 0; corner < 3; ++corner)
+            QuadricAddPlane(quadrics[triangleIndices[corner]], normal, -Dot(normal, p0), length * 0.5);
+
+        // open edges get a plane through the edge, perpendicular to the triangle
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            UINT32 a = triangleIndices[corner];
+            UINT32 b = triangleIndices[(corner + 1) % 3];
+            if (HasEdge(edges, b, a))
+                continue;
+
+            XMFLOAT3 edge = vertices[b].position - vertices[a].position;
+            XMFLOAT3 edgeNormal = Cross(edge, normal);
+            float edgeNormalLength = std::sqrtf(Dot(edgeNormal, edgeNormal));
+            if (edgeNormalLength <= 0.0f)
+                continue;
+            edgeNormal = edgeNormal * (1.0f / edgeNormalLength);
+
+            double weight = double(Dot(edge, edge)) * c_borderWeight;
+            float distance = -Dot(edgeNormal, vertices[a].position);
+            QuadricAddPlane(quadrics[a], edgeNormal, distance, weight);
+            QuadricAddPlane(quadrics[b], edgeNormal, distance, weight);
+        }
+    }
+}
+
+// Does one pass of edge collapses, cheapest first, where no two collapses touch the same triangles. Returns how many
+// triangles were removed, which is 0 when nothing more can be collapsed under maxCost.
+static size_t SimplifyPass (const std::vector<Vertex>& vertices, const std::vector<EVertexKind>& kinds, std::vector<SQuadric>& quadrics, float maxCost,
+                            size_t trianglesToRemove, std::vector<UINT32>& indices, float& maxCollapseCost, SSimplifyScratch& scratch)
+{
+    size_t numTriangles = indices.size() / 3;
+    MakeDirectedEdges(indices, scratch.m_edges);
+
+    // make the vertex -> triangle adjacency
+    scratch.m_adjacencyOffsets.assign(vertices.size() + 1, 0);
+    scratch.m_adjacency.resize(numTriangles * 3);
+    for (UINT32 index : indices)
+        scratch.m_adjacencyOffsets[index + 1]++;
+    for (size_t i = 0; i < vertices.size(); ++i)
+        scratch.m_adjacencyOffsets[i + 1] += scratch.m_adjacencyOffsets[i];
+    {
+        std::vector<UINT32> writeOffsets(scratch.m_adjacencyOffsets.begin(), scratch.m_adjacencyOffsets.end() - 1);
+        for (size_t corner = 0; corner < numTriangles * 3; ++corner)
+            scratch.m_adjacency[writeOffsets[indices[corner]]++] = UINT32(corner / 3);
+    }
+
+    auto canCollapse = [&] (UINT32 from, UINT32 to)
+    {
+        switch (kinds[from])
+        {
+            case EVertexKind::manifold: return true;
+            case EVertexKind::border: return IsOpenEdge(scratch.m_edges, from, to);
+            default: return false;
+        }
+    };
+
+    // find the cheapest direction to collapse each edge in
+    scratch.m_collapses.clear();
+    for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+    {
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            UINT32 a = indices[triangle * 3 + corner];
+            UINT32 b = indices[triangle * 3 + (corner + 1) % 3];
+
+            // edges shared by two triangles are only looked at from one side
+            if (a > b && HasEdge(scratch.m_edges, b, a))
+                continue;
+
+            SCollapse collapse = { a, b, FLT_MAX };
+            if (canCollapse(a, b))
+                collapse.m_cost = CollapseCost(quadrics[a], quadrics[b], vertices[b].position);
+            if (canCollapse(b, a))
+            {
+                float cost = CollapseCost(quadrics[b], quadrics[a], vertices[a].position);
+                if (cost < collapse.m_cost)
+                    collapse = { b, a, cost };
+            }
+            if (collapse.m_cost <= maxCost)
+                scratch.m_collapses.push_back(collapse);
+        }
+    }
+    std::sort(scratch.m_collapses.begin(), scratch.m_collapses.end(), [] (const SCollapse& a, const SCollapse& b) { return a.m_cost < b.m_cost; });
+
+    scratch.m_remap.resize(vertices.size());
+    std::iota(scratch.m_remap.begin(), scratch.m_remap.end(), 0);
+    scratch.m_touched.assign(vertices.size(), 0);
+
+    size_t removed = 0;
+    for (const SCollapse& collapse : scratch.m_collapses)
+    {
+        if (removed >= trianglesToRemove)
+            break;
+        if (scratch.m_touched[collapse.m_from] || scratch.m_touched[collapse.m_to])
+            continue;
+
+        // don't collapse if it would flip or fold over any of the triangles that stay
+        bool flips = false;
+        size_t collapsedTriangles = 0;
+        const XMFLOAT3& target = vertices[collapse.m_to].position;
+        for (UINT32 i = scratch.m_adjacencyOffsets[collapse.m_from]; i < scratch.m_adjacencyOffsets[collapse.m_from + 1] && !flips; ++i)
+        {
+            const UINT32* triangleIndices = &indices[scratch.m_adjacency[i] * 3];
+            if (triangleIndices[0] == collapse.m_to || triangleIndices[1] == collapse.m_to || triangleIndices[2] == collapse.m_to)
+            {
+                ++collapsedTriangles;
+                continue;
+            }
+
+            XMFLOAT3 before[3], after[3];
+            for (size_t corner = 0; corner < 3; ++corner)
+            {
+                before[corner] = vertices[triangleIndices[corner]].position;
+                after[corner] = triangleIndices[corner] == collapse.m_from ? target : before[corner];
+            }
+            XMFLOAT3 normalBefore = Cross(before[1] - before[0], before[2] - before[0]);
+            XMFLOAT3 normalAfter = Cross(after[1] - after[0], after[2] - after[0]);
+            flips = Dot(normalBefore, normalAfter) <= c_maxFlipCosine * std::sqrtf(Dot(normalBefore, normalBefore) * Dot(normalAfter, normalAfter));
+        }
+        if (flips)
+            continue;
+
+        scratch.m_remap[collapse.m_from] = collapse.m_to;
+        QuadricAdd(quadrics[collapse.m_to], quadrics[collapse.m_from]);
+        maxCollapseCost = std::max<float>(maxCollapseCost, collapse.m_cost);
+        removed += collapsedTriangles;
+
+        // the triangles around the collapsed vertex changed, so nothing else touches them this pass
+        for (UINT32 i = scratch.m_adjacencyOffsets[collapse.m_from]; i < scratch.m_adjacencyOffsets[collapse.m_from + 1]; ++i)
+        {
+            const UINT32* triangleIndices = &indices[scratch.m_adjacency[i] * 3];
+            scratch.m_touched[triangleIndices[0]] = 1;
+            scratch.m_touched[triangleIndices[1]] = 1;
+            scratch.m_touched[triangleIndices[2]] = 1;
+        }
+    }
+
+    if (removed == 0)
+        return 0;
+
+    // apply the collapses and remove the triangles that became degenerate
+    size_t writeIndex = 0;
+    for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+    {
+        UINT32 a = scratch.m_remap[indices[triangle * 3 + 0]];
+        UINT32 b = scratch.m_remap[indices[triangle * 3 + 1]];
+        UINT32 c = scratch.m_remap[indices[triangle * 3 + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        indices[writeIndex++] = a;
+        indices[writeIndex++] = b;
+        indices[writeIndex++] = c;
+    }
+    indices.resize(writeIndex);
+    return removed;
+}
+
+void MeshLodBuild (const std::vector<Vertex>& vertices, std::vector<UINT32>& indices, std::vector<SMeshLod>& lods)
+{
+    size_t numIndices = (indices.size() / 3) * 3;
+    lods.clear();
+    lods.push_back({ 0, UINT32(numIndices), 0.0f });
+    if (numIndices == 0 || vertices.empty())
+        return;
+
+    std::vector<UINT32> current(indices.begin(), indices.begin() + numIndices);
+
+    std::vector<EVertexKind> kinds;
+    ClassifyVertices(vertices, current, kinds);
+
+    std::vector<SQuadric> quadrics;
+    MakeQuadrics(vertices, current, quadrics);
+
+    // the costs are squared distances
+    XMFLOAT3 boxMin = vertices[0].position;
+    XMFLOAT3 boxMax = boxMin;
+    for (const Vertex& vertex : vertices)
+    {
+        boxMin = XMFLOAT3(std::min<float>(boxMin.x, vertex.position.x), std::min<float>(boxMin.y, vertex.position.y), std::min<float>(boxMin.z, vertex.position.z));
+        boxMax = XMFLOAT3(std::max<float>(boxMax.x, vertex.position.x), std::max<float>(boxMax.y, vertex.position.y), std::max<float>(boxMax.z, vertex.position.z));
+    }
+    XMFLOAT3 halfSize = (boxMax - boxMin) * 0.5f;
+    float maxError = std::sqrtf(Dot(halfSize, halfSize)) * c_maxRelativeError;
+    float maxCost = maxError * maxError;
+
+    SSimplifyScratch scratch;
+    float maxCollapseCost = 0.0f;
+    while (lods.size() < c_meshLodMaxLods)
+    {
+        size_t previousTriangles = lods.back().m_indexCount / 3;
+        size_t targetTriangles = previousTriangles / 2;
+
+        while (current.size() / 3 > targetTriangles)
+        {
+            if (SimplifyPass(vertices, kinds, quadrics, maxCost, current.size() / 3 - targetTriangles, current, maxCollapseCost, scratch) == 0)
+                break;
+        }
+
+        if (float(current.size() / 3) > float(previousTriangles) * c_minReduction)
+            break;
+
+        lods.push_back({ UINT32(indices.size()), UINT32(current.size()), std::sqrtf(maxCollapseCost) });
+        indices.insert(indices.end(), current.begin(), current.end());
+    }
+}
+
+float MeshLodPixelsPerUnit (float projectionScaleY, float viewHeight, float objectScale, float distance)
+{
+    return projectionScaleY * viewHeight * 0.5f * objectScale / std::max<float>(distance, 1e-6f);
+}
+
+size_t MeshLodSelect (const std::vector<SMeshLod>& lods, float pixelsPerUnit)
+{
+    for (size_t i = lods.size(); i > 1; --i)
+    {
+        if (lods[i - 1].m_error * pixelsPerUnit <= c_meshLodMaxPixelError)
+            return i - 1;
+    }
+    return 0;
+}
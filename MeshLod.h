@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+struct Vertex;
+
+static const size_t c_meshLodMaxLods = 5;
+
+// how many pixels of geometric error a LOD is allowed to have on screen before a more detailed one is used
+static const float c_meshLodMaxPixelError = 1.0f;
+
+// One level of detail of a mesh. The LODs of a mesh all use the same vertex buffer, and their index ranges are stored
+// one after the other in the same index buffer.
+struct SMeshLod
+{
+    UINT32  m_indexOffset;
+    UINT32  m_indexCount;
+    float   m_error;        // how far the LOD can be from the original surface, in object space units
+};
+
+// Makes a chain of simplified versions of an indexed triangle list with a quadric error metric simplifier, halving the
+// triangle count each step. The simplified index lists are appended to indices, and lods is filled out with LOD 0
+// being the original triangles. The chain stops early when a mesh can't be simplified much more without too much
+// error, so small meshes may only have LOD 0.
+// Simplification only ever collapses a vertex into one of its neighbors, so no new vertices are made. Vertices that
+// share their position with other vertices (uv and normal seams) are never moved, and vertices on open borders only
+// move along the border, so seams and borders stay intact.
+void MeshLodBuild (const std::vector<Vertex>& vertices, std::vector<UINT32>& indices, std::vector<SMeshLod>& lods);
+
+// How many pixels one object space unit covers at a distance from the camera. projectionScaleY is element [1][1] of
+// the projection matrix, and objectScale is the largest axis scale of the object to world matrix.
+float MeshLodPixelsPerUnit (float projectionScaleY, float viewHeight, float objectScale, float distance);
+
+// Returns the least detailed LOD whose error is at most c_meshLodMaxPixelError pixels on screen
+size_t MeshLodSelect (const std::vector<SMeshLod>& lods, float pixelsPerUnit);
@@ -0,0 +1,406 @@
+#include "stdafx.h"
+
+#include "MeshProcessing.h"
+#include "Math.h"
+#include "Threading.h"
+
+#include <unordered_map>
+#include <xmmintrin.h>
+
+// how many triangles / vertices each ParallelFor batch works on. Triangle batches must be a multiple of 4 for the SIMD kernel.
+static const size_t c_triangleBatchSize = 4096;
+static const size_t c_vertexBatchSize = 4096;
+
+// squared lengths and uv determinants smaller than this are treated as degenerate
+static const float c_epsilon = 1e-30f;
+
+//=================================================================================================================================
+// Welding
+//=================================================================================================================================
+
+// the parts of a vertex that make it unique, compared bitwise
+template <size_t NUMFLOATS>
+struct SWeldKey
+{
+    float m_data[NUMFLOATS];
+
+    bool operator == (const SWeldKey& other) const
+    {
+        return memcmp(m_data, other.m_data, sizeof(m_data)) == 0;
+    }
+};
+
+template <size_t NUMFLOATS>
+struct SWeldKeyHash
+{
+    size_t operator () (const SWeldKey<NUMFLOATS>& key) const
+    {
+        // FNV-1a
+        const unsigned char* bytes = (const unsigned char*)key.m_data;
+        size_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(key.m_data); ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+void MeshWeldVertices (const std::vector<Vertex>& triangleVertices, std::vector<Vertex>& vertices, std::vector<UINT32>& indices)
+{
+    typedef SWeldKey<8> TKey;
+    std::unordered_map<TKey, UINT32, SWeldKeyHash<8>> vertexMap;
+    vertexMap.reserve(triangleVertices.size());
+
+    vertices.clear();
+    indices.resize(triangleVertices.size());
+
+    for (size_t i = 0; i < triangleVertices.size(); ++i)
+    {
+        const Vertex& vertex = triangleVertices[i];
+
+        TKey key;
+        memcpy(&key.m_data[0], &vertex.position, sizeof(vertex.position));
+        memcpy(&key.m_data[3], &vertex.normal, sizeof(vertex.normal));
+        memcpy(&key.m_data[6], &vertex.uv, sizeof(vertex.uv));
+
+        auto it = vertexMap.insert(std::make_pair(key, UINT32(vertices.size())));
+        if (it.second)
+            vertices.push_back(vertex);
+        indices[i] = it.first->second;
+    }
+}
+
+//=================================================================================================================================
+// SIMD triangle kernel
+//=================================================================================================================================
+
+// the vertex data the triangle kernel reads, as structure of arrays
+struct SVertexSoA
+{
+    std::vector<float> m_positionX;
+    std::vector<float> m_positionY;
+    std::vector<float> m_positionZ;
+    std::vector<float> m_u;
+    std::vector<float> m_v;
+};
+
+// the per triangle data the triangle kernel writes, as structure of arrays.
+// The normal, tangent and bitangent are scaled by twice the triangle's area.
+struct STriangleSoA
+{
+    std::vector<float> m_normal[3];
+    std::vector<float> m_tangent[3];
+    std::vector<float> m_bitangent[3];
+    std::vector<float> m_angle[3];
+};
+
+// 4 vectors, one per SIMD lane
+struct SVec3x4
+{
+    __m128 x, y, z;
+};
+
+static inline SVec3x4 Sub (const SVec3x4& a, const SVec3x4& b)
+{
+    return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+}
+
+static inline SVec3x4 Scale (const SVec3x4& a, __m128 b)
+{
+    return { _mm_mul_ps(a.x, b), _mm_mul_ps(a.y, b), _mm_mul_ps(a.z, b) };
+}
+
+static inline SVec3x4 Cross (const SVec3x4& a, const SVec3x4& b)
+{
+    return {
+        _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+        _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+        _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+    };
+}
+
+static inline __m128 Dot (const SVec3x4& a, const SVec3x4& b)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+// Abramowitz and Stegun 4.4.45. The max error of about 7e-5 radians is plenty for a weighting factor.
+static inline __m128 Acos (__m128 x)
+{
+    __m128 absX = _mm_min_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x), _mm_set1_ps(1.0f));
+    __m128 poly = _mm_set1_ps(-0.0187293f);
+    poly = _mm_add_ps(_mm_mul_ps(poly, absX), _mm_set1_ps(0.0742610f));
+    poly = _mm_add_ps(_mm_mul_ps(poly, absX), _mm_set1_ps(-0.2121144f));
+    poly = _mm_add_ps(_mm_mul_ps(poly, absX), _mm_set1_ps(1.5707288f));
+    __m128 ret = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absX)), poly);
+
+    __m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+    return _mm_or_ps(_mm_andnot_ps(negative, ret), _mm_and_ps(negative, _mm_sub_ps(_mm_set1_ps(c_pi), ret)));
+}
+
+// the angle between two vectors, or zero if either is degenerate
+static inline __m128 AngleBetween (const SVec3x4& a, const SVec3x4& b)
+{
+    __m128 lengthSquaredProduct = _mm_mul_ps(Dot(a, a), Dot(b, b));
+    __m128 valid = _mm_cmpgt_ps(lengthSquaredProduct, _mm_set1_ps(c_epsilon));
+    __m128 cosAngle = _mm_div_ps(Dot(a, b), _mm_sqrt_ps(_mm_max_ps(lengthSquaredProduct, _mm_set1_ps(c_epsilon))));
+    return _mm_and_ps(valid, Acos(cosAngle));
+}
+
+// returns a * (length / |a|), or zero where a is degenerate or the mask is clear
+static inline SVec3x4 SetLength (const SVec3x4& a, __m128 length, __m128 mask)
+{
+    __m128 lengthSquared = Dot(a, a);
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(lengthSquared, _mm_set1_ps(c_epsilon)));
+    __m128 scale = _mm_and_ps(mask, _mm_div_ps(length, _mm_sqrt_ps(_mm_max_ps(lengthSquared, _mm_set1_ps(c_epsilon)))));
+    return Scale(a, scale);
+}
+
+static inline __m128 Gather (const std::vector<float>& values, const UINT32 index[4])
+{
+    return _mm_setr_ps(values[index[0]], values[index[1]], values[index[2]], values[index[3]]);
+}
+
+// Calculates the area weighted normal, tangent and bitangent, and the corner angles, of 4 triangles at once.
+// Lanes past the last triangle repeat the last triangle and are written into the padding at the end of the output.
+static void TriangleKernel (const SVertexSoA& vertices, const std::vector<UINT32>& indices, size_t firstTriangle, STriangleSoA& triangles)
+{
+    size_t lastTriangle = indices.size() / 3 - 1;
+
+    UINT32 corners[3][4];
+    for (size_t lane = 0; lane < 4; ++lane)
+    {
+        size_t triangle = std::min<size_t>(firstTriangle + lane, lastTriangle);
+        for (size_t corner = 0; corner < 3; ++corner)
+            corners[corner][lane] = indices[triangle * 3 + corner];
+    }
+
+    SVec3x4 positions[3];
+    __m128 u[3];
+    __m128 v[3];
+    for (size_t corner = 0; corner < 3; ++corner)
+    {
+        positions[corner] = { Gather(vertices.m_positionX, corners[corner]), Gather(vertices.m_positionY, corners[corner]), Gather(vertices.m_positionZ, corners[corner]) };
+        u[corner] = Gather(vertices.m_u, corners[corner]);
+        v[corner] = Gather(vertices.m_v, corners[corner]);
+    }
+
+    SVec3x4 edge01 = Sub(positions[1], positions[0]);
+    SVec3x4 edge02 = Sub(positions[2], positions[0]);
+    SVec3x4 edge12 = Sub(positions[2], positions[1]);
+    SVec3x4 edge10 = Sub(positions[0], positions[1]);
+
+    // the length of the cross product is twice the area of the triangle
+    SVec3x4 normal = Cross(edge02, edge01);
+    __m128 doubleArea = _mm_sqrt_ps(Dot(normal, normal));
+
+    __m128 angle0 = AngleBetween(edge01, edge02);
+    __m128 angle1 = AngleBetween(edge10, edge12);
+    __m128 angle2 = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(c_pi), angle0), angle1), _mm_setzero_ps());
+
+    // the tangent and bitangent point along increasing u and v. The sign of the uv determinant is applied instead of dividing
+    // by it since they get normalized anyways.
+    __m128 du1 = _mm_sub_ps(u[1], u[0]);
+    __m128 dv1 = _mm_sub_ps(v[1], v[0]);
+    __m128 du2 = _mm_sub_ps(u[2], u[0]);
+    __m128 dv2 = _mm_sub_ps(v[2], v[0]);
+    __m128 determinant = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+    __m128 determinantSign = _mm_and_ps(determinant, _mm_set1_ps(-0.0f));
+    __m128 uvValid = _mm_cmpgt_ps(_mm_mul_ps(determinant, determinant), _mm_set1_ps(c_epsilon));
+
+    SVec3x4 tangent = Sub(Scale(edge01, _mm_xor_ps(dv2, determinantSign)), Scale(edge02, _mm_xor_ps(dv1, determinantSign)));
+    SVec3x4 bitangent = Sub(Scale(edge02, _mm_xor_ps(du1, determinantSign)), Scale(edge01, _mm_xor_ps(du2, determinantSign)));
+    tangent = SetLength(tangent, doubleArea, uvValid);
+    bitangent = SetLength(bitangent, doubleArea, uvValid);
+
+    _mm_storeu_ps(&triangles.m_normal[0][firstTriangle], normal.x);
+    _mm_storeu_ps(&triangles.m_normal[1][firstTriangle], normal.y);
+    _mm_storeu_ps(&triangles.m_normal[2][firstTriangle], normal.z);
+    _mm_storeu_ps(&triangles.m_tangent[0][firstTriangle], tangent.x);
+    _mm_storeu_ps(&triangles.m_tangent[1][firstTriangle], tangent.y);
+    _mm_storeu_ps(&triangles.m_tangent[2][firstTriangle], tangent.z);
+    _mm_storeu_ps(&triangles.m_bitangent[0][firstTriangle], bitangent.x);
+    _mm_storeu_ps(&triangles.m_bitangent[1][firstTriangle], bitangent.y);
+    _mm_storeu_ps(&triangles.m_bitangent[2][firstTriangle], bitangent.z);
+    _mm_storeu_ps(&triangles.m_angle[0][firstTriangle], angle0);
+    _mm_storeu_ps(&triangles.m_angle[1][firstTriangle], angle1);
+    _mm_storeu_ps(&triangles.m_angle[2][firstTriangle], angle2);
+}
+
+//=================================================================================================================================
+// Tangent space
+//=================================================================================================================================
+
+// For each vertex (or group of vertices), the list of triangle corners touching it, stored contiguously.
+// A corner is triangleIndex * 3 + cornerIndex. This turns the scatter of triangle data to vertices into a gather,
+// so that vertices can be reduced in parallel without atomics and with a deterministic summation order.
+struct SAdjacency
+{
+    std::vector<UINT32> m_offsets;
+    std::vector<UINT32> m_corners;
+};
+
+// vertexGroups maps vertices to groups. If it is empty, each vertex is its own group.
+static void BuildAdjacency (const std::vector<UINT32>& indices, const std::vector<UINT32>& vertexGroups, size_t numGroups, SAdjacency& adjacency)
+{
+    auto group = [&] (size_t corner)
+    {
+        return vertexGroups.empty() ? indices[corner] : vertexGroups[indices[corner]];
+    };
+
+    // any indices past the last whole triangle are ignored
+    size_t numCorners = (indices.size() / 3) * 3;
+
+    adjacency.m_offsets.assign(numGroups + 1, 0);
+    for (size_t corner = 0; corner < numCorners; ++corner)
+        adjacency.m_offsets[group(corner) + 1]++;
+
+    for (size_t i = 0; i < numGroups; ++i)
+        adjacency.m_offsets[i + 1] += adjacency.m_offsets[i];
+
+    std::vector<UINT32> writeOffsets(adjacency.m_offsets.begin(), adjacency.m_offsets.end() - 1);
+    adjacency.m_corners.resize(numCorners);
+    for (size_t corner = 0; corner < numCorners; ++corner)
+        adjacency.m_corners[writeOffsets[group(corner)]++] = UINT32(corner);
+}
+
+// sums the angle weighted per triangle vectors of the corners of a group
+static XMFLOAT3 SumCorners (const SAdjacency& adjacency, size_t group, const STriangleSoA& triangles, const std::vector<float> (&values)[3])
+{
+    XMFLOAT3 sum = { 0.0f, 0.0f, 0.0f };
+    for (UINT32 i = adjacency.m_offsets[group]; i < adjacency.m_offsets[group + 1]; ++i)
+    {
+        UINT32 triangle = adjacency.m_corners[i] / 3;
+        float weight = triangles.m_angle[adjacency.m_corners[i] % 3][triangle];
+        sum.x += values[0][triangle] * weight;
+        sum.y += values[1][triangle] * weight;
+        sum.z += values[2][triangle] * weight;
+    }
+    return sum;
+}
+
+// any unit vector perpendicular to the given unit vector
+static XMFLOAT3 MakePerpendicular (const XMFLOAT3& v)
+{
+    XMFLOAT3 axis = (std::fabs(v.x) < std::fabs(v.y) && std::fabs(v.x) < std::fabs(v.z)) ? XMFLOAT3(1.0f, 0.0f, 0.0f)
+                  : (std::fabs(v.y) < std::fabs(v.z)) ? XMFLOAT3(0.0f, 1.0f, 0.0f) : XMFLOAT3(0.0f, 0.0f, 1.0f);
+    XMFLOAT3 ret = Cross(v, axis);
+    Normalize(ret);
+    return ret;
+}
+
+void MeshCalculateTangentSpace (std::vector<Vertex>& vertices, const std::vector<UINT32>& indices, bool calculateNormals, size_t numThreads)
+{
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles == 0)
+        return;
+
+    // convert the vertices to SoA for the SIMD kernel
+    SVertexSoA vertexSoA;
+    vertexSoA.m_positionX.resize(vertices.size());
+    vertexSoA.m_positionY.resize(vertices.size());
+    vertexSoA.m_positionZ.resize(vertices.size());
+    vertexSoA.m_u.resize(vertices.size());
+    vertexSoA.m_v.resize(vertices.size());
+    ParallelFor(vertices.size(), c_vertexBatchSize,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                vertexSoA.m_positionX[i] = vertices[i].position.x;
+                vertexSoA.m_positionY[i] = vertices[i].position.y;
+                vertexSoA.m_positionZ[i] = vertices[i].position.z;
+                vertexSoA.m_u[i] = vertices[i].uv.x;
+                vertexSoA.m_v[i] = vertices[i].uv.y;
+            }
+        },
+        numThreads
+    );
+
+    // run the SIMD kernel over the triangles. The outputs are padded to a multiple of 4 triangles.
+    STriangleSoA triangles;
+    size_t numTrianglesPadded = (numTriangles + 3) & ~size_t(3);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        triangles.m_normal[i].resize(numTrianglesPadded);
+        triangles.m_tangent[i].resize(numTrianglesPadded);
+        triangles.m_bitangent[i].resize(numTrianglesPadded);
+        triangles.m_angle[i].resize(numTrianglesPadded);
+    }
+    ParallelFor(numTriangles, c_triangleBatchSize,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t triangle = begin; triangle < end; triangle += 4)
+                TriangleKernel(vertexSoA, indices, triangle, triangles);
+        },
+        numThreads
+    );
+
+    // Normals are shared by all vertices at the same position, so they are gathered per position group.
+    std::vector<XMFLOAT3> groupNormals;
+    std::vector<UINT32> vertexGroups;
+    if (calculateNormals)
+    {
+        typedef SWeldKey<3> TKey;
+        std::unordered_map<TKey, UINT32, SWeldKeyHash<3>> groupMap;
+        groupMap.reserve(vertices.size());
+        vertexGroups.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            TKey key;
+            memcpy(key.m_data, &vertices[i].position, sizeof(vertices[i].position));
+            vertexGroups[i] = groupMap.insert(std::make_pair(key, UINT32(groupMap.size()))).first->second;
+        }
+
+        SAdjacency groupAdjacency;
+        BuildAdjacency(indices, vertexGroups, groupMap.size(), groupAdjacency);
+
+        groupNormals.resize(groupMap.size());
+        ParallelFor(groupNormals.size(), c_vertexBatchSize,
+            [&] (size_t begin, size_t end)
+            {
+                for (size_t group = begin; group < end; ++group)
+                    groupNormals[group] = SumCorners(groupAdjacency, group, triangles, triangles.m_normal);
+            },
+            numThreads
+        );
+    }
+
+    // gather the tangents and bitangents per vertex and make the final orthonormal tangent frames
+    SAdjacency vertexAdjacency;
+    BuildAdjacency(indices, std::vector<UINT32>(), vertices.size(), vertexAdjacency);
+    ParallelFor(vertices.size(), c_vertexBatchSize,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Vertex& vertex = vertices[i];
+
+                XMFLOAT3 normal = calculateNormals ? groupNormals[vertexGroups[i]] : vertex.normal;
+                if (Dot(normal, normal) > c_epsilon)
+                    Normalize(normal);
+                else
+                    normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+                if (calculateNormals)
+                    vertex.normal = normal;
+
+                // Gram-Schmidt orthogonalize the tangent against the normal
+                XMFLOAT3 tangent = SumCorners(vertexAdjacency, i, triangles, triangles.m_tangent);
+                tangent = tangent - normal * Dot(normal, tangent);
+                if (Dot(tangent, tangent) > c_epsilon)
+                    Normalize(tangent);
+                else
+                    tangent = MakePerpendicular(normal);
+
+                // the handedness says whether the bitangent is cross(normal, tangent) or the opposite
+                XMFLOAT3 bitangent = SumCorners(vertexAdjacency, i, triangles, triangles.m_bitangent);
+                float handedness = Dot(Cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+
+                vertex.tangent = XMFLOAT4(tangent.x, tangent.y, tangent.z, handedness);
+            }
+        },
+        numThreads
+    );
+}
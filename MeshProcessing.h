@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+#include "Model.h"
+
+// Welds identical vertices of a triangle list together, making an indexed triangle list.
+// The tangents are ignored when comparing vertices, since they are calculated after welding.
+void MeshWeldVertices (const std::vector<Vertex>& triangleVertices, std::vector<Vertex>& vertices, std::vector<UINT32>& indices);
+
+// Calculates smooth tangent frames for an indexed triangle list. Each triangle contributes to the vertices it touches,
+// weighted by the triangle's area and the angle of the triangle at that vertex. The tangent is Gram-Schmidt
+// orthogonalized against the normal, and tangent.w holds the handedness of the bitangent (+1 or -1), so that
+// bitangent = cross(normal, tangent.xyz) * tangent.w.
+// If calculateNormals is true, normals are also calculated and are shared by all vertices at the same position, so
+// uv seams don't show up as lighting seams.
+// numThreads of 0 means use all hardware threads.
+void MeshCalculateTangentSpace (std::vector<Vertex>& vertices, const std::vector<UINT32>& indices, bool calculateNormals, size_t numThreads = 0);
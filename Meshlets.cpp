@@ -0,0 +1,274 @@
+#include "stdafx.h"
+
+#include "Meshlets.h"
+#include "Model.h"
+#include "Math.h"
+
+#include <cfloat>
+
+// how much a candidate triangle bending the normal cone counts against it, compared to it adding one new vertex
+static const float c_coneWeight = 0.5f;
+
+static const UINT8 c_notInMeshlet = 0xFF;
+
+// the outward facing unit normal of a triangle, or zero if it is degenerate
+static XMFLOAT3 TriangleNormal (const std::vector<Vertex>& vertices, UINT32 index0, UINT32 index1, UINT32 index2)
+{
+    XMFLOAT3 normal = Cross(vertices[index2].position - vertices[index0].position, vertices[index1].position - vertices[index0].position);
+    if (Dot(normal, normal) > 0.0f)
+        Normalize(normal);
+    return normal;
+}
+
+// calculates the bounding sphere and normal cone of a meshlet, using the same cone construction as meshoptimizer
+static void CalculateMeshletBounds (const std::vector<Vertex>& vertices, const SMeshlets& meshlets, SMeshlet& meshlet)
+{
+    const UINT32* meshletVertices = &meshlets.m_vertices[meshlet.m_vertexOffset];
+    const UINT8* meshletTriangles = &meshlets.m_triangles[meshlet.m_triangleOffset * 3];
+
+    // bounding sphere around the center of the bounding box
+    XMFLOAT3 boxMin = vertices[meshletVertices[0]].position;
+    XMFLOAT3 boxMax = boxMin;
+    for (UINT32 i = 1; i < meshlet.m_vertexCount; ++i)
+    {
+        const XMFLOAT3& position = vertices[meshletVertices[i]].position;
+        boxMin = XMFLOAT3(std::min<float>(boxMin.x, position.x), std::min<float>(boxMin.y, position.y), std::min<float>(boxMin.z, position.z));
+        boxMax = XMFLOAT3(std::max<float>(boxMax.x, position.x), std::max<float>(boxMax.y, position.y), std::max<float>(boxMax.z, position.z));
+    }
+    meshlet.m_center = (boxMin + boxMax) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (UINT32 i = 0; i < meshlet.m_vertexCount; ++i)
+    {
+        XMFLOAT3 offset = vertices[meshletVertices[i]].position - meshlet.m_center;
+        radiusSquared = std::max<float>(radiusSquared, Dot(offset, offset));
+    }
+    meshlet.m_radius = std::sqrtf(radiusSquared);
+
+    // the cone axis is the average triangle normal
+    std::vector<XMFLOAT3> normals(meshlet.m_triangleCount);
+    XMFLOAT3 axis = { 0.0f, 0.0f, 0.0f };
+    for (UINT32 i = 0; i < meshlet.m_triangleCount; ++i)
+    {
+        normals[i] = TriangleNormal(vertices, meshletVertices[meshletTriangles[i * 3 + 0]], meshletVertices[meshletTriangles[i * 3 + 1]], meshletVertices[meshletTriangles[i * 3 + 2]]);
+        axis = axis + normals[i];
+    }
+
+    meshlet.m_coneApex = meshlet.m_center;
+    meshlet.m_coneAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    meshlet.m_coneCutoff = 1.0f;
+    if (Dot(axis, axis) <= 0.0f)
+        return;
+    Normalize(axis);
+
+    float minDot = 1.0f;
+    for (const XMFLOAT3& normal : normals)
+    {
+        if (Dot(normal, normal) > 0.0f)
+            minDot = std::min<float>(minDot, Dot(normal, axis));
+    }
+
+    // if the normals are spread over more than a hemisphere the meshlet can't be cone culled
+    if (minDot <= 0.0f)
+        return;
+
+    // put the apex on the axis, behind all of the triangle planes
+    float maxT = 0.0f;
+    for (UINT32 i = 0; i < meshlet.m_triangleCount; ++i)
+    {
+        if (Dot(normals[i], normals[i]) <= 0.0f)
+            continue;
+        const XMFLOAT3& position = vertices[meshletVertices[meshletTriangles[i * 3]]].position;
+        float t = Dot(meshlet.m_center - position, normals[i]) / Dot(axis, normals[i]);
+        maxT = std::max<float>(maxT, t);
+    }
+
+    // the cone of view directions that see only back faces is the normal cone widened by 90 degrees and inverted,
+    // so the cutoff is -cos(angle + 90) = sin(angle)
+    meshlet.m_coneApex = meshlet.m_center - axis * maxT;
+    meshlet.m_coneAxis = axis;
+    meshlet.m_coneCutoff = std::sqrtf(1.0f - minDot * minDot);
+}
+
+void MeshletsBuild (const std::vector<Vertex>& vertices, const std::vector<UINT32>& indices, SMeshlets& meshlets)
+{
+    meshlets.m_meshlets.clear();
+    meshlets.m_vertices.clear();
+    meshlets.m_triangles.clear();
+
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles == 0)
+        return;
+
+    std::vector<XMFLOAT3> triangleNormals(numTriangles);
+    for (size_t triangle = 0; triangle < numTriangles; ++triangle)
+        triangleNormals[triangle] = TriangleNormal(vertices, indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2]);
+
+    // make the vertex -> triangle adjacency
+    std::vector<UINT32> adjacencyOffsets(vertices.size() + 1, 0);
+    std::vector<UINT32> adjacency(numTriangles * 3);
+    for (size_t corner = 0; corner < numTriangles * 3; ++corner)
+        adjacencyOffsets[indices[corner] + 1]++;
+    for (size_t i = 0; i < vertices.size(); ++i)
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    {
+        std::vector<UINT32> writeOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t corner = 0; corner < numTriangles * 3; ++corner)
+            adjacency[writeOffsets[indices[corner]]++] = UINT32(corner / 3);
+    }
+
+    std::vector<UINT8> triangleUsed(numTriangles, 0);
+    std::vector<UINT8> localIndex(vertices.size(), c_notInMeshlet);
+
+    // the unused neighbors of the meshlet being built. The stamp keeps a triangle from being added twice per meshlet.
+    std::vector<UINT32> candidates;
+    std::vector<UINT32> candidateStamp(numTriangles, UINT32(-1));
+
+    SMeshlet meshlet = {};
+    XMFLOAT3 normalSum = { 0.0f, 0.0f, 0.0f };
+    size_t nextSeed = 0;
+
+    auto countNewVertices = [&] (size_t triangle)
+    {
+        size_t ret = 0;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            if (localIndex[indices[triangle * 3 + corner]] == c_notInMeshlet)
+                ++ret;
+        }
+        return ret;
+    };
+
+    auto finishMeshlet = [&] ()
+    {
+        if (meshlet.m_triangleCount == 0)
+            return;
+
+        for (UINT32 i = 0; i < meshlet.m_vertexCount; ++i)
+            localIndex[meshlets.m_vertices[meshlet.m_vertexOffset + i]] = c_notInMeshlet;
+
+        CalculateMeshletBounds(vertices, meshlets, meshlet);
+        meshlets.m_meshlets.push_back(meshlet);
+
+        meshlet = {};
+        meshlet.m_vertexOffset = UINT32(meshlets.m_vertices.size());
+        meshlet.m_triangleOffset = UINT32(meshlets.m_triangles.size() / 3);
+        normalSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+        candidates.clear();
+    };
+
+    auto addTriangle = [&] (size_t triangle)
+    {
+        triangleUsed[triangle] = 1;
+        for (size_t corner = 0; corner < 3; ++corner)
+        {
+            UINT32 vertex = indices[triangle * 3 + corner];
+            if (localIndex[vertex] == c_notInMeshlet)
+            {
+                localIndex[vertex] = UINT8(meshlet.m_vertexCount++);
+                meshlets.m_vertices.push_back(vertex);
+
+                // the neighbors of new vertices become candidates
+                UINT32 stamp = UINT32(meshlets.m_meshlets.size());
+                for (UINT32 i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; ++i)
+                {
+                    UINT32 neighbor = adjacency[i];
+                    if (!triangleUsed[neighbor] && candidateStamp[neighbor] != stamp)
+                    {
+                        candidateStamp[neighbor] = stamp;
+                        candidates.push_back(neighbor);
+                    }
+                }
+            }
+            meshlets.m_triangles.push_back(localIndex[vertex]);
+        }
+        meshlet.m_triangleCount++;
+        normalSum = normalSum + triangleNormals[triangle];
+    };
+
+    for (size_t remaining = numTriangles; remaining > 0; --remaining)
+    {
+        XMFLOAT3 coneAxis = normalSum;
+        if (Dot(coneAxis, coneAxis) > 0.0f)
+            Normalize(coneAxis);
+
+        // find the candidate that fits and adds the fewest vertices, preferring ones that agree with the normal cone.
+        // Used candidates get removed along the way.
+        size_t best = numTriangles;
+        float bestScore = FLT_MAX;
+        size_t writeIndex = 0;
+        for (size_t readIndex = 0; readIndex < candidates.size(); ++readIndex)
+        {
+            UINT32 triangle = candidates[readIndex];
+            if (triangleUsed[triangle])
+                continue;
+            candidates[writeIndex++] = triangle;
+
+            size_t newVertices = countNewVertices(triangle);
+            if (meshlet.m_vertexCount + newVertices > c_meshletMaxVertices)
+                continue;
+
+            float score = float(newVertices) + (1.0f - Dot(triangleNormals[triangle], coneAxis)) * c_coneWeight;
+            if (score < bestScore || (score == bestScore && triangle < best))
+            {
+                best = triangle;
+                bestScore = score;
+            }
+        }
+        candidates.resize(writeIndex);
+
+        // if no neighbor fits, continue with the next unused triangle in index order
+        if (best == numTriangles)
+        {
+            while (triangleUsed[nextSeed])
+                ++nextSeed;
+            best = nextSeed;
+
+            if (meshlet.m_vertexCount + countNewVertices(best) > c_meshletMaxVertices)
+                finishMeshlet();
+        }
+
+        addTriangle(best);
+
+        if (meshlet.m_triangleCount == c_meshletMaxTriangles)
+            finishMeshlet();
+    }
+    finishMeshlet();
+}
+
+void MeshletsCull (const SMeshlets& meshlets, const XMMATRIX& objectToWorld, const SFrustum& frustum, const XMFLOAT3& cameraPosition,
+                   std::vector<UINT32>& visibleMeshlets, SMeshletCullStats& stats)
+{
+    // the radius scales by the largest axis scale
+    float scale = std::max<float>(std::max<float>(XMVectorGetX(XMVector3Length(objectToWorld.r[0])), XMVectorGetX(XMVector3Length(objectToWorld.r[1]))), XMVectorGetX(XMVector3Length(objectToWorld.r[2])));
+    XMVECTOR camera = XMLoadFloat3(&cameraPosition);
+
+    for (size_t i = 0; i < meshlets.m_meshlets.size(); ++i)
+    {
+        const SMeshlet& meshlet = meshlets.m_meshlets[i];
+        stats.m_meshletsTested++;
+        stats.m_trianglesTested += meshlet.m_triangleCount;
+
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&meshlet.m_center), objectToWorld));
+        if (!FrustumTestSphere(frustum, center, meshlet.m_radius * scale))
+        {
+            stats.m_meshletsFrustumCulled++;
+            continue;
+        }
+
+        if (meshlet.m_coneCutoff < 1.0f)
+        {
+            XMVECTOR apex = XMVector3TransformCoord(XMLoadFloat3(&meshlet.m_coneApex), objectToWorld);
+            XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&meshlet.m_coneAxis), objectToWorld));
+            if (XMVectorGetX(XMVector3Dot(XMVector3Normalize(XMVectorSubtract(apex, camera)), axis)) >= meshlet.m_coneCutoff)
+            {
+                stats.m_meshletsConeCulled++;
+                continue;
+            }
+        }
+
+        stats.m_meshletsVisible++;
+        stats.m_trianglesVisible += meshlet.m_triangleCount;
+        visibleMeshlets.push_back(UINT32(i));
+    }
+}
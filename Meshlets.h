@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include "Culling.h"
+
+struct Vertex;
+
+static const size_t c_meshletMaxVertices = 64;
+static const size_t c_meshletMaxTriangles = 124;
+
+struct SMeshlet
+{
+    UINT32      m_vertexOffset;     // into SMeshlets::m_vertices
+    UINT32      m_triangleOffset;   // into SMeshlets::m_triangles, in triangles
+    UINT32      m_vertexCount;
+    UINT32      m_triangleCount;
+
+    XMFLOAT3    m_center;           // bounding sphere
+    float       m_radius;
+
+    // Normal cone. If dot(normalize(m_coneApex - cameraPosition), m_coneAxis) >= m_coneCutoff, every triangle in the
+    // meshlet is back facing. A cutoff of 1 with a zero axis means the cone is too wide to ever cull.
+    XMFLOAT3    m_coneApex;
+    XMFLOAT3    m_coneAxis;
+    float       m_coneCutoff;
+};
+
+// A mesh split into clusters of up to c_meshletMaxVertices vertices and c_meshletMaxTriangles triangles
+struct SMeshlets
+{
+    std::vector<SMeshlet>   m_meshlets;
+    std::vector<UINT32>     m_vertices;     // indices into the mesh's vertex buffer
+    std::vector<UINT8>      m_triangles;    // 3 indices into the meshlet's vertices per triangle
+};
+
+struct SMeshletCullStats
+{
+    size_t m_meshletsTested = 0;
+    size_t m_meshletsVisible = 0;
+    size_t m_meshletsFrustumCulled = 0;
+    size_t m_meshletsConeCulled = 0;
+    size_t m_trianglesTested = 0;
+    size_t m_trianglesVisible = 0;
+};
+
+// Splits an indexed triangle list into meshlets. Triangles are added greedily, preferring the neighbors of the meshlet
+// that add the fewest new vertices and bend the normal cone the least. Front faces are the ones where
+// cross(p2 - p0, p1 - p0) points outwards, which is the winding the models are drawn with.
+void MeshletsBuild (const std::vector<Vertex>& vertices, const std::vector<UINT32>& indices, SMeshlets& meshlets);
+
+// Tests the meshlets against the frustum and their normal cones against the camera position, appending the indices of
+// the visible meshlets to visibleMeshlets. objectToWorld is a DirectXMath row vector matrix (not the transposed one
+// in the model constant buffer) and should not have non uniform scale, else the cones are wrong.
+void MeshletsCull (const SMeshlets& meshlets, const XMMATRIX& objectToWorld, const SFrustum& frustum, const XMFLOAT3& cameraPosition,
+                   std::vector<UINT32>& visibleMeshlets, SMeshletCullStats& stats);
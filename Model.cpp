@@ -3,21 +3,91 @@
 #include "Model.h"
 #include "Math.h"
 #include "dx12.h"
+#include "ObjLoader.h"
+#include "MeshProcessing.h"
+#include "MeshCache.h"
+#include "Threading.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tinyobj/tiny_obj_loader.h"
+// makes the vertex and index buffers of a subobject
+static void CreateSubObjectBuffers (cdGraphicsAPIDX12& graphicsAPI, SSubObject& subObject, const std::vector<Vertex>& vertices, const std::vector<UINT32>& indices)
+{
+    subObject.m_numVertices = UINT(vertices.size());
+    subObject.m_numIndices = UINT(indices.size());
+    UINT vertexBufferSize = UINT(vertices.size() * sizeof(vertices[0]));
+    UINT indexBufferSize = UINT(indices.size() * sizeof(indices[0]));
 
-bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileName, const char* baseFilePath, float scale, XMFLOAT3 offset, bool flipV)
+    // Note: using upload heaps to transfer static data like vert buffers is not 
+    // recommended. Every time the GPU needs it, the upload heap will be marshalled 
+    // over. Please read up on Default Heap usage. An upload heap is used here for 
+    // code simplicity and because there are very few verts to actually transfer.
+    ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&subObject.m_vertexBuffer)));
+
+    ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&subObject.m_indexBuffer)));
+
+    // Copy the vertex and index data to the buffers.
+    UINT8* pDataBegin;
+    CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
+    ThrowIfFailed(subObject.m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pDataBegin)));
+    memcpy(pDataBegin, &vertices[0], vertexBufferSize);
+    subObject.m_vertexBuffer->Unmap(0, nullptr);
+
+    ThrowIfFailed(subObject.m_indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pDataBegin)));
+    memcpy(pDataBegin, &indices[0], indexBufferSize);
+    subObject.m_indexBuffer->Unmap(0, nullptr);
+
+    // Initialize the buffer views.
+    subObject.m_vertexBufferView.BufferLocation = subObject.m_vertexBuffer->GetGPUVirtualAddress();
+    subObject.m_vertexBufferView.StrideInBytes = sizeof(Vertex);
+    subObject.m_vertexBufferView.SizeInBytes = vertexBufferSize;
+
+    subObject.m_indexBufferView.BufferLocation = subObject.m_indexBuffer->GetGPUVirtualAddress();
+    subObject.m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+    subObject.m_indexBufferView.SizeInBytes = indexBufferSize;
+}
+
+// calculates the bounding box of a subobject, and the bounding sphere around the box's center
+static void CalculateSubObjectBounds (SSubObject& subObject, const std::vector<Vertex>& vertices)
 {
-    model.m_name = fileName;
+    subObject.m_boundsMin = vertices.empty() ? XMFLOAT3(0.0f, 0.0f, 0.0f) : vertices[0].position;
+    subObject.m_boundsMax = subObject.m_boundsMin;
+    for (const Vertex& vertex : vertices)
+    {
+        const XMFLOAT3& position = vertex.position;
+        subObject.m_boundsMin = XMFLOAT3(std::min<float>(subObject.m_boundsMin.x, position.x), std::min<float>(subObject.m_boundsMin.y, position.y), std::min<float>(subObject.m_boundsMin.z, position.z));
+        subObject.m_boundsMax = XMFLOAT3(std::max<float>(subObject.m_boundsMax.x, position.x), std::max<float>(subObject.m_boundsMax.y, position.y), std::max<float>(subObject.m_boundsMax.z, position.z));
+    }
 
+    XMFLOAT3 center = (subObject.m_boundsMin + subObject.m_boundsMax) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (const Vertex& vertex : vertices)
+    {
+        XMFLOAT3 offset = vertex.position - center;
+        radiusSquared = std::max<float>(radiusSquared, Dot(offset, offset));
+    }
+    subObject.m_boundsRadius = std::sqrtf(radiusSquared);
+}
+
+// loads an obj file and processes each of its shapes into an indexed mesh with tangent frames and meshlets
+static bool ProcessObj (const char* fileName, const char* baseFilePath, bool flipV, std::vector<SMeshCacheSubObject>& subObjects)
+{
     // try and load the model
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string err;
-    std::string textureName;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, fileName, baseFilePath, true))
+    if (!ObjLoadParallel(&attrib, &shapes, &materials, &err, fileName, baseFilePath, true))
     {
         OutputDebugStringA("TinyObj:\n");
         OutputDebugStringA(err.c_str());
@@ -31,17 +101,18 @@ bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileNa
     }
 
     // make a subobject for each shape in the model
-    for (const tinyobj::shape_t& shape : shapes)
+    subObjects.resize(shapes.size());
+    for (size_t shapeIndex = 0; shapeIndex < shapes.size(); ++shapeIndex)
     {
-        std::vector<Vertex> triangleVertices;
+        const tinyobj::shape_t& shape = shapes[shapeIndex];
+        SMeshCacheSubObject& subObject = subObjects[shapeIndex];
 
-        SSubObject subObject;
+        std::vector<Vertex> triangleVertices;
 
         size_t index_offset = 0;
         bool calculateNormals = attrib.normals.size() == 0;
 
-        // load textures
-        subObject.m_textureDiffuse = TextureMgr::LoadTexture(graphicsAPI, "Assets/white.png", false, false);
+        // get the texture name
         if (shape.mesh.material_ids.size() > 0)
         {
             int materialID = shape.mesh.material_ids[0];
@@ -51,9 +122,8 @@ bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileNa
 
                 if (material.diffuse_texname.size() > 0)
                 {
-                    textureName = baseFilePath == nullptr ? "" : baseFilePath;
-                    textureName += material.diffuse_texname;
-                    subObject.m_textureDiffuse = TextureMgr::LoadTexture(graphicsAPI, textureName.c_str(), false, true);
+                    subObject.m_textureDiffuse = baseFilePath == nullptr ? "" : baseFilePath;
+                    subObject.m_textureDiffuse += material.diffuse_texname;
                 }
             }
         }
@@ -66,8 +136,6 @@ bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileNa
                 throw std::exception();
             }
 
-            size_t startIndex = triangleVertices.size();
-
             // for each vertex in the face, make an entry in the triangle vertices array
             for (unsigned char i = 0; i < numVertices; ++i)
             {
@@ -77,6 +145,7 @@ bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileNa
                 newVertex.position = *(XMFLOAT3*)&attrib.vertices[idx.vertex_index * 3];
 
                 newVertex.normal = calculateNormals ? XMFLOAT3(0.0f, 0.0f, 0.0f) : *(XMFLOAT3*)&attrib.normals[idx.normal_index * 3];
+                newVertex.tangent = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
                 newVertex.uv = *(XMFLOAT2*)&attrib.texcoords[idx.texcoord_index * 2];
 
                 // flip V axis if we should
@@ -88,82 +157,84 @@ bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileNa
                 triangleVertices.push_back(newVertex);
             }
 
-            if (calculateNormals)
+            index_offset += numVertices;
+        }
+
+        // weld the vertices into an indexed mesh
+        MeshWeldVertices(triangleVertices, subObject.m_vertices, subObject.m_indices);
+
+        // the obj's have winding backwards compared to what i want. reverse it.
+        // This happens before calculating the tangent space so that calculated normals face outwards.
+        std::reverse(subObject.m_indices.begin(), subObject.m_indices.end());
+
+        MeshCalculateTangentSpace(subObject.m_vertices, subObject.m_indices, calculateNormals);
+    }
+
+    // build the meshlets and the LODs, one subobject per thread. The LOD indices get appended after LOD 0's.
+    ParallelFor(subObjects.size(), 1,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
             {
-                XMFLOAT3 ab = triangleVertices[startIndex + 1].position - triangleVertices[startIndex].position;
-                XMFLOAT3 ac = triangleVertices[startIndex + 2].position - triangleVertices[startIndex].position;
-
-                XMFLOAT3 norm = Cross(ac, ab);
-                Normalize(norm);
-                triangleVertices[startIndex + 0].normal = norm;
-                triangleVertices[startIndex + 1].normal = norm;
-                triangleVertices[startIndex + 2].normal = norm;
+                MeshletsBuild(subObjects[i].m_vertices, subObjects[i].m_indices, subObjects[i].m_meshlets);
+                MeshLodBuild(subObjects[i].m_vertices, subObjects[i].m_indices, subObjects[i].m_lods);
             }
+        }
+    );
 
-            // calculate tangents
-            {
-                XMFLOAT3 abPos = triangleVertices[startIndex + 1].position - triangleVertices[startIndex].position;
-                XMFLOAT3 acPos = triangleVertices[startIndex + 2].position - triangleVertices[startIndex].position;
+    return true;
+}
 
-                XMFLOAT2 abUV = triangleVertices[startIndex + 1].uv - triangleVertices[startIndex].uv;
-                XMFLOAT2 acUV = triangleVertices[startIndex + 2].uv - triangleVertices[startIndex].uv;
+bool ModelLoadMeshData (const char* fileName, const char* baseFilePath, bool flipV, std::vector<SMeshCacheSubObject>& subObjects)
+{
+    // use the mesh cache if it's up to date, else process the obj and update the cache
+    if (MeshCacheLoad(fileName, flipV, subObjects))
+        return true;
 
-                float f = 1.0f / (abUV.x * acUV.y - acUV.x * abUV.y);
+    if (!ProcessObj(fileName, baseFilePath, flipV, subObjects))
+        return false;
 
-                XMFLOAT3 tangent;
-                tangent.x = f * (acUV.y * abPos.x - abUV.y * acPos.x);
-                tangent.y = f * (acUV.y * abPos.y - abUV.y * acPos.y);
-                tangent.z = f * (acUV.y * abPos.z - abUV.y * acPos.z);
+    MeshCacheSave(fileName, flipV, subObjects);
+    return true;
+}
 
-                triangleVertices[startIndex + 0].tangent = tangent;
-                triangleVertices[startIndex + 1].tangent = tangent;
-                triangleVertices[startIndex + 2].tangent = tangent;
-            }
+bool ModelLoad(cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileName, const char* baseFilePath, float scale, XMFLOAT3 offset, bool flipV)
+{
+    model.m_name = fileName;
 
-            index_offset += numVertices;
-        }
+    std::vector<SMeshCacheSubObject> cacheSubObjects;
+    if (!ModelLoadMeshData(fileName, baseFilePath, flipV, cacheSubObjects))
+        return false;
 
-        subObject.m_numVertices = UINT(triangleVertices.size());
-        UINT vertexBufferSize = UINT(triangleVertices.size() * sizeof(triangleVertices[0]));
-
-        // the obj's have winding backwards compared to what i want. reverse it
-        std::reverse(triangleVertices.begin(), triangleVertices.end());
-
-        // Note: using upload heaps to transfer static data like vert buffers is not 
-        // recommended. Every time the GPU needs it, the upload heap will be marshalled 
-        // over. Please read up on Default Heap usage. An upload heap is used here for 
-        // code simplicity and because there are very few verts to actually transfer.
-        ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&subObject.m_vertexBuffer)));
-
-        // Copy the triangle data to the vertex buffer.
-        UINT8* pVertexDataBegin;
-        CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
-        ThrowIfFailed(subObject.m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-        memcpy(pVertexDataBegin, &triangleVertices[0], vertexBufferSize);
-        subObject.m_vertexBuffer->Unmap(0, nullptr);
-
-        // Initialize the vertex buffer view.
-        subObject.m_vertexBufferView.BufferLocation = subObject.m_vertexBuffer->GetGPUVirtualAddress();
-        subObject.m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-        subObject.m_vertexBufferView.SizeInBytes = vertexBufferSize;
+    // load the textures of all the subobjects at once, so the files are decoded in parallel
+    std::vector<STextureLoad> textureLoads(cacheSubObjects.size());
+    for (size_t i = 0; i < cacheSubObjects.size(); ++i)
+    {
+        const std::string& textureDiffuse = cacheSubObjects[i].m_textureDiffuse;
+        textureLoads[i].m_fileName = textureDiffuse.empty() ? "Assets/white.png" : textureDiffuse.c_str();
+        textureLoads[i].m_makeMips = !textureDiffuse.empty();
+    }
+    std::vector<TextureID> textures(cacheSubObjects.size());
+    TextureMgr::LoadTextures(graphicsAPI, textureLoads.size(), textureLoads.data(), textures.data());
+
+    model.m_subObjects.reserve(cacheSubObjects.size());
+    for (size_t i = 0; i < cacheSubObjects.size(); ++i)
+    {
+        SMeshCacheSubObject& cacheSubObject = cacheSubObjects[i];
+        SSubObject subObject;
+        subObject.m_textureDiffuse = textures[i];
+
+        CreateSubObjectBuffers(graphicsAPI, subObject, cacheSubObject.m_vertices, cacheSubObject.m_indices);
+        CalculateSubObjectBounds(subObject, cacheSubObject.m_vertices);
+        subObject.m_meshlets = std::move(cacheSubObject.m_meshlets);
+        subObject.m_lods = std::move(cacheSubObject.m_lods);
 
         // add the subobject to the list
-        model.m_subObjects.push_back(subObject);
+        model.m_subObjects.push_back(std::move(subObject));
     }
 
-    // init the per model constant buffer
-    model.m_constantBuffer.Init(graphicsAPI);
-    model.m_constantBuffer.Write(
-        [&] (SModelConstantBuffer& buffer) {
-            buffer.modelMatrix = XMMatrixTranspose(XMMatrixMultiply(XMMatrixScaling(scale, scale, scale), XMMatrixTranslation(offset.x, offset.y, offset.z)));
-        }
-    );
+    // the per model constants
+    model.m_constants.modelMatrix = XMMatrixTranspose(XMMatrixMultiply(XMMatrixScaling(scale, scale, scale), XMMatrixTranslation(offset.x, offset.y, offset.z)));
 
     return true;
 }
@@ -178,79 +249,21 @@ void ModelCreate (cdGraphicsAPIDX12& graphicsAPI, SModel& model, bool calculateN
         throw std::exception();
     }
 
-    // calculate normals if we should
-    if (calculateNormals)
-    {
-        for (size_t triangleIndex = 0; triangleIndex < triangleVertices.size(); triangleIndex+=3)
-        {
-            XMFLOAT3 ab = triangleVertices[triangleIndex + 1].position - triangleVertices[triangleIndex].position;
-            XMFLOAT3 ac = triangleVertices[triangleIndex + 2].position - triangleVertices[triangleIndex].position;
-
-            XMFLOAT3 norm = Cross(ac, ab);
-            Normalize(norm);
-            triangleVertices[triangleIndex + 0].normal = norm;
-            triangleVertices[triangleIndex + 1].normal = norm;
-            triangleVertices[triangleIndex + 2].normal = norm;
-        }
-    }
-
-    // calculate tangents
-    for (size_t triangleIndex = 0; triangleIndex < triangleVertices.size(); triangleIndex += 3)
-    {
-        XMFLOAT3 abPos = triangleVertices[triangleIndex + 1].position - triangleVertices[triangleIndex].position;
-        XMFLOAT3 acPos = triangleVertices[triangleIndex + 2].position - triangleVertices[triangleIndex].position;
-
-        XMFLOAT2 abUV = triangleVertices[triangleIndex + 1].uv - triangleVertices[triangleIndex].uv;
-        XMFLOAT2 acUV = triangleVertices[triangleIndex + 2].uv - triangleVertices[triangleIndex].uv;
-
-        float f = 1.0f / (abUV.x * acUV.y - acUV.x * abUV.y);
-
-        XMFLOAT3 tangent;
-        tangent.x = f * (acUV.y * abPos.x - abUV.y * acPos.x);
-        tangent.y = f * (acUV.y * abPos.y - abUV.y * acPos.y);
-        tangent.z = f * (acUV.y * abPos.z - abUV.y * acPos.z);
-
-        triangleVertices[triangleIndex + 0].tangent = tangent;
-        triangleVertices[triangleIndex + 1].tangent = tangent;
-        triangleVertices[triangleIndex + 2].tangent = tangent;
-    }
+    // weld the vertices into an indexed mesh and calculate smooth tangent frames, and normals if we should
+    std::vector<Vertex> vertices;
+    std::vector<UINT32> indices;
+    MeshWeldVertices(triangleVertices, vertices, indices);
+    MeshCalculateTangentSpace(vertices, indices, calculateNormals);
 
     // make a subobject
     model.m_subObjects.resize(1);
-    SSubObject &subObject = *model.m_subObjects.begin();
-    subObject.m_numVertices = UINT(triangleVertices.size());
-    UINT vertexBufferSize = UINT(triangleVertices.size() * sizeof(triangleVertices[0]));
+    SSubObject &subObject = model.m_subObjects[0];
     subObject.m_textureDiffuse = TextureMgr::LoadTexture(graphicsAPI, "Assets/white.png", false, false);
+    MeshletsBuild(vertices, indices, subObject.m_meshlets);
+    MeshLodBuild(vertices, indices, subObject.m_lods);
+    CreateSubObjectBuffers(graphicsAPI, subObject, vertices, indices);
+    CalculateSubObjectBounds(subObject, vertices);
 
-    // Note: using upload heaps to transfer static data like vert buffers is not 
-    // recommended. Every time the GPU needs it, the upload heap will be marshalled 
-    // over. Please read up on Default Heap usage. An upload heap is used here for 
-    // code simplicity and because there are very few verts to actually transfer.
-    ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&subObject.m_vertexBuffer)));
-
-    // Copy the triangle data to the vertex buffer.
-    UINT8* pVertexDataBegin;
-    CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
-    ThrowIfFailed(subObject.m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-    memcpy(pVertexDataBegin, &triangleVertices[0], vertexBufferSize);
-    subObject.m_vertexBuffer->Unmap(0, nullptr);
-
-    // Initialize the vertex buffer view.
-    subObject.m_vertexBufferView.BufferLocation = subObject.m_vertexBuffer->GetGPUVirtualAddress();
-    subObject.m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-    subObject.m_vertexBufferView.SizeInBytes = vertexBufferSize;
-
-    // init the per model constant buffer
-    model.m_constantBuffer.Init(graphicsAPI);
-    model.m_constantBuffer.Write(
-        [] (SModelConstantBuffer& buffer) {
-            buffer.modelMatrix = XMMatrixIdentity();
-        }
-    );
+    // the per model constants
+    model.m_constants.modelMatrix = XMMatrixIdentity();
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #pragma once
 
 #include "DXSample.h"
-#include <list>
+#include <vector>
 #include "TextureMgr.h"
-#include "ConstantBuffer.h"
+#include "Meshlets.h"
+#include "MeshLod.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -18,15 +19,25 @@ const D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
 {
 	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0},
-    { "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0},
-    { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0 }
+    { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0},
+    { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 40, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0 }
+};
+
+// The vertex input layout of instanced draws. Slot 1 has the object table slot of each instance.
+const D3D12_INPUT_ELEMENT_DESC inputElementDescsInstanced[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0},
+    { "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0},
+    { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 40, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA , 0 },
+    { "OBJECTID", 0, DXGI_FORMAT_R32_UINT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 };
 
 struct Vertex
 {
     XMFLOAT3 position;
     XMFLOAT3 normal;
-    XMFLOAT3 tangent;
+    XMFLOAT4 tangent;   // w is the bitangent handedness
     XMFLOAT2 uv;
 };
 
@@ -35,16 +46,31 @@ struct SSubObject
     ComPtr<ID3D12Resource>      m_vertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW    m_vertexBufferView;
     UINT                        m_numVertices;
+    ComPtr<ID3D12Resource>      m_indexBuffer;
+    D3D12_INDEX_BUFFER_VIEW     m_indexBufferView;
+    UINT                        m_numIndices;       // of all of the LODs
+    std::vector<SMeshLod>       m_lods;             // index ranges in the index buffer, LOD 0 is the most detailed
     TextureID                   m_textureDiffuse = TextureID::invalid;
+    SMeshlets                   m_meshlets;         // of LOD 0
+
+    // object space bounds. The bounding sphere is centered on the box.
+    XMFLOAT3                    m_boundsMin;
+    XMFLOAT3                    m_boundsMax;
+    float                       m_boundsRadius;
 };
 
 struct SModel
 {
     std::string                             m_name;
-    std::list<SSubObject>                   m_subObjects;
-    ConstantBuffer<SModelConstantBuffer>    m_constantBuffer;
+    std::vector<SSubObject>                 m_subObjects;
+    SModelConstantBuffer                    m_constants;    // uploaded by the draws that need it, each frame
 };
 
+struct SMeshCacheSubObject;
+
+// Loads the processed mesh data of a model file without touching the GPU, from the mesh cache if it's up to date
+bool ModelLoadMeshData (const char* fileName, const char* baseFilePath, bool flipV, std::vector<SMeshCacheSubObject>& subObjects);
+
 bool ModelLoad (cdGraphicsAPIDX12& graphicsAPI, SModel& model, const char* fileName, const char* baseFilePath, float scale, XMFLOAT3 offset, bool flipV);
 
 void ModelCreate (cdGraphicsAPIDX12& graphicsAPI, SModel& model, bool calculateNormals, std::vector<Vertex>& triangleVertices, const char* debugName);
\ No newline at end of file
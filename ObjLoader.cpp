@@ -0,0 +1,737 @@
+#include "stdafx.h"
+
+// The tinyobj implementation lives in this file so that the parallel loader can share its internal helpers
+// (material loading, polygon triangulation, tag parsing). That keeps the output bit for bit the same as tinyobj's.
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "ObjLoader.h"
+#include "Threading.h"
+
+#include <fstream>
+
+using tinyobj::real_t;
+
+// Chunks smaller than this aren't worth handing to another thread
+static const size_t c_minChunkSize = 64 * 1024;
+
+// How many chunks to make per thread, so that threads which finish early can pick up more work
+static const size_t c_chunksPerThread = 4;
+
+// A face vertex. Indices are zero based. Relative (negative) indices in the file are resolved against the
+// attribute counts of the chunk they are in, and are flagged so that the chunk's prefix sum is added later.
+struct SRawIndex
+{
+    int v;
+    int vt;
+    int vn;
+    unsigned char relative;
+};
+
+static const unsigned char c_relativeV  = 1;
+static const unsigned char c_relativeVT = 2;
+static const unsigned char c_relativeVN = 4;
+
+// Lines which change the shape / material state. They are rare, so they are kept as text and replayed in order.
+struct SCommand
+{
+    size_t      faceIndex;  // how many faces of the chunk come before this command
+    std::string line;       // starting at the first non space character, without the line ending
+};
+
+struct SChunk
+{
+    const char*             m_begin = nullptr;
+    const char*             m_end = nullptr;
+
+    std::vector<real_t>     m_v;
+    std::vector<real_t>     m_vc;
+    std::vector<real_t>     m_vn;
+    std::vector<real_t>     m_vt;
+
+    std::vector<SRawIndex>  m_faceIndices;
+    std::vector<size_t>     m_faceSizes;
+    std::vector<SCommand>   m_commands;
+
+    bool                    m_hasRelative = false;
+
+    // if a face failed to parse, m_failed is set and m_faceSizes.size() is the index of the failing face
+    bool                    m_failed = false;
+
+    // prefix sums, in attribute counts (not floats)
+    size_t                  m_vOffset = 0;
+    size_t                  m_vnOffset = 0;
+    size_t                  m_vtOffset = 0;
+};
+
+static inline bool IsSpace (char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static inline bool IsLineEnd (char c)
+{
+    return c == '\n' || c == '\r' || c == '\0';
+}
+
+static inline bool IsDigit (char c)
+{
+    return static_cast<unsigned int>(c - '0') < 10u;
+}
+
+static inline bool IsTokenEnd (char c)
+{
+    return IsSpace(c) || IsLineEnd(c);
+}
+
+static inline void SkipSpaces (const char*& token)
+{
+    while (IsSpace(*token))
+        ++token;
+}
+
+// Parses a float the same way tinyobj::parseReal does, so the results are bit identical. The common
+// "[-]123[.456]" case is handled inline, anything else (exponents, garbage, long fractions) goes to tinyobj.
+static inline real_t ParseReal (const char*& token, double defaultValue)
+{
+    SkipSpaces(token);
+
+    const char* s = token;
+    bool negative = false;
+    if (*s == '+' || *s == '-')
+    {
+        negative = *s == '-';
+        ++s;
+    }
+
+    if (IsDigit(*s))
+    {
+        double mantissa = 0.0;
+        while (IsDigit(*s))
+        {
+            mantissa *= 10;
+            mantissa += static_cast<int>(*s - '0');
+            ++s;
+        }
+
+        if (*s == '.')
+        {
+            static const double c_powLUT[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+            ++s;
+            int read = 1;
+            while (IsDigit(*s) && read < int(_countof(c_powLUT)))
+            {
+                mantissa += static_cast<int>(*s - '0') * c_powLUT[read];
+                ++read;
+                ++s;
+            }
+        }
+
+        if (IsTokenEnd(*s))
+        {
+            token = s;
+            return static_cast<real_t>((negative ? -1 : 1) * mantissa);
+        }
+    }
+
+    // slow path
+    const char* end = token;
+    while (!IsTokenEnd(*end))
+        ++end;
+
+    double value = defaultValue;
+    tinyobj::tryParseDouble(token, end, &value);
+    token = end;
+    return static_cast<real_t>(value);
+}
+
+// atoi, but never reads past the end of the line
+static inline int ParseIndex (const char* token)
+{
+    while (*token == ' ' || *token == '\t' || *token == '\v' || *token == '\f')
+        ++token;
+
+    bool negative = false;
+    if (*token == '+' || *token == '-')
+    {
+        negative = *token == '-';
+        ++token;
+    }
+
+    int value = 0;
+    while (IsDigit(*token))
+    {
+        value = value * 10 + (*token - '0');
+        ++token;
+    }
+    return negative ? -value : value;
+}
+
+static inline void SkipIndex (const char*& token)
+{
+    while (*token != '/' && !IsTokenEnd(*token))
+        ++token;
+}
+
+// Same rules as tinyobj::fixIndex, except negative indices are resolved against the chunk's count
+static inline bool FixIndex (int index, size_t count, int& out, unsigned char& relative, unsigned char relativeFlag)
+{
+    if (index > 0)
+    {
+        out = index - 1;
+        return true;
+    }
+
+    if (index < 0)
+    {
+        out = int(count) + index;
+        relative |= relativeFlag;
+        return true;
+    }
+
+    return false;
+}
+
+// parses i, i/j/k, i//k, i/j the way tinyobj::parseTriple does
+static inline bool ParseTriple (const char*& token, const SChunk& chunk, SRawIndex& ret)
+{
+    ret.v = -1;
+    ret.vt = -1;
+    ret.vn = -1;
+    ret.relative = 0;
+
+    if (!FixIndex(ParseIndex(token), chunk.m_v.size() / 3, ret.v, ret.relative, c_relativeV))
+        return false;
+
+    SkipIndex(token);
+    if (*token != '/')
+        return true;
+    ++token;
+
+    // i//k
+    if (*token == '/')
+    {
+        ++token;
+        if (!FixIndex(ParseIndex(token), chunk.m_vn.size() / 3, ret.vn, ret.relative, c_relativeVN))
+            return false;
+        SkipIndex(token);
+        return true;
+    }
+
+    // i/j/k or i/j
+    if (!FixIndex(ParseIndex(token), chunk.m_vt.size() / 2, ret.vt, ret.relative, c_relativeVT))
+        return false;
+
+    SkipIndex(token);
+    if (*token != '/')
+        return true;
+
+    // i/j/k
+    ++token;
+    if (!FixIndex(ParseIndex(token), chunk.m_vn.size() / 3, ret.vn, ret.relative, c_relativeVN))
+        return false;
+    SkipIndex(token);
+
+    return true;
+}
+
+static void ParseChunk (SChunk& chunk)
+{
+    const char* p = chunk.m_begin;
+    while (p < chunk.m_end)
+    {
+        const char* token = p;
+        SkipSpaces(token);
+
+        // vertex
+        if (token[0] == 'v' && IsSpace(token[1]))
+        {
+            token += 2;
+            chunk.m_v.push_back(ParseReal(token, 0.0));
+            chunk.m_v.push_back(ParseReal(token, 0.0));
+            chunk.m_v.push_back(ParseReal(token, 0.0));
+
+            chunk.m_vc.push_back(ParseReal(token, 1.0));
+            chunk.m_vc.push_back(ParseReal(token, 1.0));
+            chunk.m_vc.push_back(ParseReal(token, 1.0));
+        }
+        // normal
+        else if (token[0] == 'v' && token[1] == 'n' && IsSpace(token[2]))
+        {
+            token += 3;
+            chunk.m_vn.push_back(ParseReal(token, 0.0));
+            chunk.m_vn.push_back(ParseReal(token, 0.0));
+            chunk.m_vn.push_back(ParseReal(token, 0.0));
+        }
+        // texcoord
+        else if (token[0] == 'v' && token[1] == 't' && IsSpace(token[2]))
+        {
+            token += 3;
+            chunk.m_vt.push_back(ParseReal(token, 0.0));
+            chunk.m_vt.push_back(ParseReal(token, 0.0));
+        }
+        // face
+        else if (token[0] == 'f' && IsSpace(token[1]))
+        {
+            token += 2;
+            SkipSpaces(token);
+
+            size_t faceSize = 0;
+            while (!IsLineEnd(*token))
+            {
+                SRawIndex index;
+                if (!ParseTriple(token, chunk, index))
+                {
+                    chunk.m_failed = true;
+                    return;
+                }
+
+                chunk.m_hasRelative |= index.relative != 0;
+                chunk.m_faceIndices.push_back(index);
+                ++faceSize;
+                SkipSpaces(token);
+            }
+            chunk.m_faceSizes.push_back(faceSize);
+        }
+        // state changes get replayed later, in order
+        else if ((strncmp(token, "usemtl", 6) == 0 && IsSpace(token[6])) ||
+                 (strncmp(token, "mtllib", 6) == 0 && IsSpace(token[6])) ||
+                 ((token[0] == 'g' || token[0] == 'o' || token[0] == 't') && IsSpace(token[1])))
+        {
+            const char* end = token;
+            while (!IsLineEnd(*end))
+                ++end;
+            chunk.m_commands.push_back({ chunk.m_faceSizes.size(), std::string(token, end) });
+            token = end;
+        }
+
+        // go to the start of the next line. empty lines from "\r\n" are skipped by the loop above.
+        while (!IsLineEnd(*token))
+            ++token;
+        p = token + 1;
+    }
+}
+
+// Same as tinyobj::exportFaceGroupToShape, but triangles (and everything when not triangulating) are copied
+// straight across instead of going through a vector of vectors. Polygons are still handed to tinyobj.
+static bool ExportFaceGroupToShape (tinyobj::shape_t& shape, const std::vector<std::pair<const SRawIndex*, size_t>>& faceGroup,
+                             const std::vector<tinyobj::tag_t>& tags, int materialID, const std::string& name, bool triangulate,
+                             const std::vector<real_t>& v)
+{
+    if (faceGroup.empty())
+        return false;
+
+    std::vector<std::vector<tinyobj::vertex_index>> polygon(1);
+
+    for (const std::pair<const SRawIndex*, size_t>& face : faceGroup)
+    {
+        if (face.second == 3 || !triangulate)
+        {
+            for (size_t i = 0; i < face.second; ++i)
+            {
+                tinyobj::index_t index;
+                index.vertex_index = face.first[i].v;
+                index.normal_index = face.first[i].vn;
+                index.texcoord_index = face.first[i].vt;
+                shape.mesh.indices.push_back(index);
+            }
+
+            shape.mesh.num_face_vertices.push_back(static_cast<unsigned char>(face.second));
+            shape.mesh.material_ids.push_back(materialID);
+        }
+        else
+        {
+            polygon[0].clear();
+            for (size_t i = 0; i < face.second; ++i)
+                polygon[0].push_back(tinyobj::vertex_index(face.first[i].v, face.first[i].vt, face.first[i].vn));
+            tinyobj::exportFaceGroupToShape(&shape, polygon, tags, materialID, name, triangulate, v);
+        }
+    }
+
+    shape.name = name;
+    shape.mesh.tags = tags;
+
+    return true;
+}
+
+bool ObjLoadParallel (tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+                      std::string* err, const char* fileName, const char* mtlBaseDir, bool triangulate, size_t numThreads)
+{
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    attrib->colors.clear();
+    shapes->clear();
+
+    // read the whole file in, with a null terminator so parsing can never run off the end
+    std::vector<char> fileData;
+    {
+        std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            if (err)
+                *err = std::string("Cannot open file [") + fileName + "]\n";
+            return false;
+        }
+
+        size_t fileSize = size_t(file.tellg());
+        fileData.resize(fileSize + 1);
+        file.seekg(0, std::ios::beg);
+        file.read(&fileData[0], fileSize);
+        fileData[fileSize] = '\0';
+    }
+    const size_t dataSize = fileData.size() - 1;
+
+    if (numThreads == 0)
+        numThreads = JobSystemThreadCount(JobSystemDefault());
+
+    // split the file into chunks that start at the beginning of a line
+    size_t numChunks = std::max<size_t>(std::min<size_t>(numThreads * c_chunksPerThread, dataSize / c_minChunkSize), 1);
+    std::vector<SChunk> chunks(numChunks);
+    {
+        const char* data = &fileData[0];
+        size_t chunkStart = 0;
+        for (size_t i = 0; i < numChunks; ++i)
+        {
+            size_t chunkEnd = (i + 1 == numChunks) ? dataSize : std::max<size_t>(dataSize * (i + 1) / numChunks, chunkStart);
+            while (chunkEnd < dataSize && chunkEnd > 0 && data[chunkEnd - 1] != '\n' && data[chunkEnd - 1] != '\r')
+                ++chunkEnd;
+
+            chunks[i].m_begin = data + chunkStart;
+            chunks[i].m_end = data + chunkEnd;
+            chunkStart = chunkEnd;
+        }
+    }
+
+    // parse the chunks
+    ParallelFor(numChunks, 1,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; ++index)
+                ParseChunk(chunks[index]);
+        },
+        numThreads
+    );
+
+    // prefix sum the attribute counts
+    size_t vCount = 0;
+    size_t vnCount = 0;
+    size_t vtCount = 0;
+    for (SChunk& chunk : chunks)
+    {
+        chunk.m_vOffset = vCount;
+        chunk.m_vnOffset = vnCount;
+        chunk.m_vtOffset = vtCount;
+        vCount += chunk.m_v.size() / 3;
+        vnCount += chunk.m_vn.size() / 3;
+        vtCount += chunk.m_vt.size() / 2;
+    }
+
+    // gather the attributes and resolve relative indices
+    std::vector<real_t> v(vCount * 3);
+    std::vector<real_t> vc(vCount * 3);
+    std::vector<real_t> vn(vnCount * 3);
+    std::vector<real_t> vt(vtCount * 2);
+    auto gatherChunk = [&] (SChunk& chunk)
+    {
+        std::copy(chunk.m_v.begin(), chunk.m_v.end(), v.begin() + chunk.m_vOffset * 3);
+        std::copy(chunk.m_vc.begin(), chunk.m_vc.end(), vc.begin() + chunk.m_vOffset * 3);
+        std::copy(chunk.m_vn.begin(), chunk.m_vn.end(), vn.begin() + chunk.m_vnOffset * 3);
+        std::copy(chunk.m_vt.begin(), chunk.m_vt.end(), vt.begin() + chunk.m_vtOffset * 2);
+
+        if (!chunk.m_hasRelative)
+            return;
+
+        for (SRawIndex& rawIndex : chunk.m_faceIndices)
+        {
+            if (rawIndex.relative & c_relativeV)
+                rawIndex.v += int(chunk.m_vOffset);
+            if (rawIndex.relative & c_relativeVN)
+                rawIndex.vn += int(chunk.m_vnOffset);
+            if (rawIndex.relative & c_relativeVT)
+                rawIndex.vt += int(chunk.m_vtOffset);
+        }
+    };
+    ParallelFor(numChunks, 1,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; ++index)
+                gatherChunk(chunks[index]);
+        },
+        numThreads
+    );
+
+    // replay the faces and state changes in file order, the same way tinyobj::LoadObj does
+    std::vector<tinyobj::tag_t> tags;
+    std::vector<std::pair<const SRawIndex*, size_t>> faceGroup;
+    std::string name;
+    std::map<std::string, int> materialMap;
+    int material = -1;
+    tinyobj::shape_t shape;
+    tinyobj::MaterialFileReader materialReader(mtlBaseDir ? mtlBaseDir : "");
+
+    for (const SChunk& chunk : chunks)
+    {
+        size_t faceIndex = 0;
+        const SRawIndex* faceIndices = chunk.m_faceIndices.empty() ? nullptr : &chunk.m_faceIndices[0];
+        size_t commandIndex = 0;
+
+        while (true)
+        {
+            // add the faces that come before the next command
+            size_t faceEnd = commandIndex < chunk.m_commands.size() ? chunk.m_commands[commandIndex].faceIndex : chunk.m_faceSizes.size();
+            for (; faceIndex < faceEnd; ++faceIndex)
+            {
+                faceGroup.push_back({ faceIndices, chunk.m_faceSizes[faceIndex] });
+                faceIndices += chunk.m_faceSizes[faceIndex];
+            }
+
+            if (commandIndex >= chunk.m_commands.size())
+                break;
+
+            const std::string& line = chunk.m_commands[commandIndex].line;
+            ++commandIndex;
+
+            // use mtl
+            if (line[0] == 'u')
+            {
+                std::string materialName = line.substr(7);
+
+                int newMaterialID = -1;
+                auto it = materialMap.find(materialName);
+                if (it != materialMap.end())
+                    newMaterialID = it->second;
+
+                if (newMaterialID != material)
+                {
+                    ExportFaceGroupToShape(shape, faceGroup, tags, material, name, triangulate, v);
+                    faceGroup.clear();
+                    material = newMaterialID;
+                }
+            }
+            // load mtl
+            else if (line[0] == 'm')
+            {
+                std::vector<std::string> fileNames;
+                tinyobj::SplitString(line.substr(7), ' ', fileNames);
+
+                if (fileNames.empty())
+                {
+                    if (err)
+                        *err += "WARN: Looks like empty filename for mtllib. Use default material. \n";
+                }
+                else
+                {
+                    bool found = false;
+                    for (const std::string& mtlFileName : fileNames)
+                    {
+                        std::string mtlErr;
+                        bool ok = materialReader(mtlFileName.c_str(), materials, &materialMap, &mtlErr);
+                        if (err && !mtlErr.empty())
+                            *err += mtlErr;
+
+                        if (ok)
+                        {
+                            found = true;
+                            break;
+                        }
+                    }
+
+                    if (!found && err)
+                        *err += "WARN: Failed to load material file(s). Use default material.\n";
+                }
+            }
+            // group name
+            else if (line[0] == 'g')
+            {
+                ExportFaceGroupToShape(shape, faceGroup, tags, material, name, triangulate, v);
+                if (shape.mesh.indices.size() > 0)
+                    shapes->push_back(shape);
+
+                shape = tinyobj::shape_t();
+                faceGroup.clear();
+
+                std::vector<std::string> names;
+                const char* token = line.c_str();
+                while (!IS_NEW_LINE(token[0]))
+                {
+                    names.push_back(tinyobj::parseString(&token));
+                    token += strspn(token, " \t\r");
+                }
+
+                // names[0] is the 'g'
+                name = names.size() > 1 ? names[1] : "";
+            }
+            // object name
+            else if (line[0] == 'o')
+            {
+                if (ExportFaceGroupToShape(shape, faceGroup, tags, material, name, triangulate, v))
+                    shapes->push_back(shape);
+
+                faceGroup.clear();
+                shape = tinyobj::shape_t();
+
+                name = line.substr(2);
+            }
+            // tag
+            else if (line[0] == 't')
+            {
+                const char* token = line.c_str() + 2;
+
+                tinyobj::tag_t tag;
+                tag.name = tinyobj::parseString(&token);
+
+                tinyobj::tag_sizes tagSizes = tinyobj::parseTagTriple(&token);
+
+                tag.intValues.resize(static_cast<size_t>(tagSizes.num_ints));
+                for (int& value : tag.intValues)
+                    value = tinyobj::parseInt(&token);
+
+                tag.floatValues.resize(static_cast<size_t>(tagSizes.num_reals));
+                for (real_t& value : tag.floatValues)
+                    value = tinyobj::parseReal(&token);
+
+                tag.stringValues.resize(static_cast<size_t>(tagSizes.num_strings));
+                for (std::string& value : tag.stringValues)
+                    value = tinyobj::parseString(&token);
+
+                tags.push_back(tag);
+            }
+        }
+
+        // tinyobj stops at the first bad face, leaving the shapes made so far and no attributes
+        if (chunk.m_failed)
+        {
+            if (err)
+                *err = "Failed parse `f' line(e.g. zero value for face index).\n";
+            return false;
+        }
+    }
+
+    // the last shape. tinyobj also keeps it when a trailing usemtl already flushed the faces.
+    if (ExportFaceGroupToShape(shape, faceGroup, tags, material, name, triangulate, v) || shape.mesh.indices.size())
+        shapes->push_back(shape);
+
+    attrib->vertices.swap(v);
+    attrib->normals.swap(vn);
+    attrib->texcoords.swap(vt);
+    attrib->colors.swap(vc);
+
+    return true;
+}
+
+bool ObjLoadCompare (const tinyobj::attrib_t& attribA, const std::vector<tinyobj::shape_t>& shapesA, const std::vector<tinyobj::material_t>& materialsA,
+                     const tinyobj::attrib_t& attribB, const std::vector<tinyobj::shape_t>& shapesB, const std::vector<tinyobj::material_t>& materialsB,
+                     std::string& difference)
+{
+    if (attribA.vertices != attribB.vertices)
+    {
+        difference = "vertices";
+        return false;
+    }
+    if (attribA.normals != attribB.normals)
+    {
+        difference = "normals";
+        return false;
+    }
+    if (attribA.texcoords != attribB.texcoords)
+    {
+        difference = "texcoords";
+        return false;
+    }
+    if (attribA.colors != attribB.colors)
+    {
+        difference = "colors";
+        return false;
+    }
+
+    if (shapesA.size() != shapesB.size())
+    {
+        difference = "shape count";
+        return false;
+    }
+
+    for (size_t shapeIndex = 0; shapeIndex < shapesA.size(); ++shapeIndex)
+    {
+        const tinyobj::shape_t& a = shapesA[shapeIndex];
+        const tinyobj::shape_t& b = shapesB[shapeIndex];
+
+        difference = "shape " + std::to_string(shapeIndex) + " (" + a.name + ") ";
+
+        if (a.name != b.name)
+        {
+            difference += "name";
+            return false;
+        }
+
+        if (a.mesh.indices.size() != b.mesh.indices.size())
+        {
+            difference += "index count";
+            return false;
+        }
+
+        for (size_t i = 0; i < a.mesh.indices.size(); ++i)
+        {
+            if (a.mesh.indices[i].vertex_index != b.mesh.indices[i].vertex_index ||
+                a.mesh.indices[i].normal_index != b.mesh.indices[i].normal_index ||
+                a.mesh.indices[i].texcoord_index != b.mesh.indices[i].texcoord_index)
+            {
+                difference += "index " + std::to_string(i);
+                return false;
+            }
+        }
+
+        if (a.mesh.num_face_vertices != b.mesh.num_face_vertices)
+        {
+            difference += "num_face_vertices";
+            return false;
+        }
+
+        if (a.mesh.material_ids != b.mesh.material_ids)
+        {
+            difference += "material_ids";
+            return false;
+        }
+
+        if (a.mesh.tags.size() != b.mesh.tags.size())
+        {
+            difference += "tag count";
+            return false;
+        }
+
+        for (size_t i = 0; i < a.mesh.tags.size(); ++i)
+        {
+            if (a.mesh.tags[i].name != b.mesh.tags[i].name ||
+                a.mesh.tags[i].intValues != b.mesh.tags[i].intValues ||
+                a.mesh.tags[i].floatValues != b.mesh.tags[i].floatValues ||
+                a.mesh.tags[i].stringValues != b.mesh.tags[i].stringValues)
+            {
+                difference += "tag " + std::to_string(i);
+                return false;
+            }
+        }
+    }
+
+    if (materialsA.size() != materialsB.size())
+    {
+        difference = "material count";
+        return false;
+    }
+
+    for (size_t i = 0; i < materialsA.size(); ++i)
+    {
+        const tinyobj::material_t& a = materialsA[i];
+        const tinyobj::material_t& b = materialsB[i];
+        if (a.name != b.name ||
+            a.diffuse_texname != b.diffuse_texname ||
+            a.specular_texname != b.specular_texname ||
+            a.bump_texname != b.bump_texname ||
+            a.alpha_texname != b.alpha_texname ||
+            memcmp(a.diffuse, b.diffuse, sizeof(a.diffuse)) != 0)
+        {
+            difference = "material " + std::to_string(i) + " (" + a.name + ")";
+            return false;
+        }
+    }
+
+    difference.clear();
+    return true;
+}
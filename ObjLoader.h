@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "tinyobj/tiny_obj_loader.h"
+
+// A multithreaded front end for tinyobj.
+// The file is read into memory, split into line aligned chunks, and the v / vn / vt / f records of each chunk are
+// parsed concurrently. The chunks are then stitched together using prefix sums of their attribute counts, and the
+// shape / material state machine is replayed in file order so that the results are identical to tinyobj::LoadObj.
+// numThreads of 0 means use all hardware threads.
+bool ObjLoadParallel (tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+                      std::string* err, const char* fileName, const char* mtlBaseDir, bool triangulate, size_t numThreads = 0);
+
+// returns true if the two loads produced exactly the same data. Writes the first difference found into "difference".
+bool ObjLoadCompare (const tinyobj::attrib_t& attribA, const std::vector<tinyobj::shape_t>& shapesA, const std::vector<tinyobj::material_t>& materialsA,
+                     const tinyobj::attrib_t& attribB, const std::vector<tinyobj::shape_t>& shapesB, const std::vector<tinyobj::material_t>& materialsB,
+                     std::string& difference);
@@ -0,0 +1,86 @@
+#include "stdafx.h"
+
+#include "ObjectTable.h"
+
+#include <algorithm>
+
+void ObjectTableInit (SObjectTable& table, UINT32 capacity)
+{
+    table = SObjectTable();
+    ObjectTableGrow(table, capacity);
+}
+
+void ObjectTableGrow (SObjectTable& table, UINT32 capacity)
+{
+    if (capacity <= table.m_capacity)
+        return;
+
+    table.m_capacity = capacity;
+    table.m_dirty.resize(capacity, false);
+
+    // the new GPU table starts out empty, so everything in use has to be uploaded again. Free slots can be too, it
+    // keeps the ranges few.
+    for (UINT32 slot = 0; slot < table.m_used; ++slot)
+        ObjectTableMarkDirty(table, slot);
+}
+
+bool ObjectTableAllocate (SObjectTable& table, UINT32& slot)
+{
+    if (!table.m_freeSlots.empty())
+    {
+        slot = table.m_freeSlots.back();
+        table.m_freeSlots.pop_back();
+    }
+    else if (table.m_used < table.m_capacity)
+    {
+        slot = table.m_used++;
+    }
+    else
+    {
+        return false;
+    }
+
+    ObjectTableMarkDirty(table, slot);
+    return true;
+}
+
+void ObjectTableFree (SObjectTable& table, UINT32 slot)
+{
+    if (slot >= table.m_used)
+        throw std::exception();
+
+    table.m_freeSlots.push_back(slot);
+}
+
+void ObjectTableMarkDirty (SObjectTable& table, UINT32 slot)
+{
+    if (slot >= table.m_capacity)
+        throw std::exception();
+
+    if (table.m_dirty[slot])
+        return;
+
+    table.m_dirty[slot] = true;
+    table.m_dirtySlots.push_back(slot);
+}
+
+void ObjectTableTakeDirtyRanges (SObjectTable& table, UINT32 maxGap, std::vector<SObjectRange>& ranges)
+{
+    ranges.clear();
+
+    std::vector<UINT32>& dirtySlots = table.m_dirtySlots;
+    std::sort(dirtySlots.begin(), dirtySlots.end());
+    for (UINT32 slot : dirtySlots)
+    {
+        table.m_dirty[slot] = false;
+        if (!ranges.empty() && slot - (ranges.back().m_first + ranges.back().m_count) <= maxGap)
+            ranges.back().m_count = slot + 1 - ranges.back().m_first;
+        else
+            ranges.push_back({ slot, 1 });
+    }
+    dirtySlots.clear();
+
+    for (const SObjectRange& range : ranges)
+        table.m_stats.m_slotsUploaded += range.m_count;
+    table.m_stats.m_ranges += ranges.size();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+// Hands out slots of a persistent table of per object data that lives on the GPU, and remembers which slots changed so
+// that only those are uploaded. It doesn't know what is in a slot. The owner keeps the CPU copy of the data and does
+// the uploads.
+//
+// Freed slots can be reused right away. The copy that overwrites a slot is recorded in a later frame than the draws
+// that read it, and the queue runs them in order.
+
+struct SObjectRange
+{
+    UINT32  m_first;
+    UINT32  m_count;
+};
+
+struct SObjectTableStats
+{
+    size_t m_slotsUploaded = 0;     // including the clean slots in joined ranges
+    size_t m_ranges = 0;
+};
+
+struct SObjectTable
+{
+    UINT32                  m_capacity = 0;
+    UINT32                  m_used = 0;         // slots at or past this have never been handed out
+    std::vector<UINT32>     m_freeSlots;
+
+    // the slots that changed since the last ObjectTableTakeDirtyRanges, and a flag per slot so each is listed once
+    std::vector<UINT32>     m_dirtySlots;
+    std::vector<bool>       m_dirty;
+
+    SObjectTableStats       m_stats;
+};
+
+void ObjectTableInit (SObjectTable& table, UINT32 capacity);
+
+// Adds slots up to the new capacity. The slots in use stay where they are, and every one of them is marked dirty,
+// because growing means the owner makes a new GPU table.
+void ObjectTableGrow (SObjectTable& table, UINT32 capacity);
+
+// Returns false if every slot is in use, in which case the caller can grow the table and try again. The new slot is
+// marked dirty.
+bool ObjectTableAllocate (SObjectTable& table, UINT32& slot);
+
+void ObjectTableFree (SObjectTable& table, UINT32 slot);
+
+void ObjectTableMarkDirty (SObjectTable& table, UINT32 slot);
+
+// Gives the dirty slots as sorted ranges and clears them. Ranges closer than maxGap slots are joined, because
+// uploading a few clean slots is cheaper than another copy call.
+void ObjectTableTakeDirtyRanges (SObjectTable& table, UINT32 maxGap, std::vector<SObjectRange>& ranges);
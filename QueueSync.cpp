@@ -0,0 +1,48 @@
+#include "stdafx.h"
+
+#include "QueueSync.h"
+
+#include <algorithm>
+
+void QueueSyncSignal (SQueueSync& sync, EQueue queue, UINT64 value)
+{
+    SQueueTimeline& timeline = sync.m_queues[(size_t)queue];
+    if (value <= timeline.m_signaled)
+        throw std::exception();
+
+    timeline.m_signaled = value;
+    sync.m_stats.m_signals++;
+}
+
+bool QueueSyncWait (SQueueSync& sync, EQueue queue, EQueue otherQueue, UINT64 value)
+{
+    if (queue == otherQueue)
+        throw std::exception();
+
+    SQueueTimeline& timeline = sync.m_queues[(size_t)queue];
+    const SQueueTimeline& otherTimeline = sync.m_queues[(size_t)otherQueue];
+    if (value > otherTimeline.m_signaled)
+        throw std::exception();
+
+    UINT64& waitedFor = timeline.m_waitedFor[(size_t)otherQueue];
+    if (value <= waitedFor || value <= otherTimeline.m_completed)
+    {
+        sync.m_stats.m_waitsSkipped++;
+        return false;
+    }
+
+    waitedFor = value;
+    sync.m_stats.m_waits++;
+    return true;
+}
+
+void QueueSyncComplete (SQueueSync& sync, EQueue queue, UINT64 completedValue)
+{
+    SQueueTimeline& timeline = sync.m_queues[(size_t)queue];
+    timeline.m_completed = std::max<UINT64>(timeline.m_completed, completedValue);
+}
+
+bool QueueSyncIsComplete (const SQueueSync& sync, EQueue queue, UINT64 value)
+{
+    return value <= sync.m_queues[(size_t)queue].m_completed;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Keeps track of the fence values that the graphics and compute queues have signaled and waited for, so that work on
+// one queue can depend on work on the other. cdGraphicsAPIDX12 owns one, and issues the queue signals and waits it
+// says to.
+//
+// Each queue has its own fence. A queue can only wait for a value the other queue has already signaled, which keeps
+// the queues from waiting for each other forever. A wait is skipped when the queue already waited for that value or a
+// later one, or the CPU already saw the value complete.
+
+enum class EQueue
+{
+    graphics,
+    compute,
+
+    Count
+};
+
+struct SQueueTimeline
+{
+    UINT64  m_signaled = 0;                         // the last value signaled on the queue's fence
+    UINT64  m_completed = 0;                        // the last value the CPU saw complete
+    UINT64  m_waitedFor[(size_t)EQueue::Count] = {};  // the last value of each other queue's fence this queue waited for
+};
+
+struct SQueueSyncStats
+{
+    size_t m_signals = 0;
+    size_t m_waits = 0;
+    size_t m_waitsSkipped = 0;
+};
+
+struct SQueueSync
+{
+    SQueueTimeline  m_queues[(size_t)EQueue::Count];
+    SQueueSyncStats m_stats;
+};
+
+// Throws if value isn't after the last value the queue signaled.
+void QueueSyncSignal (SQueueSync& sync, EQueue queue, UINT64 value);
+
+// Returns true if queue has to wait on the GPU for otherQueue's fence to get to value, and false if it is already
+// covered. Throws if otherQueue hasn't signaled value, or a queue waits for itself.
+bool QueueSyncWait (SQueueSync& sync, EQueue queue, EQueue otherQueue, UINT64 value);
+
+// what the CPU read from the queue's fence
+void QueueSyncComplete (SQueueSync& sync, EQueue queue, UINT64 completedValue);
+
+bool QueueSyncIsComplete (const SQueueSync& sync, EQueue queue, UINT64 value);
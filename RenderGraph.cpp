@@ -0,0 +1,392 @@
+#include "stdafx.h"
+
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+// what one pass does with one texture, with all of the pass's reads of it combined
+struct SRenderGraphPassUse
+{
+    UINT32              m_resource;
+    UINT32              m_step;
+    RenderGraphState    m_state;
+    bool                m_write;
+};
+
+// a run of uses of a texture in one state: a write, or reads that are next to each other
+struct SRenderGraphSegment
+{
+    UINT32              m_firstStep;
+    UINT32              m_lastStep;
+    RenderGraphState    m_state;
+    bool                m_write;
+};
+
+struct SRenderGraphLifetime
+{
+    UINT32  m_resource;
+    UINT32  m_firstStep;
+    UINT32  m_lastStep;
+};
+
+static UINT64 AlignUp (UINT64 value, UINT64 alignment)
+{
+    if (alignment == 0)
+        return value;
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool LifetimesOverlap (const SRenderGraphLifetime& a, const SRenderGraphLifetime& b)
+{
+    return a.m_firstStep <= b.m_lastStep && b.m_firstStep <= a.m_lastStep;
+}
+
+static bool MemoryOverlaps (const SRenderGraphResource& a, const SRenderGraphPlacement& aPlacement, const SRenderGraphResource& b, const SRenderGraphPlacement& bPlacement)
+{
+    return aPlacement.m_heap == bPlacement.m_heap &&
+        aPlacement.m_offset < bPlacement.m_offset + b.m_desc.m_sizeInBytes &&
+        bPlacement.m_offset < aPlacement.m_offset + a.m_desc.m_sizeInBytes;
+}
+
+void RenderGraphClear (SRenderGraph& graph)
+{
+    graph.m_resources.clear();
+    graph.m_passes.clear();
+}
+
+UINT32 RenderGraphImport (SRenderGraph& graph, const char* name, const SRenderGraphTextureDesc& desc, void* external, RenderGraphState initialState, RenderGraphState finalState)
+{
+    SRenderGraphResource resource;
+    resource.m_name = name;
+    resource.m_desc = desc;
+    resource.m_imported = true;
+    resource.m_external = external;
+    resource.m_initialState = initialState;
+    resource.m_finalState = finalState;
+    graph.m_resources.push_back(resource);
+    return UINT32(graph.m_resources.size() - 1);
+}
+
+UINT32 RenderGraphCreate (SRenderGraph& graph, const char* name, const SRenderGraphTextureDesc& desc)
+{
+    SRenderGraphResource resource;
+    resource.m_name = name;
+    resource.m_desc = desc;
+    graph.m_resources.push_back(resource);
+    return UINT32(graph.m_resources.size() - 1);
+}
+
+UINT32 RenderGraphAddPass (SRenderGraph& graph, const char* name, const std::function<void ()>& execute, bool sideEffects)
+{
+    SRenderGraphPass pass;
+    pass.m_name = name;
+    pass.m_execute = execute;
+    pass.m_sideEffects = sideEffects;
+    graph.m_passes.push_back(std::move(pass));
+    return UINT32(graph.m_passes.size() - 1);
+}
+
+void RenderGraphUse (SRenderGraph& graph, UINT32 pass, UINT32 resource, ERenderGraphAccess access)
+{
+    if (pass >= graph.m_passes.size() || resource >= graph.m_resources.size() || access >= ERenderGraphAccess::Count)
+        throw std::exception();
+
+    SRenderGraphUse use;
+    use.m_resource = resource;
+    use.m_access = access;
+    graph.m_passes[pass].m_uses.push_back(use);
+}
+
+// Goes backwards through the passes, keeping a pass if it has side effects, writes an imported texture, or writes a
+// texture that a later kept pass uses. Writes count as uses too, because a pass may only write part of a texture.
+static void CullPasses (const SRenderGraph& graph, std::vector<bool>& live)
+{
+    std::vector<bool> needed(graph.m_resources.size(), false);
+    live.assign(graph.m_passes.size(), false);
+    for (size_t passIndex = graph.m_passes.size(); passIndex-- > 0;)
+    {
+        const SRenderGraphPass& pass = graph.m_passes[passIndex];
+        bool keep = pass.m_sideEffects;
+        for (const SRenderGraphUse& use : pass.m_uses)
+            keep |= RenderGraphAccessIsWrite(use.m_access) && (graph.m_resources[use.m_resource].m_imported || needed[use.m_resource]);
+
+        if (!keep)
+            continue;
+
+        live[passIndex] = true;
+        for (const SRenderGraphUse& use : pass.m_uses)
+            needed[use.m_resource] = true;
+    }
+}
+
+// the uses of the kept passes, sorted by texture and then step
+static void GatherUses (const SRenderGraph& graph, const SRenderGraphCompiled& compiled, std::vector<SRenderGraphPassUse>& uses, std::vector<UINT32>& firstUse)
+{
+    std::vector<SRenderGraphPassUse> stepUses;
+    for (UINT32 step = 0; step + 1 < compiled.m_steps.size(); ++step)
+    {
+        const SRenderGraphPass& pass = graph.m_passes[compiled.m_steps[step].m_pass];
+        size_t firstStepUse = stepUses.size();
+        for (const SRenderGraphUse& use : pass.m_uses)
+        {
+            bool write = RenderGraphAccessIsWrite(use.m_access);
+            RenderGraphState state = RenderGraphAccessState(use.m_access);
+
+            auto it = std::find_if(stepUses.begin() + firstStepUse, stepUses.end(), [&] (const SRenderGraphPassUse& other) { return other.m_resource == use.m_resource; });
+            if (it == stepUses.end())
+            {
+                stepUses.push_back({ use.m_resource, step, state, write });
+                continue;
+            }
+
+            if (write || it->m_write)
+                throw std::exception();
+            it->m_state |= state;
+        }
+    }
+
+    // counting sort by texture, which keeps them in step order
+    firstUse.assign(graph.m_resources.size() + 1, 0);
+    for (const SRenderGraphPassUse& use : stepUses)
+        firstUse[use.m_resource + 1]++;
+    for (size_t i = 1; i < firstUse.size(); ++i)
+        firstUse[i] += firstUse[i - 1];
+
+    uses.resize(stepUses.size());
+    std::vector<UINT32> next(firstUse.begin(), firstUse.end() - 1);
+    for (const SRenderGraphPassUse& use : stepUses)
+        uses[next[use.m_resource]++] = use;
+}
+
+static void AddTransition (std::vector<std::vector<SRenderGraphBarrier>>& stepBarriers, UINT32 resource, RenderGraphState before, RenderGraphState after, UINT32 lastStep, UINT32 nextStep, SRenderGraphStats& stats)
+{
+    SRenderGraphBarrier barrier;
+    barrier.m_resource = resource;
+    barrier.m_before = before;
+    barrier.m_after = after;
+
+    // with passes in between, the GPU can do the transition while it works on them
+    if (lastStep + 1 < nextStep)
+    {
+        barrier.m_type = ERenderGraphBarrierType::beginSplit;
+        stepBarriers[lastStep + 1].push_back(barrier);
+        barrier.m_type = ERenderGraphBarrierType::endSplit;
+        stepBarriers[nextStep].push_back(barrier);
+        stats.m_splitBarriers++;
+    }
+    else
+    {
+        barrier.m_type = ERenderGraphBarrierType::transition;
+        stepBarriers[nextStep].push_back(barrier);
+        stats.m_transitions++;
+    }
+}
+
+// Places the transient textures biggest first, each at the lowest offset of its heap group's heap that doesn't overlap a
+// texture it is alive at the same time as.
+static void PlaceTransients (const SRenderGraph& graph, const std::vector<SRenderGraphLifetime>& lifetimes, SRenderGraphCompiled& compiled)
+{
+    std::vector<SRenderGraphLifetime> order = lifetimes;
+    std::sort(order.begin(), order.end(),
+        [&] (const SRenderGraphLifetime& a, const SRenderGraphLifetime& b)
+        {
+            UINT64 sizeA = graph.m_resources[a.m_resource].m_desc.m_sizeInBytes;
+            UINT64 sizeB = graph.m_resources[b.m_resource].m_desc.m_sizeInBytes;
+            if (sizeA != sizeB)
+                return sizeA > sizeB;
+            return a.m_firstStep < b.m_firstStep;
+        }
+    );
+
+    std::vector<const SRenderGraphLifetime*> placed;
+    for (const SRenderGraphLifetime& lifetime : order)
+    {
+        const SRenderGraphResource& resource = graph.m_resources[lifetime.m_resource];
+        SRenderGraphPlacement& placement = compiled.m_placements[lifetime.m_resource];
+
+        UINT32 heapIndex = 0;
+        while (heapIndex < compiled.m_heaps.size() && compiled.m_heaps[heapIndex].m_heapGroup != resource.m_desc.m_heapGroup)
+            ++heapIndex;
+        if (heapIndex == compiled.m_heaps.size())
+        {
+            SRenderGraphHeap heap;
+            heap.m_heapGroup = resource.m_desc.m_heapGroup;
+            compiled.m_heaps.push_back(heap);
+        }
+        placement.m_heap = heapIndex;
+
+        // move past every texture in the way until nothing is
+        UINT64 offset = 0;
+        bool moved = true;
+        while (moved)
+        {
+            moved = false;
+            for (const SRenderGraphLifetime* other : placed)
+            {
+                const SRenderGraphResource& otherResource = graph.m_resources[other->m_resource];
+                const SRenderGraphPlacement& otherPlacement = compiled.m_placements[other->m_resource];
+                if (otherPlacement.m_heap != heapIndex || !LifetimesOverlap(lifetime, *other))
+                    continue;
+
+                if (offset < otherPlacement.m_offset + otherResource.m_desc.m_sizeInBytes && otherPlacement.m_offset < offset + resource.m_desc.m_sizeInBytes)
+                {
+                    offset = AlignUp(otherPlacement.m_offset + otherResource.m_desc.m_sizeInBytes, resource.m_desc.m_alignment);
+                    moved = true;
+                }
+            }
+        }
+        placement.m_offset = offset;
+        placed.push_back(&lifetime);
+
+        SRenderGraphHeap& heap = compiled.m_heaps[heapIndex];
+        heap.m_sizeInBytes = std::max<UINT64>(heap.m_sizeInBytes, offset + resource.m_desc.m_sizeInBytes);
+        heap.m_alignment = std::max<UINT64>(heap.m_alignment, resource.m_desc.m_alignment);
+        compiled.m_stats.m_transientBytes += resource.m_desc.m_sizeInBytes;
+    }
+
+    for (const SRenderGraphHeap& heap : compiled.m_heaps)
+        compiled.m_stats.m_heapBytes += heap.m_sizeInBytes;
+}
+
+void RenderGraphCompile (const SRenderGraph& graph, SRenderGraphCompiled& compiled)
+{
+    compiled.m_steps.clear();
+    compiled.m_barriers.clear();
+    compiled.m_placements.assign(graph.m_resources.size(), SRenderGraphPlacement());
+    compiled.m_heaps.clear();
+    compiled.m_stats = SRenderGraphStats();
+    compiled.m_stats.m_passes = graph.m_passes.size();
+
+    std::vector<bool> live;
+    CullPasses(graph, live);
+    for (UINT32 passIndex = 0; passIndex < graph.m_passes.size(); ++passIndex)
+    {
+        if (!live[passIndex])
+        {
+            compiled.m_stats.m_culledPasses++;
+            continue;
+        }
+        SRenderGraphStep step;
+        step.m_pass = passIndex;
+        compiled.m_steps.push_back(step);
+    }
+    compiled.m_steps.push_back(SRenderGraphStep());
+    UINT32 finalStep = UINT32(compiled.m_steps.size() - 1);
+
+    std::vector<SRenderGraphPassUse> uses;
+    std::vector<UINT32> firstUse;
+    GatherUses(graph, compiled, uses, firstUse);
+
+    std::vector<std::vector<SRenderGraphBarrier>> stepBarriers(compiled.m_steps.size());
+    std::vector<SRenderGraphLifetime> lifetimes;
+    std::vector<SRenderGraphSegment> segments;
+    for (UINT32 resourceIndex = 0; resourceIndex < graph.m_resources.size(); ++resourceIndex)
+    {
+        const SRenderGraphResource& resource = graph.m_resources[resourceIndex];
+
+        segments.clear();
+        for (UINT32 useIndex = firstUse[resourceIndex]; useIndex < firstUse[resourceIndex + 1]; ++useIndex)
+        {
+            const SRenderGraphPassUse& use = uses[useIndex];
+            if (!segments.empty() && !use.m_write && !segments.back().m_write)
+            {
+                segments.back().m_state |= use.m_state;
+                segments.back().m_lastStep = use.m_step;
+            }
+            else
+            {
+                segments.push_back({ use.m_step, use.m_step, use.m_state, use.m_write });
+            }
+        }
+
+        // transient textures nothing uses don't need memory
+        if (!resource.m_imported)
+        {
+            if (segments.empty())
+                continue;
+            if (!segments[0].m_write)
+                throw std::exception();
+            compiled.m_placements[resourceIndex].m_state = segments[0].m_state;
+            lifetimes.push_back({ resourceIndex, segments[0].m_firstStep, segments.back().m_lastStep });
+        }
+
+        RenderGraphState state = resource.m_imported ? resource.m_initialState : segments[0].m_state;
+        UINT32 lastStep = UINT32(-1);
+        bool lastWrite = false;
+        for (const SRenderGraphSegment& segment : segments)
+        {
+            if (segment.m_state != state)
+            {
+                AddTransition(stepBarriers, resourceIndex, state, segment.m_state, lastStep, segment.m_firstStep, compiled.m_stats);
+            }
+            else if (lastStep != UINT32(-1) && (segment.m_write || lastWrite) && (state & RenderGraphAccessState(ERenderGraphAccess::unorderedAccess)))
+            {
+                SRenderGraphBarrier barrier;
+                barrier.m_type = ERenderGraphBarrierType::unorderedAccess;
+                barrier.m_resource = resourceIndex;
+                barrier.m_before = state;
+                barrier.m_after = state;
+                stepBarriers[segment.m_firstStep].push_back(barrier);
+                compiled.m_stats.m_unorderedAccessBarriers++;
+            }
+            state = segment.m_state;
+            lastStep = segment.m_lastStep;
+            lastWrite = segment.m_write;
+        }
+
+        // Imported textures go to their final state by the end. Transient ones go back to their first state right after
+        // their last use, before a texture that shares their memory takes over.
+        if (resource.m_imported)
+        {
+            if (state != resource.m_finalState)
+                AddTransition(stepBarriers, resourceIndex, state, resource.m_finalState, lastStep, finalStep, compiled.m_stats);
+        }
+        else if (state != segments[0].m_state)
+        {
+            AddTransition(stepBarriers, resourceIndex, state, segments[0].m_state, lastStep, lastStep + 1, compiled.m_stats);
+        }
+    }
+
+    PlaceTransients(graph, lifetimes, compiled);
+
+    // A texture that shares memory with others needs an aliasing barrier before its first use each frame. It names the
+    // texture it takes over from when there is only one.
+    for (const SRenderGraphLifetime& lifetime : lifetimes)
+    {
+        const SRenderGraphResource& resource = graph.m_resources[lifetime.m_resource];
+        const SRenderGraphPlacement& placement = compiled.m_placements[lifetime.m_resource];
+
+        size_t overlaps = 0;
+        SRenderGraphBarrier barrier;
+        barrier.m_type = ERenderGraphBarrierType::aliasing;
+        barrier.m_resource = lifetime.m_resource;
+        for (const SRenderGraphLifetime& other : lifetimes)
+        {
+            if (other.m_resource != lifetime.m_resource && MemoryOverlaps(resource, placement, graph.m_resources[other.m_resource], compiled.m_placements[other.m_resource]))
+            {
+                barrier.m_resourceBefore = other.m_resource;
+                overlaps++;
+            }
+        }
+
+        if (overlaps == 0)
+            continue;
+        if (overlaps > 1)
+            barrier.m_resourceBefore = c_renderGraphNoResource;
+        barrier.m_before = barrier.m_after = placement.m_state;
+        stepBarriers[lifetime.m_firstStep].push_back(barrier);
+        compiled.m_stats.m_aliasingBarriers++;
+    }
+
+    // aliasing barriers go after the transitions of the step, which may be of the textures being taken over from
+    for (size_t stepIndex = 0; stepIndex < compiled.m_steps.size(); ++stepIndex)
+    {
+        std::vector<SRenderGraphBarrier>& barriers = stepBarriers[stepIndex];
+        std::stable_partition(barriers.begin(), barriers.end(), [] (const SRenderGraphBarrier& barrier) { return barrier.m_type != ERenderGraphBarrierType::aliasing; });
+
+        SRenderGraphStep& step = compiled.m_steps[stepIndex];
+        step.m_firstBarrier = UINT32(compiled.m_barriers.size());
+        step.m_barrierCount = UINT32(barriers.size());
+        compiled.m_barriers.insert(compiled.m_barriers.end(), barriers.begin(), barriers.end());
+    }
+}
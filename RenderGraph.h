@@ -0,0 +1,171 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// A frame described as passes that say which textures they read and write. Compiling it culls the passes nothing
+// needs, works out the barriers between the passes, and places the textures that only live within the frame in shared
+// heaps, so that textures whose lifetimes don't overlap use the same memory. cdGraphicsAPIDX12 makes the heaps and
+// textures, and records the barriers and passes.
+//
+// Textures are either imported, like the back buffer, which the graph only moves between states, or transient, which
+// the graph owns. Transient textures have to be written before they are read in a frame, because what another texture
+// left in their memory is garbage. They start and end the frame in the state of their first use, so the graph can be
+// run again the next frame without knowing what the last one did.
+
+// What a pass does with a texture. Each is a bit in a state, and reads can be combined into one state so that a texture
+// that several passes read in different ways only needs one transition. A write can't be combined with anything.
+enum class ERenderGraphAccess
+{
+    // writes
+    renderTarget,
+    depthWrite,
+    unorderedAccess,
+    copyDest,
+
+    // reads
+    depthRead,
+    pixelShaderResource,
+    nonPixelShaderResource,
+    copySource,
+    present,
+
+    Count
+};
+
+typedef UINT32 RenderGraphState;
+
+static const UINT32 c_renderGraphNoResource = UINT32(-1);
+static const UINT32 c_renderGraphNoPass = UINT32(-1);
+
+inline RenderGraphState RenderGraphAccessState (ERenderGraphAccess access)
+{
+    return RenderGraphState(1) << UINT32(access);
+}
+
+inline bool RenderGraphAccessIsWrite (ERenderGraphAccess access)
+{
+    return access < ERenderGraphAccess::depthRead;
+}
+
+// The format and flags are DXGI_FORMAT and D3D12_RESOURCE_FLAGS values, which the graph only compares. The size,
+// alignment and heap group come from the device: textures only share memory with textures in the same heap group.
+struct SRenderGraphTextureDesc
+{
+    UINT32  m_width = 0;
+    UINT32  m_height = 0;
+    UINT32  m_arraySize = 1;
+    UINT32  m_format = 0;
+    UINT32  m_flags = 0;
+    UINT64  m_sizeInBytes = 0;
+    UINT64  m_alignment = 0;
+    UINT32  m_heapGroup = 0;
+};
+
+struct SRenderGraphResource
+{
+    const char*             m_name = nullptr;
+    SRenderGraphTextureDesc m_desc;
+    bool                    m_imported = false;
+    void*                   m_external = nullptr;   // what the owner of an imported texture finds it by
+    RenderGraphState        m_initialState = 0;     // imported textures are in this state before the graph
+    RenderGraphState        m_finalState = 0;       // and are left in this state after it
+};
+
+struct SRenderGraphUse
+{
+    UINT32              m_resource = 0;
+    ERenderGraphAccess  m_access = ERenderGraphAccess::Count;
+};
+
+struct SRenderGraphPass
+{
+    const char*                     m_name = nullptr;
+    std::vector<SRenderGraphUse>    m_uses;
+    bool                            m_sideEffects = false;  // never culled, for passes whose results leave the graph some other way
+    std::function<void ()>          m_execute;
+};
+
+struct SRenderGraph
+{
+    std::vector<SRenderGraphResource>   m_resources;
+    std::vector<SRenderGraphPass>       m_passes;
+};
+
+enum class ERenderGraphBarrierType
+{
+    transition,
+    beginSplit,     // starts a transition right after the last use in the old state
+    endSplit,       // and finishes it right before the first use in the new one
+    unorderedAccess,
+    aliasing,       // the texture takes over memory that other textures used earlier
+};
+
+struct SRenderGraphBarrier
+{
+    ERenderGraphBarrierType m_type = ERenderGraphBarrierType::transition;
+    UINT32                  m_resource = 0;
+    UINT32                  m_resourceBefore = c_renderGraphNoResource;    // for aliasing, if only one texture used the memory before
+    RenderGraphState        m_before = 0;
+    RenderGraphState        m_after = 0;
+};
+
+// A pass that survived culling and the barriers that go right before it. The last step has no pass, and has the
+// barriers that leave the textures in their final states.
+struct SRenderGraphStep
+{
+    UINT32  m_pass = c_renderGraphNoPass;
+    UINT32  m_firstBarrier = 0;
+    UINT32  m_barrierCount = 0;
+};
+
+// where a transient texture lives. Imported textures and transient textures that no pass uses have no heap.
+struct SRenderGraphPlacement
+{
+    UINT32              m_heap = c_renderGraphNoResource;
+    UINT64              m_offset = 0;
+    RenderGraphState    m_state = 0;            // the state it starts and ends the frame in
+};
+
+struct SRenderGraphHeap
+{
+    UINT32  m_heapGroup = 0;
+    UINT64  m_sizeInBytes = 0;
+    UINT64  m_alignment = 0;
+};
+
+struct SRenderGraphStats
+{
+    size_t m_passes = 0;
+    size_t m_culledPasses = 0;
+    size_t m_transitions = 0;
+    size_t m_splitBarriers = 0;             // each is a begin and an end
+    size_t m_unorderedAccessBarriers = 0;
+    size_t m_aliasingBarriers = 0;
+    UINT64 m_transientBytes = 0;            // what the transient textures would take up each in their own memory
+    UINT64 m_heapBytes = 0;                 // what they take up in the heaps
+};
+
+struct SRenderGraphCompiled
+{
+    std::vector<SRenderGraphStep>       m_steps;
+    std::vector<SRenderGraphBarrier>    m_barriers;
+    std::vector<SRenderGraphPlacement>  m_placements;   // one per resource
+    std::vector<SRenderGraphHeap>       m_heaps;
+    SRenderGraphStats                   m_stats;
+};
+
+void RenderGraphClear (SRenderGraph& graph);
+
+UINT32 RenderGraphImport (SRenderGraph& graph, const char* name, const SRenderGraphTextureDesc& desc, void* external, RenderGraphState initialState, RenderGraphState finalState);
+
+UINT32 RenderGraphCreate (SRenderGraph& graph, const char* name, const SRenderGraphTextureDesc& desc);
+
+UINT32 RenderGraphAddPass (SRenderGraph& graph, const char* name, const std::function<void ()>& execute, bool sideEffects = false);
+
+// A pass can use a texture more than once, if all of the uses are reads.
+void RenderGraphUse (SRenderGraph& graph, UINT32 pass, UINT32 resource, ERenderGraphAccess access);
+
+// Throws if a pass both writes a texture and uses it some other way, or a transient texture is read before it is
+// written.
+void RenderGraphCompile (const SRenderGraph& graph, SRenderGraphCompiled& compiled);
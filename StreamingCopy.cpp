@@ -0,0 +1,65 @@
+#include "stdafx.h"
+
+#include "StreamingCopy.h"
+
+#include <cstring>
+#include <immintrin.h>
+
+size_t StreamingCopyChangedLines (void* dest, void* mirror, const void* source, size_t size, SStreamingCopyStats& stats)
+{
+    unsigned char* destBytes = (unsigned char*)dest;
+    unsigned char* mirrorBytes = (unsigned char*)mirror;
+    const unsigned char* sourceBytes = (const unsigned char*)source;
+
+    size_t written = 0;
+    size_t fullLines = size / c_streamingCopyLineSize;
+    for (size_t i = 0; i < fullLines; ++i)
+    {
+        size_t offset = i * c_streamingCopyLineSize;
+        __m128i line = _mm_loadu_si128((const __m128i*)(sourceBytes + offset));
+        __m128i old = _mm_loadu_si128((const __m128i*)(mirrorBytes + offset));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(line, old)) == 0xFFFF)
+            continue;
+
+        _mm_stream_si128((__m128i*)(destBytes + offset), line);
+        _mm_storeu_si128((__m128i*)(mirrorBytes + offset), line);
+        ++written;
+    }
+
+    // a partial line at the end can't be a 16 byte store without writing past the end of the source
+    size_t tailOffset = fullLines * c_streamingCopyLineSize;
+    size_t tailSize = size - tailOffset;
+    if (tailSize > 0 && memcmp(sourceBytes + tailOffset, mirrorBytes + tailOffset, tailSize) != 0)
+    {
+        memcpy(destBytes + tailOffset, sourceBytes + tailOffset, tailSize);
+        memcpy(mirrorBytes + tailOffset, sourceBytes + tailOffset, tailSize);
+        ++written;
+    }
+
+    // make the non-temporal stores visible before the GPU is told to read them
+    if (written > 0)
+        _mm_sfence();
+
+    stats.m_copies++;
+    stats.m_lines += fullLines + (tailSize > 0 ? 1 : 0);
+    stats.m_linesWritten += written;
+    return written;
+}
+
+void StreamingCopy (void* dest, const void* source, size_t size)
+{
+    unsigned char* destBytes = (unsigned char*)dest;
+    const unsigned char* sourceBytes = (const unsigned char*)source;
+
+    size_t fullLines = size / c_streamingCopyLineSize;
+    for (size_t i = 0; i < fullLines; ++i)
+    {
+        size_t offset = i * c_streamingCopyLineSize;
+        _mm_stream_si128((__m128i*)(destBytes + offset), _mm_loadu_si128((const __m128i*)(sourceBytes + offset)));
+    }
+
+    size_t tailOffset = fullLines * c_streamingCopyLineSize;
+    memcpy(destBytes + tailOffset, sourceBytes + tailOffset, size - tailOffset);
+
+    _mm_sfence();
+}
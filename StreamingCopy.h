@@ -0,0 +1,23 @@
+#pragma once
+
+// Copies into write combined memory, like mapped upload heaps, without reading it and without writing what didn't
+// change. Any memory will do as the destination, as long as it is 16 byte aligned.
+//
+// The caller keeps a mirror of what is in the destination. The source is compared against the mirror 16 bytes at a
+// time, and only the lines that differ are written, with non-temporal stores so they don't go through the cache.
+
+static const size_t c_streamingCopyLineSize = 16;
+
+struct SStreamingCopyStats
+{
+    size_t m_copies = 0;
+    size_t m_lines = 0;
+    size_t m_linesWritten = 0;
+};
+
+// Writes the lines of source that differ from mirror to dest, and updates mirror to match. dest has to be 16 byte
+// aligned. Returns the number of lines written.
+size_t StreamingCopyChangedLines (void* dest, void* mirror, const void* source, size_t size, SStreamingCopyStats& stats);
+
+// Writes all of source to dest with non-temporal stores. dest has to be 16 byte aligned.
+void StreamingCopy (void* dest, const void* source, size_t size);
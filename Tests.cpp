@@ -0,0 +1,1405 @@
+#include "stdafx.h"
+
+#include "BarrierBatch.h"
+#include "Benchmarks.h"
+#include "CommandStateFilter.h"
+#include "DeferredRelease.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorRing.h"
+#include "FrameLatency.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "QueueSync.h"
+#include "RenderGraph.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// The rules of the modules that don't use D3D12, checked one at a time, and the timings of the ones that don't need
+// the assets. Unlike the benchmarks, which run with -benchmark, this builds anywhere with the CMakeLists.txt next to it,
+// and runs as a ctest. Returns the number of failed checks as the exit code.
+
+// Prints every check as PASS or FAIL, and counts the failures
+class TestReport
+{
+public:
+    void Log (const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+
+    void Check (bool condition, const char* format, ...)
+    {
+        if (!condition)
+            ++m_failureCount;
+
+        printf("%s: ", condition ? "PASS" : "FAIL");
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf("\n");
+    }
+
+    size_t GetFailureCount () const { return m_failureCount; }
+
+private:
+    size_t  m_failureCount = 0;
+};
+
+static void TestCommandStateFilter (TestReport& report)
+{
+    static const size_t c_numCalls = 1000000;
+
+    report.Log("===== Command State Filter =====");
+
+    // the rules, one at a time
+    {
+        int pso[2], rootSignature[2];
+        SCommandStateFilter filter;
+        CommandStateFilterReset(filter, &pso[0]);
+
+        bool ok = !CommandStateFilterPipelineState(filter, &pso[0]) &&
+            CommandStateFilterPipelineState(filter, &pso[1]) &&
+            !CommandStateFilterPipelineState(filter, &pso[1]);
+        report.Check(ok, "pipeline state is filtered, starting with the one the command list was reset with");
+
+        ok = CommandStateFilterRootSignature(filter, &rootSignature[0]) &&
+            CommandStateFilterRootTable(filter, 3, 100) &&
+            !CommandStateFilterRootTable(filter, 3, 100) &&
+            CommandStateFilterRootTable(filter, 3, 200) &&
+            !CommandStateFilterRootSignature(filter, &rootSignature[0]) &&
+            !CommandStateFilterRootTable(filter, 3, 200) &&
+            CommandStateFilterRootSignature(filter, &rootSignature[1]) &&
+            CommandStateFilterRootTable(filter, 3, 200);
+        report.Check(ok, "root tables are filtered, and forgotten when the root signature changes");
+
+        CommandStateFilterDescriptorHeaps(filter);
+        ok = CommandStateFilterRootTable(filter, 3, 200) &&
+            !CommandStateFilterRootTable(filter, 3, 200);
+        report.Check(ok, "root tables are forgotten when the descriptor heaps change");
+
+        ok = CommandStateFilterVertexBuffer(filter, 0, { 1000, 64, 16 }) &&
+            !CommandStateFilterVertexBuffer(filter, 0, { 1000, 64, 16 }) &&
+            CommandStateFilterVertexBuffer(filter, 0, { 1000, 64, 32 }) &&
+            CommandStateFilterVertexBuffer(filter, 1, { 1000, 64, 32 }) &&
+            CommandStateFilterVertexBuffer(filter, UINT32(c_commandStateMaxVertexBuffers), { 1000, 64, 32 }) &&
+            CommandStateFilterVertexBuffer(filter, UINT32(c_commandStateMaxVertexBuffers), { 1000, 64, 32 }) &&
+            CommandStateFilterIndexBuffer(filter, { 2000, 60, 42 }) &&
+            !CommandStateFilterIndexBuffer(filter, { 2000, 60, 42 }) &&
+            CommandStateFilterIndexBuffer(filter, { 2000, 60, 57 }) &&
+            CommandStateFilterTopology(filter, 4) &&
+            !CommandStateFilterTopology(filter, 4);
+        report.Check(ok, "vertex buffers, index buffers and topology are filtered on every field");
+
+        size_t calls = filter.m_stats.m_calls;
+        CommandStateFilterReset(filter, nullptr);
+        ok = filter.m_stats.m_calls == calls &&
+            CommandStateFilterPipelineState(filter, &pso[1]) &&
+            CommandStateFilterRootSignature(filter, &rootSignature[1]) &&
+            CommandStateFilterVertexBuffer(filter, 0, { 1000, 64, 32 }) &&
+            CommandStateFilterIndexBuffer(filter, { 2000, 60, 57 }) &&
+            CommandStateFilterTopology(filter, 4);
+        report.Check(ok, "reset forgets the bound state and keeps the stats");
+    }
+
+    // random calls against a simple model of the command list that remembers everything that was set
+    {
+        int objects[4];
+        std::mt19937 rng(5678);
+        SCommandStateFilter filter;
+        CommandStateFilterReset(filter, nullptr);
+
+        std::map<UINT64, UINT64> bound;
+        size_t expectedFiltered = 0;
+        size_t mismatches = 0;
+        BenchmarkTimer timer;
+        for (size_t i = 0; i < c_numCalls; ++i)
+        {
+            UINT32 value = rng() % 4;
+            UINT32 slot = rng() % 8;
+            UINT64 key;
+            bool needed;
+            switch (rng() % 4)
+            {
+                case 0:
+                    key = 1ull << 32;
+                    needed = CommandStateFilterPipelineState(filter, &objects[value]);
+                    break;
+                case 1:
+                {
+                    key = 2ull << 32;
+                    needed = CommandStateFilterRootSignature(filter, &objects[value]);
+                    if (bound.count(key) == 0 || bound[key] != value)
+                    {
+                        for (UINT64 rootParameter = 0; rootParameter < 8; ++rootParameter)
+                            bound.erase((3ull << 32) | rootParameter);
+                    }
+                    break;
+                }
+                case 2:
+                    key = (3ull << 32) | slot;
+                    needed = CommandStateFilterRootTable(filter, slot, value);
+                    break;
+                default:
+                    key = (4ull << 32) | slot;
+                    needed = CommandStateFilterVertexBuffer(filter, slot, { value, 64, 16 });
+                    break;
+            }
+
+            bool expectedNeeded = bound.count(key) == 0 || bound[key] != value;
+            bound[key] = value;
+            if (!expectedNeeded)
+                ++expectedFiltered;
+            if (needed != expectedNeeded)
+                ++mismatches;
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        report.Check(mismatches == 0 && filter.m_stats.m_filtered == expectedFiltered, "%zu random calls filtered the same as a reference (%zu mismatches)", c_numCalls, mismatches);
+        report.Log("  %zu of %zu calls filtered, %0.2f ns per call including the reference", filter.m_stats.m_filtered, filter.m_stats.m_calls, seconds * 1e9 / double(c_numCalls));
+    }
+}
+
+static void TestFramePacer (TestReport& report)
+{
+    static const size_t c_numFrames = 10000;
+    static const double c_cpuMilliseconds = 4.0;
+    static const double c_gpuMilliseconds = 5.0;
+
+    report.Log("===== Frame Pacer =====");
+
+    // the rules, one at a time
+    {
+        SFramePacer pacer;
+        bool threw = false;
+        try
+        {
+            FramePacerInit(pacer, 0);
+        }
+        catch (const std::exception&)
+        {
+            threw = true;
+        }
+        report.Check(threw, "zero frames in flight is an error");
+
+        FramePacerInit(pacer, 2);
+        bool ok = FramePacerContext(pacer) == 0 && FramePacerAcquire(pacer, 0) == 0 && FramePacerSubmit(pacer) == 1 &&
+            FramePacerContext(pacer) == 1 && FramePacerAcquire(pacer, 0) == 0 && FramePacerSubmit(pacer) == 2;
+        report.Check(ok && pacer.m_stats.m_waits == 0, "the first use of each context doesn't wait");
+
+        ok = FramePacerContext(pacer) == 0 && FramePacerFenceValue(pacer) == 3 && FramePacerAcquire(pacer, 0) == 1;
+        report.Check(ok && pacer.m_stats.m_waits == 1, "reusing a context waits for the frame that used it last, and not the one before");
+
+        ok = FramePacerAcquire(pacer, 1) == 1;
+        report.Check(ok && pacer.m_stats.m_waits == 1, "no wait once that frame is done");
+    }
+
+    // A simulated fence. The CPU takes a while to record each frame and the GPU a while to run it, with some jitter.
+    // The GPU runs frames in order, and frame n signals n + 1 when it's done, so the completed fence value at a time is
+    // the number of frames done by then. The CPU waits on the fence when the pacer says to.
+    for (unsigned int framesInFlight = 1; framesInFlight <= 3; ++framesInFlight)
+    {
+        std::mt19937 rng(5678);
+        std::uniform_real_distribution<double> jitter(0.8, 1.2);
+        SFramePacer pacer;
+        FramePacerInit(pacer, framesInFlight);
+
+        std::vector<double> frameDone;
+        size_t reusedTooSoon = 0;
+        size_t tooFarAhead = 0;
+        double cpuTime = 0.0;
+        double gpuTime = 0.0;
+        for (size_t frame = 0; frame < c_numFrames; ++frame)
+        {
+            UINT64 completed = UINT64(std::upper_bound(frameDone.begin(), frameDone.end(), cpuTime) - frameDone.begin());
+            UINT64 fenceValue = FramePacerAcquire(pacer, completed);
+            if (completed < fenceValue)
+                cpuTime = frameDone[size_t(fenceValue - 1)];
+
+            // the last frame to use this context has to be done, and the CPU can't be more than N frames ahead
+            if (frame >= framesInFlight && frameDone[frame - framesInFlight] > cpuTime)
+                ++reusedTooSoon;
+            UINT64 framesOnGPU = frame - UINT64(std::upper_bound(frameDone.begin(), frameDone.end(), cpuTime) - frameDone.begin());
+            if (framesOnGPU >= framesInFlight)
+                ++tooFarAhead;
+
+            cpuTime += c_cpuMilliseconds * jitter(rng);
+            FramePacerSubmit(pacer);
+
+            gpuTime = std::max<double>(gpuTime, cpuTime) + c_gpuMilliseconds * jitter(rng);
+            frameDone.push_back(gpuTime);
+        }
+
+        report.Check(reusedTooSoon == 0 && tooFarAhead == 0, "%u in flight: contexts were never reused before the GPU was done with them (%zu reused too soon, %zu too far ahead)", framesInFlight, reusedTooSoon, tooFarAhead);
+        report.Log("  %u in flight: %0.2f ms per frame with %0.1f ms of CPU and %0.1f ms of GPU, %zu of %zu frames waited", framesInFlight, gpuTime / double(c_numFrames), c_cpuMilliseconds, c_gpuMilliseconds, pacer.m_stats.m_waits, pacer.m_stats.m_frames);
+    }
+}
+
+static void TestFrameLatency (TestReport& report)
+{
+    static const size_t c_framesPerPhase = 2000;
+    static const unsigned int c_maxLatency = 3;
+    static const double c_tolerance = 0.1;
+
+    report.Log("===== Frame Latency =====");
+
+    // the rules, one at a time
+    {
+        SFrameLatencyController controller;
+        int threw = 0;
+        try
+        {
+            FrameLatencyInit(controller, 0, 2, c_tolerance);
+        }
+        catch (const std::exception&)
+        {
+            threw++;
+        }
+        try
+        {
+            FrameLatencyInit(controller, 3, 2, c_tolerance);
+        }
+        catch (const std::exception&)
+        {
+            threw++;
+        }
+        report.Check(threw == 2, "a latency of 0, or a max below the min, is an error");
+
+        // GPU bound with little CPU work, so the CPU and GPU taking turns costs 5%
+        FrameLatencyInit(controller, 1, c_maxLatency, c_tolerance);
+        bool ok = controller.m_latency == c_maxLatency;
+        for (unsigned int i = 0; i + 1 < c_frameLatencyFramesBeforeChange; ++i)
+            ok = ok && !FrameLatencyUpdate(controller, 0.5, 10.0, 0.0);
+        ok = ok && controller.m_latency == c_maxLatency && FrameLatencyUpdate(controller, 0.5, 10.0, 0.0) && controller.m_latency == 1;
+        report.Check(ok && controller.m_stats.m_decreases == 1, "starts at the max, and goes down to 1 once the GPU has been the bottleneck for %u frames", c_frameLatencyFramesBeforeChange);
+
+        ok = !FrameLatencyUpdate(controller, 30.0, 10.0, 0.0);
+        for (unsigned int i = 0; i < 2 * c_frameLatencyFramesBeforeChange; ++i)
+            ok = ok && !FrameLatencyUpdate(controller, 0.5, 10.0, 0.0);
+        report.Check(ok && controller.m_latency == 1, "a single slow CPU frame doesn't change the latency");
+
+        // CPU time jumps between 2 and 8 ms, which only a third frame can cover without the GPU going idle
+        for (unsigned int i = 0; i < 10 * c_frameLatencyFramesBeforeChange; ++i)
+            FrameLatencyUpdate(controller, (i % 2) ? 2.0 : 8.0, 6.0, 0.0);
+        report.Check(controller.m_latency == c_maxLatency && controller.m_stats.m_increases >= 1, "spiky CPU times raise the latency to the max");
+
+        FrameLatencyInit(controller, 1, 2, c_tolerance);
+        for (unsigned int i = 0; i < 10 * c_frameLatencyFramesBeforeChange; ++i)
+            FrameLatencyUpdate(controller, 10.0, 2.0, 0.0);
+        report.Check(controller.m_latency == 2 && controller.m_stats.m_decreases == 0, "CPU bound frames keep the CPU and GPU overlapped");
+    }
+
+    // A simulated CPU and GPU going through a GPU bound scene, one with spiky CPU times, and a CPU bound one. With a
+    // latency of L, the CPU can't start a frame until the GPU is done with the frame L before it. The latency of a
+    // frame is from when the CPU starts it, which is when it reads input, to when the GPU is done with it.
+    struct SPolicy
+    {
+        const char* m_name;
+        unsigned int m_fixedLatency;    // 0 to adapt
+        double m_frameMilliseconds;
+        double m_latencyMilliseconds;
+    };
+    SPolicy policies[] =
+    {
+        { "latency 1", 1, 0.0, 0.0 },
+        { "latency 3", 3, 0.0, 0.0 },
+        { "adaptive", 0, 0.0, 0.0 },
+    };
+
+    for (SPolicy& policy : policies)
+    {
+        std::mt19937 rng(6789);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        SFrameLatencyController controller;
+        FrameLatencyInit(controller, 1, c_maxLatency, c_tolerance);
+
+        std::vector<double> gpuDone;
+        double cpuEnd = 0.0;
+        double totalLatency = 0.0;
+        size_t numFrames = c_framesPerPhase * 3;
+        for (size_t frame = 0; frame < numFrames; ++frame)
+        {
+            double cpu, gpu;
+            switch (frame / c_framesPerPhase)
+            {
+                case 0: cpu = 0.8 + 0.4 * unit(rng); gpu = 8.0; break;
+                case 1: cpu = 1.0 + 8.0 * unit(rng); gpu = 6.0; break;
+                default: cpu = 8.5 + unit(rng); gpu = 3.0; break;
+            }
+
+            unsigned int latency = policy.m_fixedLatency ? policy.m_fixedLatency : controller.m_latency;
+            double cpuStart = cpuEnd;
+            if (frame >= latency)
+                cpuStart = std::max<double>(cpuStart, gpuDone[frame - latency]);
+            double waited = cpuStart - cpuEnd;
+
+            cpuEnd = cpuStart + cpu;
+            double gpuStart = gpuDone.empty() ? cpuEnd : std::max<double>(cpuEnd, gpuDone.back());
+            gpuDone.push_back(gpuStart + gpu);
+            totalLatency += gpuDone.back() - cpuStart;
+
+            FrameLatencyUpdate(controller, cpu, gpu, waited);
+        }
+
+        policy.m_frameMilliseconds = gpuDone.back() / double(numFrames);
+        policy.m_latencyMilliseconds = totalLatency / double(numFrames);
+        report.Log("  %-10s %0.2f ms per frame, %0.2f ms latency", policy.m_name, policy.m_frameMilliseconds, policy.m_latencyMilliseconds);
+        if (!policy.m_fixedLatency)
+            report.Log("  %-10s %zu increases, %zu decreases, %0.1f ms per frame waiting to start", "", controller.m_stats.m_increases, controller.m_stats.m_decreases, controller.m_stats.m_waitMilliseconds / double(numFrames));
+    }
+
+    const SPolicy& lowest = policies[0];
+    const SPolicy& highest = policies[1];
+    const SPolicy& adaptive = policies[2];
+    report.Check(adaptive.m_frameMilliseconds < lowest.m_frameMilliseconds && adaptive.m_latencyMilliseconds < highest.m_latencyMilliseconds, "adapting is faster than a latency of 1, with less latency than a latency of %u", c_maxLatency);
+}
+
+static void TestDeferredRelease (TestReport& report)
+{
+    report.Log("===== Deferred Release =====");
+
+    SDeferredReleaseQueue queue;
+    std::vector<SDeferredRelease> retired;
+    SDeferredRelease release;
+    release.m_bytes = 100;
+    release.m_fenceValue = 1;
+    DeferredReleasePush(queue, release);
+    release.m_kind = EDeferredReleaseKind::descriptorRange;
+    release.m_first = 5;
+    release.m_count = 3;
+    release.m_bytes = 96;
+    release.m_fenceValue = 2;
+    DeferredReleasePush(queue, release);
+
+    bool ok = queue.m_stats.m_pending == 2 && queue.m_stats.m_pendingBytes == 196;
+    report.Check(ok, "pending counts and bytes add up");
+
+    DeferredReleaseRetire(queue, 0, retired);
+    ok = retired.empty();
+    DeferredReleaseRetire(queue, 1, retired);
+    ok = ok && retired.size() == 1 && retired[0].m_kind == EDeferredReleaseKind::object && queue.m_stats.m_pendingBytes == 96;
+    report.Check(ok, "entries come out once their fence value completes, and not before");
+
+    bool threw = false;
+    try
+    {
+        release.m_fenceValue = 1;
+        DeferredReleasePush(queue, release);
+    }
+    catch (const std::exception&)
+    {
+        threw = true;
+    }
+    report.Check(threw, "pushing a lower fence value than the last one is an error");
+
+    DeferredReleaseRetire(queue, 5, retired);
+    ok = retired.size() == 2 && retired[1].m_first == 5 && retired[1].m_count == 3 && queue.m_stats.m_pending == 0 &&
+        queue.m_stats.m_pendingBytes == 0 && queue.m_stats.m_released == 2 && queue.m_stats.m_releasedBytes == 196 &&
+        queue.m_stats.m_peakPendingBytes == 196;
+    report.Check(ok, "retiring gives back what was pushed, and the stats follow");
+}
+
+// Sums [begin, end) of the data into the job's slot. Big ranges are split into two jobs, and the job waits for them,
+// which runs other jobs meanwhile, so this checks that jobs can depend on jobs they hand out.
+struct SJobSumTree
+{
+    SJobSystem*         m_system;
+    const UINT32*       m_values;
+    size_t              m_grainSize;
+};
+
+struct SJobSumNode
+{
+    const SJobSumTree*  m_tree;
+    UINT64              m_sum;
+};
+
+static void JobSumRange (const SJob& job)
+{
+    SJobSumNode& node = *(SJobSumNode*)job.m_data;
+    const SJobSumTree& tree = *node.m_tree;
+    node.m_sum = 0;
+
+    if (job.m_end - job.m_begin <= tree.m_grainSize)
+    {
+        for (size_t i = job.m_begin; i < job.m_end; ++i)
+            node.m_sum += tree.m_values[i];
+        return;
+    }
+
+    SJobSumNode children[2] = { { &tree, 0 }, { &tree, 0 } };
+    SJob jobs[2];
+    size_t middle = (job.m_begin + job.m_end) / 2;
+    for (size_t i = 0; i < 2; ++i)
+    {
+        jobs[i].m_function = JobSumRange;
+        jobs[i].m_data = &children[i];
+        jobs[i].m_begin = (i == 0) ? job.m_begin : middle;
+        jobs[i].m_end = (i == 0) ? middle : job.m_end;
+    }
+
+    SJobCounter counter;
+    JobSystemRun(*tree.m_system, jobs, 2, counter);
+    JobSystemWait(*tree.m_system, counter);
+    node.m_sum = children[0].m_sum + children[1].m_sum;
+}
+
+// a few hundred nanoseconds of work, which is about as small as engine jobs get
+static void JobSpin (const SJob& job)
+{
+    UINT32 value = UINT32(job.m_begin);
+    for (size_t i = 0; i < 100; ++i)
+        value = value * 1664525u + 1013904223u;
+    ((std::atomic<UINT32>*)job.m_data)->fetch_add(value & 1, std::memory_order_relaxed);
+}
+
+static void TestJobSystem (TestReport& report)
+{
+    static const size_t c_numItems = 100000;
+    static const size_t c_numJobs = 200000;
+    static const size_t c_jobsPerBatch = 256;
+    static const size_t c_maxThreads = 64;
+
+    report.Log("===== Job System =====");
+
+    SJobSystem system;
+    JobSystemInit(system, 4);
+    report.Check(JobSystemThreadCount(system) == 4, "the job system has the threads it was asked for");
+
+    int threw = 0;
+    try { JobSystemInit(system, 4); } catch (...) { ++threw; }
+    report.Check(threw == 1, "starting a job system twice throws");
+
+    std::vector<std::atomic<UINT32>> visits(c_numItems);
+    for (std::atomic<UINT32>& visit : visits)
+        visit = 0;
+    JobSystemParallelFor(system, c_numItems, 7,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                visits[i]++;
+        }
+    );
+    bool ok = true;
+    for (const std::atomic<UINT32>& visit : visits)
+        ok &= visit == 1;
+    report.Check(ok, "parallel for visits every item once, with a grain size that doesn't divide the count");
+
+    size_t maxConcurrent = 0;
+    std::atomic<size_t> concurrent(0);
+    std::mutex maxLock;
+    JobSystemParallelFor(system, 64, 1,
+        [&] (size_t, size_t)
+        {
+            size_t now = ++concurrent;
+            {
+                std::lock_guard<std::mutex> lock(maxLock);
+                maxConcurrent = std::max<size_t>(maxConcurrent, now);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            --concurrent;
+        },
+        2
+    );
+    report.Check(maxConcurrent <= 2, "parallel for uses at most the threads it is given (%zu at once)", maxConcurrent);
+
+    std::vector<UINT32> values(c_numItems);
+    UINT64 expectedSum = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = UINT32(i * 2654435761u) >> 8;
+        expectedSum += values[i];
+    }
+    SJobSumTree tree = { &system, values.data(), 1000 };
+    SJobSumNode root = { &tree, 0 };
+    SJob rootJob;
+    rootJob.m_function = JobSumRange;
+    rootJob.m_data = &root;
+    rootJob.m_end = values.size();
+    SJobCounter counter;
+    JobSystemRun(system, &rootJob, 1, counter);
+    JobSystemWait(system, counter);
+    report.Check(root.m_sum == expectedSum && counter.m_pending == 0, "jobs that wait on jobs they hand out get the right sum");
+
+    // more jobs than a deque holds, from the thread that owns a deque
+    std::atomic<UINT32> ran(0);
+    std::vector<SJob> jobs(c_jobDequeCapacity * 3);
+    for (SJob& job : jobs)
+    {
+        job.m_function = JobSpin;
+        job.m_data = &ran;
+    }
+    SJobSystemStats before = JobSystemGetStats(system);
+    JobSystemRun(system, jobs.data(), jobs.size(), counter);
+    JobSystemWait(system, counter);
+    SJobSystemStats after = JobSystemGetStats(system);
+    report.Check(after.m_inlineJobs > before.m_inlineJobs && after.m_jobsRun - before.m_jobsRun == jobs.size(), "jobs that don't fit in the deque run right away, and every job runs once");
+
+    // from a thread that isn't a worker
+    std::thread external([&] ()
+    {
+        SJobCounter externalCounter;
+        JobSystemRun(system, jobs.data(), 100, externalCounter);
+        JobSystemWait(system, externalCounter);
+    });
+    external.join();
+    after = JobSystemGetStats(system);
+    report.Check(after.m_externalJobs == 100, "jobs from other threads go through the locked queue, and finish");
+
+    JobSystemShutdown(system);
+    report.Check(JobSystemThreadCount(system) == 0, "shutting down stops the threads");
+    JobSystemInit(system, 2);
+    counter.m_pending = 0;
+    JobSystemRun(system, &rootJob, 1, counter);
+    JobSystemWait(system, counter);
+    report.Check(root.m_sum == expectedSum, "a job system can be started again after shutting down");
+    JobSystemShutdown(system);
+
+    // Throughput of tiny jobs handed out by one thread in batches, which the others have to steal, and scaling of a
+    // parallel for over the same work, from 1 to 64 threads. Threads past the hardware thread count show what
+    // oversubscribing costs.
+    report.Log("  %u hardware threads", std::thread::hardware_concurrency());
+    double oneThreadJobsPerSecond = 0.0;
+    double oneThreadParallelFor = 0.0;
+    for (size_t numThreads = 1; numThreads <= c_maxThreads; numThreads *= 2)
+    {
+        SJobSystem system;
+        JobSystemInit(system, numThreads);
+
+        std::atomic<UINT32> ran(0);
+        std::vector<SJob> jobs(c_jobsPerBatch);
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            jobs[i].m_function = JobSpin;
+            jobs[i].m_data = &ran;
+            jobs[i].m_begin = i;
+        }
+
+        BenchmarkTimer timer;
+        for (size_t batch = 0; batch < c_numJobs / c_jobsPerBatch; ++batch)
+        {
+            SJobCounter counter;
+            JobSystemRun(system, jobs.data(), jobs.size(), counter);
+            JobSystemWait(system, counter);
+        }
+        double jobsPerSecond = double(c_numJobs / c_jobsPerBatch * c_jobsPerBatch) / timer.ElapsedSeconds();
+        SJobSystemStats stats = JobSystemGetStats(system);
+
+        std::vector<UINT32> results(c_numJobs);
+        timer.Reset();
+        JobSystemParallelFor(system, c_numJobs, 64,
+            [&] (size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    UINT32 value = UINT32(i);
+                    for (size_t j = 0; j < 100; ++j)
+                        value = value * 1664525u + 1013904223u;
+                    results[i] = value;
+                }
+            }
+        );
+        double parallelForMilliseconds = timer.ElapsedSeconds() * 1000.0;
+        JobSystemShutdown(system);
+
+        if (numThreads == 1)
+        {
+            oneThreadJobsPerSecond = jobsPerSecond;
+            oneThreadParallelFor = parallelForMilliseconds;
+        }
+
+        report.Log("  %2zu threads: %0.2f M jobs/s (%0.2fx), %0.1f%% of jobs stolen, %0.1f%% of steals worked, %zu sleeps. parallel for %0.2f ms (%0.2fx)",
+            numThreads, jobsPerSecond / 1000000.0, jobsPerSecond / oneThreadJobsPerSecond,
+            100.0 * double(stats.m_steals) / double(std::max<size_t>(stats.m_jobsRun, 1)),
+            100.0 * double(stats.m_steals) / double(std::max<size_t>(stats.m_stealAttempts, 1)),
+            stats.m_sleeps, parallelForMilliseconds, oneThreadParallelFor / parallelForMilliseconds);
+    }
+}
+
+// a texture of width x height at 4 bytes a pixel, with the 64KB alignment of placed textures
+static SRenderGraphTextureDesc RenderGraphTestDesc (UINT32 width, UINT32 height, UINT32 heapGroup = 0)
+{
+    SRenderGraphTextureDesc desc;
+    desc.m_width = width;
+    desc.m_height = height;
+    desc.m_sizeInBytes = (UINT64(width) * height * 4 + 65535) & ~UINT64(65535);
+    desc.m_alignment = 65536;
+    desc.m_heapGroup = heapGroup;
+    return desc;
+}
+
+// ReserveGeneralHeapID without a device: a full allocator doubles, and the transient ring of the replaced heap starts over
+static UINT32 ReserveGrowing (SDescriptorAllocator& allocator, SDescriptorRing& ring, UINT32 count)
+{
+    UINT32 offset;
+    if (!DescriptorAllocatorAllocate(allocator, count, offset))
+    {
+        DescriptorAllocatorGrow(allocator, std::max<UINT32>(allocator.m_capacity * 2, allocator.m_capacity + count));
+        DescriptorRingReset(ring);
+        if (!DescriptorAllocatorAllocate(allocator, count, offset))
+            throw std::exception();
+    }
+    return offset;
+}
+
+// Plays the barriers of a compiled graph, and checks that every pass finds its textures in the states it uses them in,
+// that nothing is used in the middle of a split barrier, that the textures end the graph in the states they started in,
+// and that transient textures alive at the same time don't share memory.
+static bool RenderGraphValid (const SRenderGraph& graph, const SRenderGraphCompiled& compiled)
+{
+    static const RenderGraphState c_inSplit = 0;
+
+    std::vector<RenderGraphState> states(graph.m_resources.size());
+    std::vector<UINT32> firstStep(graph.m_resources.size(), UINT32(-1));
+    std::vector<UINT32> lastStep(graph.m_resources.size(), 0);
+    for (size_t i = 0; i < graph.m_resources.size(); ++i)
+        states[i] = graph.m_resources[i].m_imported ? graph.m_resources[i].m_initialState : compiled.m_placements[i].m_state;
+
+    for (UINT32 stepIndex = 0; stepIndex < compiled.m_steps.size(); ++stepIndex)
+    {
+        const SRenderGraphStep& step = compiled.m_steps[stepIndex];
+        for (UINT32 barrierIndex = step.m_firstBarrier; barrierIndex < step.m_firstBarrier + step.m_barrierCount; ++barrierIndex)
+        {
+            const SRenderGraphBarrier& barrier = compiled.m_barriers[barrierIndex];
+            RenderGraphState& state = states[barrier.m_resource];
+            switch (barrier.m_type)
+            {
+                case ERenderGraphBarrierType::transition:
+                case ERenderGraphBarrierType::beginSplit:
+                {
+                    if (state != barrier.m_before || barrier.m_before == barrier.m_after)
+                        return false;
+                    state = (barrier.m_type == ERenderGraphBarrierType::beginSplit) ? c_inSplit : barrier.m_after;
+                    break;
+                }
+                case ERenderGraphBarrierType::endSplit:
+                {
+                    if (state != c_inSplit)
+                        return false;
+                    state = barrier.m_after;
+                    break;
+                }
+                case ERenderGraphBarrierType::unorderedAccess:
+                {
+                    if (!(state & RenderGraphAccessState(ERenderGraphAccess::unorderedAccess)))
+                        return false;
+                    break;
+                }
+                case ERenderGraphBarrierType::aliasing:
+                {
+                    if (graph.m_resources[barrier.m_resource].m_imported)
+                        return false;
+                    break;
+                }
+            }
+        }
+
+        if (step.m_pass == c_renderGraphNoPass)
+            continue;
+
+        for (const SRenderGraphUse& use : graph.m_passes[step.m_pass].m_uses)
+        {
+            if (!(states[use.m_resource] & RenderGraphAccessState(use.m_access)))
+                return false;
+            firstStep[use.m_resource] = std::min<UINT32>(firstStep[use.m_resource], stepIndex);
+            lastStep[use.m_resource] = std::max<UINT32>(lastStep[use.m_resource], stepIndex);
+        }
+    }
+
+    for (size_t i = 0; i < graph.m_resources.size(); ++i)
+    {
+        const SRenderGraphResource& resource = graph.m_resources[i];
+        if (states[i] != (resource.m_imported ? resource.m_finalState : compiled.m_placements[i].m_state))
+            return false;
+        if (!resource.m_imported && (firstStep[i] == UINT32(-1)) != (compiled.m_placements[i].m_heap == c_renderGraphNoResource))
+            return false;
+    }
+
+    for (size_t i = 0; i < graph.m_resources.size(); ++i)
+    {
+        const SRenderGraphPlacement& a = compiled.m_placements[i];
+        if (a.m_heap == c_renderGraphNoResource)
+            continue;
+        if (a.m_offset + graph.m_resources[i].m_desc.m_sizeInBytes > compiled.m_heaps[a.m_heap].m_sizeInBytes || compiled.m_heaps[a.m_heap].m_heapGroup != graph.m_resources[i].m_desc.m_heapGroup)
+            return false;
+
+        for (size_t j = i + 1; j < graph.m_resources.size(); ++j)
+        {
+            const SRenderGraphPlacement& b = compiled.m_placements[j];
+            if (b.m_heap != a.m_heap || firstStep[i] > lastStep[j] || firstStep[j] > lastStep[i])
+                continue;
+            if (a.m_offset < b.m_offset + graph.m_resources[j].m_desc.m_sizeInBytes && b.m_offset < a.m_offset + graph.m_resources[i].m_desc.m_sizeInBytes)
+                return false;
+        }
+    }
+    return true;
+}
+
+// the barriers of one texture in a compiled graph, with the step each is in
+static std::vector<std::pair<UINT32, SRenderGraphBarrier>> RenderGraphBarriersOf (const SRenderGraphCompiled& compiled, UINT32 resource)
+{
+    std::vector<std::pair<UINT32, SRenderGraphBarrier>> ret;
+    for (UINT32 stepIndex = 0; stepIndex < compiled.m_steps.size(); ++stepIndex)
+    {
+        const SRenderGraphStep& step = compiled.m_steps[stepIndex];
+        for (UINT32 barrierIndex = step.m_firstBarrier; barrierIndex < step.m_firstBarrier + step.m_barrierCount; ++barrierIndex)
+        {
+            if (compiled.m_barriers[barrierIndex].m_resource == resource)
+                ret.push_back({ stepIndex, compiled.m_barriers[barrierIndex] });
+        }
+    }
+    return ret;
+}
+
+static void TestRenderGraph (TestReport& report)
+{
+    static const size_t c_numChainPasses = 2000;
+    static const size_t c_numCompiles = 100;
+
+    report.Log("===== Render Graph =====");
+
+    RenderGraphState present = RenderGraphAccessState(ERenderGraphAccess::present);
+    RenderGraphState renderTarget = RenderGraphAccessState(ERenderGraphAccess::renderTarget);
+    RenderGraphState pixelShaderResource = RenderGraphAccessState(ERenderGraphAccess::pixelShaderResource);
+    RenderGraphState nonPixelShaderResource = RenderGraphAccessState(ERenderGraphAccess::nonPixelShaderResource);
+    auto nothing = [] () {};
+
+    // the rules, one at a time
+    {
+        // passes that only write textures nobody reads are culled, unless they have side effects
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(64, 64), nullptr, present, present);
+        UINT32 unused = RenderGraphCreate(graph, "Unused", RenderGraphTestDesc(64, 64));
+        UINT32 feedsUnused = RenderGraphCreate(graph, "Feeds Unused", RenderGraphTestDesc(64, 64));
+        UINT32 pass = RenderGraphAddPass(graph, "Feeds Unused", nothing);
+        RenderGraphUse(graph, pass, feedsUnused, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Unused", nothing);
+        RenderGraphUse(graph, pass, feedsUnused, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, unused, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Side Effects", nothing, true);
+        pass = RenderGraphAddPass(graph, "Draw", nothing);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+        bool ok = compiled.m_stats.m_culledPasses == 2 && compiled.m_steps.size() == 3 && compiled.m_steps[0].m_pass == 2 && compiled.m_steps[1].m_pass == 3 &&
+            compiled.m_placements[unused].m_heap == c_renderGraphNoResource && compiled.m_placements[feedsUnused].m_heap == c_renderGraphNoResource && compiled.m_heaps.empty();
+        report.Check(ok && RenderGraphValid(graph, compiled), "passes whose results nothing uses are culled, along with what only they needed, but passes with side effects aren't");
+    }
+    {
+        // a transition with passes in between its last and next use is split over them, and one without isn't
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(64, 64), nullptr, present, present);
+        UINT32 early = RenderGraphCreate(graph, "Early", RenderGraphTestDesc(64, 64));
+        UINT32 late = RenderGraphCreate(graph, "Late", RenderGraphTestDesc(64, 64));
+        UINT32 pass = RenderGraphAddPass(graph, "Write Early", nothing);
+        RenderGraphUse(graph, pass, early, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Write Late", nothing);
+        RenderGraphUse(graph, pass, late, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Combine", nothing);
+        RenderGraphUse(graph, pass, early, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, late, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+
+        auto earlyBarriers = RenderGraphBarriersOf(compiled, early);
+        auto lateBarriers = RenderGraphBarriersOf(compiled, late);
+        bool ok = earlyBarriers.size() >= 2 && earlyBarriers[0].first == 1 && earlyBarriers[0].second.m_type == ERenderGraphBarrierType::beginSplit &&
+            earlyBarriers[1].first == 2 && earlyBarriers[1].second.m_type == ERenderGraphBarrierType::endSplit &&
+            earlyBarriers[1].second.m_before == renderTarget && earlyBarriers[1].second.m_after == pixelShaderResource;
+        ok = ok && lateBarriers.size() >= 1 && lateBarriers[0].first == 2 && lateBarriers[0].second.m_type == ERenderGraphBarrierType::transition;
+        report.Check(ok && RenderGraphValid(graph, compiled), "transitions are split over the passes between the last and next use, and plain when there are none");
+
+        ok = compiled.m_placements[early].m_state == renderTarget && earlyBarriers.back().first == 3 && earlyBarriers.back().second.m_after == renderTarget;
+        report.Check(ok, "transient textures go back to the state of their first use after their last use");
+    }
+    {
+        // reads next to each other are one state, and a pass can read a texture more than one way
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(64, 64), nullptr, present, present);
+        UINT32 texture = RenderGraphCreate(graph, "Texture", RenderGraphTestDesc(64, 64));
+        UINT32 pass = RenderGraphAddPass(graph, "Write", nothing);
+        RenderGraphUse(graph, pass, texture, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Read Pixel", nothing);
+        RenderGraphUse(graph, pass, texture, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Read Both", nothing);
+        RenderGraphUse(graph, pass, texture, ERenderGraphAccess::nonPixelShaderResource);
+        RenderGraphUse(graph, pass, texture, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+
+        auto barriers = RenderGraphBarriersOf(compiled, texture);
+        bool ok = barriers.size() == 2 && barriers[0].first == 1 && barriers[0].second.m_after == (pixelShaderResource | nonPixelShaderResource) &&
+            barriers[1].first == 3 && barriers[1].second.m_before == (pixelShaderResource | nonPixelShaderResource);
+        report.Check(ok && RenderGraphValid(graph, compiled), "reads in a row share one transition to all of their states");
+    }
+    {
+        // writes of the same texture as a uav one after another need a uav barrier between them, and nothing else does
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(64, 64), nullptr, present, present);
+        UINT32 uav = RenderGraphCreate(graph, "UAV", RenderGraphTestDesc(64, 64, 1));
+        for (int i = 0; i < 3; ++i)
+        {
+            UINT32 pass = RenderGraphAddPass(graph, "Write UAV", nothing);
+            RenderGraphUse(graph, pass, uav, ERenderGraphAccess::unorderedAccess);
+        }
+        UINT32 pass = RenderGraphAddPass(graph, "Read UAV", nothing);
+        RenderGraphUse(graph, pass, uav, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+
+        auto barriers = RenderGraphBarriersOf(compiled, uav);
+        bool ok = compiled.m_stats.m_unorderedAccessBarriers == 2 && barriers.size() == 4 &&
+            barriers[0].first == 1 && barriers[0].second.m_type == ERenderGraphBarrierType::unorderedAccess &&
+            barriers[1].first == 2 && barriers[1].second.m_type == ERenderGraphBarrierType::unorderedAccess &&
+            barriers[2].first == 3 && barriers[2].second.m_type == ERenderGraphBarrierType::transition;
+        report.Check(ok && RenderGraphValid(graph, compiled), "uav writes in a row get uav barriers between them");
+    }
+    {
+        // textures alive at different times share memory, and ones alive at the same time or in other heap groups don't
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(256, 256), nullptr, present, present);
+        UINT32 first = RenderGraphCreate(graph, "First", RenderGraphTestDesc(256, 256));
+        UINT32 second = RenderGraphCreate(graph, "Second", RenderGraphTestDesc(256, 256));
+        UINT32 third = RenderGraphCreate(graph, "Third", RenderGraphTestDesc(256, 256));
+        UINT32 other = RenderGraphCreate(graph, "Other Group", RenderGraphTestDesc(256, 256, 1));
+        UINT32 pass = RenderGraphAddPass(graph, "Write First", nothing);
+        RenderGraphUse(graph, pass, first, ERenderGraphAccess::renderTarget);
+        RenderGraphUse(graph, pass, other, ERenderGraphAccess::unorderedAccess);
+        pass = RenderGraphAddPass(graph, "First To Second", nothing);
+        RenderGraphUse(graph, pass, first, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, second, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Second To Third", nothing);
+        RenderGraphUse(graph, pass, second, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, third, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Third To Back Buffer", nothing);
+        RenderGraphUse(graph, pass, third, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, other, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+
+        UINT64 size = graph.m_resources[first].m_desc.m_sizeInBytes;
+        const std::vector<SRenderGraphPlacement>& placements = compiled.m_placements;
+        bool ok = compiled.m_heaps.size() == 2 && placements[first].m_heap == placements[third].m_heap && placements[first].m_offset == placements[third].m_offset &&
+            placements[second].m_heap == placements[first].m_heap && placements[second].m_offset != placements[first].m_offset &&
+            placements[other].m_heap != placements[first].m_heap && compiled.m_stats.m_transientBytes == 4 * size && compiled.m_stats.m_heapBytes == 3 * size;
+        report.Check(ok && RenderGraphValid(graph, compiled), "textures with lifetimes that don't overlap share memory (%zu KB in heaps for %zu KB of textures)",
+            size_t(compiled.m_stats.m_heapBytes / 1024), size_t(compiled.m_stats.m_transientBytes / 1024));
+
+        auto thirdBarriers = RenderGraphBarriersOf(compiled, third);
+        auto secondBarriers = RenderGraphBarriersOf(compiled, second);
+        ok = compiled.m_stats.m_aliasingBarriers == 2 && !thirdBarriers.empty() && thirdBarriers[0].first == 2 &&
+            thirdBarriers[0].second.m_type == ERenderGraphBarrierType::aliasing && thirdBarriers[0].second.m_resourceBefore == first &&
+            secondBarriers.size() == 2 && secondBarriers[0].second.m_type != ERenderGraphBarrierType::aliasing;
+        for (const auto& barrier : RenderGraphBarriersOf(compiled, other))
+            ok = ok && barrier.second.m_type != ERenderGraphBarrierType::aliasing;
+        report.Check(ok, "textures that share memory get an aliasing barrier before their first use, naming the texture they take over from");
+    }
+    {
+        // imported textures start in their initial state and end in their final one, even if no pass uses them
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 imported = RenderGraphImport(graph, "Imported", RenderGraphTestDesc(64, 64), nullptr, RenderGraphAccessState(ERenderGraphAccess::copyDest), pixelShaderResource);
+        UINT32 untouched = RenderGraphImport(graph, "Untouched", RenderGraphTestDesc(64, 64), nullptr, present, renderTarget);
+        UINT32 pass = RenderGraphAddPass(graph, "Draw", nothing);
+        RenderGraphUse(graph, pass, imported, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+
+        auto barriers = RenderGraphBarriersOf(compiled, imported);
+        auto untouchedBarriers = RenderGraphBarriersOf(compiled, untouched);
+        bool ok = barriers.size() == 2 && barriers[0].second.m_after == renderTarget && barriers[1].first == 1 && barriers[1].second.m_after == pixelShaderResource &&
+            !untouchedBarriers.empty() && untouchedBarriers.back().second.m_after == renderTarget && compiled.m_heaps.empty();
+        report.Check(ok && RenderGraphValid(graph, compiled), "imported textures go from their initial state to their final state");
+    }
+    {
+        // graphs that can't work are errors
+        auto throws = [] (const std::function<void (SRenderGraph& graph)>& build)
+        {
+            SRenderGraph graph;
+            SRenderGraphCompiled compiled;
+            try
+            {
+                build(graph);
+                RenderGraphCompile(graph, compiled);
+            }
+            catch (const std::exception&)
+            {
+                return true;
+            }
+            return false;
+        };
+
+        bool ok = throws([] (SRenderGraph& graph)
+        {
+            UINT32 texture = RenderGraphCreate(graph, "Texture", RenderGraphTestDesc(64, 64));
+            UINT32 pass = RenderGraphAddPass(graph, "Read And Write", [] () {}, true);
+            RenderGraphUse(graph, pass, texture, ERenderGraphAccess::renderTarget);
+            RenderGraphUse(graph, pass, texture, ERenderGraphAccess::pixelShaderResource);
+        });
+        report.Check(ok, "a pass that writes a texture and uses it another way is an error");
+
+        ok = throws([] (SRenderGraph& graph)
+        {
+            UINT32 texture = RenderGraphCreate(graph, "Texture", RenderGraphTestDesc(64, 64));
+            UINT32 pass = RenderGraphAddPass(graph, "Read", [] () {}, true);
+            RenderGraphUse(graph, pass, texture, ERenderGraphAccess::pixelShaderResource);
+        });
+        report.Check(ok, "reading a transient texture before anything writes it is an error");
+
+        ok = throws([] (SRenderGraph& graph)
+        {
+            UINT32 pass = RenderGraphAddPass(graph, "Pass", [] () {});
+            RenderGraphUse(graph, pass, 0, ERenderGraphAccess::renderTarget);
+        }) && throws([] (SRenderGraph& graph)
+        {
+            UINT32 texture = RenderGraphCreate(graph, "Texture", RenderGraphTestDesc(64, 64));
+            RenderGraphUse(graph, 0, texture, ERenderGraphAccess::renderTarget);
+        });
+        report.Check(ok, "using a texture or pass that doesn't exist is an error");
+    }
+
+    {
+        // Realizing a graph makes a view of each of its transient textures in the general heap. When the heap is full that
+        // grows it, and the tables made before are gone with the ring of the old heap, which is why the frame realizes
+        // the graph before it makes any.
+        SRenderGraph graph;
+        SRenderGraphCompiled compiled;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(64, 64), nullptr, present, present);
+        UINT32 scene = RenderGraphCreate(graph, "Scene", RenderGraphTestDesc(64, 64));
+        UINT32 blurred = RenderGraphCreate(graph, "Blurred", RenderGraphTestDesc(64, 64));
+        UINT32 pass = RenderGraphAddPass(graph, "Scene", nothing);
+        RenderGraphUse(graph, pass, scene, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Blur", nothing);
+        RenderGraphUse(graph, pass, scene, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, blurred, ERenderGraphAccess::renderTarget);
+        pass = RenderGraphAddPass(graph, "Combine", nothing);
+        RenderGraphUse(graph, pass, blurred, ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+        RenderGraphCompile(graph, compiled);
+
+        // the textures loaded so far fill the heap, and a table of two of them is made before the graph is realized
+        SDescriptorAllocator allocator;
+        SDescriptorRing ring;
+        DescriptorAllocatorInit(allocator, 4);
+        DescriptorRingInit(ring, 16);
+        UINT32 textures = ReserveGrowing(allocator, ring, 4);
+        UINT32 sources[] = { textures, textures + 1 };
+        UINT32 offset;
+        bool needsCopy;
+        DescriptorRingAllocateTable(ring, sources, _countof(sources), offset, needsCopy);
+
+        UINT32 views = 0;
+        for (UINT32 resource = 0; resource < graph.m_resources.size(); ++resource)
+        {
+            if (!graph.m_resources[resource].m_imported && compiled.m_placements[resource].m_heap != c_renderGraphNoResource)
+            {
+                ReserveGrowing(allocator, ring, 1);
+                views++;
+            }
+        }
+        DescriptorRingAllocateTable(ring, sources, _countof(sources), offset, needsCopy);
+        bool ok = views == 2 && allocator.m_growths == 1 && needsCopy;
+        report.Check(ok, "realizing a graph in a full general heap grows it, and a table made before has to be made again");
+
+        // made after the graph is realized, the table lasts until the graph is executed
+        DescriptorRingAllocateTable(ring, sources, _countof(sources), offset, needsCopy);
+        report.Check(!needsCopy && allocator.m_growths == 1, "tables made after the graph is realized aren't lost to a growth");
+
+        // A pass that grows the heap again changes the growth count, which is how the frame knows to make its tables
+        // again. The graph's views keep their place in the bigger heap.
+        UINT32 growths = allocator.m_growths;
+        ReserveGrowing(allocator, ring, allocator.m_capacity);
+        DescriptorRingAllocateTable(ring, sources, _countof(sources), offset, needsCopy);
+        std::vector<SDescriptorRange> ranges;
+        DescriptorAllocatorGetAllocatedRanges(allocator, ranges);
+        ok = allocator.m_growths != growths && needsCopy && !ranges.empty() && ranges[0].m_offset == 0 && ranges[0].m_count >= 4 + views;
+        report.Check(ok, "a growth during the graph shows in the growth count, and the views made before it keep their place");
+    }
+
+    // A long post processing chain. Each pass reads the last one or two results and writes a new one at full, half or
+    // quarter size, some passes write results that nothing reads, some blur a uav in place a few times, and the last
+    // pass writes the back buffer.
+    {
+        std::mt19937 rng(4242);
+        SRenderGraph graph;
+        UINT32 backBuffer = RenderGraphImport(graph, "Back Buffer", RenderGraphTestDesc(1920, 1080), nullptr, present, present);
+        std::vector<UINT32> results;
+        auto nothingFn = [] () {};
+        for (size_t i = 0; i < c_numChainPasses; ++i)
+        {
+            UINT32 scale = 1 << (rng() % 3);
+            bool uav = (rng() % 4) == 0;
+            UINT32 result = RenderGraphCreate(graph, "Result", RenderGraphTestDesc(1920 / scale, 1080 / scale, uav ? 1 : 0));
+            UINT32 pass = RenderGraphAddPass(graph, "Post", nothingFn);
+            RenderGraphUse(graph, pass, result, uav ? ERenderGraphAccess::unorderedAccess : ERenderGraphAccess::renderTarget);
+            for (size_t input = 1; input <= 2 && input <= results.size(); ++input)
+            {
+                if (input == 1 || rng() % 2)
+                    RenderGraphUse(graph, pass, results[results.size() - input], uav ? ERenderGraphAccess::nonPixelShaderResource : ERenderGraphAccess::pixelShaderResource);
+            }
+
+            size_t blurs = uav ? rng() % 3 : 0;
+            for (size_t blur = 0; blur < blurs; ++blur)
+            {
+                pass = RenderGraphAddPass(graph, "Blur", nothingFn);
+                RenderGraphUse(graph, pass, result, ERenderGraphAccess::unorderedAccess);
+            }
+
+            // one in eight results is a debug view that nothing reads
+            if (rng() % 8 == 0)
+                continue;
+            results.push_back(result);
+        }
+        UINT32 pass = RenderGraphAddPass(graph, "Present", nothingFn);
+        RenderGraphUse(graph, pass, results.back(), ERenderGraphAccess::pixelShaderResource);
+        RenderGraphUse(graph, pass, backBuffer, ERenderGraphAccess::renderTarget);
+
+        SRenderGraphCompiled compiled;
+        BenchmarkTimer timer;
+        for (size_t i = 0; i < c_numCompiles; ++i)
+            RenderGraphCompile(graph, compiled);
+        double seconds = timer.ElapsedSeconds();
+
+        const SRenderGraphStats& stats = compiled.m_stats;
+        report.Check(RenderGraphValid(graph, compiled), "a %zu pass post processing chain compiles to a valid graph", stats.m_passes);
+        report.Log("  %zu passes culled, %zu transitions, %zu split barriers, %zu uav barriers, %zu aliasing barriers",
+            stats.m_culledPasses, stats.m_transitions, stats.m_splitBarriers, stats.m_unorderedAccessBarriers, stats.m_aliasingBarriers);
+        report.Log("  %0.1f MB of transient textures in %0.1f MB of heaps (%0.1f%% saved), %0.3f ms per compile",
+            double(stats.m_transientBytes) / (1024.0 * 1024.0), double(stats.m_heapBytes) / (1024.0 * 1024.0),
+            100.0 * (1.0 - double(stats.m_heapBytes) / double(std::max<UINT64>(stats.m_transientBytes, 1))), seconds * 1000.0 / double(c_numCompiles));
+    }
+}
+
+static void TestBarrierBatch (TestReport& report)
+{
+    static const size_t c_numTextures = 1000;
+    static const size_t c_numResources = 64;
+    static const size_t c_numFlushes = 100000;
+    static const size_t c_maxBarriersPerFlush = 16;
+
+    // made up state bits, like D3D12_RESOURCE_STATES
+    static const UINT32 c_copyDest = 0x400;
+    static const UINT32 c_shaderResource = 0x40 | 0x80;
+    static const UINT32 c_renderTarget = 0x4;
+    static const UINT32 c_unorderedAccess = 0x8;
+
+    report.Log("===== Barrier Batch =====");
+
+    int resources[4];
+
+    // the rules, one at a time
+    {
+        SBarrierBatch batch;
+        std::vector<SBarrier> barriers;
+        BarrierBatchTransition(batch, &resources[0], c_copyDest, c_shaderResource);
+        BarrierBatchTransition(batch, &resources[1], c_copyDest, c_shaderResource);
+        BarrierBatchTransition(batch, &resources[0], c_shaderResource, c_renderTarget);
+        BarrierBatchFlush(batch, barriers);
+        bool ok = barriers.size() == 2 && barriers[0].m_resource == &resources[0] && barriers[0].m_before == c_copyDest && barriers[0].m_after == c_renderTarget &&
+            barriers[1].m_resource == &resources[1] && batch.m_pending.empty();
+        report.Check(ok, "a transition that continues a pending one is merged into it, and the order is kept");
+
+        BarrierBatchTransition(batch, &resources[0], c_renderTarget, c_shaderResource);
+        BarrierBatchTransition(batch, &resources[0], c_shaderResource, c_renderTarget);
+        BarrierBatchTransition(batch, &resources[1], c_shaderResource, c_shaderResource);
+        BarrierBatchFlush(batch, barriers);
+        report.Check(barriers.empty() && batch.m_stats.m_flushes == 1, "transitions that end where they started and ones that go nowhere are dropped, and flushing nothing isn't a flush");
+
+        BarrierBatchUnorderedAccess(batch, &resources[2]);
+        BarrierBatchUnorderedAccess(batch, &resources[2]);
+        BarrierBatchUnorderedAccess(batch, &resources[3]);
+        BarrierBatchUnorderedAccess(batch, &resources[2]);
+        BarrierBatchUnorderedAccess(batch, nullptr);
+        BarrierBatchUnorderedAccess(batch, nullptr);
+        BarrierBatchFlush(batch, barriers);
+        ok = barriers.size() == 3 && barriers[0].m_resource == &resources[2] && barriers[1].m_resource == &resources[3] && barriers[2].m_resource == nullptr;
+        report.Check(ok, "uav barriers right after one of the same resource are dropped");
+
+        BarrierBatchTransition(batch, &resources[2], c_unorderedAccess, c_shaderResource, 0, 1);
+        BarrierBatchTransition(batch, &resources[2], c_shaderResource, c_renderTarget);
+        BarrierBatchTransition(batch, &resources[3], c_renderTarget, c_unorderedAccess);
+        BarrierBatchUnorderedAccess(batch, &resources[3]);
+        BarrierBatchTransition(batch, &resources[3], c_unorderedAccess, c_shaderResource);
+        BarrierBatchTransition(batch, &resources[1], c_shaderResource, c_copyDest, 0);
+        BarrierBatchTransition(batch, &resources[1], c_copyDest, c_shaderResource, 1);
+        BarrierBatchAliasing(batch, &resources[0], &resources[1]);
+        BarrierBatchTransition(batch, &resources[0], c_renderTarget, c_shaderResource);
+        BarrierBatchFlush(batch, barriers);
+        ok = barriers.size() == 9 && barriers[0].m_flags == 1 && barriers[7].m_type == EBarrierType::aliasing && barriers[7].m_resourceBefore == &resources[0];
+        report.Check(ok, "split transitions, transitions of other subresources, and transitions with a uav or aliasing barrier between them aren't merged");
+
+        const SBarrierBatchStats& stats = batch.m_stats;
+        ok = stats.m_requested == 21 && stats.m_issued == 14 && stats.m_merged == 2 && stats.m_dropped == 5 && stats.m_flushes == 3;
+        report.Check(ok, "the stats count %zu barriers asked for and %zu issued in %zu calls", stats.m_requested, stats.m_issued, stats.m_flushes);
+    }
+
+    // Loading textures: each is copied and then moved to a shader resource. The batch issues them in one call where the
+    // textures used to issue one call each.
+    {
+        std::vector<int> textures(c_numTextures);
+        SBarrierBatch batch;
+        std::vector<SBarrier> barriers;
+        for (int& texture : textures)
+            BarrierBatchTransition(batch, &texture, c_copyDest, c_shaderResource);
+        BarrierBatchFlush(batch, barriers);
+        report.Check(barriers.size() == c_numTextures && batch.m_stats.m_flushes == 1, "loading %zu textures issues their %zu transitions in %zu call", c_numTextures, batch.m_stats.m_issued, batch.m_stats.m_flushes);
+    }
+
+    // Random barriers on a pool of resources, flushed at random points. The states the issued barriers leave the
+    // resources in have to be the ones the requested barriers would have at every flush.
+    {
+        static const UINT32 c_states[] = { c_copyDest, c_shaderResource, c_renderTarget, c_unorderedAccess };
+
+        std::mt19937 rng(1357);
+        std::vector<int> pool(c_numResources);
+        std::vector<UINT32> requestedStates(c_numResources, c_copyDest);
+        std::vector<UINT32> issuedStates(c_numResources, c_copyDest);
+        SBarrierBatch batch;
+        std::vector<SBarrier> barriers;
+        size_t wrong = 0;
+
+        BenchmarkTimer timer;
+        for (size_t flush = 0; flush < c_numFlushes; ++flush)
+        {
+            size_t count = rng() % (c_maxBarriersPerFlush + 1);
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t resource = rng() % c_numResources;
+                UINT32 after = c_states[rng() % _countof(c_states)];
+                if ((requestedStates[resource] & c_unorderedAccess) && rng() % 4 == 0)
+                {
+                    BarrierBatchUnorderedAccess(batch, &pool[resource]);
+                    continue;
+                }
+                BarrierBatchTransition(batch, &pool[resource], requestedStates[resource], after);
+                requestedStates[resource] = after;
+            }
+
+            BarrierBatchFlush(batch, barriers);
+            for (const SBarrier& barrier : barriers)
+            {
+                if (barrier.m_type != EBarrierType::transition)
+                    continue;
+                UINT32& state = issuedStates[(const int*)barrier.m_resource - pool.data()];
+                if (state != barrier.m_before)
+                    ++wrong;
+                state = barrier.m_after;
+            }
+            if (issuedStates != requestedStates)
+                ++wrong;
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        const SBarrierBatchStats& stats = batch.m_stats;
+        report.Check(wrong == 0, "%zu random barriers over %zu flushes leave the resources in the states asked for (%zu wrong)", stats.m_requested, c_numFlushes, wrong);
+        report.Log("  %zu issued (%0.1f%%), %zu merged, %zu dropped, %zu calls instead of %zu, %0.2f ns per barrier",
+            stats.m_issued, 100.0 * double(stats.m_issued) / double(std::max<size_t>(stats.m_requested, 1)), stats.m_merged, stats.m_dropped,
+            stats.m_flushes, stats.m_requested, seconds * 1e9 / double(std::max<size_t>(stats.m_requested, 1)));
+    }
+}
+
+// What a simulated queue has been given and not done yet. Work signals the queue's fence with the value when it is
+// done, and needs the other queue's fence to be at least m_requires by then.
+struct SMockQueueOp
+{
+    bool    m_wait = false;
+    UINT64  m_value = 0;
+    UINT64  m_requires = 0;
+};
+
+struct SMockQueue
+{
+    std::deque<SMockQueueOp>    m_ops;
+    UINT64                      m_fence = 0;
+    UINT64                      m_requires = 0;     // the most of the other queue's fence that work recorded so far needs
+};
+
+// Does the op at the front of the queue, unless it is a wait for the other queue that isn't there yet. Counts work
+// that ran before the other queue got to what it needed.
+static bool MockQueueStep (SMockQueue& queue, const SMockQueue& otherQueue, size_t& violations)
+{
+    if (queue.m_ops.empty())
+        return false;
+
+    const SMockQueueOp& op = queue.m_ops.front();
+    if (op.m_wait)
+    {
+        if (otherQueue.m_fence < op.m_value)
+            return false;
+    }
+    else
+    {
+        if (otherQueue.m_fence < op.m_requires)
+            ++violations;
+        queue.m_fence = op.m_value;
+    }
+    queue.m_ops.pop_front();
+    return true;
+}
+
+static void TestQueueSync (TestReport& report)
+{
+    static const size_t c_numSubmits = 200000;
+    static const size_t c_maxStepsPerSubmit = 3;
+    static const size_t c_submitsPerCompletionRead = 8;
+
+    report.Log("===== Queue Sync =====");
+
+    // the rules, one at a time
+    {
+        SQueueSync sync;
+        int threw = 0;
+        QueueSyncSignal(sync, EQueue::graphics, 1);
+        QueueSyncSignal(sync, EQueue::graphics, 2);
+        try
+        {
+            QueueSyncSignal(sync, EQueue::graphics, 2);
+        }
+        catch (const std::exception&)
+        {
+            threw++;
+        }
+        try
+        {
+            QueueSyncWait(sync, EQueue::compute, EQueue::graphics, 3);
+        }
+        catch (const std::exception&)
+        {
+            threw++;
+        }
+        try
+        {
+            QueueSyncWait(sync, EQueue::graphics, EQueue::graphics, 1);
+        }
+        catch (const std::exception&)
+        {
+            threw++;
+        }
+        report.Check(threw == 3, "signaling a value that isn't later, waiting for a value not signaled yet, and a queue waiting for itself throw");
+
+        bool first = QueueSyncWait(sync, EQueue::compute, EQueue::graphics, 1);
+        bool again = QueueSyncWait(sync, EQueue::compute, EQueue::graphics, 1);
+        bool earlier = QueueSyncWait(sync, EQueue::compute, EQueue::graphics, 0);
+        bool later = QueueSyncWait(sync, EQueue::compute, EQueue::graphics, 2);
+        report.Check(first && !again && !earlier && later, "a wait covered by an earlier wait of the same queue is skipped");
+
+        QueueSyncSignal(sync, EQueue::compute, 5);
+        QueueSyncComplete(sync, EQueue::compute, 4);
+        QueueSyncComplete(sync, EQueue::compute, 3);
+        bool completed = QueueSyncWait(sync, EQueue::graphics, EQueue::compute, 4);
+        bool pending = QueueSyncWait(sync, EQueue::graphics, EQueue::compute, 5);
+        bool ok = !completed && pending && QueueSyncIsComplete(sync, EQueue::compute, 4) && !QueueSyncIsComplete(sync, EQueue::compute, 5);
+        report.Check(ok, "a wait for a value the CPU saw complete is skipped, and completion doesn't go backwards");
+
+        const SQueueSyncStats& stats = sync.m_stats;
+        ok = stats.m_signals == 3 && stats.m_waits == 3 && stats.m_waitsSkipped == 3;
+        report.Check(ok, "the stats count %zu signals, %zu waits and %zu skipped", stats.m_signals, stats.m_waits, stats.m_waitsSkipped);
+    }
+
+    // Two simulated queues, with work submitted to random ones that depends on random earlier work of the other, and
+    // the queues running random amounts in between. Every dependency has to be met by the waits that weren't skipped,
+    // and the queues can't get stuck waiting for each other.
+    {
+        std::mt19937 rng(2468);
+        SQueueSync sync;
+        SMockQueue queues[(size_t)EQueue::Count];
+        size_t violations = 0;
+        size_t stuck = 0;
+
+        BenchmarkTimer timer;
+        for (size_t submit = 0; submit < c_numSubmits; ++submit)
+        {
+            EQueue queue = EQueue(rng() % (size_t)EQueue::Count);
+            EQueue otherQueue = (queue == EQueue::graphics) ? EQueue::compute : EQueue::graphics;
+            SMockQueue& mockQueue = queues[(size_t)queue];
+
+            // depend on something the other queue was given lately, so that some of it is still running
+            UINT64 otherSignaled = sync.m_queues[(size_t)otherQueue].m_signaled;
+            if (otherSignaled > 0 && rng() % 2 == 0)
+            {
+                UINT64 value = otherSignaled - std::min<UINT64>(rng() % 8, otherSignaled - 1);
+                mockQueue.m_requires = std::max<UINT64>(mockQueue.m_requires, value);
+                if (QueueSyncWait(sync, queue, otherQueue, value))
+                {
+                    SMockQueueOp wait;
+                    wait.m_wait = true;
+                    wait.m_value = value;
+                    mockQueue.m_ops.push_back(wait);
+                }
+            }
+
+            SMockQueueOp work;
+            work.m_value = sync.m_queues[(size_t)queue].m_signaled + 1;
+            work.m_requires = mockQueue.m_requires;
+            QueueSyncSignal(sync, queue, work.m_value);
+            mockQueue.m_ops.push_back(work);
+
+            // the GPU gets some of it done, and the CPU sees that now and then
+            size_t steps = rng() % (c_maxStepsPerSubmit + 1);
+            for (size_t step = 0; step < steps; ++step)
+            {
+                size_t first = rng() % (size_t)EQueue::Count;
+                if (!MockQueueStep(queues[first], queues[1 - first], violations))
+                    MockQueueStep(queues[1 - first], queues[first], violations);
+            }
+            if (submit % c_submitsPerCompletionRead == 0)
+            {
+                QueueSyncComplete(sync, EQueue::graphics, queues[(size_t)EQueue::graphics].m_fence);
+                QueueSyncComplete(sync, EQueue::compute, queues[(size_t)EQueue::compute].m_fence);
+            }
+        }
+
+        // run the rest, which has to finish
+        while (!queues[0].m_ops.empty() || !queues[1].m_ops.empty())
+        {
+            bool stepped = MockQueueStep(queues[0], queues[1], violations);
+            stepped |= MockQueueStep(queues[1], queues[0], violations);
+            if (!stepped)
+            {
+                stuck++;
+                break;
+            }
+        }
+        double seconds = timer.ElapsedSeconds();
+
+        const SQueueSyncStats& stats = sync.m_stats;
+        report.Check(stuck == 0, "%zu submits on two queues with random dependencies all finish", c_numSubmits);
+        report.Check(violations == 0, "the work only runs once what it depends on is done (%zu too early)", violations);
+        size_t asked = stats.m_waits + stats.m_waitsSkipped;
+        report.Log("  %zu waits asked for, %zu issued, %zu skipped (%0.1f%%), %0.2f ns per submit",
+            asked, stats.m_waits, stats.m_waitsSkipped, 100.0 * double(stats.m_waitsSkipped) / double(std::max<size_t>(asked, 1)), seconds * 1e9 / double(c_numSubmits));
+    }
+}
+
+int main ()
+{
+    TestReport report;
+
+    TestCommandStateFilter(report);
+    TestFramePacer(report);
+    TestFrameLatency(report);
+    TestDeferredRelease(report);
+    TestJobSystem(report);
+    TestRenderGraph(report);
+    TestBarrierBatch(report);    TestQueueSync(report);
+
+    report.Log("===== %zu failures =====", report.GetFailureCount());
+    return int(report.GetFailureCount());
+}
@@ -2,62 +2,47 @@
 
 #include "TextureMgr.h"
 
+#include <algorithm>
+
+// stb_image keeps the reason a load failed in a global, which the decoding jobs would race on, so it doesn't keep one
+// and ReportLoadError says which file failed instead
+#define STBI_NO_FAILURE_STRINGS
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
-static float sRGBU8_To_LinearF32(stbi_uc value)
+// the root parameters of the mip generation compute shader
+enum MipsRootParameter
 {
-    return std::powf(float(value) / 255.0f, 2.2f);
-}
+    Source,
+    Destination,
+    Constants,
+};
 
-static stbi_uc LinearF32_To_sRGBU8(float value)
+// what mips.hlsl has in b0
+struct SMipConstants
 {
-    return stbi_uc(std::powf(value, 1.0f / 2.2f)*255.0f);
-}
+    UINT    m_isSRGB;
+    float   m_texelSize[2];
+};
 
-static void MakeNextMip(std::vector<stbi_uc>& srcU8, std::vector<float>& srcF32, int &textureWidth, int &textureHeight)
+// called from the decoding jobs, so the message is one call that other threads' messages can't end up in the middle of
+static void ReportLoadError (const char* fileName)
 {
-    // box blur for now. can replace with something else if needed.
-
-    // allocate memory for the mip
-    std::vector<float> dest;
-    int destWidth = textureWidth / 2;
-    int destHeight = textureWidth / 2;
-    dest.resize(destWidth * destHeight * 4); 
+    std::string message = std::string("Could not load texture ") + fileName + "\n";
+    OutputDebugStringA(message.c_str());
+}
 
-    // make the mip via box filter
-    size_t destPixel = 0;
-    for (size_t y = 0; y < destHeight; ++y)
+// the number of mips down to 1x1
+static UINT16 FullMipCount (UINT width, UINT height)
+{
+    UINT16 numMips = 1;
+    UINT size = std::max<UINT>(width, height);
+    while (size > 1)
     {
-        size_t srcPixel00 = (y * 2)*textureWidth * 4;
-        size_t srcPixel10 = (y * 2)*textureWidth * 4 + 4;
-        size_t srcPixel01 = (y * 2 + 1)*textureWidth * 4;
-        size_t srcPixel11 = (y * 2 + 1)*textureWidth * 4 + 4;
-        for (size_t x = 0; x < destWidth; ++x)
-        {
-            dest[destPixel + 0] = (srcF32[srcPixel00 + 0] + srcF32[srcPixel10 + 0] + srcF32[srcPixel01 + 0] + srcF32[srcPixel11 + 0]) / 4.0f;
-            dest[destPixel + 1] = (srcF32[srcPixel00 + 1] + srcF32[srcPixel10 + 1] + srcF32[srcPixel01 + 1] + srcF32[srcPixel11 + 1]) / 4.0f;
-            dest[destPixel + 2] = (srcF32[srcPixel00 + 2] + srcF32[srcPixel10 + 2] + srcF32[srcPixel01 + 2] + srcF32[srcPixel11 + 2]) / 4.0f;
-            dest[destPixel + 3] = (srcF32[srcPixel00 + 3] + srcF32[srcPixel10 + 3] + srcF32[srcPixel01 + 3] + srcF32[srcPixel11 + 3]) / 4.0f;
-
-            destPixel += 4;
-            srcPixel00 += 8;
-            srcPixel10 += 8;
-            srcPixel01 += 8;
-            srcPixel11 += 8;
-        }
+        size /= 2;
+        ++numMips;
     }
-
-    // dest is now src
-    srcF32.resize(dest.size());
-    srcU8.resize(dest.size());
-    memcpy(&srcF32[0], &dest[0], dest.size()*sizeof(float));
-    textureWidth = destWidth;
-    textureHeight = destHeight;
-
-    // convert the floating point mip to an sRGB u8 mip
-    for (size_t i = 0; i < dest.size(); ++i)
-        srcU8[i] = LinearF32_To_sRGBU8(srcF32[i]);
+    return numMips;
 }
 
 std::vector<UINT8> GenerateErrorTextureData (UINT TextureWidth, UINT TextureHeight, UINT TexturePixelSize)
@@ -96,11 +81,35 @@ std::vector<UINT8> GenerateErrorTextureData (UINT TextureWidth, UINT TextureHeig
     return data;
 }
 
-void TextureMgr::Create(cdGraphicsAPIDX12& graphicsAPI)
+void TextureMgr::Create(cdGraphicsAPIDX12& graphicsAPI, bool shaderDebug)
 {
     TextureMgr& mgr = Get(true);
     mgr.m_created = true;
 
+    // the mip generation compute shader
+    {
+        std::vector<cdRootSignatureParameter> rootSignatureParameters =
+        {
+            { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1 },
+            { D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1 },
+            { D3D12_DESCRIPTOR_RANGE_TYPE_CBV, sizeof(SMipConstants) / 4, ERootParameterKind::constants },
+            { D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, ERootParameterKind::staticSampler, 0, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP }
+        };
+        mgr.m_mipsRootSignature = graphicsAPI.CreateRootSignature(rootSignatureParameters);
+        if (!mgr.m_mipsRootSignature)
+            throw std::exception();
+
+        ID3DBlob* computeShader = nullptr;
+        if (!graphicsAPI.CompileCS(L"./assets/Shaders/mips.hlsl", computeShader, shaderDebug))
+            throw std::exception();
+
+        D3D12_COMPUTE_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.pRootSignature = mgr.m_mipsRootSignature;
+        psoDesc.CS = CD3DX12_SHADER_BYTECODE(computeShader);
+        ThrowIfFailed(graphicsAPI.m_device->CreateComputePipelineState(&psoDesc, IID_PPV_ARGS(&mgr.m_mipsPSO)));
+        computeShader->Release();
+    }
+
     // create an obvious error texture for invalid id
 
     TextureID newTextureID = mgr.ReserveTextureID();
@@ -155,11 +164,11 @@ void TextureMgr::Create(cdGraphicsAPIDX12& graphicsAPI)
     textureData.SlicePitch = textureData.RowPitch * TextureHeight;
 
     UpdateSubresources(graphicsAPI.m_commandList, newTexture.m_resource, textureUploadHeap, 0, 0, 1, &textureData);
-    graphicsAPI.m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    graphicsAPI.Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
 
-    // add the texture upload heap to the list of heaps to clear when the frame completes
-    graphicsAPI.m_textureUploadHeaps.push_back(textureUploadHeap);
+    // release the texture upload heap once the GPU is done with the copy
+    graphicsAPI.DeferRelease(textureUploadHeap);
 
     // add the texture to the texture list
     newTexture.m_heapID = graphicsAPI.ReserveGeneralHeapID();
@@ -171,6 +180,7 @@ void TextureMgr::Create(cdGraphicsAPIDX12& graphicsAPI)
     newTexture.m_srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     newTexture.m_srvDesc.Texture2D.MipLevels = 1;
     graphicsAPI.m_device->CreateShaderResourceView(newTexture.m_resource, &newTexture.m_srvDesc, MakeCPUHandle(graphicsAPI, newTextureID));
+    graphicsAPI.CommitGeneralHeapDescriptors(newTexture.m_heapID);
 
     // for debugging
     SetNameIndexed(newTexture.m_resource, L"Texture", (UINT)newTextureID);
@@ -187,6 +197,12 @@ void TextureMgr::Destroy()
     mgr.m_texturesLoaded.clear();
     mgr.m_texturesLoadedCubeMaps.clear();
 
+    // the caller waited for the GPU, so the mips are done
+    mgr.m_mipsToGenerate.clear();
+    mgr.m_mipsGenerating.clear();
+    SAFE_RELEASE(mgr.m_mipsPSO);
+    SAFE_RELEASE(mgr.m_mipsRootSignature);
+
     mgr.m_nextTextureID = TextureID::invalid;
 
     mgr.m_created = false;
@@ -194,44 +210,97 @@ void TextureMgr::Destroy()
 
 TextureID TextureMgr::LoadTexture (cdGraphicsAPIDX12& graphicsAPI, const char* fileName, bool isLinear, bool makeMips)
 {
-    // TODO: temp?
-    makeMips = false;
+    STextureLoad load;
+    load.m_fileName = fileName;
+    load.m_isLinear = isLinear;
+    load.m_makeMips = makeMips;
+    TextureID texture;
+    LoadTextures(graphicsAPI, 1, &load, &texture);
+    return texture;
+}
 
-    // if we already have this file loaded, re-use it
+void TextureMgr::LoadTextures (cdGraphicsAPIDX12& graphicsAPI, size_t count, const STextureLoad* loads, TextureID* textures)
+{
+    struct SDecodedImage
+    {
+        stbi_uc*    m_pixels = nullptr;
+        int         m_width = 0;
+        int         m_height = 0;
+    };
+
+    // find the files that aren't loaded yet, once each even if they are asked for more than once
     TextureMgr& mgr = Get();
-    auto it = mgr.m_texturesLoaded.find(fileName);
-    if (it != mgr.m_texturesLoaded.end())
-        return it->second;
+    std::vector<const char*> fileNames;
+    std::unordered_map<std::string, size_t> imageIndices;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const char* fileName = loads[i].m_fileName;
+        if (mgr.m_texturesLoaded.find(fileName) == mgr.m_texturesLoaded.end() && imageIndices.insert({ fileName, fileNames.size() }).second)
+            fileNames.push_back(fileName);
+    }
 
-    int textureWidth, textureHeight, channelsInFile;
-    stbi_uc* pixels = stbi_load(fileName, &textureWidth, &textureHeight, &channelsInFile, 4);
-    if (!pixels)
-        return TextureID::invalid;
+    // decoding is most of the time it takes, so each file is decoded on its own job
+    std::vector<SDecodedImage> images(fileNames.size());
+    ParallelFor(fileNames.size(), 1,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t imageIndex = begin; imageIndex < end; ++imageIndex)
+            {
+                int channelsInFile = 0;
+                SDecodedImage& image = images[imageIndex];
+                image.m_pixels = stbi_load(fileNames[imageIndex], &image.m_width, &image.m_height, &channelsInFile, 4);
+                if (!image.m_pixels)
+                    ReportLoadError(fileNames[imageIndex]);
+            }
+        }
+    );
 
-    UINT16 numMips = 1;
-    if (makeMips)
+    // making the resources uses the command list, so it happens here, in order. Textures asked for twice are loaded
+    // by the time the second one comes up, and re-used.
+    for (size_t i = 0; i < count; ++i)
     {
-        int size = min(textureWidth, textureHeight) / 2;
-        while (size > 0)
+        const STextureLoad& load = loads[i];
+        auto it = mgr.m_texturesLoaded.find(load.m_fileName);
+        if (it != mgr.m_texturesLoaded.end())
         {
-            ++numMips;
-            size = size / 2;
+            textures[i] = it->second;
+            continue;
         }
+
+        const SDecodedImage& image = images[imageIndices[load.m_fileName]];
+        textures[i] = image.m_pixels
+            ? CreateTexture(graphicsAPI, load.m_fileName, image.m_pixels, image.m_width, image.m_height, load.m_isLinear, load.m_makeMips)
+            : TextureID::invalid;
     }
 
+    for (SDecodedImage& image : images)
+        stbi_image_free(image.m_pixels);
+
+    // the textures' transitions out of the copy dest state go in one call at the end of the batch
+    graphicsAPI.FlushBarriers();
+}
+
+TextureID TextureMgr::CreateTexture (cdGraphicsAPIDX12& graphicsAPI, const char* fileName, const unsigned char* pixels, int textureWidth, int textureHeight, bool isLinear, bool makeMips)
+{
+    TextureMgr& mgr = Get();
+
+    UINT16 numMips = makeMips ? FullMipCount(textureWidth, textureHeight) : 1;
+    DXGI_FORMAT srvFormat = isLinear ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
     TextureID newTextureID = mgr.ReserveTextureID();
     mgr.m_textures.insert({ newTextureID,{} });
     STexture& newTexture = mgr.m_textures.find(newTextureID)->second;
 
     newTexture.m_heapID = graphicsAPI.ReserveGeneralHeapID();
 
-    // Describe and create a Texture2D.
+    // Describe and create a Texture2D. The compute queue writes the mips through a UAV, which can't be sRGB, so
+    // textures with mips are typeless.
     D3D12_RESOURCE_DESC textureDesc = {};
     textureDesc.MipLevels = numMips;
-    textureDesc.Format = isLinear ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    textureDesc.Format = (numMips > 1) ? DXGI_FORMAT_R8G8B8A8_TYPELESS : srvFormat;
     textureDesc.Width = textureWidth;
     textureDesc.Height = textureHeight;
-    textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    textureDesc.Flags = (numMips > 1) ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
     textureDesc.DepthOrArraySize = 1;
     textureDesc.SampleDesc.Count = 1;
     textureDesc.SampleDesc.Quality = 0;
@@ -264,74 +333,32 @@ TextureID TextureMgr::LoadTexture (cdGraphicsAPIDX12& graphicsAPI, const char* f
     textureData.SlicePitch = textureData.RowPitch * textureHeight;
     UpdateSubresources(graphicsAPI.m_commandList, newTexture.m_resource, textureUploadHeap, 0, D3D12CalcSubresource(0, 0, 0, numMips, 1), 1, &textureData);
 
-    // add the texture upload heap to the list of heaps to clear when the frame completes
-    graphicsAPI.m_textureUploadHeaps.push_back(textureUploadHeap);
-    
-    // update subsequent mips - box blur for now. should do something better later if this is noticeably bad looking.
-    if (numMips > 1)
-    {
-        // data setup
-        std::vector<stbi_uc> mipDataU8;
-        std::vector<float> mipDataF32;
-        mipDataU8.resize(textureWidth*textureHeight * 4);
-        memcpy(&mipDataU8[0], pixels, mipDataU8.size());
-        mipDataF32.resize(mipDataU8.size());
-        for (size_t i = 0; i < mipDataU8.size(); ++i)
-            mipDataF32[i] = sRGBU8_To_LinearF32(mipDataU8[i]);
-
-        int width = textureWidth;
-        int height = textureHeight;
-
-        // for each mip
-        for (UINT i = 1; i < numMips; ++i)
-        {
-            const UINT64 uploadBufferSize = GetRequiredIntermediateSize(newTexture.m_resource, i, 1);
-
-            // Create the GPU upload buffer.
-            ID3D12Resource* textureUploadHeap;
-            ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
-                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-                D3D12_HEAP_FLAG_NONE,
-                &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-                D3D12_RESOURCE_STATE_GENERIC_READ,
-                nullptr,
-                IID_PPV_ARGS(&textureUploadHeap)));
-
-            // make the mip
-            MakeNextMip(mipDataU8, mipDataF32, width, height);
-
-            // upload the mip
-            textureData.pData = &mipDataU8[0];
-            textureData.RowPitch = width * 4;
-            textureData.SlicePitch = textureData.RowPitch * height;
-            UpdateSubresources(graphicsAPI.m_commandList, newTexture.m_resource, textureUploadHeap, 0, D3D12CalcSubresource(i, 0, 0, numMips, 1), 1, &textureData);
+    // release the texture upload heap once the GPU is done with the copy
+    graphicsAPI.DeferRelease(textureUploadHeap);
 
-            // add the texture upload heap to the list of heaps to clear when the frame completes
-            graphicsAPI.m_textureUploadHeaps.push_back(textureUploadHeap);
-        }
-    }
-
-    graphicsAPI.m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    if (numMips > 1)
+        QueueMipGeneration(graphicsAPI, newTexture.m_resource, textureDesc, srvFormat);
+    else
+        graphicsAPI.Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
     // Describe and create a SRV for the texture.
     newTexture.m_srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    newTexture.m_srvDesc.Format = textureDesc.Format;
+    newTexture.m_srvDesc.Format = srvFormat;
     newTexture.m_srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     newTexture.m_srvDesc.Texture2D.MipLevels = numMips;
     graphicsAPI.m_device->CreateShaderResourceView(newTexture.m_resource, &newTexture.m_srvDesc, MakeCPUHandle(graphicsAPI, newTextureID));
+    graphicsAPI.CommitGeneralHeapDescriptors(newTexture.m_heapID);
 
     // add this texture id by it's filename 
     mgr.m_texturesLoaded.insert({fileName, newTextureID});
 
-    stbi_image_free(pixels);
-
     // for debugging
     SetNameIndexed(newTexture.m_resource, L"Texture", (UINT)newTextureID);
 
     return newTextureID;
 }
 
-TextureID TextureMgr::LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* baseFileName, bool isLinear)
+TextureID TextureMgr::LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* baseFileName, bool isLinear, bool makeMips)
 {
     static const size_t c_numFaces = 6;
 
@@ -341,20 +368,29 @@ TextureID TextureMgr::LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* b
     if (it != mgr.m_texturesLoadedCubeMaps.end())
         return it->second;
 
-    // try and load the faces
-    bool error = false;
-    char fileName[256];
+    // try and load the faces, each on its own job
     stbi_uc *imagePixels[c_numFaces];
     int textureWidth[c_numFaces];
     int textureHeight[c_numFaces];
-    for (size_t faceIndex = 0; faceIndex < c_numFaces; ++faceIndex)
-    {
-        sprintf_s(fileName, baseFileName, c_skyBoxSuffices[faceIndex]);
+    ParallelFor(c_numFaces, 1,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t faceIndex = begin; faceIndex < end; ++faceIndex)
+            {
+                char fileName[256];
+                sprintf_s(fileName, baseFileName, c_skyBoxSuffices[faceIndex]);
 
-        int channelsInFile = 0;
-        imagePixels[faceIndex] = stbi_load(fileName, &textureWidth[faceIndex], &textureHeight[faceIndex], &channelsInFile, 4);
-        error |= imagePixels[faceIndex] == nullptr;
-    }
+                int channelsInFile = 0;
+                imagePixels[faceIndex] = stbi_load(fileName, &textureWidth[faceIndex], &textureHeight[faceIndex], &channelsInFile, 4);
+                if (!imagePixels[faceIndex])
+                    ReportLoadError(fileName);
+            }
+        }
+    );
+
+    bool error = false;
+    for (stbi_uc* pixels : imagePixels)
+        error |= pixels == nullptr;
 
     // make sure all images have the same dimensions
     if (!error)
@@ -380,13 +416,16 @@ TextureID TextureMgr::LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* b
 
     newTexture.m_heapID = graphicsAPI.ReserveGeneralHeapID();
 
-    // Describe and create a Texture2D.
+    UINT16 numMips = makeMips ? FullMipCount(textureWidth[0], textureHeight[0]) : 1;
+    DXGI_FORMAT srvFormat = isLinear ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+    // Describe and create a Texture2D. Like CreateTexture, it is typeless if the compute queue makes its mips.
     D3D12_RESOURCE_DESC textureDesc = {};
-    textureDesc.MipLevels = 1;
-    textureDesc.Format = isLinear ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    textureDesc.MipLevels = numMips;
+    textureDesc.Format = (numMips > 1) ? DXGI_FORMAT_R8G8B8A8_TYPELESS : srvFormat;
     textureDesc.Width = textureWidth[0];
     textureDesc.Height = textureHeight[0];
-    textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    textureDesc.Flags = (numMips > 1) ? D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS : D3D12_RESOURCE_FLAG_NONE;
     textureDesc.DepthOrArraySize = 6;
     textureDesc.SampleDesc.Count = 1;
     textureDesc.SampleDesc.Quality = 0;
@@ -419,24 +458,28 @@ TextureID TextureMgr::LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* b
         textureData.pData = imagePixels[faceIndex];
         textureData.RowPitch = textureWidth[0] * 4;
         textureData.SlicePitch = textureData.RowPitch * textureHeight[0];
-        UpdateSubresources(graphicsAPI.m_commandList, newTexture.m_resource, textureUploadHeap, 0, (UINT)faceIndex, 1, &textureData);
+        UpdateSubresources(graphicsAPI.m_commandList, newTexture.m_resource, textureUploadHeap, 0, D3D12CalcSubresource(0, (UINT)faceIndex, 0, numMips, (UINT)c_numFaces), 1, &textureData);
 
-        // add the texture upload heap to the list of heaps to clear when the frame completes
-        graphicsAPI.m_textureUploadHeaps.push_back(textureUploadHeap);
+        // release the texture upload heap once the GPU is done with the copy
+        graphicsAPI.DeferRelease(textureUploadHeap);
     }
 
     // resource barier for all these copies
-    graphicsAPI.m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    if (numMips > 1)
+        QueueMipGeneration(graphicsAPI, newTexture.m_resource, textureDesc, srvFormat);
+    else
+        graphicsAPI.Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
     // Describe and create a SRV for the texture.
     newTexture.m_srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    newTexture.m_srvDesc.Format = textureDesc.Format;
+    newTexture.m_srvDesc.Format = srvFormat;
     newTexture.m_srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-    newTexture.m_srvDesc.Texture2D.MipLevels = 1;
+    newTexture.m_srvDesc.Texture2D.MipLevels = numMips;
     graphicsAPI.m_device->CreateShaderResourceView(newTexture.m_resource, &newTexture.m_srvDesc, MakeCPUHandle(graphicsAPI, newTextureID));
+    graphicsAPI.CommitGeneralHeapDescriptors(newTexture.m_heapID);
 
     // add this texture id by it's filename
-    mgr.m_texturesLoadedCubeMaps.insert({fileName, newTextureID});
+    mgr.m_texturesLoadedCubeMaps.insert({baseFileName, newTextureID});
 
     // for debugging
     SetNameIndexed(newTexture.m_resource, L"CubeMap", (UINT)newTextureID);
@@ -459,37 +502,43 @@ TextureID TextureMgr::LoadCubeMapMips(cdGraphicsAPIDX12& graphicsAPI, const char
     if (it != mgr.m_texturesLoadedCubeMaps.end())
         return it->second;
 
-    // try and load the faces
+    // try and load the faces of every mip, each on its own job
+    std::vector<stbi_uc*> imagePixels(numImages, nullptr);
+    std::vector<int> imageWidth(numImages, 0);
+    std::vector<int> imageHeight(numImages, 0);
+    ParallelFor(numImages, 1,
+        [&] (size_t begin, size_t end)
+        {
+            for (size_t imageIndex = begin; imageIndex < end; ++imageIndex)
+            {
+                char fileName[256];
+                sprintf_s(fileName, baseFileName, int(imageIndex / c_numFaces), c_skyBoxSuffices[imageIndex % c_numFaces]);
+
+                int channelsInFile = 0;
+                imagePixels[imageIndex] = stbi_load(fileName, &imageWidth[imageIndex], &imageHeight[imageIndex], &channelsInFile, 4);
+                if (!imagePixels[imageIndex])
+                    ReportLoadError(fileName);
+            }
+        }
+    );
+
     bool error = false;
-    char fileName[256];
-    std::vector<stbi_uc*> imagePixels;
     std::vector<int> textureWidth;
     std::vector<int> textureHeight;
-
-    for (int mipIndex = 0; mipIndex < numMips; ++mipIndex)
+    for (size_t imageIndex = 0; imageIndex < numImages; ++imageIndex)
     {
-        for (size_t faceIndex = 0; faceIndex < c_numFaces; ++faceIndex)
-        {
-            sprintf_s(fileName, baseFileName, mipIndex, c_skyBoxSuffices[faceIndex]);
+        error |= imagePixels[imageIndex] == nullptr;
 
-            int channelsInFile = 0;
-            int width, height;
-
-            stbi_uc *pixels = stbi_load(fileName, &width, &height, &channelsInFile, 4);
-            imagePixels.push_back(pixels);
-            error |= pixels == nullptr;
-
-            // make sure all images for the same mip have the same dimensions
-            if (faceIndex == 0)
-            {
-                textureWidth.push_back(width);
-                textureHeight.push_back(height);
-            }
-            else
-            {
-                error |= (*textureWidth.rbegin()) != width;
-                error |= (*textureHeight.rbegin()) != height;
-            }
+        // make sure all images for the same mip have the same dimensions
+        if (imageIndex % c_numFaces == 0)
+        {
+            textureWidth.push_back(imageWidth[imageIndex]);
+            textureHeight.push_back(imageHeight[imageIndex]);
+        }
+        else
+        {
+            error |= (*textureWidth.rbegin()) != imageWidth[imageIndex];
+            error |= (*textureHeight.rbegin()) != imageHeight[imageIndex];
         }
     }
 
@@ -551,15 +600,15 @@ TextureID TextureMgr::LoadCubeMapMips(cdGraphicsAPIDX12& graphicsAPI, const char
             textureData.SlicePitch = textureData.RowPitch * textureHeight[mipIndex];
             UpdateSubresources(graphicsAPI.m_commandList, newTexture.m_resource, textureUploadHeap, 0, D3D12CalcSubresource(mipIndex, (UINT)faceIndex, 0, numMips, (UINT)c_numFaces), 1, &textureData);
 
-            // add the texture upload heap to the list of heaps to clear when the frame completes
-            graphicsAPI.m_textureUploadHeaps.push_back(textureUploadHeap);
+            // release the texture upload heap once the GPU is done with the copy
+            graphicsAPI.DeferRelease(textureUploadHeap);
 
             ++imageIndex;
         }
     }
 
     // resource barier for all these copies
-    graphicsAPI.m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+    graphicsAPI.Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
     // Describe and create a SRV for the texture.
     newTexture.m_srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -567,9 +616,10 @@ TextureID TextureMgr::LoadCubeMapMips(cdGraphicsAPIDX12& graphicsAPI, const char
     newTexture.m_srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
     newTexture.m_srvDesc.Texture2D.MipLevels = numMips;
     graphicsAPI.m_device->CreateShaderResourceView(newTexture.m_resource, &newTexture.m_srvDesc, MakeCPUHandle(graphicsAPI, newTextureID));
+    graphicsAPI.CommitGeneralHeapDescriptors(newTexture.m_heapID);
 
     // add this texture id by it's filename
-    mgr.m_texturesLoadedCubeMaps.insert({fileName, newTextureID});
+    mgr.m_texturesLoadedCubeMaps.insert({baseFileName, newTextureID});
 
     // for debugging
     SetNameIndexed(newTexture.m_resource, L"CubeMap", (UINT)newTextureID);
@@ -581,74 +631,128 @@ TextureID TextureMgr::LoadCubeMapMips(cdGraphicsAPIDX12& graphicsAPI, const char
     return newTextureID;
 }
 
-TextureID TextureMgr::CreateUAVTexture(cdGraphicsAPIDX12& graphicsAPI, UINT64 width, UINT height)
+void TextureMgr::QueueMipGeneration (cdGraphicsAPIDX12& graphicsAPI, ID3D12Resource* resource, const D3D12_RESOURCE_DESC& desc, DXGI_FORMAT srvFormat)
 {
-    DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    SMipGeneration mips;
+    mips.m_resource = resource;
+    mips.m_srvFormat = srvFormat;
+    mips.m_width = UINT(desc.Width);
+    mips.m_height = desc.Height;
+    mips.m_arraySize = desc.DepthOrArraySize;
+    mips.m_numMips = desc.MipLevels;
+    Get().m_mipsToGenerate.push_back(mips);
+
+    for (UINT slice = 0; slice < mips.m_arraySize; ++slice)
+    {
+        for (UINT16 mip = 0; mip < mips.m_numMips; ++mip)
+        {
+            D3D12_RESOURCE_STATES after = (mip == 0) ? D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+            graphicsAPI.Transition(resource, D3D12_RESOURCE_STATE_COPY_DEST, after, D3D12CalcSubresource(mip, slice, 0, mips.m_numMips, mips.m_arraySize));
+        }
+    }
+}
 
-    // take a texture ID
+void TextureMgr::GenerateMips (cdGraphicsAPIDX12& graphicsAPI)
+{
     TextureMgr& mgr = Get();
-    TextureID newTextureID = mgr.ReserveTextureID();
+    if (mgr.m_mipsToGenerate.empty())
+        return;
 
-    // create a new STexture
-    STexture newTexture;
-    newTexture.m_heapID = graphicsAPI.ReserveGeneralHeapID();
-    
-    // create the resource for the uav
-    D3D12_HEAP_PROPERTIES defaultHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, 1, 1);
-    bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS | D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS;
-    ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
-        &defaultHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &bufferDesc,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&newTexture.m_resource)));
-
-    // create the resource for the uav that is invisible to shaders
-    ThrowIfFailed(graphicsAPI.m_device->CreateCommittedResource(
-        &defaultHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &bufferDesc,
-        D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-        nullptr,
-        IID_PPV_ARGS(&newTexture.m_resourceShaderInvisible)));
+    // The views are made before the command list is opened, because growing the general heap would change the heap it
+    // binds. They are 2D arrays even for single textures, which is what the shader reads and writes.
+    UINT16 maxMips = 1;
+    for (SMipGeneration& mips : mgr.m_mipsToGenerate)
+    {
+        maxMips = std::max<UINT16>(maxMips, mips.m_numMips);
+        mips.m_heapID = graphicsAPI.ReserveGeneralHeapID((mips.m_numMips - 1) * 2);
+        for (UINT16 mip = 1; mip < mips.m_numMips; ++mip)
+        {
+            unsigned int heapID = mips.m_heapID + (mip - 1) * 2;
+
+            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+            srvDesc.Format = mips.m_srvFormat;
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+            srvDesc.Texture2DArray.MostDetailedMip = mip - 1;
+            srvDesc.Texture2DArray.MipLevels = 1;
+            srvDesc.Texture2DArray.ArraySize = mips.m_arraySize;
+            graphicsAPI.m_device->CreateShaderResourceView(mips.m_resource, &srvDesc, graphicsAPI.GetGeneralHeapCPUHandle(heapID));
+
+            D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+            uavDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+            uavDesc.Texture2DArray.MipSlice = mip;
+            uavDesc.Texture2DArray.ArraySize = mips.m_arraySize;
+            graphicsAPI.m_device->CreateUnorderedAccessView(mips.m_resource, nullptr, &uavDesc, graphicsAPI.GetGeneralHeapCPUHandle(heapID + 1));
+        }
+        graphicsAPI.CommitGeneralHeapDescriptors(mips.m_heapID, (mips.m_numMips - 1) * 2);
+    }
 
-    //commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(newTexture.m_resource, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-    
-    // add the texture to the texture list
-    mgr.m_textures.insert({ newTextureID, newTexture });
+    // mip 0 was uploaded on the graphics queue
+    graphicsAPI.ComputeWaitForGraphics(graphicsAPI.GetSubmittedGraphicsFenceValue());
 
-    // create the uav
-    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-    uavDesc.Format = format;
-    uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-    graphicsAPI.m_device->CreateUnorderedAccessView(newTexture.m_resource, nullptr, &uavDesc, MakeCPUHandle(graphicsAPI, newTextureID));
+    // A mip level of every texture at a time. The next level reads the one just written, so the level's transitions
+    // are flushed after its dispatches, and before the next level's.
+    ID3D12GraphicsCommandList* commandList = graphicsAPI.OpenComputeCommandList(mgr.m_mipsRootSignature, mgr.m_mipsPSO);
+    for (UINT16 mip = 1; mip < maxMips; ++mip)
+    {
+        for (const SMipGeneration& mips : mgr.m_mipsToGenerate)
+        {
+            if (mip >= mips.m_numMips)
+                continue;
+
+            UINT width = std::max<UINT>(mips.m_width >> mip, 1);
+            UINT height = std::max<UINT>(mips.m_height >> mip, 1);
+            SMipConstants constants;
+            constants.m_isSRGB = (mips.m_srvFormat == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB) ? 1 : 0;
+            constants.m_texelSize[0] = 1.0f / float(width);
+            constants.m_texelSize[1] = 1.0f / float(height);
+
+            unsigned int heapID = mips.m_heapID + (mip - 1) * 2;
+            commandList->SetComputeRootDescriptorTable(MipsRootParameter::Source, graphicsAPI.GetGeneralHeapGPUHandle(heapID));
+            commandList->SetComputeRootDescriptorTable(MipsRootParameter::Destination, graphicsAPI.GetGeneralHeapGPUHandle(heapID + 1));
+            commandList->SetComputeRoot32BitConstants(MipsRootParameter::Constants, sizeof(constants) / 4, &constants, 0);
+            commandList->Dispatch((width + 7) / 8, (height + 7) / 8, mips.m_arraySize);
+
+            for (UINT slice = 0; slice < mips.m_arraySize; ++slice)
+            {
+                UINT subresource = D3D12CalcSubresource(mip, slice, 0, mips.m_numMips, mips.m_arraySize);
+                graphicsAPI.ComputeTransition(mips.m_resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, subresource);
+            }
+        }
+        graphicsAPI.FlushComputeBarriers(commandList);
+    }
+    mgr.m_mipsFenceValue = graphicsAPI.SubmitComputeCommandList(commandList);
 
-    // create the uav that is invisible to shaders
-    graphicsAPI.m_device->CreateUnorderedAccessView(newTexture.m_resourceShaderInvisible, nullptr, &uavDesc, MakeCPUHandleShaderInvisible(graphicsAPI, newTextureID));
+    mgr.m_mipsGenerating.insert(mgr.m_mipsGenerating.end(), mgr.m_mipsToGenerate.begin(), mgr.m_mipsToGenerate.end());
+    mgr.m_mipsToGenerate.clear();
+}
 
-    // for debugging
-    SetNameIndexed(newTexture.m_resource, L"UAV", (UINT)newTextureID);
-    SetNameIndexed(newTexture.m_resourceShaderInvisible, L"UAVShaderInvisible", (UINT)newTextureID);
+void TextureMgr::FinishMips (cdGraphicsAPIDX12& graphicsAPI)
+{
+    TextureMgr& mgr = Get();
+    if (mgr.m_mipsGenerating.empty())
+        return;
 
-    return newTextureID;
+    // The compute queue can't move textures to the pixel shader state, so that happens here. The views go once the
+    // GPU is done with this frame, which is after the compute work.
+    graphicsAPI.GraphicsWaitForCompute(mgr.m_mipsFenceValue);
+    for (const SMipGeneration& mips : mgr.m_mipsGenerating)
+    {
+        graphicsAPI.Transition(mips.m_resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        graphicsAPI.FreeGeneralHeapID(mips.m_heapID, (mips.m_numMips - 1) * 2);
+    }
+    mgr.m_mipsGenerating.clear();
 }
 
-unsigned int TextureMgr::CreateTextureDescriptorTable(cdGraphicsAPIDX12& graphicsAPI, size_t numTextures, TextureID* textures)
+CD3DX12_GPU_DESCRIPTOR_HANDLE TextureMgr::MakeDescriptorTable(cdGraphicsAPIDX12& graphicsAPI, size_t numTextures, const TextureID* textures)
 {
-    unsigned int ret = graphicsAPI.ReserveGeneralHeapID((unsigned int)numTextures);
-    for (unsigned int i = 0; i < numTextures; ++i)
-    {
-        STexture& texture = GetTexture(textures[i]);
+    if (numTextures > c_maxTransientDescriptorTableSize)
+        throw std::exception();
 
-        CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle(
-            graphicsAPI.m_generalHeap->GetCPUDescriptorHandleForHeapStart(),
-            ret + i,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
+    unsigned int heapIDs[c_maxTransientDescriptorTableSize];
+    for (size_t i = 0; i < numTextures; ++i)
+        heapIDs[i] = GetTexture(textures[i]).m_heapID;
 
-        graphicsAPI.m_device->CreateShaderResourceView(texture.m_resource, &texture.m_srvDesc, cpuHandle);
-    }
-    return ret;
+    return graphicsAPI.MakeTransientDescriptorTable(heapIDs, (unsigned int)numTextures);
 }
\ No newline at end of file
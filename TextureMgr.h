@@ -21,86 +21,55 @@ enum class TextureID : UINT32
     invalid = 0
 };
 
+struct STextureLoad
+{
+    const char* m_fileName = nullptr;
+    bool        m_isLinear = false;
+    bool        m_makeMips = false;
+};
+
 // A static class, which internally uses a singleton
 class TextureMgr
 {
 public:
 
-    static void Create (cdGraphicsAPIDX12& graphicsAPI);
+    static void Create (cdGraphicsAPIDX12& graphicsAPI, bool shaderDebug);
     static void Destroy ();
 
     static TextureID LoadTexture (cdGraphicsAPIDX12& graphicsAPI, const char* fileName, bool isLinear, bool makeMips);
 
-    static TextureID LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* baseFileName, bool isLinear);
+    // Loads count textures at once, decoding the files on the job system. textures gets the ID of each.
+    static void LoadTextures (cdGraphicsAPIDX12& graphicsAPI, size_t count, const STextureLoad* loads, TextureID* textures);
+
+    static TextureID LoadCubeMap (cdGraphicsAPIDX12& graphicsAPI, const char* baseFileName, bool isLinear, bool makeMips = false);
 
     static TextureID LoadCubeMapMips (cdGraphicsAPIDX12& graphicsAPI, const char* baseFileName, int numMips, bool isLinear);
 
-    static TextureID CreateUAVTexture (cdGraphicsAPIDX12& graphicsAPI, UINT64 width, UINT height);
+    // Textures loaded with makeMips only have mip 0 uploaded. GenerateMips makes the rest of their mips on the compute
+    // queue, and has to be called after the command list that loaded them was submitted. FinishMips makes the graphics
+    // queue wait for that in the frame being recorded, and the textures can be used from then on. It does nothing if no
+    // mips are being made, so it can be called every frame.
+    static void GenerateMips (cdGraphicsAPIDX12& graphicsAPI);
+    static void FinishMips (cdGraphicsAPIDX12& graphicsAPI);
 
-    static unsigned int CreateTextureDescriptorTable(cdGraphicsAPIDX12& graphicsAPI, size_t numTextures, TextureID* textures);
+    // Makes a descriptor table of the textures' SRVs that lasts until the end of the frame
+    static CD3DX12_GPU_DESCRIPTOR_HANDLE MakeDescriptorTable(cdGraphicsAPIDX12& graphicsAPI, size_t numTextures, const TextureID* textures);
 
     inline static CD3DX12_GPU_DESCRIPTOR_HANDLE MakeGPUHandle (cdGraphicsAPIDX12& graphicsAPI, TextureID index)
     {
-        TextureMgr& mgr = Get();
-
-        if (mgr.m_textures.find(index) == mgr.m_textures.end())
-            throw std::exception();
-
-        STexture& texture = mgr.m_textures[index];
-
-        return CD3DX12_GPU_DESCRIPTOR_HANDLE(
-            graphicsAPI.m_generalHeap->GetGPUDescriptorHandleForHeapStart(),
-            (UINT)texture.m_heapID,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
-    }
-
-    inline static CD3DX12_GPU_DESCRIPTOR_HANDLE MakeGPUHandleShaderInvisible (cdGraphicsAPIDX12& graphicsAPI, TextureID index)
-    {
-        TextureMgr& mgr = Get();
-
-        if (mgr.m_textures.find(index) == mgr.m_textures.end())
-            throw std::exception();
-
-        STexture& texture = mgr.m_textures[index];
-
-        return CD3DX12_GPU_DESCRIPTOR_HANDLE(
-            graphicsAPI.m_generalHeapShaderInvisible->GetGPUDescriptorHandleForHeapStart(),
-            (UINT)texture.m_heapID,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
+        return graphicsAPI.GetGeneralHeapGPUHandle(GetTexture(index).m_heapID);
     }
 
+    // The handle in the staging heap. Views written here need CommitGeneralHeapDescriptors to be seen by shaders.
     inline static CD3DX12_CPU_DESCRIPTOR_HANDLE MakeCPUHandle (cdGraphicsAPIDX12& graphicsAPI, TextureID index)
     {
-        TextureMgr& mgr = Get();
-
-        if (mgr.m_textures.find(index) == mgr.m_textures.end())
-            throw std::exception();
-
-        STexture& texture = mgr.m_textures[index];
-
-        return CD3DX12_CPU_DESCRIPTOR_HANDLE(
-            graphicsAPI.m_generalHeap->GetCPUDescriptorHandleForHeapStart(),
-            (UINT)texture.m_heapID,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
+        return graphicsAPI.GetGeneralHeapCPUHandle(GetTexture(index).m_heapID);
     }
 
-    inline static CD3DX12_CPU_DESCRIPTOR_HANDLE MakeCPUHandleShaderInvisible (cdGraphicsAPIDX12& graphicsAPI, TextureID index)
+    // where the texture's SRV is in the general heap, which is its index in a bindless texture array
+    inline static unsigned int GetHeapID (TextureID index)
     {
-        TextureMgr& mgr = Get();
-
-        if (mgr.m_textures.find(index) == mgr.m_textures.end())
-            throw std::exception();
-
-        STexture& texture = mgr.m_textures[index];
-
-        return CD3DX12_CPU_DESCRIPTOR_HANDLE(
-            graphicsAPI.m_generalHeapShaderInvisible->GetCPUDescriptorHandleForHeapStart(),
-            (UINT)texture.m_heapID,
-            graphicsAPI.m_generalHeapDescriptorSize
-        );
+        return GetTexture(index).m_heapID;
     }
 
     inline static ID3D12Resource* GetResource (cdGraphicsAPIDX12& graphicsAPI, TextureID index)
@@ -115,29 +84,37 @@ public:
         return texture.m_resource;
     }
 
-    inline static ID3D12Resource* GetResourceShaderInvisible (cdGraphicsAPIDX12& graphicsAPI, TextureID index)
-    {
-        TextureMgr& mgr = Get();
-
-        if (mgr.m_textures.find(index) == mgr.m_textures.end())
-            throw std::exception();
-
-        STexture& texture = mgr.m_textures[index];
-
-        return texture.m_resource;
-    }
-
 private:
     struct STexture
     {
         D3D12_SHADER_RESOURCE_VIEW_DESC m_srvDesc = {};
         ID3D12Resource*                 m_resource  = nullptr;
-        ID3D12Resource*                 m_resourceShaderInvisible = nullptr;
         unsigned int                    m_heapID = (unsigned int)-1;
     };
 
+    // A texture whose mips the compute queue makes. Each mip after the first has an SRV of the mip before it and a UAV
+    // of itself, next to each other in the general heap.
+    struct SMipGeneration
+    {
+        ID3D12Resource* m_resource = nullptr;
+        DXGI_FORMAT     m_srvFormat = DXGI_FORMAT_UNKNOWN;
+        UINT            m_width = 0;
+        UINT            m_height = 0;
+        UINT            m_arraySize = 1;
+        UINT16          m_numMips = 1;
+        unsigned int    m_heapID = (unsigned int)-1;
+    };
+
 private:
     TextureMgr() {}
+
+    // makes the resource and SRV from decoded RGBA8 pixels, and remembers it by file name
+    static TextureID CreateTexture (cdGraphicsAPIDX12& graphicsAPI, const char* fileName, const unsigned char* pixels, int textureWidth, int textureHeight, bool isLinear, bool makeMips);
+
+    // Moves the uploaded texture's mip 0 to be read by the compute queue and the other mips to be written by it, and
+    // adds it to the textures for GenerateMips.
+    static void QueueMipGeneration (cdGraphicsAPIDX12& graphicsAPI, ID3D12Resource* resource, const D3D12_RESOURCE_DESC& desc, DXGI_FORMAT srvFormat);
+
     ~TextureMgr() {}
 
     inline static TextureMgr& Get(bool skipCreatedTest = false)
@@ -178,4 +155,13 @@ private:
     
     // next texture id
     TextureID                                       m_nextTextureID = TextureID::invalid;
+
+    // the mip generation compute shader
+    ID3D12RootSignature*                            m_mipsRootSignature = nullptr;
+    ID3D12PipelineState*                            m_mipsPSO = nullptr;
+
+    // textures waiting for GenerateMips, and the ones the compute queue is making mips of, up to m_mipsFenceValue
+    std::vector<SMipGeneration>                     m_mipsToGenerate;
+    std::vector<SMipGeneration>                     m_mipsGenerating;
+    UINT64                                          m_mipsFenceValue = 0;
 };
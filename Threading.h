@@ -0,0 +1,12 @@
+#pragma once
+
+#include "JobSystem.h"
+
+// Splits [0, count) into batches of batchSize items and runs work(begin, end) on each batch, on the default job system.
+// Batches are handed out to at most numThreads threads (including the calling thread) as they finish their previous
+// batch. numThreads of 0 means use all of the job system's threads.
+template <typename LAMBDA>
+void ParallelFor (size_t count, size_t batchSize, const LAMBDA& work, size_t numThreads = 0)
+{
+    JobSystemParallelFor(JobSystemDefault(), count, batchSize, work, numThreads);
+}
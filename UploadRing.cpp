@@ -0,0 +1,57 @@
+#include "stdafx.h"
+
+#include "UploadRing.h"
+
+#include <algorithm>
+
+void UploadRingInit (SUploadRing& ring, UINT64 capacity)
+{
+    ring = SUploadRing();
+    ring.m_capacity = capacity;
+}
+
+bool UploadRingAllocate (SUploadRing& ring, UINT64 size, UINT64 alignment, UINT64& offset)
+{
+    if (size == 0 || size > ring.m_capacity || alignment == 0 || (alignment & (alignment - 1)) != 0 || ring.m_capacity % alignment != 0)
+        return false;
+
+    // the capacity is a multiple of the alignment, so aligning the count aligns the offset too
+    UINT64 head = (ring.m_head + alignment - 1) & ~(alignment - 1);
+
+    // skip to the start of the ring if the allocation would go past the end
+    UINT64 index = head % ring.m_capacity;
+    if (index + size > ring.m_capacity)
+    {
+        head += ring.m_capacity - index;
+        index = 0;
+    }
+    if (head + size - ring.m_tail > ring.m_capacity)
+        return false;
+
+    ring.m_stats.m_allocations++;
+    ring.m_stats.m_bytesAllocated += size_t(head + size - ring.m_head);
+    ring.m_head = head + size;
+    ring.m_stats.m_peakBytesInUse = std::max<size_t>(ring.m_stats.m_peakBytesInUse, size_t(ring.m_head - ring.m_tail));
+
+    offset = index;
+    return true;
+}
+
+void UploadRingEndFrame (SUploadRing& ring, UINT64 fenceValue)
+{
+    // a frame that allocated nothing has nothing to free later
+    UINT64 lastHead = ring.m_frameEnds.empty() ? ring.m_tail : ring.m_frameEnds.back().m_head;
+    if (ring.m_head != lastHead)
+        ring.m_frameEnds.push_back({ ring.m_head, fenceValue });
+}
+
+void UploadRingRetire (SUploadRing& ring, UINT64 completedFenceValue)
+{
+    size_t retired = 0;
+    while (retired < ring.m_frameEnds.size() && ring.m_frameEnds[retired].m_fenceValue <= completedFenceValue)
+    {
+        ring.m_tail = ring.m_frameEnds[retired].m_head;
+        ++retired;
+    }
+    ring.m_frameEnds.erase(ring.m_frameEnds.begin(), ring.m_frameEnds.begin() + retired);
+}
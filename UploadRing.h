@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+// Hands out pieces of an upload buffer that only live for a frame, like per draw constants and instance data. It only
+// deals in byte offsets, and cdGraphicsAPIDX12 turns them into CPU and GPU addresses of one persistently mapped upload
+// buffer.
+//
+// Allocating just moves the head forward. The space of a frame is given back all at once when its fence retires.
+
+struct SUploadRingStats
+{
+    size_t m_allocations = 0;
+    size_t m_bytesAllocated = 0;    // including alignment padding, and what was skipped to wrap around
+    size_t m_peakBytesInUse = 0;
+};
+
+struct SUploadRing
+{
+    UINT64                          m_capacity = 0;
+
+    // These count every byte ever allocated, so they only go up. The buffer offset is the count modulo capacity.
+    UINT64                          m_head = 0;
+    UINT64                          m_tail = 0;         // everything before this is free
+
+    // where each submitted frame's allocations end, oldest first
+    struct SFrameEnd
+    {
+        UINT64  m_head;
+        UINT64  m_fenceValue;
+    };
+    std::vector<SFrameEnd>          m_frameEnds;
+
+    SUploadRingStats                m_stats;
+};
+
+void UploadRingInit (SUploadRing& ring, UINT64 capacity);
+
+// Finds size bytes at the given alignment, which has to be a power of two that divides the capacity. Returns false if
+// the ring is too full, which means more was allocated in the frames that the GPU hasn't finished than fits.
+// Allocations never wrap around the end of the ring.
+bool UploadRingAllocate (SUploadRing& ring, UINT64 size, UINT64 alignment, UINT64& offset);
+
+// Marks what was allocated so far as used by GPU work that is done when fenceValue completes
+void UploadRingEndFrame (SUploadRing& ring, UINT64 fenceValue);
+
+// Frees the allocations of the frames that are done
+void UploadRingRetire (SUploadRing& ring, UINT64 completedFenceValue);
@@ -23,6 +23,10 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 	pSample->ParseCommandLineArgs(argv, argc);
 	LocalFree(argv);
 
+    // benchmarks are headless, so they don't need a window
+    if (pSample->IsBenchmarkMode())
+        return pSample->OnBenchmark();
+
 	// Initialize the window class.
 	WNDCLASSEX windowClass = { 0 };
 	windowClass.cbSize = sizeof(WNDCLASSEX);
@@ -6,12 +6,16 @@
 #define STEREO_MODE_NONE 0
 #define STEREO_MODE_RED  1
 #define STEREO_MODE_BLUE 2
+#define STEREO_MODE_SINGLE_PASS 3   // both eyes at once. Even instances are the red eye and odd ones the blue eye.
+
+#define MATERIAL_BINDING_TABLES   0
+#define MATERIAL_BINDING_BINDLESS 1 // textures are found by index in the whole general heap
 
 struct VSInput
 {
     float4 position : POSITION;
     float3 normal : NORMAL;
-    float3 tangent : TANGENT;
+    float4 tangent : TANGENT;  // w is the bitangent handedness
     float2 uv : TEXCOORD0;
 };
 
@@ -47,3 +51,32 @@ Texture2D<float4> g_texturePBR_Metalness : register(t6);
 Texture2D<float4> g_texturePBR_Normal : register(t7);
 Texture2D<float4> g_texturePBR_Roughness : register(t8);
 Texture2D<float4> g_texturePBR_AO : register(t9);
+
+// The persistent per object data, indexed by the object ID of an instance. Matches SObjectData in D3D12HelloTriangle.h.
+struct SObjectData
+{
+    row_major float4x4 objectToWorld;
+};
+
+StructuredBuffer<SObjectData> g_objects : register(t10);
+
+// Bindless materials. The root constants say which material record and diffuse texture a draw uses, and the texture
+// indices are into the general heap.
+struct SMaterialRecord
+{
+    uint albedo;
+    uint metalness;
+    uint normal;
+    uint roughness;
+    uint AO;
+};
+
+StructuredBuffer<SMaterialRecord> g_materialRecords : register(t11);
+
+cbuffer DrawConstants : register(b2)
+{
+    uint materialIndex;
+    uint diffuseTextureIndex;
+};
+
+Texture2D<float4> g_textures[] : register(t0, space1);
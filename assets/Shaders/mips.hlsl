@@ -0,0 +1,34 @@
+// Makes a mip of a texture from the mip before it, on the compute queue. Each slice of a texture array is its own
+// dispatch z. Sampling the middle of each 2x2 block of the source with a linear sampler averages the block.
+
+Texture2DArray<float4> g_source : register(t0);
+RWTexture2DArray<float4> g_destination : register(u1);  // u0 is the pixel shaders' output
+SamplerState g_linearClamp : register(s0);
+
+cbuffer MipConstants : register(b0)
+{
+    uint g_isSRGB;          // the source is read as sRGB, and the destination has to be written as sRGB by hand
+    float2 g_texelSize;     // of the destination
+};
+
+float3 LinearToSRGB(float3 value)
+{
+    float3 low = value * 12.92f;
+    float3 high = 1.055f * pow(abs(value), 1.0f / 2.4f) - 0.055f;
+    return (value <= 0.0031308f) ? low : high;
+}
+
+[numthreads(8, 8, 1)]
+void CSMain(uint3 threadID : SV_DispatchThreadID)
+{
+    uint width, height, slices;
+    g_destination.GetDimensions(width, height, slices);
+    if (threadID.x >= width || threadID.y >= height)
+        return;
+
+    float2 uv = (float2(threadID.xy) + 0.5f) * g_texelSize;
+    float4 color = g_source.SampleLevel(g_linearClamp, float3(uv, threadID.z), 0.0f);
+    if (g_isSRGB)
+        color.rgb = LinearToSRGB(color.rgb);
+    g_destination[threadID] = color;
+}
@@ -5,47 +5,82 @@ struct PSInput
 {
 	float4 position : SV_POSITION;
     float3 normal : NORMAL;
-    float3 tangent : TANGENT;
+    float4 tangent : TANGENT;
     float2 uv : TEXCOORD0;
     float3 worldPosition : TEXCOORD1;
+#if STEREO_MODE == STEREO_MODE_SINGLE_PASS
+    uint eye : SV_RenderTargetArrayIndex;
+#endif
+};
+
+// the object table slot of an instance, from vertex buffer slot 1. The input assembler steps through it by
+// SV_InstanceID, starting at the draw's start instance location. Single pass stereo steps every other instance.
+struct VSInstanceInput
+{
+    uint objectID : OBJECTID;
 };
 
-PSInput VSMain(in VSInput input)
+PSInput VSMain(in VSInput input, in VSInstanceInput instance, in uint instanceID : SV_InstanceID)
 {
+    float4x4 instanceMatrix = g_objects[instance.objectID].objectToWorld;
+
     // make model, view, projection matrix
-    float4x4 mvp = mul(modelMatrix, viewProjectionMatrix);
+    float4x4 mvp = mul(instanceMatrix, viewProjectionMatrix);
     
     // if we are doing right eye, move the object a bit
     #if STEREO_MODE == STEREO_MODE_BLUE
         mvp[3].x -= 0.125f;
     #elif STEREO_MODE == STEREO_MODE_RED
         mvp[3].x += 0.125f;
+    #elif STEREO_MODE == STEREO_MODE_SINGLE_PASS
+        uint eye = instanceID & 1;
+        mvp[3].x += (eye == 0) ? 0.125f : -0.125f;
     #endif
 
     PSInput result;
+    #if STEREO_MODE == STEREO_MODE_SINGLE_PASS
+        result.eye = eye;
+    #endif
     result.position = mul(input.position, mvp);
     result.normal = input.normal;
     result.tangent = input.tangent;
     result.uv = input.uv;
-    result.worldPosition = mul(input.position, modelMatrix).xyz;
+    result.worldPosition = mul(input.position, instanceMatrix).xyz;
 	return result;
 }
 
+// the textures come from descriptor tables, or are looked up by the draw's material
+#if MATERIAL_BINDING == MATERIAL_BINDING_BINDLESS
+    #define TEXTURE_DIFFUSE         g_textures[diffuseTextureIndex]
+    #define TEXTURE_PBR_ALBEDO      g_textures[g_materialRecords[materialIndex].albedo]
+    #define TEXTURE_PBR_METALNESS   g_textures[g_materialRecords[materialIndex].metalness]
+    #define TEXTURE_PBR_NORMAL      g_textures[g_materialRecords[materialIndex].normal]
+    #define TEXTURE_PBR_ROUGHNESS   g_textures[g_materialRecords[materialIndex].roughness]
+    #define TEXTURE_PBR_AO          g_textures[g_materialRecords[materialIndex].AO]
+#else
+    #define TEXTURE_DIFFUSE         g_textureDiffuse
+    #define TEXTURE_PBR_ALBEDO      g_texturePBR_Albedo
+    #define TEXTURE_PBR_METALNESS   g_texturePBR_Metalness
+    #define TEXTURE_PBR_NORMAL      g_texturePBR_Normal
+    #define TEXTURE_PBR_ROUGHNESS   g_texturePBR_Roughness
+    #define TEXTURE_PBR_AO          g_texturePBR_AO
+#endif
+
 float4 PSMain(in PSInput input) : SV_TARGET
 {
     float3 ret = float3(0.0f, 0.0f, 0.0f);
 
     // calculate normal, tangent, bitangent
     float3 normal = normalize(input.normal);
-    float3 tangent = normalize(input.tangent);
-    float3 bitangent = normalize(cross(normal, tangent));
+    float3 tangent = normalize(input.tangent.xyz);
+    float3 bitangent = normalize(cross(normal, tangent)) * input.tangent.w;
 
     // get PBR lighting parameters
-    float3 albedo = g_textureDiffuse.Sample(sampleWrap, input.uv).rgb * g_texturePBR_Albedo.Sample(sampleWrap, input.uv).rgb;
-    float metalness = g_texturePBR_Metalness.Sample(sampleWrap, input.uv).r;
-    float roughness = g_texturePBR_Roughness.Sample(sampleWrap, input.uv).r;
-    float AO = g_texturePBR_AO.Sample(sampleWrap, input.uv).r;
-    float3 textureNormal = g_texturePBR_Normal.Sample(sampleWrap, input.uv).rgb  * 2.0 - 1.0;
+    float3 albedo = TEXTURE_DIFFUSE.Sample(sampleWrap, input.uv).rgb * TEXTURE_PBR_ALBEDO.Sample(sampleWrap, input.uv).rgb;
+    float metalness = TEXTURE_PBR_METALNESS.Sample(sampleWrap, input.uv).r;
+    float roughness = TEXTURE_PBR_ROUGHNESS.Sample(sampleWrap, input.uv).r;
+    float AO = TEXTURE_PBR_AO.Sample(sampleWrap, input.uv).r;
+    float3 textureNormal = TEXTURE_PBR_NORMAL.Sample(sampleWrap, input.uv).rgb  * 2.0 - 1.0;
     float3x3 tbn = float3x3(
         tangent,
         bitangent,
@@ -55,7 +90,7 @@ float4 PSMain(in PSInput input) : SV_TARGET
 
 #if MATERIAL_MODE == MATERIAL_MODE_UNTEXTURED
     normal = normalize(input.normal);
-    albedo = g_textureDiffuse.Sample(sampleWrap, input.uv).rgb;
+    albedo = TEXTURE_DIFFUSE.Sample(sampleWrap, input.uv).rgb;
     metalness = 0.0f;
     roughness = 1.0f;
     AO = 1.0f;
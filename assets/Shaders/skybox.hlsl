@@ -4,11 +4,19 @@ struct PSInput
 {
 	float4 position : SV_POSITION;
     float3 uvw : TEXCOORD0;
+#if STEREO_MODE == STEREO_MODE_SINGLE_PASS
+    uint eye : SV_RenderTargetArrayIndex;
+#endif
 };
 
-PSInput VSMain(in VSInput input)
+PSInput VSMain(in VSInput input, in uint instanceID : SV_InstanceID)
 {
 	PSInput result;
+
+    // the skybox looks the same to both eyes, but each eye has its own render target
+    #if STEREO_MODE == STEREO_MODE_SINGLE_PASS
+        result.eye = instanceID & 1;
+    #endif
     
     float4x4 viewMatrixNoTranslation = float4x4(
         float4(viewMatrix[0].xyz, 0.0f),
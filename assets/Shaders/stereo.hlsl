@@ -0,0 +1,27 @@
+// Combines the two eyes of single pass stereo into a red / blue anaglyph. The eyes were rendered to the slices of a
+// texture array, slice 0 for red and slice 1 for blue.
+
+Texture2DArray<float4> g_textureEyes : register(t1);
+
+struct PSInput
+{
+    float4 position : SV_POSITION;
+};
+
+// a triangle that covers the screen
+PSInput VSMain(in uint vertexID : SV_VertexID)
+{
+    float2 uv = float2((vertexID << 1) & 2, vertexID & 2);
+
+    PSInput result;
+    result.position = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    return result;
+}
+
+float4 PSMain(in PSInput input) : SV_TARGET
+{
+    int2 pixel = int2(input.position.xy);
+    float3 red = g_textureEyes.Load(int4(pixel, 0, 0)).rgb;
+    float3 blue = g_textureEyes.Load(int4(pixel, 1, 0)).rgb;
+    return float4(red.r, blue.g, blue.b, 1.0f);
+}
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 
 #include "dx12.h"
+#include "DXSampleHelper.h"
+#include "pix3.h"
 
 #include <array>
 #include <fstream>
@@ -69,7 +71,7 @@ static void GetHardwareAdapter(IDXGIFactory2* pFactory, IDXGIAdapter1** ppAdapte
     *ppAdapter = adapter;
 }
 
-bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int frameCount, unsigned int width, unsigned int height, HWND hWnd)
+bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int frameCount, unsigned int width, unsigned int height, HWND hWnd, unsigned int samplerDescriptors, bool frameLatencyWaitable)
 {
 
     // ==================== Create factory ====================
@@ -145,6 +147,15 @@ bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int f
         hardwareAdapter->Release();
     }
 
+    // ==================== Check Features ====================
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if (SUCCEEDED(m_device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+    {
+        m_renderTargetArrayIndexFromVS = options.VPAndRTArrayIndexFromAnyShaderFeedingRasterizerSupportedWithoutGSEmulation != FALSE;
+        m_bindlessSupported = options.ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_2;
+    }
+
     // ==================== Create Command Queue ====================
 
     // Describe and create the command queue.
@@ -155,6 +166,11 @@ bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int f
     if (FAILED(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue))))
         return false;
 
+    // and the compute queue, for work that runs alongside the frames
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+    if (FAILED(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_computeQueue))))
+        return false;
+
     // ==================== Create Swap Chain ====================
 
     // Describe and create the swap chain.
@@ -166,6 +182,7 @@ bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int f
     swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
     swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     swapChainDesc.SampleDesc.Count = 1;
+    swapChainDesc.Flags = frameLatencyWaitable ? DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT : 0;
 
     IDXGISwapChain1* swapChain;
     if (FAILED(factory->CreateSwapChainForHwnd(
@@ -187,6 +204,15 @@ bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int f
     swapChain->Release();
     factory->Release();
 
+    // the latency starts out at the most frames the CPU can be ahead anyway, and comes down if that costs little
+    if (frameLatencyWaitable)
+    {
+        FrameLatencyInit(m_frameLatency, 1, c_framesInFlight, c_frameLatencyTolerance);
+        if (FAILED(m_swapChain->SetMaximumFrameLatency(m_frameLatency.m_latency)))
+            return false;
+        m_frameLatencyWaitableObject = m_swapChain->GetFrameLatencyWaitableObject();
+    }
+
     // ==================== Create Heaps ====================
 
     D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
@@ -204,27 +230,49 @@ bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int f
     if (FAILED(m_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap))))
         return false;
 
-    // Describe and create a sampler descriptor heap.
-    D3D12_DESCRIPTOR_HEAP_DESC samplerHeapDesc = {};
-    samplerHeapDesc.NumDescriptors = c_maxSamplerDescriptors;
-    samplerHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
-    samplerHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    if (FAILED(m_device->CreateDescriptorHeap(&samplerHeapDesc, IID_PPV_ARGS(&m_samplerHeap))))
-        return false;
+    // Describe and create a sampler descriptor heap, if there are samplers that aren't static
+    if (samplerDescriptors > 0)
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC samplerHeapDesc = {};
+        samplerHeapDesc.NumDescriptors = samplerDescriptors;
+        samplerHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER;
+        samplerHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        if (FAILED(m_device->CreateDescriptorHeap(&samplerHeapDesc, IID_PPV_ARGS(&m_samplerHeap))))
+            return false;
+    }
 
-    // shader visible, CPU write only
+    // shader visible, CPU write only. The transient descriptor ring goes at the end.
     D3D12_DESCRIPTOR_HEAP_DESC generalHeapDesc = {};
-    generalHeapDesc.NumDescriptors = c_maxGeneralDescriptors;
+    generalHeapDesc.NumDescriptors = c_initialGeneralDescriptors + c_transientDescriptors;
     generalHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     generalHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     if (FAILED(m_device->CreateDescriptorHeap(&generalHeapDesc, IID_PPV_ARGS(&m_generalHeap))))
         return false;
 
     // shader invisible, CPU read/write
+    generalHeapDesc.NumDescriptors = c_initialGeneralDescriptors;
     generalHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     if (FAILED(m_device->CreateDescriptorHeap(&generalHeapDesc, IID_PPV_ARGS(&m_generalHeapShaderInvisible))))
         return false;
 
+    DescriptorAllocatorInit(m_generalHeapAllocator, c_initialGeneralDescriptors);
+    DescriptorRingInit(m_transientDescriptorRing, c_transientDescriptors);
+
+    // the upload ring, which stays mapped
+    if (FAILED(m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(c_uploadRingSize),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_uploadBuffer))))
+        return false;
+
+    CD3DX12_RANGE readRange(0, 0);
+    if (FAILED(m_uploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_uploadBufferBegin))))
+        return false;
+    UploadRingInit(m_uploadRing, c_uploadRingSize);
+
     m_rtvHeapDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
     m_dsvHeapDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
     m_samplerHeapDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER);
@@ -253,36 +301,41 @@ bool cdGraphicsAPIDX12::Create(bool gpuDebug, bool useWarpDevice, unsigned int f
 		}
 	}
 
-    // Create the depth stencil view.
-    {
-        D3D12_DEPTH_STENCIL_VIEW_DESC depthStencilDesc = {};
-        depthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-        depthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-        depthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
-
-        D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
-        depthOptimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-        depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
-        depthOptimizedClearValue.DepthStencil.Stencil = 0;
-
-        if (FAILED(m_device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, width, height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL),
-            D3D12_RESOURCE_STATE_DEPTH_WRITE,
-            &depthOptimizedClearValue,
-            IID_PPV_ARGS(&m_depthStencil)
-        )))
-            return false;
+    // ==================== Create Frame Contexts ====================
 
-        m_device->CreateDepthStencilView(m_depthStencil, &depthStencilDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
-    }
+    // the command lists of the frame contexts are made as they are needed
+    if (FAILED(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence))))
+        return false;
+    if (FAILED(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_computeFence))))
+        return false;
 
-    // ==================== Create Command Allocator ====================
+    m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (m_fenceEvent == nullptr)
+        return false;
 
-    if (FAILED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator))))
+    // ==================== Create Frame Timestamps ====================
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = c_framesInFlight * 2;
+    if (FAILED(m_device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_timestampQueryHeap))))
         return false;
 
+    if (FAILED(m_device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(c_framesInFlight * 2 * sizeof(UINT64)),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(&m_timestampReadback))))
+        return false;
+
+    if (FAILED(m_commandQueue->GetTimestampFrequency(&m_timestampFrequency)))
+        return false;
+
+    FramePacerInit(m_framePacer, c_framesInFlight);
+    AcquireFrame();
+
     return true;
 }
 
@@ -296,24 +349,69 @@ ID3D12RootSignature* cdGraphicsAPIDX12::CreateRootSignature(const std::vector<cd
     if (FAILED(m_device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
         featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
 
-    // create root parameters
+    UINT dwordCost = RootSignatureDWORDCost(rootSignatureParameters);
+    char buffer[256];
+    sprintf_s(buffer, "Root signature: %u of %u DWORDs\n", dwordCost, c_maxRootSignatureDWORDs);
+    OutputDebugStringA(buffer);
+
+    // create root parameters. Ranges are reserved up front because the parameters point at them.
     std::vector<CD3DX12_DESCRIPTOR_RANGE1> ranges;
     std::vector<CD3DX12_ROOT_PARAMETER1> rootParameters;
-    ranges.resize(rootSignatureParameters.size());
-    rootParameters.resize(rootSignatureParameters.size());
+    std::vector<D3D12_STATIC_SAMPLER_DESC> staticSamplers;
+    ranges.reserve(rootSignatureParameters.size());
 
     std::array<UINT, 4> startingRegisters{};
     startingRegisters[D3D12_DESCRIPTOR_RANGE_TYPE_UAV] = 1; // the output is uav 0
 
     for (size_t i = 0; i < rootSignatureParameters.size(); ++i)
     {
-        ranges[i].Init(rootSignatureParameters[i].type, (UINT)rootSignatureParameters[i].count, startingRegisters[rootSignatureParameters[i].type]);
-        startingRegisters[rootSignatureParameters[i].type] += rootSignatureParameters[i].count;
-    }
+        const cdRootSignatureParameter& parameter = rootSignatureParameters[i];
 
-    for (size_t i = 0; i < rootSignatureParameters.size(); ++i)
-    {
-        rootParameters[i].InitAsDescriptorTable(1, &ranges[i]);
+        UINT shaderRegister = 0;
+        if (parameter.space == 0)
+        {
+            // constants and root descriptors take one register
+            shaderRegister = startingRegisters[parameter.type];
+            startingRegisters[parameter.type] += (parameter.kind == ERootParameterKind::descriptorTable) ? parameter.count : 1;
+        }
+
+        if (parameter.kind == ERootParameterKind::staticSampler)
+        {
+            CD3DX12_STATIC_SAMPLER_DESC sampler(shaderRegister, parameter.samplerFilter, parameter.samplerAddressMode, parameter.samplerAddressMode, parameter.samplerAddressMode);
+            sampler.RegisterSpace = parameter.space;
+            staticSamplers.push_back(sampler);
+            continue;
+        }
+
+        rootParameters.emplace_back();
+        CD3DX12_ROOT_PARAMETER1& rootParameter = rootParameters.back();
+        switch (parameter.kind)
+        {
+            case ERootParameterKind::descriptorTable:
+            {
+                // an unbounded range covers descriptors that nothing has written yet, so it can't promise they are static
+                D3D12_DESCRIPTOR_RANGE_FLAGS flags = (parameter.count == c_unboundedDescriptorRange) ? D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE : D3D12_DESCRIPTOR_RANGE_FLAG_NONE;
+                ranges.emplace_back();
+                ranges.back().Init(parameter.type, parameter.count, shaderRegister, parameter.space, flags);
+                rootParameter.InitAsDescriptorTable(1, &ranges.back());
+                break;
+            }
+            case ERootParameterKind::constants:
+            {
+                rootParameter.InitAsConstants(parameter.count, shaderRegister, parameter.space);
+                break;
+            }
+            case ERootParameterKind::constantBufferView:
+            {
+                rootParameter.InitAsConstantBufferView(shaderRegister, parameter.space);
+                break;
+            }
+            case ERootParameterKind::shaderResourceView:
+            {
+                rootParameter.InitAsShaderResourceView(shaderRegister, parameter.space);
+                break;
+            }
+        }
     }
 
     D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
@@ -323,7 +421,7 @@ ID3D12RootSignature* cdGraphicsAPIDX12::CreateRootSignature(const std::vector<cd
         D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
 
     CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-    rootSignatureDesc.Init_1_1((UINT)rootParameters.size(), &rootParameters[0], 0, nullptr, rootSignatureFlags);
+    rootSignatureDesc.Init_1_1((UINT)rootParameters.size(), rootParameters.data(), (UINT)staticSamplers.size(), staticSamplers.data(), rootSignatureFlags);
 
     ID3DBlob* signature;
     ID3DBlob* error;
@@ -340,6 +438,27 @@ ID3D12RootSignature* cdGraphicsAPIDX12::CreateRootSignature(const std::vector<cd
     return rootSignature;
 }
 
+UINT RootSignatureDWORDCost(const std::vector<cdRootSignatureParameter>& rootSignatureParameters)
+{
+    UINT cost = 0;
+    for (const cdRootSignatureParameter& parameter : rootSignatureParameters)
+    {
+        switch (parameter.kind)
+        {
+            case ERootParameterKind::descriptorTable: cost += 1; break;
+            case ERootParameterKind::constants: cost += parameter.count; break;
+            case ERootParameterKind::constantBufferView: cost += 2; break;
+            case ERootParameterKind::shaderResourceView: cost += 2; break;
+            case ERootParameterKind::staticSampler: break;
+        }
+    }
+
+    if (cost > c_maxRootSignatureDWORDs)
+        throw std::exception();
+
+    return cost;
+}
+
 bool cdGraphicsAPIDX12::CompileVSPS(const WCHAR* fileName, ID3DBlob*& vertexShader, ID3DBlob*& pixelShader, bool shaderDebug, const std::vector<D3D_SHADER_MACRO> &defines)
 {
     #if defined(_DEBUG)
@@ -350,12 +469,12 @@ bool cdGraphicsAPIDX12::CompileVSPS(const WCHAR* fileName, ID3DBlob*& vertexShad
     #endif
 
     ID3DBlob* error;
-    HRESULT hr = D3DCompileFromFile(fileName, &defines[0], D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &error);
+    HRESULT hr = D3DCompileFromFile(fileName, &defines[0], D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &error);
     OutputShaderErrorMessage(error, fileName);
     if (FAILED(hr))
         return false;
 
-    hr = D3DCompileFromFile(fileName, &defines[0], D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &error);
+    hr = D3DCompileFromFile(fileName, &defines[0], D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &error);
     OutputShaderErrorMessage(error, fileName);
     if (FAILED(hr))
         return false;
@@ -366,39 +485,829 @@ bool cdGraphicsAPIDX12::CompileVSPS(const WCHAR* fileName, ID3DBlob*& vertexShad
     return true;
 }
 
-bool cdGraphicsAPIDX12::CreateCommandList(ID3D12PipelineState* pso)
+bool cdGraphicsAPIDX12::CompileCS(const WCHAR* fileName, ID3DBlob*& computeShader, bool shaderDebug)
 {
-    if (FAILED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator, pso, IID_PPV_ARGS(&m_commandList))))
-        return false;
+    #if defined(_DEBUG)
+        UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    #else
+        UINT compileFlags = shaderDebug ? D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION : 0;
+    #endif
 
+    ID3DBlob* error = nullptr;
+    HRESULT hr = D3DCompileFromFile(fileName, nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_1", compileFlags, 0, &computeShader, &error);
+    OutputShaderErrorMessage(error, fileName);
+    if (error)
+        error->Release();
+
+    return SUCCEEDED(hr);
+}
+
+bool cdGraphicsAPIDX12::CreateCommandList(ID3D12PipelineState* pso)
+{
+    m_commandList = TakeCommandList(pso);
+    m_commandListOpen = true;
+    m_commandList->EndQuery(m_timestampQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, FramePacerContext(m_framePacer) * 2);
+    CommandStateFilterReset(m_stateFilter, pso);
     return true;
 }
 
+// the next command list of a frame context's lists of the type, made if there isn't one to reuse
+static ID3D12GraphicsCommandList* TakeFrameCommandList (ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type, std::vector<ID3D12CommandAllocator*>& commandAllocators,
+    std::vector<ID3D12GraphicsCommandList*>& commandLists, size_t& commandListsUsed, ID3D12PipelineState* pso)
+{
+    size_t index = commandListsUsed++;
+    if (index == commandLists.size())
+    {
+        ID3D12CommandAllocator* commandAllocator;
+        ID3D12GraphicsCommandList* commandList;
+        ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&commandAllocator)));
+        ThrowIfFailed(device->CreateCommandList(0, type, commandAllocator, pso, IID_PPV_ARGS(&commandList)));
+        commandAllocators.push_back(commandAllocator);
+        commandLists.push_back(commandList);
+        return commandList;
+    }
+
+    // Command list allocators can only be reset when the associated 
+    // command lists have finished execution on the GPU. AcquireFrame
+    // waited for the frame that last used this context.
+    ThrowIfFailed(commandAllocators[index]->Reset());
+    ThrowIfFailed(commandLists[index]->Reset(commandAllocators[index], pso));
+    return commandLists[index];
+}
+
+ID3D12GraphicsCommandList* cdGraphicsAPIDX12::TakeCommandList(ID3D12PipelineState* pso)
+{
+    SFrameContext& context = m_frameContexts[FramePacerContext(m_framePacer)];
+    return TakeFrameCommandList(m_device, D3D12_COMMAND_LIST_TYPE_DIRECT, context.m_commandAllocators, context.m_commandLists, context.m_commandListsUsed, pso);
+}
+
+void cdGraphicsAPIDX12::BeginRecording(cdCommandRecorderDX12& recorder, ID3D12RootSignature* rootSignature, ID3D12PipelineState* pso)
+{
+    CommandStateFilterReset(recorder.m_stateFilter, pso);
+    recorder.SetGraphicsRootSignature(rootSignature);
+    SetDescriptorHeaps(recorder);
+}
+
+void cdGraphicsAPIDX12::BeginParallelRecording(size_t count, ID3D12RootSignature* rootSignature)
+{
+    // the barriers belong before the parallel command lists, which are submitted after the main one so far
+    FlushBarriers();
+    if (m_passEvent)
+        PIXEndEvent(m_commandList);
+    ThrowIfFailed(m_commandList->Close());
+
+    m_parallelRecorders.resize(count);
+    for (cdCommandRecorderDX12& recorder : m_parallelRecorders)
+    {
+        recorder.m_commandList = TakeCommandList(nullptr);
+        BeginRecording(recorder, rootSignature, nullptr);
+        if (m_passEvent)
+            PIXBeginEvent(recorder.m_commandList, PIX_COLOR_INDEX(0), "%s", m_passEvent);
+    }
+}
+
+void cdGraphicsAPIDX12::EndParallelRecording(ID3D12RootSignature* rootSignature)
+{
+    // the state filter stats are the frame's, so the parallel recorders add theirs to the main one
+    for (cdCommandRecorderDX12& recorder : m_parallelRecorders)
+    {
+        if (m_passEvent)
+            PIXEndEvent(recorder.m_commandList);
+        ThrowIfFailed(recorder.m_commandList->Close());
+        m_stateFilter.m_stats.m_calls += recorder.m_stateFilter.m_stats.m_calls;
+        m_stateFilter.m_stats.m_filtered += recorder.m_stateFilter.m_stats.m_filtered;
+        recorder.m_stateFilter.m_stats = SCommandStateFilterStats();
+    }
+
+    m_commandList = TakeCommandList(nullptr);
+    BeginRecording(*this, rootSignature, nullptr);
+    if (m_passEvent)
+        PIXBeginEvent(m_commandList, PIX_COLOR_INDEX(0), "%s", m_passEvent);
+}
+
 bool cdGraphicsAPIDX12::CloseAndExecuteCommandList()
 {
+    FlushBarriers();
+    m_commandListOpen = false;
+    DescriptorRingEndFrame(m_transientDescriptorRing, GetFrameFenceValue());
+    UploadRingEndFrame(m_uploadRing, GetFrameFenceValue());
+
+    unsigned int firstTimestamp = FramePacerContext(m_framePacer) * 2;
+    m_commandList->EndQuery(m_timestampQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, firstTimestamp + 1);
+    m_commandList->ResolveQueryData(m_timestampQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, firstTimestamp, 2, m_timestampReadback, firstTimestamp * sizeof(UINT64));
+    std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - m_frameStartTime;
+    m_cpuFrameMilliseconds = cpuTime.count();
+
     if (FAILED(m_commandList->Close()))
         return false;
 
-    ID3D12CommandList* ppCommandLists[] = { m_commandList };
-    m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+    // everything the frame recorded goes in one submit, in the order the command lists were taken
+    SFrameContext& context = m_frameContexts[FramePacerContext(m_framePacer)];
+    m_commandQueue->ExecuteCommandLists(UINT(context.m_commandListsUsed), reinterpret_cast<ID3D12CommandList* const*>(context.m_commandLists.data()));
+
+    // the GPU signals when it's done with the frame, and the next frame is the one being recorded
+    UINT64 fenceValue = FramePacerSubmit(m_framePacer);
+    if (FAILED(m_commandQueue->Signal(m_fence, fenceValue)))
+        return false;
+    QueueSyncSignal(m_queueSync, EQueue::graphics, fenceValue);
+
     return true;
 }
 
+ID3D12GraphicsCommandList* cdGraphicsAPIDX12::OpenComputeCommandList(ID3D12RootSignature* rootSignature, ID3D12PipelineState* pso)
+{
+    SFrameContext& context = m_frameContexts[FramePacerContext(m_framePacer)];
+    ID3D12GraphicsCommandList* commandList = TakeFrameCommandList(m_device, D3D12_COMMAND_LIST_TYPE_COMPUTE, context.m_computeCommandAllocators,
+        context.m_computeCommandLists, context.m_computeCommandListsUsed, pso);
+
+    ID3D12DescriptorHeap* ppHeaps[] = { m_generalHeap, m_samplerHeap };
+    commandList->SetDescriptorHeaps(m_samplerHeap ? 2 : 1, ppHeaps);
+    commandList->SetComputeRootSignature(rootSignature);
+    return commandList;
+}
+
+UINT64 cdGraphicsAPIDX12::SubmitComputeCommandList(ID3D12GraphicsCommandList* commandList)
+{
+    FlushComputeBarriers(commandList);
+    ThrowIfFailed(commandList->Close());
+    ID3D12CommandList* commandLists[] = { commandList };
+    m_computeQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
+
+    UINT64 fenceValue = m_queueSync.m_queues[(size_t)EQueue::compute].m_signaled + 1;
+    ThrowIfFailed(m_computeQueue->Signal(m_computeFence, fenceValue));
+    QueueSyncSignal(m_queueSync, EQueue::compute, fenceValue);
+
+    // the context's compute command lists can be reused once this is done
+    m_frameContexts[FramePacerContext(m_framePacer)].m_computeFenceValue = fenceValue;
+    return fenceValue;
+}
+
+void cdGraphicsAPIDX12::ComputeWaitForGraphics(UINT64 graphicsFenceValue)
+{
+    if (QueueSyncWait(m_queueSync, EQueue::compute, EQueue::graphics, graphicsFenceValue))
+        ThrowIfFailed(m_computeQueue->Wait(m_fence, graphicsFenceValue));
+}
+
+void cdGraphicsAPIDX12::GraphicsWaitForCompute(UINT64 computeFenceValue)
+{
+    if (QueueSyncWait(m_queueSync, EQueue::graphics, EQueue::compute, computeFenceValue))
+        ThrowIfFailed(m_commandQueue->Wait(m_computeFence, computeFenceValue));
+}
+
 bool cdGraphicsAPIDX12::OpenCommandList(ID3D12RootSignature* rootSignature, ID3D12PipelineState* pso)
 {
-    // Command list allocators can only be reset when the associated 
-    // command lists have finished execution on the GPU; apps should use 
-    // fences to determine GPU execution progress.
-    if (FAILED(m_commandAllocator->Reset()))
-        return false;
+    m_commandList = TakeCommandList(pso);
+    m_commandListOpen = true;
+    m_commandList->EndQuery(m_timestampQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, FramePacerContext(m_framePacer) * 2);
+    BeginRecording(*this, rootSignature, pso);
 
-    if (FAILED(m_commandList->Reset(m_commandAllocator, pso)))
-        return false;
+    return true;
+}
+
+void cdGraphicsAPIDX12::AcquireFrame()
+{
+    std::chrono::high_resolution_clock::time_point waitStart = std::chrono::high_resolution_clock::now();
+
+    // wait for the swap chain before anything else, so that the frame starts from the newest input
+    if (m_frameLatencyWaitableObject)
+        WaitForSingleObjectEx(m_frameLatencyWaitableObject, 1000, TRUE);
+
+    UINT64 fenceValue = FramePacerAcquire(m_framePacer, m_fence->GetCompletedValue());
+    WaitForFenceValue(m_fence, fenceValue);
+
+    // the frame that last used this context is done, so its command lists can be reused and its timestamps are there.
+    // Its compute work doesn't hold the graphics queue up, so that is waited for on its own.
+    unsigned int context = FramePacerContext(m_framePacer);
+    WaitForFenceValue(m_computeFence, m_frameContexts[context].m_computeFenceValue);
+    m_frameContexts[context].m_commandListsUsed = 0;
+    m_frameContexts[context].m_computeCommandListsUsed = 0;
+    RetireCompletedFrames();
+    if (fenceValue > 0)
+        ReadFrameTimestamps(context);
+
+    m_frameStartTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> waitTime = m_frameStartTime - waitStart;
+
+    // the first frames load the assets, and would throw the averages off
+    if (m_frameLatencyWaitableObject && m_framePacer.m_frameNumber > c_framesInFlight &&
+        FrameLatencyUpdate(m_frameLatency, m_cpuFrameMilliseconds, m_gpuFrameMilliseconds, waitTime.count()))
+        ThrowIfFailed(m_swapChain->SetMaximumFrameLatency(m_frameLatency.m_latency));
+}
+
+void cdGraphicsAPIDX12::ReadFrameTimestamps(unsigned int context)
+{
+    D3D12_RANGE readRange = { context * 2 * sizeof(UINT64), (context + 1) * 2 * sizeof(UINT64) };
+    D3D12_RANGE writeRange = { 0, 0 };
+    UINT64* timestamps;
+    ThrowIfFailed(m_timestampReadback->Map(0, &readRange, reinterpret_cast<void**>(&timestamps)));
+    UINT64 begin = timestamps[context * 2];
+    UINT64 end = timestamps[context * 2 + 1];
+    m_timestampReadback->Unmap(0, &writeRange);
+
+    if (end > begin)
+        m_gpuFrameMilliseconds = double(end - begin) * 1000.0 / double(m_timestampFrequency);
+}
+
+void cdGraphicsAPIDX12::WaitForGPU()
+{
+    // the last frame submitted signals the frame number of the frame being recorded
+    WaitForFenceValue(m_fence, m_framePacer.m_frameNumber);
+    WaitForFenceValue(m_computeFence, m_queueSync.m_queues[(size_t)EQueue::compute].m_signaled);
+    RetireCompletedFrames();
+}
+
+void cdGraphicsAPIDX12::WaitForFenceValue(ID3D12Fence* fence, UINT64 fenceValue)
+{
+    if (fence->GetCompletedValue() >= fenceValue)
+        return;
+
+    ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+    WaitForSingleObject(m_fenceEvent, INFINITE);
+}
+
+void cdGraphicsAPIDX12::RetireCompletedFrames()
+{
+    UINT64 completedFenceValue = m_fence->GetCompletedValue();
+    QueueSyncComplete(m_queueSync, EQueue::graphics, completedFenceValue);
+    QueueSyncComplete(m_queueSync, EQueue::compute, m_computeFence->GetCompletedValue());
+    RetireDeferredReleases(completedFenceValue);
+    DescriptorAllocatorRetire(m_generalHeapAllocator, completedFenceValue);
+    DescriptorRingRetire(m_transientDescriptorRing, completedFenceValue);
+    UploadRingRetire(m_uploadRing, completedFenceValue);
+}
+
+void cdGraphicsAPIDX12::RetireDeferredReleases(UINT64 completedFenceValue)
+{
+    std::vector<SDeferredRelease> retired;
+    DeferredReleaseRetire(m_deferredReleases, completedFenceValue, retired);
+    for (const SDeferredRelease& release : retired)
+    {
+        switch (release.m_kind)
+        {
+            case EDeferredReleaseKind::object:
+            {
+                static_cast<ID3D12Pageable*>(release.m_object)->Release();
+                break;
+            }
+            case EDeferredReleaseKind::descriptorRange:
+            {
+                // the GPU is done with it, so the allocator can hand it out at its next retire
+                DescriptorAllocatorFree(m_generalHeapAllocator, release.m_first, release.m_count, completedFenceValue);
+                break;
+            }
+        }
+    }
+}
+
+// what an object takes up in memory, as far as it can be told
+static UINT64 PageableSize (ID3D12Device* device, ID3D12Pageable* object)
+{
+    UINT64 bytes = 0;
+    ID3D12Resource* resource;
+    ID3D12Heap* heap;
+    ID3D12DescriptorHeap* descriptorHeap;
+    if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(&resource))))
+    {
+        D3D12_RESOURCE_DESC desc = resource->GetDesc();
+        bytes = device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+        resource->Release();
+    }
+    else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(&heap))))
+    {
+        bytes = heap->GetDesc().SizeInBytes;
+        heap->Release();
+    }
+    else if (SUCCEEDED(object->QueryInterface(IID_PPV_ARGS(&descriptorHeap))))
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC desc = descriptorHeap->GetDesc();
+        bytes = UINT64(desc.NumDescriptors) * device->GetDescriptorHandleIncrementSize(desc.Type);
+        descriptorHeap->Release();
+    }
+    return bytes;
+}
+
+void cdGraphicsAPIDX12::DeferRelease(ID3D12Pageable* object)
+{
+    if (!object)
+        return;
+
+    SDeferredRelease release;
+    release.m_kind = EDeferredReleaseKind::object;
+    release.m_object = object;
+    release.m_bytes = PageableSize(m_device, object);
+    release.m_fenceValue = GetFrameFenceValue();
+    DeferredReleasePush(m_deferredReleases, release);
+}
+
+void cdCommandRecorderDX12::SetPipelineState(ID3D12PipelineState* pso)
+{
+    if (CommandStateFilterPipelineState(m_stateFilter, pso))
+        m_commandList->SetPipelineState(pso);
+}
+
+void cdCommandRecorderDX12::SetGraphicsRootSignature(ID3D12RootSignature* rootSignature)
+{
+    if (CommandStateFilterRootSignature(m_stateFilter, rootSignature))
+        m_commandList->SetGraphicsRootSignature(rootSignature);
+}
+
+void cdCommandRecorderDX12::SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+    if (CommandStateFilterRootTable(m_stateFilter, rootParameter, handle.ptr))
+        m_commandList->SetGraphicsRootDescriptorTable(rootParameter, handle);
+}
+
+void cdCommandRecorderDX12::IASetVertexBuffer(UINT slot, const D3D12_VERTEX_BUFFER_VIEW& view)
+{
+    if (CommandStateFilterVertexBuffer(m_stateFilter, slot, { view.BufferLocation, view.SizeInBytes, view.StrideInBytes }))
+        m_commandList->IASetVertexBuffers(slot, 1, &view);
+}
+
+void cdCommandRecorderDX12::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view)
+{
+    if (CommandStateFilterIndexBuffer(m_stateFilter, { view.BufferLocation, view.SizeInBytes, UINT32(view.Format) }))
+        m_commandList->IASetIndexBuffer(&view);
+}
 
-    m_commandList->SetGraphicsRootSignature(rootSignature);
+void cdCommandRecorderDX12::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+{
+    if (CommandStateFilterTopology(m_stateFilter, UINT32(topology)))
+        m_commandList->IASetPrimitiveTopology(topology);
+}
 
+void cdGraphicsAPIDX12::SetDescriptorHeaps(cdCommandRecorderDX12& recorder)
+{
     ID3D12DescriptorHeap* ppHeaps[] = { m_generalHeap, m_samplerHeap };
-    m_commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+    recorder.m_commandList->SetDescriptorHeaps(m_samplerHeap ? 2 : 1, ppHeaps);
+}
 
-    return true;
-}
\ No newline at end of file
+void cdCommandRecorderDX12::SetGraphicsRootConstantBufferView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    if (CommandStateFilterRootTable(m_stateFilter, rootParameterIndex, address))
+        m_commandList->SetGraphicsRootConstantBufferView(rootParameterIndex, address);
+}
+
+void cdCommandRecorderDX12::SetGraphicsRootShaderResourceView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+{
+    if (CommandStateFilterRootTable(m_stateFilter, rootParameterIndex, address))
+        m_commandList->SetGraphicsRootShaderResourceView(rootParameterIndex, address);
+}
+
+void cdCommandRecorderDX12::SetGraphicsRoot32BitConstants(UINT rootParameterIndex, UINT value0, UINT value1)
+{
+    if (CommandStateFilterRootTable(m_stateFilter, rootParameterIndex, UINT64(value0) | (UINT64(value1) << 32)))
+    {
+        UINT values[] = { value0, value1 };
+        m_commandList->SetGraphicsRoot32BitConstants(rootParameterIndex, _countof(values), values, 0);
+    }
+}
+
+unsigned int cdGraphicsAPIDX12::ReserveGeneralHeapID(unsigned int count)
+{
+    UINT32 id;
+    if (!DescriptorAllocatorAllocate(m_generalHeapAllocator, count, id))
+    {
+        GrowGeneralHeap(count);
+        if (!DescriptorAllocatorAllocate(m_generalHeapAllocator, count, id))
+            throw std::exception();
+    }
+    return id;
+}
+
+void cdGraphicsAPIDX12::FreeGeneralHeapID(unsigned int id, unsigned int count)
+{
+    SDeferredRelease release;
+    release.m_kind = EDeferredReleaseKind::descriptorRange;
+    release.m_first = id;
+    release.m_count = count;
+    release.m_bytes = UINT64(count) * m_generalHeapDescriptorSize;
+    release.m_fenceValue = GetFrameFenceValue();
+    DeferredReleasePush(m_deferredReleases, release);
+}
+
+void cdGraphicsAPIDX12::CommitGeneralHeapDescriptors(unsigned int id, unsigned int count)
+{
+    m_device->CopyDescriptorsSimple(count, CD3DX12_CPU_DESCRIPTOR_HANDLE(m_generalHeap->GetCPUDescriptorHandleForHeapStart(), (INT)id, m_generalHeapDescriptorSize), GetGeneralHeapCPUHandle(id), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void cdGraphicsAPIDX12::GrowGeneralHeap(unsigned int count)
+{
+    UINT32 oldCapacity = m_generalHeapAllocator.m_capacity;
+    UINT32 newCapacity = std::max<UINT32>(oldCapacity * 2, oldCapacity + count);
+
+    D3D12_DESCRIPTOR_HEAP_DESC generalHeapDesc = {};
+    generalHeapDesc.NumDescriptors = newCapacity + c_transientDescriptors;
+    generalHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    generalHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ID3D12DescriptorHeap* generalHeap;
+    ThrowIfFailed(m_device->CreateDescriptorHeap(&generalHeapDesc, IID_PPV_ARGS(&generalHeap)));
+
+    generalHeapDesc.NumDescriptors = newCapacity;
+    generalHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    ID3D12DescriptorHeap* generalHeapShaderInvisible;
+    ThrowIfFailed(m_device->CreateDescriptorHeap(&generalHeapDesc, IID_PPV_ARGS(&generalHeapShaderInvisible)));
+
+    // copy the live descriptors over from the staging heap, because shader visible heaps are too slow to read from
+    std::vector<SDescriptorRange> ranges;
+    DescriptorAllocatorGetAllocatedRanges(m_generalHeapAllocator, ranges);
+    for (const SDescriptorRange& range : ranges)
+    {
+        CD3DX12_CPU_DESCRIPTOR_HANDLE src(m_generalHeapShaderInvisible->GetCPUDescriptorHandleForHeapStart(), (INT)range.m_offset, m_generalHeapDescriptorSize);
+        CD3DX12_CPU_DESCRIPTOR_HANDLE dest(generalHeapShaderInvisible->GetCPUDescriptorHandleForHeapStart(), (INT)range.m_offset, m_generalHeapDescriptorSize);
+        CD3DX12_CPU_DESCRIPTOR_HANDLE destShaderVisible(generalHeap->GetCPUDescriptorHandleForHeapStart(), (INT)range.m_offset, m_generalHeapDescriptorSize);
+        m_device->CopyDescriptorsSimple(range.m_count, dest, src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        m_device->CopyDescriptorsSimple(range.m_count, destShaderVisible, src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    }
+
+    // command lists that were already recorded may still use the old shader visible heap on the GPU. The old staging
+    // heap is only used by the CPU, so it can go now.
+    DeferRelease(m_generalHeap);
+    m_generalHeapShaderInvisible->Release();
+    m_generalHeap = generalHeap;
+    m_generalHeapShaderInvisible = generalHeapShaderInvisible;
+    DescriptorAllocatorGrow(m_generalHeapAllocator, newCapacity);
+
+    // the transient tables in flight stay in the old heap, so the ring in the new one starts out empty
+    DescriptorRingReset(m_transientDescriptorRing);
+
+    // the open command list has to switch to the new heap, which unbinds the root tables
+    if (m_commandListOpen)
+    {
+        SetDescriptorHeaps(*this);
+        CommandStateFilterDescriptorHeaps(m_stateFilter);
+    }
+}
+
+SUploadAllocation cdGraphicsAPIDX12::AllocateUpload(UINT64 size, UINT64 alignment)
+{
+    UINT64 offset;
+    if (!UploadRingAllocate(m_uploadRing, size, alignment, offset))
+        throw std::exception();
+
+    SUploadAllocation allocation;
+    allocation.m_cpuAddress = m_uploadBufferBegin + offset;
+    allocation.m_gpuAddress = m_uploadBuffer->GetGPUVirtualAddress() + offset;
+    allocation.m_resource = m_uploadBuffer;
+    allocation.m_offset = offset;
+    return allocation;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE cdGraphicsAPIDX12::MakeTransientDescriptorTable(const unsigned int* ids, unsigned int count)
+{
+    if (count > c_maxTransientDescriptorTableSize)
+        throw std::exception();
+
+    UINT32 offset;
+    bool needsCopy;
+    if (!DescriptorRingAllocateTable(m_transientDescriptorRing, ids, count, offset, needsCopy))
+        throw std::exception();
+
+    // the ring is after the allocated part of the heap
+    unsigned int tableID = m_generalHeapAllocator.m_capacity + offset;
+
+    // copy runs of neighboring descriptors with one call each
+    if (needsCopy)
+    {
+        unsigned int runStart = 0;
+        for (unsigned int i = 1; i <= count; ++i)
+        {
+            if (i < count && ids[i] == ids[i - 1] + 1)
+                continue;
+
+            CD3DX12_CPU_DESCRIPTOR_HANDLE dest(m_generalHeap->GetCPUDescriptorHandleForHeapStart(), (INT)(tableID + runStart), m_generalHeapDescriptorSize);
+            m_device->CopyDescriptorsSimple(i - runStart, dest, GetGeneralHeapCPUHandle(ids[runStart]), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            runStart = i;
+        }
+    }
+
+    return GetGeneralHeapGPUHandle(tableID);
+}
+
+// the D3D12 state of each render graph access, in ERenderGraphAccess order
+static const D3D12_RESOURCE_STATES c_renderGraphAccessStates[] =
+{
+    D3D12_RESOURCE_STATE_RENDER_TARGET,
+    D3D12_RESOURCE_STATE_DEPTH_WRITE,
+    D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+    D3D12_RESOURCE_STATE_COPY_DEST,
+    D3D12_RESOURCE_STATE_DEPTH_READ,
+    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+    D3D12_RESOURCE_STATE_COPY_SOURCE,
+    D3D12_RESOURCE_STATE_PRESENT,
+};
+static_assert(_countof(c_renderGraphAccessStates) == (size_t)ERenderGraphAccess::Count, "c_renderGraphAccessStates has the wrong number of entries");
+
+static D3D12_RESOURCE_STATES RenderGraphStateToD3D12 (RenderGraphState state)
+{
+    D3D12_RESOURCE_STATES ret = D3D12_RESOURCE_STATE_COMMON;
+    for (size_t i = 0; i < _countof(c_renderGraphAccessStates); ++i)
+    {
+        if (state & RenderGraphAccessState(ERenderGraphAccess(i)))
+            ret |= c_renderGraphAccessStates[i];
+    }
+    return ret;
+}
+
+static const UINT32 c_renderGraphHeapGroupTargets = 0;     // render targets and depth buffers
+static const UINT32 c_renderGraphHeapGroupTextures = 1;    // everything else
+
+static D3D12_RESOURCE_DESC RenderGraphTextureDescToD3D12 (const SRenderGraphTextureDesc& desc)
+{
+    return CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT(desc.m_format), desc.m_width, desc.m_height, UINT16(desc.m_arraySize), 1, 1, 0, D3D12_RESOURCE_FLAGS(desc.m_flags));
+}
+
+static bool RenderGraphTextureDescsMatch (const SRenderGraphTextureDesc& a, const SRenderGraphTextureDesc& b)
+{
+    return a.m_width == b.m_width && a.m_height == b.m_height && a.m_arraySize == b.m_arraySize && a.m_format == b.m_format && a.m_flags == b.m_flags;
+}
+
+SRenderGraphTextureDesc cdGraphicsAPIDX12::MakeRenderGraphTextureDesc(DXGI_FORMAT format, UINT width, UINT height, UINT arraySize, D3D12_RESOURCE_FLAGS flags)
+{
+    SRenderGraphTextureDesc desc;
+    desc.m_width = width;
+    desc.m_height = height;
+    desc.m_arraySize = arraySize;
+    desc.m_format = UINT32(format);
+    desc.m_flags = UINT32(flags);
+    desc.m_heapGroup = (flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) ? c_renderGraphHeapGroupTargets : c_renderGraphHeapGroupTextures;
+
+    D3D12_RESOURCE_DESC resourceDesc = RenderGraphTextureDescToD3D12(desc);
+    D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+    desc.m_sizeInBytes = info.SizeInBytes;
+    desc.m_alignment = info.Alignment;
+    return desc;
+}
+
+void cdGraphicsAPIDX12::ReleaseRenderGraphTexture(SRenderGraphTextureDX12& texture)
+{
+    DeferRelease(texture.m_resource);
+    if (texture.m_srvHeapID != (unsigned int)-1)
+        FreeGeneralHeapID(texture.m_srvHeapID);
+    if (texture.m_uavHeapID != (unsigned int)-1)
+        FreeGeneralHeapID(texture.m_uavHeapID);
+    texture = SRenderGraphTextureDX12();
+}
+
+void cdGraphicsAPIDX12::RealizeRenderGraph(const SRenderGraph& graph, const SRenderGraphCompiled& compiled)
+{
+    // a heap that is too small or of the wrong group is made again, and so are the textures in it
+    std::vector<bool> heapMade(compiled.m_heaps.size(), false);
+    m_renderGraphHeaps.resize(std::max<size_t>(m_renderGraphHeaps.size(), compiled.m_heaps.size()));
+    for (size_t heapIndex = 0; heapIndex < compiled.m_heaps.size(); ++heapIndex)
+    {
+        const SRenderGraphHeap& heap = compiled.m_heaps[heapIndex];
+        SRenderGraphHeapDX12& heapDX12 = m_renderGraphHeaps[heapIndex];
+        if (heapDX12.m_heap && heapDX12.m_heapGroup == heap.m_heapGroup && heapDX12.m_sizeInBytes >= heap.m_sizeInBytes)
+            continue;
+
+        DeferRelease(heapDX12.m_heap);
+        heapDX12.m_heapGroup = heap.m_heapGroup;
+        heapDX12.m_sizeInBytes = heap.m_sizeInBytes;
+
+        CD3DX12_HEAP_DESC heapDesc(heap.m_sizeInBytes, D3D12_HEAP_TYPE_DEFAULT, heap.m_alignment,
+            (heap.m_heapGroup == c_renderGraphHeapGroupTargets) ? D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES);
+        ThrowIfFailed(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heapDX12.m_heap)));
+        SetNameIndexed(heapDX12.m_heap, L"Render Graph Heap", (UINT)heapIndex);
+        heapMade[heapIndex] = true;
+    }
+
+    for (size_t i = graph.m_resources.size(); i < m_renderGraphTextures.size(); ++i)
+        ReleaseRenderGraphTexture(m_renderGraphTextures[i]);
+    m_renderGraphTextures.resize(graph.m_resources.size());
+
+    for (UINT32 resourceIndex = 0; resourceIndex < graph.m_resources.size(); ++resourceIndex)
+    {
+        const SRenderGraphResource& resource = graph.m_resources[resourceIndex];
+        const SRenderGraphPlacement& placement = compiled.m_placements[resourceIndex];
+        SRenderGraphTextureDX12& texture = m_renderGraphTextures[resourceIndex];
+
+        if (placement.m_heap == c_renderGraphNoResource)
+        {
+            ReleaseRenderGraphTexture(texture);
+            continue;
+        }
+
+        if (texture.m_resource && !heapMade[placement.m_heap] && texture.m_heap == placement.m_heap && texture.m_offset == placement.m_offset &&
+            RenderGraphTextureDescsMatch(texture.m_desc, resource.m_desc))
+            continue;
+
+        ReleaseRenderGraphTexture(texture);
+        texture.m_desc = resource.m_desc;
+        texture.m_heap = placement.m_heap;
+        texture.m_offset = placement.m_offset;
+
+        D3D12_RESOURCE_DESC resourceDesc = RenderGraphTextureDescToD3D12(resource.m_desc);
+        D3D12_CLEAR_VALUE depthClearValue = {};
+        depthClearValue.Format = resourceDesc.Format;
+        depthClearValue.DepthStencil.Depth = 1.0f;
+        bool depth = (resourceDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) != 0;
+        ThrowIfFailed(m_device->CreatePlacedResource(m_renderGraphHeaps[placement.m_heap].m_heap, placement.m_offset, &resourceDesc,
+            RenderGraphStateToD3D12(placement.m_state), depth ? &depthClearValue : nullptr, IID_PPV_ARGS(&texture.m_resource)));
+        SetNameIndexed(texture.m_resource, L"Render Graph Texture", (UINT)resourceIndex);
+
+        // Views of a texture array see all of its slices. RTVs and DSVs are only read when they are set, so they can be
+        // written over while the GPU still works on earlier frames.
+        bool array = resource.m_desc.m_arraySize > 1;
+        if (resourceDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET)
+        {
+            D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+            rtvDesc.Format = resourceDesc.Format;
+            rtvDesc.ViewDimension = array ? D3D12_RTV_DIMENSION_TEXTURE2DARRAY : D3D12_RTV_DIMENSION_TEXTURE2D;
+            rtvDesc.Texture2DArray.ArraySize = resource.m_desc.m_arraySize;
+            m_device->CreateRenderTargetView(texture.m_resource, &rtvDesc, GetRenderGraphRTV(resourceIndex));
+        }
+        if (depth)
+        {
+            D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+            dsvDesc.Format = resourceDesc.Format;
+            dsvDesc.ViewDimension = array ? D3D12_DSV_DIMENSION_TEXTURE2DARRAY : D3D12_DSV_DIMENSION_TEXTURE2D;
+            dsvDesc.Texture2DArray.ArraySize = resource.m_desc.m_arraySize;
+            m_device->CreateDepthStencilView(texture.m_resource, &dsvDesc, GetRenderGraphDSV(resourceIndex));
+        }
+        if (!depth && !(resourceDesc.Flags & D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE))
+        {
+            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Format = resourceDesc.Format;
+            srvDesc.ViewDimension = array ? D3D12_SRV_DIMENSION_TEXTURE2DARRAY : D3D12_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+            srvDesc.Texture2DArray.MipLevels = 1;
+            srvDesc.Texture2DArray.ArraySize = resource.m_desc.m_arraySize;
+            texture.m_srvHeapID = ReserveGeneralHeapID();
+            m_device->CreateShaderResourceView(texture.m_resource, &srvDesc, GetGeneralHeapCPUHandle(texture.m_srvHeapID));
+            CommitGeneralHeapDescriptors(texture.m_srvHeapID);
+        }
+        if (resourceDesc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)
+        {
+            D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+            uavDesc.Format = resourceDesc.Format;
+            uavDesc.ViewDimension = array ? D3D12_UAV_DIMENSION_TEXTURE2DARRAY : D3D12_UAV_DIMENSION_TEXTURE2D;
+            uavDesc.Texture2DArray.ArraySize = resource.m_desc.m_arraySize;
+            texture.m_uavHeapID = ReserveGeneralHeapID();
+            // the staging heap copy of the uav is also what ClearUnorderedAccessViewFloat needs as its CPU handle
+            m_device->CreateUnorderedAccessView(texture.m_resource, nullptr, &uavDesc, GetGeneralHeapCPUHandle(texture.m_uavHeapID));
+            CommitGeneralHeapDescriptors(texture.m_uavHeapID);
+        }
+    }
+}
+
+void cdGraphicsAPIDX12::ExecuteRenderGraph(const SRenderGraph& graph, const SRenderGraphCompiled& compiled)
+{
+    for (const SRenderGraphStep& step : compiled.m_steps)
+    {
+        for (UINT32 barrierIndex = step.m_firstBarrier; barrierIndex < step.m_firstBarrier + step.m_barrierCount; ++barrierIndex)
+        {
+            const SRenderGraphBarrier& barrier = compiled.m_barriers[barrierIndex];
+            ID3D12Resource* resource = GetRenderGraphResource(graph, barrier.m_resource);
+            switch (barrier.m_type)
+            {
+                case ERenderGraphBarrierType::transition:
+                case ERenderGraphBarrierType::beginSplit:
+                case ERenderGraphBarrierType::endSplit:
+                {
+                    D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+                    if (barrier.m_type == ERenderGraphBarrierType::beginSplit)
+                        flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+                    else if (barrier.m_type == ERenderGraphBarrierType::endSplit)
+                        flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+                    Transition(resource, RenderGraphStateToD3D12(barrier.m_before), RenderGraphStateToD3D12(barrier.m_after), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, flags);
+                    break;
+                }
+                case ERenderGraphBarrierType::unorderedAccess:
+                {
+                    UAVBarrier(resource);
+                    break;
+                }
+                case ERenderGraphBarrierType::aliasing:
+                {
+                    ID3D12Resource* before = (barrier.m_resourceBefore == c_renderGraphNoResource) ? nullptr : GetRenderGraphResource(graph, barrier.m_resourceBefore);
+                    AliasingBarrier(before, resource);
+                    break;
+                }
+            }
+        }
+
+        // the last step's barriers are flushed with whatever comes after the graph
+        if (step.m_pass != c_renderGraphNoPass)
+            FlushBarriers();
+
+        // render targets and depth buffers that took over memory have to be cleared or discarded before anything else
+        for (UINT32 barrierIndex = step.m_firstBarrier; barrierIndex < step.m_firstBarrier + step.m_barrierCount; ++barrierIndex)
+        {
+            const SRenderGraphBarrier& barrier = compiled.m_barriers[barrierIndex];
+            if (barrier.m_type == ERenderGraphBarrierType::aliasing &&
+                (barrier.m_after & (RenderGraphAccessState(ERenderGraphAccess::renderTarget) | RenderGraphAccessState(ERenderGraphAccess::depthWrite))))
+                m_commandList->DiscardResource(GetRenderGraphResource(graph, barrier.m_resource), nullptr);
+        }
+
+        if (step.m_pass != c_renderGraphNoPass)
+        {
+            const SRenderGraphPass& pass = graph.m_passes[step.m_pass];
+            m_passEvent = pass.m_name;
+            PIXBeginEvent(m_commandList, PIX_COLOR_INDEX(0), "%s", m_passEvent);
+            pass.m_execute();
+            PIXEndEvent(m_commandList);
+            m_passEvent = nullptr;
+        }
+    }
+}
+
+ID3D12Resource* cdGraphicsAPIDX12::GetRenderGraphResource(const SRenderGraph& graph, UINT32 resource) const
+{
+    const SRenderGraphResource& graphResource = graph.m_resources[resource];
+    return graphResource.m_imported ? (ID3D12Resource*)graphResource.m_external : m_renderGraphTextures[resource].m_resource;
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE cdGraphicsAPIDX12::GetRenderGraphRTV(UINT32 resource) const
+{
+    INT index = INT(m_renderTargetsColor.size() + resource);
+    if (index >= INT(c_maxRTVDescriptors))
+        throw std::exception();
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), index, m_rtvHeapDescriptorSize);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE cdGraphicsAPIDX12::GetRenderGraphDSV(UINT32 resource) const
+{
+    if (resource >= c_maxDSVDescriptors)
+        throw std::exception();
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), INT(resource), m_dsvHeapDescriptorSize);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE cdGraphicsAPIDX12::GetRenderGraphSRV(UINT32 resource) const
+{
+    return GetGeneralHeapGPUHandle(m_renderGraphTextures[resource].m_srvHeapID);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE cdGraphicsAPIDX12::GetRenderGraphUAV(UINT32 resource) const
+{
+    return GetGeneralHeapGPUHandle(m_renderGraphTextures[resource].m_uavHeapID);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE cdGraphicsAPIDX12::GetRenderGraphUAVStaging(UINT32 resource) const
+{
+    return GetGeneralHeapCPUHandle(m_renderGraphTextures[resource].m_uavHeapID);
+}
+
+void cdGraphicsAPIDX12::Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, UINT subresource, D3D12_RESOURCE_BARRIER_FLAGS flags)
+{
+    BarrierBatchTransition(m_barrierBatch, resource, UINT32(before), UINT32(after), subresource, UINT32(flags));
+}
+
+void cdGraphicsAPIDX12::UAVBarrier(ID3D12Resource* resource)
+{
+    BarrierBatchUnorderedAccess(m_barrierBatch, resource);
+}
+
+void cdGraphicsAPIDX12::AliasingBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter)
+{
+    BarrierBatchAliasing(m_barrierBatch, resourceBefore, resourceAfter);
+}
+
+void cdGraphicsAPIDX12::FlushBarriers()
+{
+    FlushBarrierBatch(m_barrierBatch, m_commandList);
+}
+
+void cdGraphicsAPIDX12::ComputeTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, UINT subresource)
+{
+    BarrierBatchTransition(m_computeBarrierBatch, resource, UINT32(before), UINT32(after), subresource);
+}
+
+void cdGraphicsAPIDX12::FlushComputeBarriers(ID3D12GraphicsCommandList* commandList)
+{
+    FlushBarrierBatch(m_computeBarrierBatch, commandList);
+}
+
+void cdGraphicsAPIDX12::FlushBarrierBatch(SBarrierBatch& batch, ID3D12GraphicsCommandList* commandList)
+{
+    BarrierBatchFlush(batch, m_barriersFlushed);
+    if (m_barriersFlushed.empty())
+        return;
+
+    m_barriersD3D12.clear();
+    for (const SBarrier& barrier : m_barriersFlushed)
+    {
+        ID3D12Resource* resource = const_cast<ID3D12Resource*>(static_cast<const ID3D12Resource*>(barrier.m_resource));
+        switch (barrier.m_type)
+        {
+            case EBarrierType::transition:
+            {
+                m_barriersD3D12.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, D3D12_RESOURCE_STATES(barrier.m_before), D3D12_RESOURCE_STATES(barrier.m_after),
+                    barrier.m_subresource, D3D12_RESOURCE_BARRIER_FLAGS(barrier.m_flags)));
+                break;
+            }
+            case EBarrierType::unorderedAccess:
+            {
+                m_barriersD3D12.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+                break;
+            }
+            case EBarrierType::aliasing:
+            {
+                ID3D12Resource* resourceBefore = const_cast<ID3D12Resource*>(static_cast<const ID3D12Resource*>(barrier.m_resourceBefore));
+                m_barriersD3D12.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(resourceBefore, resource));
+                break;
+            }
+        }
+    }
+    commandList->ResourceBarrier((UINT)m_barriersD3D12.size(), m_barriersD3D12.data());
+}
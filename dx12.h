@@ -3,94 +3,444 @@
 // TODO: includes to dx12 stuff here
 
 #include <vector>
+#include <chrono>
+#include "CommandStateFilter.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorRing.h"
+#include "UploadRing.h"
+#include "FramePacer.h"
+#include "FrameLatency.h"
+#include "DeferredRelease.h"
+#include "BarrierBatch.h"
+#include "QueueSync.h"
+#include "RenderGraph.h"
+#include "Threading.h"
 
+enum class ERootParameterKind
+{
+    descriptorTable,
+    constants,              // count is the number of 32 bit values, in a b register
+    constantBufferView,     // a constant buffer set by GPU address
+    shaderResourceView,     // a buffer set by GPU address, in a t register
+    staticSampler,          // a sampler baked into the root signature. It doesn't take a root parameter index.
+};
+
+// A descriptor table of one range, unless kind says otherwise. Registers are given out in order for each type, except
+// for parameters in a register space other than 0, which start at register 0 of that space.
 struct cdRootSignatureParameter
 {
     D3D12_DESCRIPTOR_RANGE_TYPE type;
-    UINT                        count;
+    UINT                        count;      // c_unboundedDescriptorRange is a range to the end of the heap, and needs a space other than 0
+    ERootParameterKind          kind = ERootParameterKind::descriptorTable;
+    UINT                        space = 0;
+
+    // for static samplers
+    D3D12_FILTER                samplerFilter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+    D3D12_TEXTURE_ADDRESS_MODE  samplerAddressMode = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+};
+
+static const UINT c_unboundedDescriptorRange = UINT_MAX;
+
+// How many frames the CPU can get ahead of the GPU. Resources the CPU writes each frame keep this many versions.
+static const unsigned int c_framesInFlight = 2;
+
+// With a waitable swap chain, how much longer frames can get to lower the frame latency, as a fraction
+static const double c_frameLatencyTolerance = 0.1;
+
+// what each frame in flight has of its own
+struct SFrameContext
+{
+    // The frame's command lists, in the order they are submitted. Each has its own allocator so that they can be
+    // recorded on different threads. More are made as needed, and frames that use the context later reuse them.
+    std::vector<ID3D12CommandAllocator*>    m_commandAllocators;
+    std::vector<ID3D12GraphicsCommandList*> m_commandLists;
+    size_t                                  m_commandListsUsed = 0;
+
+    // the same for the compute queue, and the compute fence value of the last one submitted
+    std::vector<ID3D12CommandAllocator*>    m_computeCommandAllocators;
+    std::vector<ID3D12GraphicsCommandList*> m_computeCommandLists;
+    size_t                                  m_computeCommandListsUsed = 0;
+    UINT64                                  m_computeFenceValue = 0;
+};
+
+// The most root arguments a root signature can have. Tables cost 1, root descriptors 2 and constants 1 each.
+static const UINT c_maxRootSignatureDWORDs = 64;
+
+// Throws if the parameters cost more than c_maxRootSignatureDWORDs
+UINT RootSignatureDWORDCost(const std::vector<cdRootSignatureParameter>& rootSignatureParameters);
+
+// A piece of the per frame upload buffer. The resource and offset are for copies.
+struct SUploadAllocation
+{
+    void*                       m_cpuAddress;
+    D3D12_GPU_VIRTUAL_ADDRESS   m_gpuAddress;
+    ID3D12Resource*             m_resource;
+    UINT64                      m_offset;
 };
 
 #define SAFE_RELEASE(x) {if (x) {x->Release(); x = nullptr;}}
 
-class cdGraphicsAPIDX12
+// A transient texture of the render graph, placed in one of the graph's heaps, and its views. The views that the
+// texture's flags don't allow aren't made.
+struct SRenderGraphTextureDX12
+{
+    SRenderGraphTextureDesc m_desc;
+    UINT32                  m_heap = c_renderGraphNoResource;
+    UINT64                  m_offset = 0;
+    ID3D12Resource*         m_resource = nullptr;
+    unsigned int            m_srvHeapID = (unsigned int)-1;
+    unsigned int            m_uavHeapID = (unsigned int)-1;
+};
+
+struct SRenderGraphHeapDX12
+{
+    ID3D12Heap* m_heap = nullptr;
+    UINT32      m_heapGroup = 0;
+    UINT64      m_sizeInBytes = 0;
+};
+
+// A command list and what is bound on it. The state setting calls skip setting state to what it already is. The
+// graphics API is the recorder of the main command list, and parallel recording makes one per thread.
+class cdCommandRecorderDX12
 {
 public:
-    bool Create(bool gpuDebug, bool useWarpDevice, unsigned int frameCount, unsigned int width, unsigned int height, HWND hWnd);
+    void SetPipelineState(ID3D12PipelineState* pso);
+    void SetGraphicsRootSignature(ID3D12RootSignature* rootSignature);
+    void SetGraphicsRootDescriptorTable(UINT rootParameter, D3D12_GPU_DESCRIPTOR_HANDLE handle);
+    void IASetVertexBuffer(UINT slot, const D3D12_VERTEX_BUFFER_VIEW& view);
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW& view);
+    void IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY topology);
+
+    // Root descriptors and two root constants are 64 bits, so the state filter tracks them like root tables
+    void SetGraphicsRootConstantBufferView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+    void SetGraphicsRootShaderResourceView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS address);
+    void SetGraphicsRoot32BitConstants(UINT rootParameterIndex, UINT value0, UINT value1);
+
+    ID3D12GraphicsCommandList* m_commandList = nullptr;
+
+    // what is bound on m_commandList. It is reset with the command list, and the stats are left for the caller to clear.
+    SCommandStateFilter m_stateFilter;
+};
+
+class cdGraphicsAPIDX12 : public cdCommandRecorderDX12
+{
+public:
+    // The sampler heap is only made if samplerDescriptors isn't 0, because static samplers usually do.
+    // A frame latency waitable swap chain makes AcquireFrame wait until the swap chain has room for another frame, and
+    // adapts how many frames that is to the measured CPU and GPU frame times.
+    bool Create(bool gpuDebug, bool useWarpDevice, unsigned int frameCount, unsigned int width, unsigned int height, HWND hWnd, unsigned int samplerDescriptors = 0, bool frameLatencyWaitable = false);
 
     ID3D12RootSignature* CreateRootSignature(const std::vector<cdRootSignatureParameter>& rootSignatureParameters);
 
     bool CompileVSPS(const WCHAR* fileName, ID3DBlob*& vertexShader, ID3DBlob*& pixelShader, bool shaderDebug, const std::vector<D3D_SHADER_MACRO> &defines);
+    bool CompileCS(const WCHAR* fileName, ID3DBlob*& computeShader, bool shaderDebug);
 
     bool CreateCommandList(ID3D12PipelineState* pso);
 
-    unsigned int ReserveGeneralHeapID(unsigned int count=1)
+    // Allocates a contiguous range of general heap descriptors, growing the heap if needed. Descriptors are written
+    // to the CPU only staging heap through GetGeneralHeapCPUHandle, and then copied to the shader visible heap by
+    // CommitGeneralHeapDescriptors. The staging heap keeps a copy of every descriptor, which is what lets the shader
+    // visible heap be remade bigger.
+    unsigned int ReserveGeneralHeapID(unsigned int count=1);
+
+    // The descriptors can be reused once the GPU is done with the current frame
+    void FreeGeneralHeapID(unsigned int id, unsigned int count=1);
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE GetGeneralHeapCPUHandle(unsigned int id) const
+    {
+        return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_generalHeapShaderInvisible->GetCPUDescriptorHandleForHeapStart(), (INT)id, m_generalHeapDescriptorSize);
+    }
+
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GetGeneralHeapGPUHandle(unsigned int id) const
     {
-        unsigned int ret = m_generalHeapDescriptorNextID;
-        m_generalHeapDescriptorNextID += count;
-        return ret;
+        return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_generalHeap->GetGPUDescriptorHandleForHeapStart(), (INT)id, m_generalHeapDescriptorSize);
     }
 
+    void CommitGeneralHeapDescriptors(unsigned int id, unsigned int count=1);
+
+    // Builds a descriptor table that lasts until the end of this frame, by copying general heap descriptors from the
+    // staging heap into the ring at the end of the shader visible heap. Asking for the same table twice in a frame
+    // gives the same one back.
+    CD3DX12_GPU_DESCRIPTOR_HANDLE MakeTransientDescriptorTable(const unsigned int* ids, unsigned int count);
+
+    void GrowGeneralHeap(unsigned int count);
+
+    // Gives upload heap memory that lasts until the end of this frame, from a ring in one persistently mapped buffer.
+    // The default alignment is what constant buffers need.
+    SUploadAllocation AllocateUpload(UINT64 size, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    // copies constants into the upload ring, for binding as a root CBV this frame
+    template <typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS UploadConstants(const T& data)
+    {
+        SUploadAllocation allocation = AllocateUpload(sizeof(T));
+        memcpy(allocation.m_cpuAddress, &data, sizeof(T));
+        return allocation.m_gpuAddress;
+    }
+
+    // binds the general heap, and the sampler heap if there is one
+    void SetDescriptorHeaps(cdCommandRecorderDX12& recorder);
+
+    // Closing the command list submits the frame, and moves on to recording the next one
     bool CloseAndExecuteCommandList();
     bool OpenCommandList(ID3D12RootSignature* rootSignature, ID3D12PipelineState* pso);
 
-    void OnFrameComplete()
+    // Waits until the GPU is done with the frame that last used the context of the frame being recorded, and frees
+    // what the finished frames held on to. This has to happen before the CPU writes anything for the frame.
+    void AcquireFrame();
+
+    // waits until the GPU is done with everything that was submitted, on both queues
+    void WaitForGPU();
+
+    // The compute queue runs work that nothing needs right away, like making mips, alongside the graphics queue. Its
+    // command lists come from the frame context being recorded, open with the descriptor heaps and root signature set.
+    // Submitting one signals the compute fence with the value it returns. Deferred frees go by the graphics fence, so
+    // what compute work uses has to be kept until a graphics frame that waited for it.
+    ID3D12GraphicsCommandList* OpenComputeCommandList(ID3D12RootSignature* rootSignature, ID3D12PipelineState* pso);
+    UINT64 SubmitComputeCommandList(ID3D12GraphicsCommandList* commandList);
+
+    // Barriers for the compute command list wait in m_computeBarrierBatch, like the graphics ones do, until
+    // FlushComputeBarriers records them on it. Submitting the compute command list flushes.
+    void ComputeTransition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+    void FlushComputeBarriers(ID3D12GraphicsCommandList* commandList);
+
+    // the graphics fence value of the last frame submitted
+    UINT64 GetSubmittedGraphicsFenceValue() const
     {
-        for (ID3D12Resource* r : m_textureUploadHeaps)
-            SAFE_RELEASE(r);
+        return m_framePacer.m_frameNumber;
+    }
+
+    // Make the queue wait on the GPU until the other queue's fence gets to the value, which has to be submitted already.
+    // The compute queue waits before its next submit, and the graphics queue before the frame being recorded. Waits that
+    // an earlier one covers, or that the CPU saw complete, are skipped.
+    void ComputeWaitForGraphics(UINT64 graphicsFenceValue);
+    void GraphicsWaitForCompute(UINT64 computeFenceValue);
 
-        m_textureUploadHeaps.clear();
+    // Records count command lists at once, calling work(recorder, index) for each on its own thread. The main command
+    // list so far is submitted before them, and a new main one after them. Every command list starts out with just the
+    // root signature, descriptor heaps and PIX event of the render graph pass set, so the work and the main command list after it have to bind the rest.
+    // Nothing else may use the graphics API until it returns.
+    template <typename LAMBDA>
+    void RecordInParallel(size_t count, ID3D12RootSignature* rootSignature, const LAMBDA& work)
+    {
+        BeginParallelRecording(count, rootSignature);
+        ParallelFor(count, 1,
+            [&] (size_t begin, size_t end)
+            {
+                for (size_t index = begin; index < end; ++index)
+                    work(m_parallelRecorders[index], index);
+            },
+            count
+        );
+        EndParallelRecording(rootSignature);
     }
 
+    // Barriers wait in m_barrierBatch until FlushBarriers records them on the main command list with one ResourceBarrier
+    // call. Flush before the commands that need them. Closing the command list and starting parallel recording flush.
+    void Transition(ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, UINT subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE);
+    void UAVBarrier(ID3D12Resource* resource);
+    void AliasingBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter);
+    void FlushBarriers();
+
+    // A render graph texture desc, with the size and alignment the device says the texture needs. Render targets and
+    // depth buffers go in one heap group and other textures in another, which is what resource heap tier 1 needs.
+    SRenderGraphTextureDesc MakeRenderGraphTextureDesc(DXGI_FORMAT format, UINT width, UINT height, UINT arraySize, D3D12_RESOURCE_FLAGS flags);
+
+    // Makes the heaps, transient textures and views the compiled graph needs, keeping the ones from the last graph that
+    // still fit. Making views can grow the general heap, which moves it and empties the transient descriptor ring, so
+    // the frame makes its descriptor tables and GPU handles after this.
+    void RealizeRenderGraph(const SRenderGraph& graph, const SRenderGraphCompiled& compiled);
+
+    // Records the barriers and passes of the realized graph on the main command list. The graph's views are general heap
+    // IDs, which keep their place when the heap grows, so passes that grow it only have to remake their own tables.
+    void ExecuteRenderGraph(const SRenderGraph& graph, const SRenderGraphCompiled& compiled);
+
+    // These are for the passes of the graph being executed. The views are of transient textures.
+    ID3D12Resource* GetRenderGraphResource(const SRenderGraph& graph, UINT32 resource) const;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE GetRenderGraphRTV(UINT32 resource) const;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE GetRenderGraphDSV(UINT32 resource) const;
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GetRenderGraphSRV(UINT32 resource) const;
+    CD3DX12_GPU_DESCRIPTOR_HANDLE GetRenderGraphUAV(UINT32 resource) const;
+    CD3DX12_CPU_DESCRIPTOR_HANDLE GetRenderGraphUAVStaging(UINT32 resource) const;
+
+    // For objects that the GPU may still be using, like resources and heaps. This takes over the caller's reference,
+    // and releases it once the GPU is done with the frame being recorded.
+    void DeferRelease(ID3D12Pageable* object);
+
     void Destroy()
     {
         for (ID3D12Resource* r : m_renderTargetsColor)
             SAFE_RELEASE(r);
         m_renderTargetsColor.clear();
 
-        for (ID3D12Resource* r : m_textureUploadHeaps)
-            SAFE_RELEASE(r);
+        // the caller waited for the GPU, and nothing recorded since was submitted
+        RetireDeferredReleases(UINT64(-1));
+
+        for (SFrameContext& context : m_frameContexts)
+        {
+            for (ID3D12GraphicsCommandList* commandList : context.m_commandLists)
+                commandList->Release();
+            for (ID3D12CommandAllocator* commandAllocator : context.m_commandAllocators)
+                commandAllocator->Release();
+            for (ID3D12GraphicsCommandList* commandList : context.m_computeCommandLists)
+                commandList->Release();
+            for (ID3D12CommandAllocator* commandAllocator : context.m_computeCommandAllocators)
+                commandAllocator->Release();
+            context = SFrameContext();
+        }
+        m_commandList = nullptr;
+
+        SAFE_RELEASE(m_fence);
+        SAFE_RELEASE(m_computeFence);
+        if (m_fenceEvent)
+        {
+            CloseHandle(m_fenceEvent);
+            m_fenceEvent = nullptr;
+        }
+
+        if (m_frameLatencyWaitableObject)
+        {
+            CloseHandle(m_frameLatencyWaitableObject);
+            m_frameLatencyWaitableObject = nullptr;
+        }
+
+        SAFE_RELEASE(m_timestampQueryHeap);
+        SAFE_RELEASE(m_timestampReadback);
+
+        for (SRenderGraphTextureDX12& texture : m_renderGraphTextures)
+            SAFE_RELEASE(texture.m_resource);
+        m_renderGraphTextures.clear();
+        for (SRenderGraphHeapDX12& heap : m_renderGraphHeaps)
+            SAFE_RELEASE(heap.m_heap);
+        m_renderGraphHeaps.clear();
 
-        SAFE_RELEASE(m_depthStencil);
         SAFE_RELEASE(m_rtvHeap);
         SAFE_RELEASE(m_dsvHeap);
         SAFE_RELEASE(m_samplerHeap);
         SAFE_RELEASE(m_generalHeap);
         SAFE_RELEASE(m_generalHeapShaderInvisible);
+        SAFE_RELEASE(m_uploadBuffer);
         SAFE_RELEASE(m_swapChain);
-        SAFE_RELEASE(m_commandList);
-        SAFE_RELEASE(m_commandAllocator);
+        SAFE_RELEASE(m_computeQueue);
         SAFE_RELEASE(m_commandQueue);
         SAFE_RELEASE(m_device);
     }
 
     ID3D12Device* m_device = nullptr;
     ID3D12CommandQueue* m_commandQueue = nullptr;
+    ID3D12CommandQueue* m_computeQueue = nullptr;
     IDXGISwapChain3* m_swapChain = nullptr;
-    ID3D12CommandAllocator* m_commandAllocator = nullptr;
-    ID3D12GraphicsCommandList* m_commandList = nullptr;
+
+    // Frame n signals fence value n + 1 when the GPU is done with it. The frame pacer says which context a frame uses,
+    // and what it has to wait for.
+    ID3D12Fence* m_fence = nullptr;
+    HANDLE m_fenceEvent = nullptr;
+    SFramePacer m_framePacer;
+    SFrameContext m_frameContexts[c_framesInFlight];
+
+    // The compute queue signals its own fence, counting up from 1 with each submit. m_queueSync has what each queue
+    // signaled and waited for.
+    ID3D12Fence* m_computeFence = nullptr;
+    SQueueSync m_queueSync;
+
+    // the barriers waiting to be recorded, and the stats of how many were asked for and issued
+    SBarrierBatch m_barrierBatch;
+    SBarrierBatch m_computeBarrierBatch;
+    std::vector<SBarrier> m_barriersFlushed;
+    std::vector<D3D12_RESOURCE_BARRIER> m_barriersD3D12;
+
+    // objects and general heap descriptors that are let go of once the GPU is done with them
+    SDeferredReleaseQueue m_deferredReleases;
+
+    // Each frame context has a pair of timestamps around its command list, read back when the context is reused. The
+    // times are of the last frame measured, and the CPU time doesn't include waiting to start the frame.
+    ID3D12QueryHeap* m_timestampQueryHeap = nullptr;
+    ID3D12Resource* m_timestampReadback = nullptr;
+    UINT64 m_timestampFrequency = 0;
+    std::chrono::high_resolution_clock::time_point m_frameStartTime;
+    double m_cpuFrameMilliseconds = 0.0;
+    double m_gpuFrameMilliseconds = 0.0;
+
+    // only there if the swap chain was made frame latency waitable
+    HANDLE m_frameLatencyWaitableObject = nullptr;
+    SFrameLatencyController m_frameLatency;
 
     std::vector<ID3D12Resource*> m_renderTargetsColor;
-    ID3D12Resource* m_depthStencil = nullptr;
+
+    // The render graph's heaps, and its transient textures by resource index. The RTVs of the textures go after the
+    // back buffers' in the RTV heap, and their DSVs are at their resource index in the DSV heap.
+    std::vector<SRenderGraphHeapDX12> m_renderGraphHeaps;
+    std::vector<SRenderGraphTextureDX12> m_renderGraphTextures;
 
     ID3D12DescriptorHeap* m_rtvHeap = nullptr;
     ID3D12DescriptorHeap* m_dsvHeap = nullptr;
     ID3D12DescriptorHeap* m_samplerHeap = nullptr;
     ID3D12DescriptorHeap* m_generalHeap = nullptr;
-    ID3D12DescriptorHeap* m_generalHeapShaderInvisible = nullptr;
+    ID3D12DescriptorHeap* m_generalHeapShaderInvisible = nullptr;   // the staging copy of m_generalHeap
 
     unsigned int m_rtvHeapDescriptorSize = 0;
     unsigned int m_dsvHeapDescriptorSize = 0;
     unsigned int m_samplerHeapDescriptorSize = 0;
     unsigned int m_generalHeapDescriptorSize = 0;
 
-    unsigned int m_generalHeapDescriptorNextID = 0;
+    SDescriptorAllocator m_generalHeapAllocator;
+
+    // lives in the shader visible general heap, after the descriptors that m_generalHeapAllocator hands out
+    SDescriptorRing m_transientDescriptorRing;
+
+    // persistently mapped, and handed out by m_uploadRing
+    ID3D12Resource* m_uploadBuffer = nullptr;
+    unsigned char* m_uploadBufferBegin = nullptr;
+    SUploadRing m_uploadRing;
+
+    // which version of per frame resources the frame being recorded uses
+    unsigned int GetFrameSlot() const
+    {
+        return FramePacerContext(m_framePacer);
+    }
+
+    // the fence value that says the GPU is done with the frame being recorded, for deferring frees
+    UINT64 GetFrameFenceValue() const
+    {
+        return FramePacerFenceValue(m_framePacer);
+    }
+
+    bool m_commandListOpen = false;
+
+    // whether vertex shaders can pick the render target array slice without the driver emulating it with a geometry shader
+    bool m_renderTargetArrayIndexFromVS = false;
+
+    // whether a descriptor table can have an SRV range over the whole heap, which is resource binding tier 2
+    bool m_bindlessSupported = false;
+
+private:
+    // The next command list of the frame context, reset and open. It is submitted after the ones taken before it.
+    ID3D12GraphicsCommandList* TakeCommandList(ID3D12PipelineState* pso);
+    void BeginRecording(cdCommandRecorderDX12& recorder, ID3D12RootSignature* rootSignature, ID3D12PipelineState* pso);
+    void BeginParallelRecording(size_t count, ID3D12RootSignature* rootSignature);
+    void EndParallelRecording(ID3D12RootSignature* rootSignature);
+
+    // records the barriers of the batch on the command list with one ResourceBarrier call
+    void FlushBarrierBatch(SBarrierBatch& batch, ID3D12GraphicsCommandList* commandList);
+
+    std::vector<cdCommandRecorderDX12> m_parallelRecorders;
+
+    // The PIX event of the render graph pass being executed. PIX events can't span command lists, so parallel recording
+    // ends it on the main command list and begins it again on each command list recorded after that.
+    const char* m_passEvent = nullptr;
+
+    void WaitForFenceValue(ID3D12Fence* fence, UINT64 fenceValue);
+    void ReadFrameTimestamps(unsigned int context);
+    void RetireCompletedFrames();
+    void RetireDeferredReleases(UINT64 completedFenceValue);
 
-    // kept until the texture uploads are done
-    std::vector<ID3D12Resource*>    m_textureUploadHeaps;
+    void ReleaseRenderGraphTexture(SRenderGraphTextureDX12& texture);
 };
 
 // Number of descriptors allowed of each type. Increase these counts if needed
 static const unsigned int c_maxRTVDescriptors = 50; // Render Target Views
 static const unsigned int c_maxDSVDescriptors = 50; // Depth Stencil Views
-static const unsigned int c_maxSamplerDescriptors = 10; // Texture Samplers
-static const unsigned int c_maxGeneralDescriptors = 200; // Shader Resource Views, unordered access views, constant buffer views
\ No newline at end of file
+static const unsigned int c_initialGeneralDescriptors = 200; // Shader Resource Views, unordered access views, constant buffer views. This heap grows as needed.
+static const unsigned int c_transientDescriptors = 1024; // descriptor tables made each frame, for all the frames the GPU hasn't finished
+static const unsigned int c_maxTransientDescriptorTableSize = 16;
+static const UINT64 c_uploadRingSize = 16 * 1024 * 1024; // bytes of upload memory for all the frames the GPU hasn't finished
\ No newline at end of file
@@ -15,6 +15,8 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
@@ -30,3 +32,25 @@
 #include <string>
 #include <wrl.h>
 #include <shellapi.h>
+
+#else
+
+// Off Windows only the modules that don't use D3D12 are built, for the tests in Tests.cpp, so this is just the
+// Windows types and macros that they use.
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+
+typedef uint8_t     UINT8;
+typedef uint16_t    UINT16;
+typedef uint32_t    UINT32;
+typedef uint64_t    UINT64;
+typedef int64_t     INT64;
+typedef unsigned int UINT;
+typedef uint32_t    DWORD;
+typedef int         BOOL;
+
+#define _countof(array) (sizeof(array) / sizeof((array)[0]))
+
+#endif